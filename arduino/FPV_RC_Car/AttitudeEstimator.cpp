@@ -0,0 +1,101 @@
+#include "AttitudeEstimator.h"
+#include <math.h>
+
+#define DEG_TO_RAD_F 0.017453292f
+#define RAD_TO_DEG_F 57.29578f
+
+void AttitudeEstimator::update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+  gx *= DEG_TO_RAD_F;
+  gy *= DEG_TO_RAD_F;
+  gz *= DEG_TO_RAD_F;
+
+  // the car's own acceleration, the turn's is the speed times the rate around Z. The speed
+  // is differentiated rather than the accelerometer used, that would cancel the tilt it reads
+  if (dt > 0) {
+    float rate = dt < ATTITUDE_ACCEL_TAU ? dt / ATTITUDE_ACCEL_TAU : 1.0f;
+    accel += ((speed - previous_speed) / dt - accel) * rate;
+    previous_speed = speed;
+  }
+  ax -= accel / ATTITUDE_GRAVITY;
+  ay -= speed * gz / ATTITUDE_GRAVITY;
+
+  // what is left should be gravity alone, bumps and crashes fade the correction out
+  float accel_norm = sqrtf(ax * ax + ay * ay + az * az);
+  float weight = 2.0f - fabsf(accel_norm - 1.0f) / ATTITUDE_ACCEL_BAND;
+  if (weight > 1.0f) weight = 1.0f;
+  if (weight > 0.0f) {
+    float inv_norm = 1.0f / accel_norm;
+    ax *= inv_norm;
+    ay *= inv_norm;
+    az *= inv_norm;
+
+    // gravity direction predicted by the current attitude
+    float vx = 2.0f * (q1 * q3 - q0 * q2);
+    float vy = 2.0f * (q0 * q1 + q2 * q3);
+    float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+    // error is the cross product between measured and predicted gravity
+    float ex = (ay * vz - az * vy) * weight;
+    float ey = (az * vx - ax * vz) * weight;
+    float ez = (ax * vy - ay * vx) * weight;
+
+    integral_x += ATTITUDE_KI * ex * dt;
+    integral_y += ATTITUDE_KI * ey * dt;
+    float cx = ATTITUDE_KP * ex + integral_x;
+    float cy = ATTITUDE_KP * ey + integral_y;
+    float cz = ATTITUDE_KP * ez;
+    // gravity says nothing about the heading, the part of the correction around it goes
+    float vertical = cx * vx + cy * vy + cz * vz;
+    gx += cx - vertical * vx;
+    gy += cy - vertical * vy;
+    gz += cz - vertical * vz;
+  }
+
+  float half_dt = 0.5f * dt;
+  gx *= half_dt;
+  gy *= half_dt;
+  gz *= half_dt;
+  float a = q0, b = q1, c = q2;
+  q0 += -b * gx - c * gy - q3 * gz;
+  q1 += a * gx + c * gz - q3 * gy;
+  q2 += a * gy - b * gz + q3 * gx;
+  q3 += a * gz + b * gy - c * gx;
+
+  float inv_norm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= inv_norm;
+  q1 *= inv_norm;
+  q2 *= inv_norm;
+  q3 *= inv_norm;
+}
+
+void AttitudeEstimator::reset() {
+  q0 = 1;
+  q1 = q2 = q3 = 0;
+  integral_x = integral_y = 0;
+}
+
+void AttitudeEstimator::setSpeed(float speed) {
+  this->speed = speed;
+}
+
+void AttitudeEstimator::getQuaternion(float *w, float *x, float *y, float *z) {
+  *w = q0;
+  *x = q1;
+  *y = q2;
+  *z = q3;
+}
+
+float AttitudeEstimator::getRoll() {
+  return atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * RAD_TO_DEG_F;
+}
+
+float AttitudeEstimator::getPitch() {
+  float s = 2.0f * (q0 * q2 - q3 * q1);
+  if (s > 1.0f) s = 1.0f;
+  if (s < -1.0f) s = -1.0f;
+  return asinf(s) * RAD_TO_DEG_F;
+}
+
+float AttitudeEstimator::getYaw() {
+  return atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) * RAD_TO_DEG_F;
+}
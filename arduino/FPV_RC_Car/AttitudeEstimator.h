@@ -0,0 +1,39 @@
+#ifndef ATTITUDE_ESTIMATOR_H
+#define ATTITUDE_ESTIMATOR_H
+
+#include <stdint.h>
+
+#define ATTITUDE_KP 2.0f  // proportional gain pulling the estimate towards the accelerometer
+#define ATTITUDE_KI 0.05f // integral gain, slowly absorbs the remaining X/Y gyro bias
+#define ATTITUDE_ACCEL_BAND 0.1f // g off 1 g the correction counts in full, none at twice that
+#define ATTITUDE_ACCEL_TAU 0.05f // s, low-pass on the car's acceleration taken from its speed
+#define ATTITUDE_GRAVITY 9.80665f
+
+// Mahony complementary filter in single precision.
+// Gyro rates are integrated into a quaternion and the error between the predicted and the
+// measured gravity vector is fed back as a rate correction. There is no magnetometer, so
+// yaw is gyro-only and relies on the bias from GyroCalibration: the correction is kept off
+// the vertical and the integral only runs on X/Y. The accelerometer reads the car's own
+// acceleration as well, setSpeed() takes it out, and what is left only counts in full while
+// its magnitude is within ATTITUDE_ACCEL_BAND of 1 g. X is the axis along the car, Z up.
+class AttitudeEstimator {
+  public:
+    // gyro in deg/s, accel in g (any scale, it is normalized), dt in seconds
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    // Speed of the car along X in m/s, before every update. The acceleration along the car is
+    // its rate of change and the turn's centripetal acceleration the speed times the Z rate
+    void setSpeed(float speed);
+    void reset();
+    void getQuaternion(float *w, float *x, float *y, float *z);
+    // Euler angles in degrees, computed on demand since the hot path only needs the quaternion
+    float getRoll();
+    float getPitch();
+    float getYaw();
+
+  private:
+    float q0 = 1, q1 = 0, q2 = 0, q3 = 0;
+    float integral_x = 0, integral_y = 0;
+    float speed = 0, previous_speed = 0, accel = 0;
+};
+
+#endif // ATTITUDE_ESTIMATOR_H
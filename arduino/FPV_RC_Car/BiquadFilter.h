@@ -0,0 +1,169 @@
+#ifndef BIQUAD_FILTER_H
+#define BIQUAD_FILTER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Second order IIR sections with RBJ cookbook coefficients.
+// The coefficient helpers are constexpr (C++11 style, single expression) so fixed filters are
+// computed by the compiler, the same helpers also work at runtime for the dynamic notch.
+
+#define BIQUAD_Q_BUTTERWORTH 0.70710678f
+#define BIQUAD_FIXED_SHIFT 29  // coefficients are Q2.29 in the fixed point filter
+#define BIQUAD_SAMPLE_SHIFT 16 // samples are Q16.16 in the fixed point filter
+
+struct BiquadCoefficients {
+  float b0, b1, b2, a1, a2;
+};
+
+namespace biquad {
+  constexpr double PI_D = 3.14159265358979323846;
+
+  constexpr double sinSeries(double x2, double term, int n) {
+    return (term < 1e-12 && term > -1e-12) ? term : term + sinSeries(x2, -term * x2 / ((2 * n + 2) * (2 * n + 3)), n + 1);
+  }
+
+  constexpr double cosSeries(double x2, double term, int n) {
+    return (term < 1e-12 && term > -1e-12) ? term : term + cosSeries(x2, -term * x2 / ((2 * n + 1) * (2 * n + 2)), n + 1);
+  }
+
+  constexpr double sin(double x) {
+    return sinSeries(x * x, x, 0);
+  }
+
+  constexpr double cos(double x) {
+    return cosSeries(x * x, 1.0, 0);
+  }
+
+  constexpr double omega(float frequency, float sample_rate) {
+    return 2.0 * PI_D * frequency / sample_rate;
+  }
+
+  constexpr BiquadCoefficients lowpassFromTrig(double c, double alpha) {
+    return BiquadCoefficients{(float)((1.0 - c) / 2.0 / (1.0 + alpha)), (float)((1.0 - c) / (1.0 + alpha)), (float)((1.0 - c) / 2.0 / (1.0 + alpha)),
+                              (float)(-2.0 * c / (1.0 + alpha)), (float)((1.0 - alpha) / (1.0 + alpha))};
+  }
+
+  constexpr BiquadCoefficients notchFromTrig(double c, double alpha) {
+    return BiquadCoefficients{(float)(1.0 / (1.0 + alpha)), (float)(-2.0 * c / (1.0 + alpha)), (float)(1.0 / (1.0 + alpha)),
+                              (float)(-2.0 * c / (1.0 + alpha)), (float)((1.0 - alpha) / (1.0 + alpha))};
+  }
+}
+
+constexpr BiquadCoefficients biquadLowpass(float cutoff, float sample_rate, float q = BIQUAD_Q_BUTTERWORTH) {
+  return biquad::lowpassFromTrig(biquad::cos(biquad::omega(cutoff, sample_rate)), biquad::sin(biquad::omega(cutoff, sample_rate)) / (2.0 * q));
+}
+
+constexpr BiquadCoefficients biquadNotch(float center, float sample_rate, float q) {
+  return biquad::notchFromTrig(biquad::cos(biquad::omega(center, sample_rate)), biquad::sin(biquad::omega(center, sample_rate)) / (2.0 * q));
+}
+
+constexpr BiquadCoefficients biquadPassthrough() {
+  return BiquadCoefficients{1, 0, 0, 0, 0};
+}
+
+// Runtime variant using the libm trig functions, for coefficients that change while driving
+inline BiquadCoefficients biquadNotchRuntime(float center, float sample_rate, float q) {
+  float w = 2.0f * (float)biquad::PI_D * center / sample_rate;
+  return biquad::notchFromTrig(cosf(w), sinf(w) / (2.0f * q));
+}
+
+// Notch on the motor rotation frequency, passthrough while it is outside the usable band
+inline BiquadCoefficients biquadMotorNotch(float motor_erpm, float motor_poles, float sample_rate, float q, float min_hz) {
+  float motor_hz = fabsf(motor_erpm) / motor_poles / 60.0f;
+  if (motor_hz < min_hz || motor_hz > sample_rate * 0.45f) {
+    return biquadPassthrough();
+  }
+  return biquadNotchRuntime(motor_hz, sample_rate, q);
+}
+
+// Float section, transposed direct form II
+template <typename T>
+class Biquad {
+  public:
+    void setCoefficients(const BiquadCoefficients &c) {
+      b0 = c.b0; b1 = c.b1; b2 = c.b2; a1 = c.a1; a2 = c.a2;
+    }
+
+    T process(T x) {
+      T y = b0 * x + z1;
+      z1 = b1 * x - a1 * y + z2;
+      z2 = b2 * x - a2 * y;
+      return y;
+    }
+
+    void reset() {
+      z1 = z2 = 0;
+    }
+
+  private:
+    T b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    T z1 = 0, z2 = 0;
+};
+
+// Fixed point section on Q16.16 samples, direct form I with a 64 bit accumulator so the
+// state never needs headroom of its own
+template <>
+class Biquad<int32_t> {
+  public:
+    void setCoefficients(const BiquadCoefficients &c) {
+      b0 = toFixed(c.b0); b1 = toFixed(c.b1); b2 = toFixed(c.b2); a1 = toFixed(c.a1); a2 = toFixed(c.a2);
+    }
+
+    int32_t process(int32_t x) {
+      int64_t acc = (int64_t)b0 * x + (int64_t)b1 * x1 + (int64_t)b2 * x2 - (int64_t)a1 * y1 - (int64_t)a2 * y2;
+      int32_t y = (int32_t)(acc >> BIQUAD_FIXED_SHIFT);
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+      return y;
+    }
+
+    void reset() {
+      x1 = x2 = y1 = y2 = 0;
+    }
+
+  private:
+    static int32_t toFixed(float v) {
+      return (int32_t)lroundf(v * (float)(1L << BIQUAD_FIXED_SHIFT));
+    }
+
+    int32_t b0 = 1L << BIQUAD_FIXED_SHIFT, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    int32_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+};
+
+inline int32_t biquadToFixed(float v) {
+  return (int32_t)(v * (float)(1L << BIQUAD_SAMPLE_SHIFT));
+}
+
+inline float biquadFromFixed(int32_t v) {
+  return (float)v / (float)(1L << BIQUAD_SAMPLE_SHIFT);
+}
+
+// N cascaded sections, processed in order
+template <typename T, int N>
+class FilterChain {
+  public:
+    void setStage(int stage, const BiquadCoefficients &c) {
+      stages[stage].setCoefficients(c);
+    }
+
+    T process(T x) {
+      for (int i = 0; i < N; i++) {
+        x = stages[i].process(x);
+      }
+      return x;
+    }
+
+    void reset() {
+      for (int i = 0; i < N; i++) {
+        stages[i].reset();
+      }
+    }
+
+  private:
+    Biquad<T> stages[N];
+};
+
+#endif // BIQUAD_FILTER_H
@@ -0,0 +1,127 @@
+#include "BrakeControl.h"
+#include <math.h>
+
+#define BRAKE_FREE_SHARE 0.1f // of the requested current, below it a wheel following the car rolls free
+
+BrakeControl::BrakeControl(float standstill, float slip_max, float decel_margin, float release, float reapply) {
+  this->standstill = standstill;
+  this->slip_max = slip_max;
+  this->decel_margin = decel_margin;
+  this->release = release;
+  this->reapply = reapply;
+}
+
+void BrakeControl::setCurve(float max_current, float expo) {
+  this->max_current = max_current;
+  this->expo = expo;
+}
+
+void BrakeControl::setModulation(bool enabled) {
+  modulation = enabled;
+}
+
+void BrakeControl::update(float command, float wheel_speed, float accel, float dt) {
+  if (state == BrakeState::BRAKE) {
+    // the car slows as the accelerometer says, a wheel rolling faster than that is right
+    // but it doesn't roll back through zero
+    if (reference_speed > 0) {
+      reference_speed = fmaxf(reference_speed + accel * dt, 0.0f);
+      reference_speed = fmaxf(reference_speed, wheel_speed);
+    } else {
+      reference_speed = fminf(reference_speed + accel * dt, 0.0f);
+      reference_speed = fminf(reference_speed, wheel_speed);
+    }
+  } else {
+    reference_speed = wheel_speed;
+  }
+  bool stopped = fabsf(reference_speed) <= standstill && fabsf(wheel_speed) <= standstill;
+  if (stopped && fabsf(command) < BRAKE_NEUTRAL) {
+    reverse_armed = true;
+  } else if (!stopped && reference_speed > 0) {
+    reverse_armed = false;
+  }
+
+  BrakeState next;
+  if (command > BRAKE_NEUTRAL) {
+    next = reference_speed < -standstill ? BrakeState::BRAKE : BrakeState::FORWARD;
+  } else if (command < -BRAKE_NEUTRAL) {
+    if (reference_speed > standstill || (stopped && !reverse_armed)) {
+      next = BrakeState::BRAKE;
+    } else {
+      next = BrakeState::REVERSE;
+    }
+  } else {
+    next = reference_speed < -standstill ? BrakeState::REVERSE : BrakeState::FORWARD;
+  }
+
+  float magnitude = fabsf(command);
+  float requested = max_current * ((1 - expo) * magnitude + expo * magnitude * magnitude * magnitude);
+  float direction = reference_speed > 0 ? 1.0f : -1.0f;
+  float speed = fabsf(reference_speed);
+  slip = next == BrakeState::BRAKE && speed > standstill ? (speed - direction * wheel_speed) / speed : 0;
+  if (next != BrakeState::BRAKE) {
+    brake_current = 0;
+    releasing = false;
+  } else if (state != BrakeState::BRAKE || !modulation) {
+    current_limit = requested;
+    brake_current = requested;
+  } else {
+    // how much faster the wheel slows than the car
+    float excess_decel = direction * (previous_wheel - wheel_speed) / dt + direction * accel;
+    bool locking = speed > standstill && (slip > slip_max || excess_decel > decel_margin);
+    if (releasing && brake_current < requested * BRAKE_FREE_SHARE && fabsf(excess_decel) < decel_margin / 2) {
+      // with the brake all but off the wheel's speed is the car's, the accelerometer's drift
+      // in the reference goes with it
+      reference_speed = wheel_speed;
+      slip = 0;
+      releasing = false;
+    } else if (locking) {
+      if (!releasing) {
+        lock_count++;
+      }
+      releasing = true;
+      current_limit = brake_current * release;
+    } else if (releasing && slip < slip_max / 2) {
+      releasing = false;
+    } else if (!releasing) {
+      current_limit += reapply * dt;
+    }
+    current_limit = current_limit < requested ? current_limit : requested;
+    brake_current = current_limit;
+  }
+  state = next;
+  previous_wheel = wheel_speed;
+}
+
+BrakeState BrakeControl::getState() {
+  return state;
+}
+
+float BrakeControl::driveCommand(float command) {
+  if (state == BrakeState::FORWARD) {
+    return command > 0 ? command : 0;
+  } else if (state == BrakeState::REVERSE) {
+    return command < 0 ? command : 0;
+  }
+  return 0;
+}
+
+float BrakeControl::getBrakeCurrent() {
+  return brake_current;
+}
+
+float BrakeControl::getReferenceSpeed() {
+  return reference_speed;
+}
+
+float BrakeControl::getSlip() {
+  return slip;
+}
+
+bool BrakeControl::isReleasing() {
+  return releasing;
+}
+
+uint16_t BrakeControl::getLockCount() {
+  return lock_count;
+}
@@ -0,0 +1,59 @@
+#ifndef BRAKE_CONTROL_H
+#define BRAKE_CONTROL_H
+
+#include <stdint.h>
+
+#define BRAKE_NEUTRAL 0.05f // throttle commands within this of 0 count as a centered stick
+
+enum class BrakeState : uint8_t { FORWARD, BRAKE, REVERSE };
+
+// Throttle stick to VESC setpoints with regenerative braking. Pulling the stick against the
+// direction the car rolls brakes with a brake current from the curve instead of asking the
+// motor for reverse RPM. Reverse is only driven from standstill, and only once the stick has
+// been centered there, so holding the brake keeps the car stopped. While braking the speed
+// of the car is carried on by the accelerometer, since a locking wheel takes the ERPM down
+// with it. A wheel that slips more than slip_max behind that speed, or slows faster than the
+// accelerometer by decel_margin, is locking: the brake current drops to release of what it
+// was while it is, then comes back at reapply A/s once the slip has halved.
+class BrakeControl {
+  public:
+    // standstill in m/s, decel_margin in m/s^2, reapply in A/s
+    BrakeControl(float standstill, float slip_max, float decel_margin, float release, float reapply);
+    // max_current in A at full stick, expo 0 is linear and 1 cubic
+    void setCurve(float max_current, float expo);
+    void setModulation(bool enabled);
+    // Call at a fixed rate. command is the throttle in -1..1, wheel_speed the signed m/s from
+    // the ERPM, accel the IMU's m/s^2 along the car
+    void update(float command, float wheel_speed, float accel, float dt);
+    BrakeState getState();
+    // The throttle command that may go to the VESC as RPM, 0 while braking or against the
+    // direction update() last allowed
+    float driveCommand(float command);
+    float getBrakeCurrent(); // A, 0 unless braking
+    float getReferenceSpeed(); // m/s, the car's speed as the brake sees it
+    float getSlip(); // share the wheel is slower than the car while braking
+    bool isReleasing(); // the brake current is held back for a locking wheel
+    uint16_t getLockCount(); // locks detected since power up
+
+  private:
+    float standstill;
+    float slip_max;
+    float decel_margin;
+    float release;
+    float reapply;
+    float max_current = 0;
+    float expo = 0;
+    bool modulation = true;
+
+    BrakeState state = BrakeState::FORWARD;
+    bool reverse_armed = false;
+    float reference_speed = 0;
+    float previous_wheel = 0;
+    float current_limit = 0;
+    float brake_current = 0;
+    float slip = 0;
+    bool releasing = false;
+    uint16_t lock_count = 0;
+};
+
+#endif // BRAKE_CONTROL_H
@@ -0,0 +1,73 @@
+#include "CRSFLink.h"
+
+void CRSFLink::begin(HardwareSerial *serial) {
+  this->serial = serial;
+  serial->begin(CRSF_BAUDRATE);
+}
+
+void CRSFLink::receive(const uint8_t *data, uint16_t length, uint32_t now_us) {
+  // the capture records keep their 16 byte bursts
+  if (receive_tap != NULL) {
+    for (uint16_t i = 0; i < length; i += 16) {
+      receive_tap(data + i, length - i < 16 ? length - i : 16, now_us);
+    }
+  }
+  for (uint16_t i = 0; i < length; i++) {
+    if (parser.feed(data[i], now_us)) {
+      handleFrame(&parser.frame, now_us);
+    }
+  }
+}
+
+void CRSFLink::handleFrame(const crsfFrame_t *frame, uint32_t now_us) {
+  if (frame->frame.type == CRSF_FRAMETYPE_RC_CHANNELS_PACKED) {
+    crsfUnpackChannels(frame->frame.payload, channels);
+    last_frame_timestamp = millis();
+    last_channels_us = now_us;
+    channel_frames++;
+  } else if (frame->frame.type == CRSF_FRAMETYPE_LINK_STATISTICS) {
+    if (crsfUnpackLinkStatistics(frame, &link_statistics)) {
+      new_link_statistics = true;
+    }
+  } else if (frame->frame.type >= CRSF_FRAMETYPE_DEVICE_PING && extended_handler != NULL) {
+    extended_handler(frame);
+  }
+}
+
+void CRSFLink::setExtendedFrameHandler(crsfFrameHandler_t handler) {
+  extended_handler = handler;
+}
+
+void CRSFLink::setReceiveTap(crsfReceiveTap_t tap) {
+  receive_tap = tap;
+}
+
+bool CRSFLink::takeLinkStatistics() {
+  bool taken = new_link_statistics;
+  new_link_statistics = false;
+  return taken;
+}
+
+float CRSFLink::getChannelFloat(int channel) {
+  return crsfChannelToFloat(channels[channel]);
+}
+
+uint16_t CRSFLink::getChannelRaw(int channel) {
+  return channels[channel];
+}
+
+void CRSFLink::transmitFrame(const uint8_t *frame, uint8_t length) {
+  if (length > 0) {
+    serial->write(frame, length);
+  }
+}
+
+void CRSFLink::transmitGpsFrame(crsfGpsFrame_t frame) {
+  uint8_t buffer[CRSF_FRAME_SIZE_MAX];
+  transmitFrame(buffer, crsfBuildGpsFrame(buffer, &frame));
+}
+
+void CRSFLink::transmitVoltageFrame(crsfVoltageFrame_t frame) {
+  uint8_t buffer[CRSF_FRAME_SIZE_MAX];
+  transmitFrame(buffer, crsfBuildVoltageFrame(buffer, &frame));
+}
@@ -0,0 +1,44 @@
+#ifndef CRSF_LINK_H
+#define CRSF_LINK_H
+
+#include <Arduino.h>
+#include "CRSFProtocol.h"
+
+typedef void (*crsfFrameHandler_t)(const crsfFrame_t *frame);
+// Sees the raw received bytes before they are parsed
+typedef void (*crsfReceiveTap_t)(const uint8_t *data, uint8_t length, uint32_t now_us);
+
+// CRSF receiver connection. The port interrupt only buffers bytes, SerialMux hands them to
+// receive() from loop() and extended frames go straight to their handler.
+class CRSFLink {
+  public:
+    void begin(HardwareSerial *serial);
+    // SerialMux span handler of the port, now_us is the arrival time of the last byte
+    void receive(const uint8_t *data, uint16_t length, uint32_t now_us);
+    void setExtendedFrameHandler(crsfFrameHandler_t handler);
+    void setReceiveTap(crsfReceiveTap_t tap);
+    float getChannelFloat(int channel);
+    uint16_t getChannelRaw(int channel);
+    void transmitFrame(const uint8_t *frame, uint8_t length);
+    void transmitGpsFrame(crsfGpsFrame_t frame);
+    void transmitVoltageFrame(crsfVoltageFrame_t frame);
+    // True once per received link statistics frame, which is then in link_statistics
+    bool takeLinkStatistics();
+
+    uint32_t last_frame_timestamp = 0;
+    uint32_t channel_frames = 0; // channels frames received
+    uint32_t last_channels_us = 0; // arrival of the newest one
+    crsfLinkStatistics_t link_statistics = {};
+
+  private:
+    void handleFrame(const crsfFrame_t *frame, uint32_t now_us);
+
+    HardwareSerial *serial = NULL;
+    CRSFFrameParser parser;
+    uint16_t channels[CRSF_CHANNEL_COUNT] = {0};
+    crsfFrameHandler_t extended_handler = NULL;
+    crsfReceiveTap_t receive_tap = NULL;
+    bool new_link_statistics = false;
+};
+
+#endif // CRSF_LINK_H
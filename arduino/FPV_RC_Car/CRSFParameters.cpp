@@ -0,0 +1,142 @@
+#include "CRSFParameters.h"
+#include <string.h>
+#include <math.h>
+
+static uint8_t *putString(uint8_t *dst, const char *s) {
+  size_t length = strlen(s) + 1;
+  memcpy(dst, s, length);
+  return dst + length;
+}
+
+static uint8_t *putInt32(uint8_t *dst, int32_t value) {
+  *dst++ = (uint8_t)(value >> 24);
+  *dst++ = (uint8_t)(value >> 16);
+  *dst++ = (uint8_t)(value >> 8);
+  *dst++ = (uint8_t)value;
+  return dst;
+}
+
+static int32_t getInt32(const uint8_t *src) {
+  return (int32_t)(((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3]);
+}
+
+static float decimalScale(uint8_t decimals) {
+  float scale = 1;
+  while (decimals--) {
+    scale *= 10;
+  }
+  return scale;
+}
+
+CRSFParameterServer::CRSFParameterServer(ParamStore *store, const char *device_name, uint8_t address) {
+  this->store = store;
+  this->device_name = device_name;
+  this->address = address;
+}
+
+uint8_t CRSFParameterServer::handleFrame(const crsfFrame_t *frame, uint8_t *reply) {
+  const uint8_t *payload = frame->frame.payload;
+  uint8_t length = frame->frame.frameLength - CRSF_FRAME_LENGTH_TYPE_CRC;
+  uint8_t destination = payload[0];
+  uint8_t origin = payload[1];
+  if (length < 2 || (destination != address && destination != CRSF_ADDRESS_BROADCAST)) {
+    return 0;
+  }
+
+  switch (frame->frame.type) {
+    case CRSF_FRAMETYPE_DEVICE_PING:
+      return buildDeviceInfo(origin, reply);
+    case CRSF_FRAMETYPE_PARAMETER_READ:
+      if (length < 4) {
+        return 0;
+      }
+      return buildEntry(origin, payload[2], reply);
+    case CRSF_FRAMETYPE_PARAMETER_WRITE: {
+      if (length < 4 || payload[2] == 0) {
+        return 0;
+      }
+      uint8_t index = payload[2] - 1;
+      const ParamDescriptor *param = store->get(index);
+      if (param == NULL) {
+        return 0;
+      }
+      if (param->type == PARAM_FLOAT) {
+        if (length < 7) {
+          return 0;
+        }
+        store->setValue(index, getInt32(&payload[3]) / decimalScale(param->decimals));
+      } else {
+        store->setValue(index, payload[3]);
+      }
+      written = index;
+      return buildEntry(origin, payload[2], reply);
+    }
+    default:
+      return 0;
+  }
+}
+
+int16_t CRSFParameterServer::takeWritten() {
+  int16_t index = written;
+  written = -1;
+  return index;
+}
+
+uint8_t CRSFParameterServer::buildDeviceInfo(uint8_t destination, uint8_t *reply) {
+  uint8_t payload[CRSF_PAYLOAD_SIZE_MAX];
+  uint8_t *p = payload;
+  *p++ = destination;
+  *p++ = address;
+  p = putString(p, device_name);
+  p = putInt32(p, 0); // serial number
+  p = putInt32(p, 0); // hardware id
+  p = putInt32(p, 0); // software id
+  *p++ = store->getCount();
+  *p++ = 0; // parameter protocol version
+  return crsfBuildFrame(reply, CRSF_FRAMETYPE_DEVICE_INFO, payload, p - payload);
+}
+
+uint8_t CRSFParameterServer::buildEntry(uint8_t destination, uint8_t field, uint8_t *reply) {
+  uint8_t payload[CRSF_PAYLOAD_SIZE_MAX];
+  uint8_t *p = payload;
+  *p++ = destination;
+  *p++ = address;
+  *p++ = field;
+  *p++ = 0; // chunks remaining, every entry fits a single frame
+  *p++ = 0; // parent folder
+
+  if (field == 0) {
+    *p++ = CRSF_PARAM_FOLDER;
+    p = putString(p, device_name);
+    for (uint8_t i = 0; i < store->getCount(); i++) {
+      *p++ = i + 1;
+    }
+    *p++ = 0xFF;
+    return crsfBuildFrame(reply, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, payload, p - payload);
+  }
+
+  const ParamDescriptor *param = store->get(field - 1);
+  if (param == NULL) {
+    return 0;
+  }
+  if (param->type == PARAM_FLOAT) {
+    float scale = decimalScale(param->decimals);
+    *p++ = CRSF_PARAM_FLOAT;
+    p = putString(p, param->name);
+    p = putInt32(p, lroundf(store->getValue(field - 1) * scale));
+    p = putInt32(p, lroundf(param->min * scale));
+    p = putInt32(p, lroundf(param->max * scale));
+    p = putInt32(p, lroundf(param->default_value * scale));
+    *p++ = param->decimals;
+    p = putInt32(p, 1); // step of one least significant digit
+  } else {
+    *p++ = CRSF_PARAM_UINT8;
+    p = putString(p, param->name);
+    *p++ = (uint8_t)store->getValue(field - 1);
+    *p++ = (uint8_t)param->min;
+    *p++ = (uint8_t)param->max;
+    *p++ = (uint8_t)param->default_value;
+  }
+  p = putString(p, param->unit != NULL ? param->unit : "");
+  return crsfBuildFrame(reply, CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY, payload, p - payload);
+}
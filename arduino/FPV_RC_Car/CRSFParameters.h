@@ -0,0 +1,35 @@
+#ifndef CRSF_PARAMETERS_H
+#define CRSF_PARAMETERS_H
+
+#include <stdint.h>
+#include "CRSFProtocol.h"
+#include "ParamStore.h"
+
+enum crsfParameterType_e : uint8_t {
+  CRSF_PARAM_UINT8 = 0,
+  CRSF_PARAM_FLOAT = 8,
+  CRSF_PARAM_FOLDER = 11
+};
+
+// Serves a ParamStore over the CRSF device/parameter frames used by the transmitter Lua
+// scripts. Field 0 is the root folder, store index i is exposed as field i + 1.
+class CRSFParameterServer {
+  public:
+    CRSFParameterServer(ParamStore *store, const char *device_name, uint8_t address = CRSF_ADDRESS_FLIGHT_CONTROLLER);
+    // Handles an extended frame. A reply frame is built into reply (CRSF_FRAME_SIZE_MAX bytes),
+    // returns the number of bytes to send or 0 when the frame needs no answer.
+    uint8_t handleFrame(const crsfFrame_t *frame, uint8_t *reply);
+    // Store index of the parameter last written by the transmitter, -1 if none since the last call
+    int16_t takeWritten();
+
+  private:
+    uint8_t buildDeviceInfo(uint8_t destination, uint8_t *reply);
+    uint8_t buildEntry(uint8_t destination, uint8_t field, uint8_t *reply);
+
+    ParamStore *store;
+    const char *device_name;
+    uint8_t address;
+    int16_t written = -1;
+};
+
+#endif // CRSF_PARAMETERS_H
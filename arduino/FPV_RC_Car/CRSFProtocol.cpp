@@ -0,0 +1,156 @@
+#include "CRSFProtocol.h"
+#include <string.h>
+
+uint8_t crc8_dvb_s2(uint8_t crc, uint8_t a) {
+  crc ^= a;
+  for (int ii = 0; ii < 8; ++ii) {
+    if (crc & 0x80) {
+      crc = (crc << 1) ^ 0xD5;
+    } else {
+      crc = crc << 1;
+    }
+  }
+  return crc;
+}
+
+uint8_t crsfFrameCRC(const crsfFrame_t *frame) {
+  // CRC includes type and payload
+  uint8_t crc = crc8_dvb_s2(0, frame->frame.type);
+  for (int ii = 0; ii < frame->frame.frameLength - CRSF_FRAME_LENGTH_TYPE_CRC; ++ii) {
+    crc = crc8_dvb_s2(crc, frame->frame.payload[ii]);
+  }
+  return crc;
+}
+
+uint8_t crsfFrameSize(const crsfFrame_t *frame) {
+  return frame->frame.frameLength + CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH;
+}
+
+void crsfUnpackChannels(const uint8_t *payload, uint16_t *channels) {
+  // 11 bit little endian fields packed back to back
+  uint32_t bits = 0;
+  uint8_t bit_count = 0;
+  for (int channel = 0; channel < CRSF_CHANNEL_COUNT; channel++) {
+    while (bit_count < 11) {
+      bits |= (uint32_t)(*payload++) << bit_count;
+      bit_count += 8;
+    }
+    channels[channel] = bits & 0x7FF;
+    bits >>= 11;
+    bit_count -= 11;
+  }
+}
+
+bool crsfUnpackLinkStatistics(const crsfFrame_t *frame, crsfLinkStatistics_t *stats) {
+  if (frame->frame.frameLength < CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE + CRSF_FRAME_LENGTH_TYPE_CRC) {
+    return false;
+  }
+  const uint8_t *p = frame->frame.payload;
+  stats->uplinkRssi1 = p[0];
+  stats->uplinkRssi2 = p[1];
+  stats->uplinkLinkQuality = p[2];
+  stats->uplinkSnr = (int8_t)p[3];
+  stats->activeAntenna = p[4];
+  stats->rfMode = p[5];
+  stats->uplinkTxPower = p[6];
+  stats->downlinkRssi = p[7];
+  stats->downlinkLinkQuality = p[8];
+  stats->downlinkSnr = (int8_t)p[9];
+  return true;
+}
+
+float crsfChannelToFloat(uint16_t value) {
+  float scaled = (float)((int)value - CRSF_CHANNEL_MIN) / (CRSF_CHANNEL_MAX - CRSF_CHANNEL_MIN);
+  return scaled < 0.0f ? 0.0f : (scaled > 1.0f ? 1.0f : scaled);
+}
+
+uint8_t crsfBuildFrame(uint8_t *buffer, uint8_t type, const uint8_t *payload, uint8_t payloadLen) {
+  if (payloadLen > CRSF_PAYLOAD_SIZE_MAX) {
+    return 0;
+  }
+  crsfFrame_t *frame = (crsfFrame_t *)buffer;
+  frame->frame.deviceAddress = CRSF_SYNC_BYTE;
+  frame->frame.frameLength = payloadLen + CRSF_FRAME_LENGTH_TYPE_CRC;
+  frame->frame.type = type;
+  memcpy(frame->frame.payload, payload, payloadLen);
+  frame->frame.payload[payloadLen] = crsfFrameCRC(frame);
+  return crsfFrameSize(frame);
+}
+
+static uint8_t *putBE(uint8_t *dst, uint32_t value, uint8_t bytes) {
+  while (bytes > 0) {
+    bytes--;
+    *dst++ = (uint8_t)(value >> (bytes * 8));
+  }
+  return dst;
+}
+
+uint8_t crsfBuildGpsFrame(uint8_t *buffer, const crsfGpsFrame_t *gps) {
+  uint8_t payload[CRSF_FRAME_GPS_PAYLOAD_SIZE];
+  uint8_t *p = payload;
+  p = putBE(p, (uint32_t)gps->latitude, 4);
+  p = putBE(p, (uint32_t)gps->longitude, 4);
+  p = putBE(p, gps->groundSpeed, 2);
+  p = putBE(p, gps->heading, 2);
+  p = putBE(p, gps->altitude, 2);
+  *p = gps->satellites;
+  return crsfBuildFrame(buffer, CRSF_FRAMETYPE_GPS, payload, sizeof(payload));
+}
+
+uint8_t crsfBuildVoltageFrame(uint8_t *buffer, const crsfVoltageFrame_t *voltage) {
+  uint8_t payload[CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE];
+  uint8_t *p = payload;
+  p = putBE(p, voltage->voltage, 2);
+  p = putBE(p, voltage->current, 2);
+  p = putBE(p, voltage->capacity, 3);
+  *p = voltage->remaining;
+  return crsfBuildFrame(buffer, CRSF_FRAMETYPE_BATTERY_SENSOR, payload, sizeof(payload));
+}
+
+bool CRSFFrameParser::feed(uint8_t byte, uint32_t now_us) {
+  if (index > 0 && now_us - frame_start > CRSF_FRAME_TIMEOUT_US) {
+    index = 0;
+  }
+  if (index == 0) {
+    frame_start = now_us;
+  }
+  frame.bytes[index++] = byte;
+
+  if (index == 2) {
+    uint8_t length = frame.frame.frameLength;
+    if (length < CRSF_FRAME_LENGTH_TYPE_CRC || length > CRSF_FRAME_SIZE_MAX - 2) {
+      index = 0;
+    }
+    return false;
+  }
+  if (index > 2 && index >= crsfFrameSize(&frame)) {
+    index = 0;
+    if (frame.bytes[crsfFrameSize(&frame) - 1] == crsfFrameCRC(&frame)) {
+      return true;
+    }
+    crc_errors++;
+  }
+  return false;
+}
+
+bool CRSFFrameDetector::feed(uint8_t byte, uint32_t now_us) {
+  if (index > 0 && now_us - frame_start > CRSF_FRAME_TIMEOUT_US) {
+    index = 0;
+  }
+  if (index == 0) {
+    frame_start = now_us;
+  } else if (index == 1) {
+    if (byte < CRSF_FRAME_LENGTH_TYPE_CRC || byte > CRSF_FRAME_SIZE_MAX - 2) {
+      index = 0;
+      return false;
+    }
+    size = byte + CRSF_FRAME_LENGTH_ADDRESS + CRSF_FRAME_LENGTH_FRAMELENGTH;
+  } else if (index == 2) {
+    type = byte;
+  }
+  if (++index > 2 && index >= size) {
+    index = 0;
+    return type == CRSF_FRAMETYPE_RC_CHANNELS_PACKED;
+  }
+  return false;
+}
@@ -0,0 +1,141 @@
+#ifndef CRSF_PROTOCOL_H
+#define CRSF_PROTOCOL_H
+
+#include <stdint.h>
+
+// CRSF frame definitions and byte-stream framing, shared by the car firmware and host tools.
+// Definitions follow arduino/crsf_test, multi-byte payload fields are big endian on the wire.
+
+#define CRSF_BAUDRATE 420000
+#define CRSF_SYNC_BYTE 0xC8
+#define CRSF_PAYLOAD_SIZE_MAX 60
+#define CRSF_FRAME_SIZE_MAX (CRSF_PAYLOAD_SIZE_MAX + 4)
+#define CRSF_FRAME_TIMEOUT_US 1000 // a frame is abandoned if its bytes are spread further apart than this
+#define CRSF_CHANNEL_COUNT 16
+#define CRSF_CHANNEL_MIN 172
+#define CRSF_CHANNEL_MAX 1811
+
+enum crsfFrameType_e : uint8_t {
+  CRSF_FRAMETYPE_GPS = 0x02,
+  CRSF_FRAMETYPE_BATTERY_SENSOR = 0x08,
+  CRSF_FRAMETYPE_LINK_STATISTICS = 0x14,
+  CRSF_FRAMETYPE_RC_CHANNELS_PACKED = 0x16,
+  CRSF_FRAMETYPE_ATTITUDE = 0x1E,
+  CRSF_FRAMETYPE_FLIGHT_MODE = 0x21,
+  // extended frames, payload starts with destination and origin address
+  CRSF_FRAMETYPE_DEVICE_PING = 0x28,
+  CRSF_FRAMETYPE_DEVICE_INFO = 0x29,
+  CRSF_FRAMETYPE_PARAMETER_SETTINGS_ENTRY = 0x2B,
+  CRSF_FRAMETYPE_PARAMETER_READ = 0x2C,
+  CRSF_FRAMETYPE_PARAMETER_WRITE = 0x2D
+};
+
+enum crsfAddress_e : uint8_t {
+  CRSF_ADDRESS_BROADCAST = 0x00,
+  CRSF_ADDRESS_FLIGHT_CONTROLLER = 0xC8,
+  CRSF_ADDRESS_RADIO_TRANSMITTER = 0xEA,
+  CRSF_ADDRESS_CRSF_RECEIVER = 0xEC,
+  CRSF_ADDRESS_CRSF_TRANSMITTER = 0xEE
+};
+
+enum {
+  CRSF_FRAME_GPS_PAYLOAD_SIZE = 15,
+  CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE = 8,
+  CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE = 10,
+  CRSF_FRAME_RC_CHANNELS_PAYLOAD_SIZE = 22, // 11 bits per channel * 16 channels = 22 bytes.
+  CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE = 6,
+  CRSF_FRAME_LENGTH_ADDRESS = 1, // length of ADDRESS field
+  CRSF_FRAME_LENGTH_FRAMELENGTH = 1, // length of FRAMELENGTH field
+  CRSF_FRAME_LENGTH_TYPE = 1, // length of TYPE field
+  CRSF_FRAME_LENGTH_CRC = 1, // length of CRC field
+  CRSF_FRAME_LENGTH_TYPE_CRC = 2, // length of TYPE and CRC fields combined
+  CRSF_FRAME_LENGTH_EXT_TYPE_CRC = 4 // length of Extended Dest/Origin, TYPE and CRC fields combined
+};
+
+typedef struct crsfFrameDef_s {
+  uint8_t deviceAddress;
+  uint8_t frameLength;
+  uint8_t type;
+  uint8_t payload[CRSF_PAYLOAD_SIZE_MAX + 1]; // +1 for CRC at end of payload
+} crsfFrameDef_t;
+
+typedef union crsfFrame_u {
+  uint8_t bytes[CRSF_FRAME_SIZE_MAX];
+  crsfFrameDef_t frame;
+} crsfFrame_t;
+
+typedef struct {
+  int32_t latitude;    // degrees * 1e7
+  int32_t longitude;   // degrees * 1e7
+  uint16_t groundSpeed; // km/h * 10
+  uint16_t heading;    // degrees * 100
+  uint16_t altitude;   // meters + 1000
+  uint8_t satellites;
+} crsfGpsFrame_t;
+
+typedef struct {
+  uint16_t voltage;  // volts * 10
+  uint16_t current;
+  uint32_t capacity; // mAh, 24 bits on the wire
+  uint8_t remaining; // percent
+} crsfVoltageFrame_t;
+
+// Link statistics the receiver sends a few times a second
+typedef struct {
+  uint8_t uplinkRssi1;     // -dBm, antenna 1
+  uint8_t uplinkRssi2;     // -dBm, antenna 2
+  uint8_t uplinkLinkQuality; // percent of packets received
+  int8_t uplinkSnr;        // dB
+  uint8_t activeAntenna;
+  uint8_t rfMode;          // packet rate index, numbered differently by each system
+  uint8_t uplinkTxPower;   // power index of the transmitter
+  uint8_t downlinkRssi;    // -dBm
+  uint8_t downlinkLinkQuality; // percent
+  int8_t downlinkSnr;      // dB
+} crsfLinkStatistics_t;
+
+uint8_t crc8_dvb_s2(uint8_t crc, uint8_t a);
+// CRC of a complete frame, covers type and payload
+uint8_t crsfFrameCRC(const crsfFrame_t *frame);
+// Number of bytes of the whole frame including address, length and CRC
+uint8_t crsfFrameSize(const crsfFrame_t *frame);
+void crsfUnpackChannels(const uint8_t *payload, uint16_t *channels);
+// Returns false if the frame is too short to be link statistics
+bool crsfUnpackLinkStatistics(const crsfFrame_t *frame, crsfLinkStatistics_t *stats);
+// Channel value scaled to 0..1
+float crsfChannelToFloat(uint16_t value);
+// Builds a frame into buffer (CRSF_FRAME_SIZE_MAX bytes), returns the number of bytes to send
+uint8_t crsfBuildFrame(uint8_t *buffer, uint8_t type, const uint8_t *payload, uint8_t payloadLen);
+uint8_t crsfBuildGpsFrame(uint8_t *buffer, const crsfGpsFrame_t *gps);
+uint8_t crsfBuildVoltageFrame(uint8_t *buffer, const crsfVoltageFrame_t *voltage);
+
+// Splits a byte stream into CRC checked frames
+class CRSFFrameParser {
+  public:
+    // Returns true when byte completed a frame with a valid CRC, the frame stays in frame
+    // until the next call
+    bool feed(uint8_t byte, uint32_t now_us);
+    crsfFrame_t frame;
+    uint32_t crc_errors = 0;
+
+  private:
+    uint8_t index = 0;
+    uint32_t frame_start = 0;
+};
+
+// Follows the frame boundaries of the stream from the port interrupt, without copying or
+// checking the CRC, so loop() can be told an RC channels frame is in as soon as its last byte
+// is. The boundaries are found the same way CRSFFrameParser finds them.
+class CRSFFrameDetector {
+  public:
+    // Returns true when byte is the last of an RC channels frame
+    bool feed(uint8_t byte, uint32_t now_us);
+
+  private:
+    uint8_t index = 0;
+    uint8_t size = 0;
+    uint8_t type = 0;
+    uint32_t frame_start = 0;
+};
+
+#endif // CRSF_PROTOCOL_H
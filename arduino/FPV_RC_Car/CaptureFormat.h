@@ -0,0 +1,57 @@
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <stdint.h>
+
+// Capture stream written by a CAPTURE_LOG build and read back by tools/replay.
+// The stream is a sequence of records, each a CaptureRecord followed by length payload bytes,
+// the first record holds the CaptureHeader.
+// Everything is little endian, both the SAMD21 and the host are.
+
+#define CAPTURE_MAGIC 0x43565046 // "FPVC"
+#define CAPTURE_VERSION 2
+#define CAPTURE_PAYLOAD_MAX 64
+
+enum CaptureKind : uint8_t {
+  CAPTURE_HEADER = 0, // one CaptureHeader, first record of a capture
+  CAPTURE_CRSF_RX = 1, // raw bytes received from the CRSF receiver
+  CAPTURE_VESC_RX = 2, // raw bytes received from the VESC
+  CAPTURE_IMU = 3, // one CaptureImuSample
+  CAPTURE_DROPPED = 4 // uint32_t count of bytes lost because the log buffer was full
+};
+
+#define CAPTURE_FLAG_FILTER_FIXED 0x01 // built with GYRO_FILTER_FIXED
+
+struct __attribute__((packed)) CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  // firmware configuration and parameter values at boot, enough to rerun the control code
+  float gyro_sample_rate;
+  float gyro_yaw_cal;
+  float gyro_stationary_erpm;
+  float gyro_stationary_stddev;
+  float gyro_lowpass_hz;
+  float gyro_notch_q;
+  float gyro_notch_min_hz;
+  float motor_poles;
+  float kmh_to_motor_erpm;
+  float max_speed_kmh;
+  float max_steering_deg_s;
+  float steering_trim;
+  float steering_min_us;
+  float steering_max_us;
+};
+
+struct __attribute__((packed)) CaptureRecord {
+  uint32_t timestamp_us;
+  uint8_t kind;
+  uint8_t length;
+};
+
+struct __attribute__((packed)) CaptureImuSample {
+  float gyro[3]; // deg/s as returned by the driver
+  float accel[3]; // g
+};
+
+#endif // CAPTURE_FORMAT_H
@@ -0,0 +1,51 @@
+#include "CaptureLog.h"
+
+void CaptureLog::begin(Stream *out, const CaptureHeader &header) {
+  this->out = out;
+  record(CAPTURE_HEADER, (const uint8_t *)&header, sizeof(header));
+}
+
+void CaptureLog::record(uint8_t kind, const uint8_t *data, uint8_t length) {
+  record(kind, data, length, micros());
+}
+
+void CaptureLog::record(uint8_t kind, const uint8_t *data, uint8_t length, uint32_t timestamp_us) {
+  CaptureRecord rec = {timestamp_us, kind, length};
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  // header and payload go in together or not at all so the stream never desyncs
+  uint16_t used = (uint16_t)(head - tail) & (CAPTURE_BUFFER_SIZE - 1);
+  uint16_t needed = sizeof(rec) + length;
+  if (CAPTURE_BUFFER_SIZE - 1 - used < needed) {
+    dropped_bytes += sizeof(rec) + length;
+  } else {
+    put((const uint8_t *)&rec, sizeof(rec));
+    put(data, length);
+  }
+  __set_PRIMASK(primask);
+}
+
+void CaptureLog::put(const uint8_t *data, uint16_t length) {
+  for (uint16_t i = 0; i < length; i++) {
+    buffer[head] = data[i];
+    head = (head + 1) & (CAPTURE_BUFFER_SIZE - 1);
+  }
+}
+
+void CaptureLog::flush() {
+  if (out == NULL) {
+    return;
+  }
+  if (dropped_bytes != reported_dropped) {
+    uint32_t dropped = dropped_bytes;
+    record(CAPTURE_DROPPED, (const uint8_t *)&dropped, sizeof(dropped));
+    reported_dropped = dropped;
+  }
+  // only the writer side moves tail, the ISR only moves head
+  uint16_t end = head;
+  while (tail != end) {
+    uint16_t chunk = end > tail ? end - tail : CAPTURE_BUFFER_SIZE - tail;
+    out->write(&buffer[tail], chunk);
+    tail = (tail + chunk) & (CAPTURE_BUFFER_SIZE - 1);
+  }
+}
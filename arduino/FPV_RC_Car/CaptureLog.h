@@ -0,0 +1,30 @@
+#ifndef CAPTURE_LOG_H
+#define CAPTURE_LOG_H
+
+#include <Arduino.h>
+#include "CaptureFormat.h"
+
+#define CAPTURE_BUFFER_SIZE 8192
+
+// Ring buffer of capture records, safe to fill from interrupts. flush() is called from loop()
+// and writes whatever is buffered to the host port.
+class CaptureLog {
+  public:
+    void begin(Stream *out, const CaptureHeader &header);
+    void record(uint8_t kind, const uint8_t *data, uint8_t length);
+    void record(uint8_t kind, const uint8_t *data, uint8_t length, uint32_t timestamp_us);
+    void flush();
+
+    volatile uint32_t dropped_bytes = 0;
+
+  private:
+    void put(const uint8_t *data, uint16_t length);
+
+    Stream *out = NULL;
+    uint8_t buffer[CAPTURE_BUFFER_SIZE];
+    volatile uint16_t head = 0;
+    volatile uint16_t tail = 0;
+    uint32_t reported_dropped = 0;
+};
+
+#endif // CAPTURE_LOG_H
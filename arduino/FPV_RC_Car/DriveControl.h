@@ -0,0 +1,82 @@
+#ifndef DRIVE_CONTROL_H
+#define DRIVE_CONTROL_H
+
+#include <stdint.h>
+#include <math.h>
+
+#define DRIVE_MIN_ERPM 300 // below this the motor is commanded to stop
+#define STEER_ASSIST_REDUCTION 0.7f // throttle cut at full steering lock in STEER_ASSIST
+#define SWITCH_HIGH 0.75f // an aux channel above this is a switch set high
+#define SWITCH_LOW 0.25f // and below this one set low, in between it keeps its position
+
+// Stick to actuator mapping shared by the firmware and the host tools
+
+enum DriveMode {
+  NO_CONNECTION,
+  DIRECT,
+  TURN_ASSIST,
+  OFF,
+  STEER_ASSIST, // direct steering, throttle reduced with steering angle (python/main.py)
+  AUTONOMOUS, // follows the waypoint path, the throttle stick caps the speed
+  REPEAT, // AUTONOMOUS along the lap taught in DIRECT
+  AUTOTUNE // relay tuning of the turn rate gain schedule
+};
+
+// Position of a two position switch on an aux channel. A centered or unassigned channel reads
+// 0.5, it never turns a switch on, and a channel wandering around a threshold doesn't toggle it
+inline bool auxSwitch(float input, bool previous) {
+  if (input > SWITCH_HIGH) {
+    return true;
+  } else if (input < SWITCH_LOW) {
+    return false;
+  }
+  return previous;
+}
+
+// modeSelect picks off/direct/turn assist, the assist switch swaps direct for steer assist and
+// turn assist for autonomous, the teach switch autonomous for repeat and the tune switch turn
+// assist for autotune
+inline DriveMode selectDriveMode(float modeSelect, bool assist, bool teach = false, bool tune = false) {
+  if (modeSelect < 0.33) {
+    return DriveMode::OFF;
+  } else if (modeSelect < 0.66) {
+    return assist ? DriveMode::STEER_ASSIST : DriveMode::DIRECT;
+  }
+  if (assist) {
+    return teach ? DriveMode::REPEAT : DriveMode::AUTONOMOUS;
+  }
+  return tune ? DriveMode::AUTOTUNE : DriveMode::TURN_ASSIST;
+}
+
+// Integral of the turn rate PID, clamped so the I term alone can swing the steering through its
+// whole range and no further. A zero I gain holds it at zero
+inline float clampTurnRateIntegral(float integral, float i_gain) {
+  float limit = i_gain > 0 ? 1.0f / i_gain : 0;
+  return integral < -limit ? -limit : (integral > limit ? limit : integral);
+}
+
+// Channel value in 0..1 to a command in -1..1
+inline float stickToCommand(float input) {
+  return (input - 0.5f) * 2.0f;
+}
+
+inline float clampCommand(float command) {
+  return command < -1.0f ? -1.0f : (command > 1.0f ? 1.0f : command);
+}
+
+// Throttle scaled down the further the wheels are turned, keeps the car from spinning out
+inline float steerAssistThrottle(float throttleCommand, float steeringCommand) {
+  return throttleCommand * (1.0f - STEER_ASSIST_REDUCTION * fabsf(clampCommand(steeringCommand)));
+}
+
+// Servo pulse width for a steering command in -1..1, kept fractional for ServoOutput
+inline float steeringToPulseUs(float steeringCommand, float trim, float min_us, float max_us) {
+  return min_us + (max_us - min_us) * 0.5f * (clampCommand(steeringCommand + trim) + 1.0f);
+}
+
+inline float throttleToErpm(float throttleCommand, float max_speed_kmh, float kmh_to_erpm) {
+  float desired_erpm = clampCommand(throttleCommand) * max_speed_kmh * kmh_to_erpm;
+  return fabsf(desired_erpm) > DRIVE_MIN_ERPM ? desired_erpm : 0;
+}
+
+#endif // DRIVE_CONTROL_H
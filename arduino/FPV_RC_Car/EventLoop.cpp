@@ -0,0 +1,41 @@
+#include <Arduino.h>
+#include "EventLoop.h"
+
+EventLoop::EventLoop(uint32_t window_us) : window_us(window_us) {}
+
+void EventLoop::post(uint8_t events) {
+  // a handler of higher priority could post between the read and the write
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  pending |= events;
+  __set_PRIMASK(primask);
+}
+
+uint8_t EventLoop::wait() {
+  __disable_irq();
+  while (pending == 0) {
+    uint32_t start = micros();
+    __DSB();
+    __WFI();
+    asleep_us += micros() - start;
+    // the interrupt that woke the core runs here
+    __enable_irq();
+    __disable_irq();
+  }
+  uint8_t events = pending;
+  pending = 0;
+  __enable_irq();
+  wakeups++;
+
+  uint32_t now = micros();
+  if (now - window_start >= window_us) {
+    load = 100.0f * (1.0f - (float)asleep_us / (now - window_start));
+    window_start = now;
+    asleep_us = 0;
+  }
+  return events;
+}
+
+float EventLoop::getLoad() {
+  return load;
+}
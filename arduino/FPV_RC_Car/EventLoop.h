@@ -0,0 +1,36 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+#define EVENT_GYRO 0x01 // IMU data ready
+#define EVENT_CRSF 0x02 // a CRSF channels frame completed
+#define EVENT_TICK 0x04 // timed work and the ports without an event of their own
+
+// Sleeps the core between the interrupts that bring work. Interrupt handlers post() events
+// into a mask and wait() sleeps with WFI until it isn't empty. The mask is checked with
+// interrupts masked, and WFI still wakes on an interrupt that became pending meanwhile, so an
+// event posted just before the sleep isn't lost. The handler runs once interrupts are unmasked
+// again, and wakeups that posted nothing, like single received bytes, go back to sleep. The time
+// asleep is summed per window into the load, the share of time the core was awake.
+class EventLoop {
+  public:
+    EventLoop(uint32_t window_us);
+    // Safe from interrupts of any priority and from loop()
+    void post(uint8_t events);
+    // Returns the events posted since the last call, sleeps until there is one
+    uint8_t wait();
+    // Percent of the last complete window spent awake
+    float getLoad();
+
+    uint32_t wakeups = 0; // returns of wait(), each a pass of loop()
+
+  private:
+    volatile uint8_t pending = 0;
+    uint32_t window_us;
+    uint32_t window_start = 0;
+    uint32_t asleep_us = 0;
+    float load = 100;
+};
+
+#endif // EVENT_LOOP_H
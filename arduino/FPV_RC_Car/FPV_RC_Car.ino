@@ -1,74 +1,436 @@
-#include <VescUart.h>
-#include <buffer.h>
-#include <crc.h>
-#include <datatypes.h>
-
 #include <AutoPID.h>
 
 #include <SparkFunLSM6DS3_SPI.h>
 
 #include <Arduino.h>
 #include "wiring_private.h"
-#include <CRSFIn.h>
+#include "SerialMux.h"
+#include "SerialPorts.h"
+#include "CRSFLink.h"
+#include "VescLink.h"
+#include "CRSFParameters.h"
+#include "ParamStore.h"
 #include <Servo.h>
+#include "ServoOutput.h"
+#include "GyroCalibration.h"
+#include "AttitudeEstimator.h"
+#include "BiquadFilter.h"
+#include "DriveControl.h"
+#include "SteeringFeedForward.h"
+#include "Odometry.h"
+#include "PurePursuit.h"
+#include "TrajectoryLog.h"
+#include "TrajectoryFollower.h"
+#include "LinkMonitor.h"
+#include "EventLoop.h"
+#include "StartupSequence.h"
+#include "TurnRateAutotune.h"
+#include "YawRateLqr.h"
+#include "YawLqrGains.h"
+#include "SpeedEstimator.h"
+#include "BrakeControl.h"
 
 #define STEERING_TRIM 0
-#define GYRO_YAW_CAL 1.2
+#define GYRO_YAW_CAL 1.2 // starting bias guess, replaced once GyroCalibration has seen the car stationary
+#define GYRO_STATIONARY_ERPM 150
+#define GYRO_STATIONARY_STDDEV 0.5 // deg/s
+// #define GYRO_TEMP_COMP
+#define GYRO_TEMP_INTERVAL 1000 // ms between temperature reads
 #define STEERING_PIN 5
+#define STEERING_TCC_CHANNEL 1 // pin 5 is PA15, TCC0/WO[5]
+#define STEERING_FRAME_HZ 50 // up to 333 for digital servos
+#define STEERING_MIN_US 1000
+#define STEERING_MAX_US 2000
 #define THROTTLE_PIN 13
+#define VESC_BAUDRATE 115200
+#define VESC_VALUES_INTERVAL 10 // ms between telemetry requests
+#define VESC_SETPOINT_REFRESH 100 // ms, an unchanged setpoint is only resent this often
+#define VESC_VALUE_FIELDS (VESC_FIELD_AVG_INPUT_CURRENT | VESC_FIELD_RPM | VESC_FIELD_INPUT_VOLTAGE | VESC_FIELD_TACHOMETER)
 #define PID_MAX_GAIN 1.0 / 512.0
 #define PID_MIN_GAIN 0.025 / 512.0
 #define PID_SCALE_POINT 20 // km/h
 #define PID_I_TERM 1.0 / 32.0
 #define PID_D_TERM 1.0 / 64.0
-#define GYRO_LOWPASS_ALPHA 0.5  // lower is stronger filtering
+#define PID_RATE_HZ 50 // AutoPID steps
+#define PID_INTEGRAL_BAND 20.0 // deg/s, with the feed-forward on the PID only integrates errors smaller than this
+#define GYRO_SAMPLE_RATE 416.0 // Hz, LSM6DS3 default ODR
+#define GYRO_LOWPASS_HZ 40.0
+#define GYRO_NOTCH_Q 3.0 // higher is a narrower notch
+#define GYRO_NOTCH_MIN_HZ 20.0 // notch is bypassed below this motor frequency
+// #define GYRO_FILTER_FIXED // run the yaw rate filters in Q16.16 instead of float
 
 #define MOTOR_POLES 2.0
 #define DRIVE_RATIO 10.83
 #define WHEEL_CIRCUMFERENCE 0.3676 // meters
 #define KMH_TO_METERS_PER_MIN 16.66667
 #define KMH_TO_MOTOR_ERPM ((DRIVE_RATIO * MOTOR_POLES * KMH_TO_METERS_PER_MIN) / WHEEL_CIRCUMFERENCE)
+#define METERS_PER_TACHO_COUNT (WHEEL_CIRCUMFERENCE / (6.0 * MOTOR_POLES * DRIVE_RATIO)) // the VESC counts 6 per electrical revolution
+#define SPEED_ACCEL_AXIS 0 // accelerometer axis along the car
+#define SPEED_ACCEL_SIGN 1.0 // -1 if that axis points backwards
+#define SPEED_ACCEL_NOISE 0.5 // m/s^2 per sqrt(Hz), accelerometer noise and vibration
+#define SPEED_BIAS_DRIFT 0.5 // m/s^2 per sqrt(s), how quickly slopes move the accelerometer bias
+#define SPEED_ERPM_NOISE 0.05 // m/s, noise of the wheel speed from the ERPM
+#define SPEED_ERPM_DELAY_US 1000 // from the values request going out until the VESC reads the ERPM, replies are polled, see PolledSerial
+#define SPEED_STALE_MS 50 // without IMU samples for this long the speed is the wheel speed
+#define BRAKE_MAX_CURRENT 20.0 // A of regenerative brake current at full reverse stick
+#define BRAKE_EXPO 0.3 // 0 is a linear brake curve, 1 cubic
+#define BRAKE_RATE_HZ 100 // BrakeControl steps, the lock detection sees a new ERPM about every step
+#define BRAKE_STANDSTILL_KMH 1.0 // below this the car counts as stopped, reverse is driven from there
+#define BRAKE_ABS // release the brake current when a wheel locks
+#define BRAKE_SLIP_MAX 0.2 // share the wheel may turn slower than the car before it counts as locking
+#define BRAKE_DECEL_MARGIN 4.0 // m/s^2 the wheel may slow faster than the accelerometer says the car does
+#define BRAKE_RELEASE 0.85 // the brake current is cut to this share of itself every step the wheel locks
+#define BRAKE_REAPPLY 100.0 // A/s the brake current comes back at after a lock
+#define ODOMETRY_ORIGIN_LAT 0 // degrees * 1e7, the pose is sent as GPS coordinates around this point
+#define ODOMETRY_ORIGIN_LON 0 // degrees * 1e7
+#define METERS_TO_LAT 89.83 // degrees * 1e7 per meter
 
 #define MAX_SPEED_KMH 10
 #define MAX_STEERING_DEG_S 180.0
+#define WHEELBASE 0.26 // meters
+#define MAX_STEERING_ANGLE_DEG 25.0 // front wheel angle at full servo travel
+#define FEED_FORWARD_GAIN 1.0 // share of the bicycle model steering added to the PID output, 0 disables
+// #define YAW_CONTROL_LQR // steer TURN_ASSIST, AUTONOMOUS and REPEAT with YawRateLqr on every gyro sample instead of AutoPID
+#define YAW_LQR_SERVO_TAU 0.03 // s, the LQR's servo and yaw lags, the ones tools/yaw_lqr made YawLqrGains.h with
+#define YAW_LQR_YAW_TAU 0.08 // s
+#define YAW_LQR_SERVO_SLEW 400.0 // deg/s of wheel angle the LQR's commands stay under
+#define YAW_LQR_INTEGRAL_LIMIT 20.0 // degrees of lost heading the LQR's integral makes up at most
+#define PATH_LOOKAHEAD 1.0 // meters ahead along the path the AUTONOMOUS mode steers for
+#define PATH_SPEED_KMH 6.0 // AUTONOMOUS cruise speed
+#define PATH_MAX_LATERAL_ACCEL 4.0 // m/s^2, the path speed is reduced in turns to stay under this
+#define TEACH_CHANNEL 4 // switch that records a lap in DIRECT and repeats it in place of AUTONOMOUS
+#define TEACH_INTERVAL 50 // ms between samples of a taught lap
+#define AUTOTUNE_CHANNEL 5 // switch that swaps TURN_ASSIST for AUTOTUNE
+#define AUTOTUNE_RELAY 0.3 // steering the relay switches between
+#define AUTOTUNE_HYSTERESIS 3.0 // deg/s past the setpoint before the relay switches, above the gyro noise
+#define AUTOTUNE_YAW_RATE 0.0 // deg/s the car weaves around
+#define AUTOTUNE_CYCLES 4 // matching oscillation cycles that finish a speed bucket
+#define AUTOTUNE_SETTLE 1.0 // s at the bucket speed before the relay starts
+#define AUTOTUNE_TIMEOUT 15.0 // s of relay before a bucket is left as it was
+#define AUTOTUNE_MIN_SPEED_KMH 3.0 // the yaw rate barely answers the steering below this
+#define LINK_LQ_FULL 70 // uplink LQ (%) from which speed and telemetry are not reduced
+#define LINK_LQ_MIN 30 // LQ at and below which the speed is held at LINK_MIN_SPEED_SCALE
+#define LINK_MIN_SPEED_SCALE 0.3 // share of the max speed left on a poor link
+#define LINK_FAILSAFE_FRAMES 8 // channels frame intervals without a frame before the car stops
+#define LINK_FAILSAFE_MIN_MS 20 // bounds of that gap, the upper one also applies until the frame rate is known
+#define LINK_FAILSAFE_MAX_MS 200
+#define TELEMETRY_INTERVAL 50 // ms between GPS and battery frames to the radio, stretched up to 4x as LQ drops
+#define PARAM_SAVE_DELAY 1000 // ms after the last parameter write before it is committed to flash
+#define ATTITUDE_BUDGET_US 250 // per update, overruns are counted in attitude_overruns
+#define LOOP_TICK_MS 2 // loop() sleeps until gyro data or a CRSF frame, and at most this long
+#define LOAD_WINDOW_MS 1000 // the CPU load is the share of this the core was awake
+#define IMU_INIT_TIMEOUT 100 // ms before a failed IMU init is tried again
+#define IMU_INIT_ATTEMPTS 5 // then TURN_ASSIST, AUTONOMOUS and REPEAT stay locked
+#define OSD_INIT_TIMEOUT 1000 // ms the OSD gets to answer before it is asked again
+#define OSD_INIT_ATTEMPTS 10
 // #define DEBUG
+// #define CAPTURE_LOG // stream CRSF, VESC and IMU input over USB for tools/replay, don't combine with DEBUG
+// #define LATENCY_PROBE // pin high from the end of a CRSF channels frame until its values are written, for a logic analyzer
+#define LATENCY_PROBE_PIN 7
 //#define OSD_ON
+#define OSD_INTERVAL 100 // ms between OSD redraws
+#define OSD_POSE_COLUMN 1 // character grid position of the odometry pose
+#define OSD_POSE_ROW 14
+#define OSD_LINK_COLUMN 1 // uplink LQ and RSSI
+#define OSD_LINK_ROW 13
+#define OSD_LOAD_COLUMN 20 // CPU load
+#define OSD_LOAD_ROW 13
+#define OSD_TUNE_COLUMN 1 // AUTOTUNE progress
+#define OSD_TUNE_ROW 12
 
-enum DriveMode {
-  NO_CONNECTION,
-  DIRECT,
-  TURN_ASSIST,
-  OFF
-};
-Uart Serial2(&sercom3, 26, 27, SERCOM_RX_PAD_1, UART_TX_PAD_0);
+#ifdef OSD_ON
+#include <FrSkyPixelOsd.h>
+#endif
+#ifdef CAPTURE_LOG
+#include "CaptureLog.h"
+#endif
+
+EventLoop loop_events(LOAD_WINDOW_MS * 1000UL);
+volatile uint8_t tick_ms = 0;
+SerialMux serial_mux;
+CRSFFrameDetector crsf_detector;
+volatile bool crsf_frame_event = false; // an RC channels frame completed since the last poll
+SercomSerial crsf_port(&sercom3, SERCOM_RX_PAD_1, UART_TX_PAD_0); // pins 26 (RX), 27 (TX)
+PolledSerial vesc_serial(&Serial1);
+#ifdef OSD_ON
+SercomSerial osd_port(&sercom1, SERCOM_RX_PAD_3, UART_TX_PAD_2); // pins 12 (RX), 10 (TX)
+FrSkyPixelOsd osd(&osd_port);
+uint32_t last_osd = 0;
+#endif
 uint32_t last_update = millis();
-Servo steering, lights;
-VescUart esc;
-CRSFIn remote;
+ServoOutput steering(STEERING_PIN, STEERING_TCC_CHANNEL);
+Servo lights;
+VescLink esc(VESC_VALUE_FIELDS, VESC_VALUES_INTERVAL, VESC_SETPOINT_REFRESH);
+#ifdef CAPTURE_LOG
+CaptureLog capture;
+#endif
+CRSFLink remote;
+// the car drives once the link and the ESC are up, the rest comes up meanwhile
+enum StartupDeviceId { STARTUP_LINK, STARTUP_ESC, STARTUP_IMU, STARTUP_GYRO, STARTUP_OSD };
+const StartupDevice STARTUP_DEVICES[] = {
+  {"link", 0, 0}, // first channels frames
+  {"esc", 0, 0}, // first telemetry reply
+  {"imu", IMU_INIT_TIMEOUT, IMU_INIT_ATTEMPTS},
+  {"gyro", 0, 0}, // bias converged, the gyro steered modes unlock
+  #ifdef OSD_ON
+  {"osd", OSD_INIT_TIMEOUT, OSD_INIT_ATTEMPTS},
+  #endif
+};
+StartupSequence startup(STARTUP_DEVICES, sizeof(STARTUP_DEVICES) / sizeof(StartupDevice), (1UL << STARTUP_LINK) | (1UL << STARTUP_ESC));
+#ifdef DEBUG
+bool startup_reported = false;
+#endif
+LinkMonitor link_monitor(LINK_LQ_FULL, LINK_LQ_MIN, LINK_MIN_SPEED_SCALE, LINK_FAILSAFE_FRAMES, LINK_FAILSAFE_MIN_MS * 1000UL, LINK_FAILSAFE_MAX_MS * 1000UL);
+uint32_t last_telemetry = 0;
 LSM6DS3 imu(SPI_MODE, 2);
+GyroCalibration gyro_cal(-GYRO_YAW_CAL, GYRO_STATIONARY_ERPM, GYRO_STATIONARY_STDDEV);
 uint32_t last_sensor = micros();
-double yaw = 0;
+uint32_t last_temperature = 0;
+AttitudeEstimator attitude;
+uint32_t attitude_us = 0;
+uint32_t attitude_overruns = 0;
+// stage 0 is a fixed low-pass, stage 1 a notch following the motor rotation frequency
+constexpr BiquadCoefficients GYRO_LOWPASS = biquadLowpass(GYRO_LOWPASS_HZ, GYRO_SAMPLE_RATE);
+#ifdef GYRO_FILTER_FIXED
+FilterChain<int32_t, 2> yaw_filter;
+#else
+FilterChain<float, 2> yaw_filter;
+#endif
+double yaw = 0; // deg clockwise, the integrated bias corrected yaw rate
 double yaw_v = 0;
 double target_yaw_v = 0;
 double turn_rate_out = 0;
-float current_speed = 0;
+float current_speed = 0; // km/h, the SpeedEstimator's at every IMU sample
+float current_accel = 0; // m/s^2 along the car
+float motor_erpm = 0;
 DriveMode drive_mode = DriveMode::NO_CONNECTION;
 DriveMode previous_drive_mode = DriveMode::NO_CONNECTION;
+bool assist_switch = false; // aux switch positions, see auxSwitch()
+bool teach_switch = false;
+bool tune_switch = false;
+bool tune_armed = false; // the tune switch was off since power up, AUTOTUNE may start
+bool path_armed = false; // the assist switch was off since power up, AUTONOMOUS and REPEAT may start
+SteeringFeedForward steering_ff(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+SpeedEstimator speed_estimator(SPEED_ACCEL_NOISE, SPEED_BIAS_DRIFT, SPEED_ERPM_NOISE, SPEED_STALE_MS * 1000);
+BrakeControl brake(BRAKE_STANDSTILL_KMH / 3.6, BRAKE_SLIP_MAX, BRAKE_DECEL_MARGIN, BRAKE_RELEASE, BRAKE_REAPPLY);
+uint32_t last_brake = 0;
+Odometry odometry(METERS_PER_TACHO_COUNT);
+const float meters_to_lon = METERS_TO_LAT / cos(ODOMETRY_ORIGIN_LAT * 1e-7 * DEG_TO_RAD);
+// AUTONOMOUS waypoints in meters, in the odometry frame of the car when the mode is switched in:
+// x forward, y left. A 4 m by 3 m oval lapped counterclockwise.
+const PathPoint AUTONOMOUS_PATH[] = {
+  {0.00, 0.00}, {2.00, 0.00}, {4.00, 0.00}, {4.57, 0.11}, {5.06, 0.44}, {5.39, 0.93}, {5.50, 1.50},
+  {5.39, 2.07}, {5.06, 2.56}, {4.57, 2.89}, {4.00, 3.00}, {2.00, 3.00}, {0.00, 3.00}, {-0.57, 2.89},
+  {-1.06, 2.56}, {-1.39, 2.07}, {-1.50, 1.50}, {-1.39, 0.93}, {-1.06, 0.44}, {-0.57, 0.11},
+};
+PurePursuit pursuit(PATH_LOOKAHEAD, PATH_SPEED_KMH / 3.6, PATH_MAX_LATERAL_ACCEL);
+TrajectoryLog teach_log;
+TrajectoryFollower follower(PATH_LOOKAHEAD);
+bool teaching = false;
+uint32_t last_teach_sample = 0;
+#ifdef LATENCY_PROBE
+volatile bool probe_pending = false; // the probe pin is up for a frame not parsed yet
+bool probe_parsed = false; // and the frame is parsed, the pin drops once the outputs are written
+#endif
 AutoPID turn_rate_pid(&yaw_v, &target_yaw_v, &turn_rate_out, -1, 1, PID_MAX_GAIN, PID_I_TERM, PID_D_TERM);
+TurnRateAutotune autotune(AUTOTUNE_RELAY, AUTOTUNE_HYSTERESIS, AUTOTUNE_CYCLES, AUTOTUNE_SETTLE, AUTOTUNE_TIMEOUT);
+uint32_t last_autotune = 0;
+float autotune_out = 0;
+bool autotune_applied = false;
+#ifdef YAW_CONTROL_LQR
+// uses the whole feed-forward, FF Gain only applies to the PID
+YawRateLqr yaw_lqr(YAW_LQR_GAINS, sizeof(YAW_LQR_GAINS) / sizeof(YawLqrGain), YAW_LQR_SPEED_MIN, YAW_LQR_SPEED_STEP, &steering_ff,
+                   MAX_STEERING_ANGLE_DEG, YAW_LQR_SERVO_TAU, YAW_LQR_SERVO_SLEW, YAW_LQR_YAW_TAU, YAW_LQR_INTEGRAL_LIMIT);
+float yaw_lqr_out = 0;
+#endif
 
+// turn rate gain schedule, bucket i covers PID_CONFIG_SPEED[i] up to the next speed
 float PID_CONFIG_SPEED[] = {0.0, 5.0, 15.0};
 float PID_CONFIG_VALUE[] = {1.0 / 512.0, 1.0 / 512.0, 1.0 / 20480.0};
+float PID_CONFIG_I[] = {PID_I_TERM, PID_I_TERM, PID_I_TERM};
+float PID_CONFIG_D[] = {PID_D_TERM, PID_D_TERM, PID_D_TERM};
+#define PID_BUCKETS (sizeof(PID_CONFIG_SPEED) / sizeof(float))
+float max_speed_kmh = MAX_SPEED_KMH;
+float steering_trim = STEERING_TRIM;
+float gyro_lowpass_hz = GYRO_LOWPASS_HZ;
+float ff_gain = FEED_FORWARD_GAIN;
+float path_speed_kmh = PATH_SPEED_KMH;
+float path_lookahead = PATH_LOOKAHEAD;
+float brake_max_current = BRAKE_MAX_CURRENT;
+float brake_expo = BRAKE_EXPO;
+
+// Runtime tunables, the control code reads the variables directly. Only append to this table,
+// the flash record is matched by position.
+const ParamDescriptor PARAMS[] = {
+  {"Gain Spd 1", PARAM_FLOAT, &PID_CONFIG_SPEED[0], 0, 40, PID_CONFIG_SPEED[0], 1, "km/h"},
+  {"Gain Spd 2", PARAM_FLOAT, &PID_CONFIG_SPEED[1], 0, 40, PID_CONFIG_SPEED[1], 1, "km/h"},
+  {"Gain Spd 3", PARAM_FLOAT, &PID_CONFIG_SPEED[2], 0, 40, PID_CONFIG_SPEED[2], 1, "km/h"},
+  {"P Gain 1", PARAM_FLOAT, &PID_CONFIG_VALUE[0], 0, 0.1, PID_CONFIG_VALUE[0], 7, ""},
+  {"P Gain 2", PARAM_FLOAT, &PID_CONFIG_VALUE[1], 0, 0.1, PID_CONFIG_VALUE[1], 7, ""},
+  {"P Gain 3", PARAM_FLOAT, &PID_CONFIG_VALUE[2], 0, 0.1, PID_CONFIG_VALUE[2], 7, ""},
+  {"I Gain 1", PARAM_FLOAT, &PID_CONFIG_I[0], 0, 1, PID_I_TERM, 5, ""},
+  {"D Gain 1", PARAM_FLOAT, &PID_CONFIG_D[0], 0, 2000, PID_D_TERM, 5, ""},
+  {"Max Speed", PARAM_FLOAT, &max_speed_kmh, 0, 40, MAX_SPEED_KMH, 1, "km/h"},
+  {"Steer Trim", PARAM_FLOAT, &steering_trim, -0.25, 0.25, STEERING_TRIM, 3, ""},
+  {"Gyro LPF", PARAM_FLOAT, &gyro_lowpass_hz, 5, 150, GYRO_LOWPASS_HZ, 0, "Hz"},
+  {"FF Gain", PARAM_FLOAT, &ff_gain, 0, 1.5, FEED_FORWARD_GAIN, 2, ""},
+  {"Path Speed", PARAM_FLOAT, &path_speed_kmh, 0, 20, PATH_SPEED_KMH, 1, "km/h"},
+  {"Lookahead", PARAM_FLOAT, &path_lookahead, 0.3, 5, PATH_LOOKAHEAD, 1, "m"},
+  {"I Gain 2", PARAM_FLOAT, &PID_CONFIG_I[1], 0, 1, PID_I_TERM, 5, ""},
+  {"I Gain 3", PARAM_FLOAT, &PID_CONFIG_I[2], 0, 1, PID_I_TERM, 5, ""},
+  {"D Gain 2", PARAM_FLOAT, &PID_CONFIG_D[1], 0, 2000, PID_D_TERM, 5, ""},
+  {"D Gain 3", PARAM_FLOAT, &PID_CONFIG_D[2], 0, 2000, PID_D_TERM, 5, ""},
+  {"Brake Amps", PARAM_FLOAT, &brake_max_current, 0, 60, BRAKE_MAX_CURRENT, 1, "A"},
+  {"Brake Expo", PARAM_FLOAT, &brake_expo, 0, 1, BRAKE_EXPO, 2, ""},
+};
+ParamStore params(PARAMS, sizeof(PARAMS) / sizeof(ParamDescriptor));
+CRSFParameterServer param_server(&params, "FPV RC Car");
+uint32_t last_param_change = 0;
 
 float steeringCommand = 0;
 float throttleCommand = 0;
 
 void SERCOM3_Handler() {
-  remote.IrqHandler();
+  crsf_port.IrqHandler();
+}
+
+#ifdef OSD_ON
+void SERCOM1_Handler() {
+  osd_port.IrqHandler();
+}
+#endif
+
+// Called by the core's SysTick handler every millisecond
+extern "C" int sysTickHook(void) {
+  if (++tick_ms >= LOOP_TICK_MS) {
+    tick_ms = 0;
+    loop_events.post(EVENT_TICK);
+  }
+  return 0;
+}
+
+// IMU data ready, the line stays high until the sample is read
+void gyroReady() {
+  loop_events.post(EVENT_GYRO);
+}
+
+// SERCOM3 receive hook, runs in the interrupt
+void detectCrsfFrame(uint8_t byte, uint32_t now_us) {
+  if (crsf_detector.feed(byte, now_us)) {
+    crsf_frame_event = true;
+    loop_events.post(EVENT_CRSF);
+    #ifdef LATENCY_PROBE
+    probe_pending = true;
+    digitalWrite(LATENCY_PROBE_PIN, HIGH);
+    #endif
+  }
+}
+
+#ifdef LATENCY_PROBE
+// Call after a poll of the CRSF port, every frame that had ended by then is parsed
+void probeParsed(){
+  noInterrupts();
+  probe_parsed = probe_parsed || probe_pending;
+  probe_pending = false;
+  interrupts();
+}
+
+// Call once the outputs are written
+void probeWritten(){
+  if (probe_parsed) {
+    probe_parsed = false;
+    digitalWrite(LATENCY_PROBE_PIN, LOW);
+  }
+}
+#endif
+
+void receiveCrsf(const uint8_t *data, uint16_t length, uint32_t now_us) {
+  remote.receive(data, length, now_us);
+}
+
+void receiveVesc(const uint8_t *data, uint16_t length, uint32_t now_us) {
+  esc.receive(data, length, now_us);
+}
+
+#ifdef CAPTURE_LOG
+void captureCrsf(const uint8_t *data, uint8_t length, uint32_t now_us){
+  capture.record(CAPTURE_CRSF_RX, data, length, now_us);
+}
+
+void captureVesc(const uint8_t *data, uint8_t length, uint32_t now_us){
+  capture.record(CAPTURE_VESC_RX, data, length, now_us);
+}
+
+void beginCapture(){
+  CaptureHeader header = {};
+  header.magic = CAPTURE_MAGIC;
+  header.version = CAPTURE_VERSION;
+  #ifdef GYRO_FILTER_FIXED
+  header.flags |= CAPTURE_FLAG_FILTER_FIXED;
+  #endif
+  header.gyro_sample_rate = GYRO_SAMPLE_RATE;
+  header.gyro_yaw_cal = GYRO_YAW_CAL;
+  header.gyro_stationary_erpm = GYRO_STATIONARY_ERPM;
+  header.gyro_stationary_stddev = GYRO_STATIONARY_STDDEV;
+  header.gyro_lowpass_hz = gyro_lowpass_hz;
+  header.gyro_notch_q = GYRO_NOTCH_Q;
+  header.gyro_notch_min_hz = GYRO_NOTCH_MIN_HZ;
+  header.motor_poles = MOTOR_POLES;
+  header.kmh_to_motor_erpm = KMH_TO_MOTOR_ERPM;
+  header.max_speed_kmh = max_speed_kmh;
+  header.max_steering_deg_s = MAX_STEERING_DEG_S;
+  header.steering_trim = steering_trim;
+  header.steering_min_us = STEERING_MIN_US;
+  header.steering_max_us = STEERING_MAX_US;
+  Serial.begin(115200);
+  capture.begin(&Serial, header);
+  remote.setReceiveTap(captureCrsf);
+  esc.setReceiveTap(captureVesc);
+}
+#endif
+
+// Reads gyro (deg/s) and accel (g) in one SPI transaction, OUTX_L_G through OUTZ_H_XL are contiguous
+void readImu(float *gyro, float *accel) {
+  uint8_t raw[12];
+  imu.readRegisterRegion(raw, LSM6DS3_ACC_GYRO_OUTX_L_G, sizeof(raw));
+  for (int i = 0; i < 3; i++) {
+    gyro[i] = imu.calcGyro((int16_t)(raw[i * 2] | (raw[i * 2 + 1] << 8)));
+    accel[i] = imu.calcAccel((int16_t)(raw[6 + i * 2] | (raw[6 + i * 2 + 1] << 8)));
+  }
+}
+
+// Pushes parameter values into the objects that cache them
+void applyParams(){
+  if (gyro_lowpass_hz == GYRO_LOWPASS_HZ) {
+    yaw_filter.setStage(0, GYRO_LOWPASS);
+  } else {
+    yaw_filter.setStage(0, biquadLowpass(gyro_lowpass_hz, GYRO_SAMPLE_RATE));
+  }
+  pursuit.setTuning(path_lookahead, path_speed_kmh / 3.6f);
+  follower.setLookahead(path_lookahead);
+  brake.setCurve(brake_max_current, brake_expo);
+}
+
+void handleParameterFrame(const crsfFrame_t *frame){
+  uint8_t reply[CRSF_FRAME_SIZE_MAX];
+  remote.transmitFrame(reply, param_server.handleFrame(frame, reply));
+  if (param_server.takeWritten() >= 0) {
+    applyParams();
+    last_param_change = millis();
+  }
 }
 
-float get_pid_p_for_speed_kmh(float speed){
+void handleParams(){
+  // flash writes stall the CPU, so only commit once tuning has settled and the car is stopped
+  if (params.isDirty() && millis() - last_param_change > PARAM_SAVE_DELAY && abs(motor_erpm) < GYRO_STATIONARY_ERPM) {
+    params.save();
+  }
+}
+
+// Gain schedule bucket for a speed in km/h
+int pidBucketForSpeed(float speed){
   int choose_value = 0;
-  for(; choose_value<sizeof(PID_CONFIG_SPEED) / sizeof(float); choose_value++){
+  for(; choose_value < (int)PID_BUCKETS - 1; choose_value++){
     if(PID_CONFIG_SPEED[choose_value+1] > speed){
       break;
     }
@@ -76,102 +438,360 @@ float get_pid_p_for_speed_kmh(float speed){
   #ifdef DEBUG
   Serial.printf("pid value: %d\n", choose_value);
   #endif
-  return PID_CONFIG_VALUE[choose_value];
+  return choose_value;
+}
+
+void setParam(void *value, float new_value){
+  for (uint8_t i = 0; i < params.getCount(); i++) {
+    if (params.get(i)->value == value) {
+      params.setValue(i, new_value);
+    }
+  }
+}
+
+// Writes the tuned buckets into the gain schedule, saved once the car stands still
+void applyAutotune(){
+  for (uint8_t i = 0; i < autotune.getCount(); i++) {
+    const AutotuneResult &result = autotune.getResult(i);
+    #ifdef DEBUG
+    Serial.printf("bucket %u at %.1f km/h: %s Ku %.6f Tu %.3f s, P %.7f I %.5f D %.2f\n", i + 1, result.speed_kmh,
+                  result.converged ? "tuned" : "not tuned", result.ultimate_gain, result.ultimate_period, result.kp, result.ki, result.kd);
+    #endif
+    if (result.converged) {
+      setParam(&PID_CONFIG_VALUE[i], result.kp);
+      setParam(&PID_CONFIG_I[i], result.ki);
+      setParam(&PID_CONFIG_D[i], result.kd);
+    }
+  }
+  last_param_change = millis();
+}
+
+// Drive modes that steer for target_yaw_v on the gyro
+bool steersYawRate(DriveMode mode){
+  return mode == DriveMode::TURN_ASSIST || mode == DriveMode::AUTONOMOUS || mode == DriveMode::REPEAT;
+}
+
+void resetTurnRate(){
+  #ifdef YAW_CONTROL_LQR
+  yaw_lqr.reset(steeringCommand);
+  yaw_lqr_out = steeringCommand;
+  #else
+  turn_rate_pid.reset();
+  #endif
+}
+
+void updateGyroNotch(){
+  yaw_filter.setStage(1, biquadMotorNotch(motor_erpm, MOTOR_POLES, GYRO_SAMPLE_RATE, GYRO_NOTCH_Q, GYRO_NOTCH_MIN_HZ));
+}
+
+// Throttle for a path speed in m/s, the throttle stick is a dead man's switch and caps it
+float pathThrottle(float speed, float throttleInput){
+  float command = max_speed_kmh > 0 ? speed * 3.6f / max_speed_kmh : 0;
+  return min(command, max(stickToCommand(throttleInput), 0.0f));
 }
 
 void handleRemote(){
-  if (millis() - remote.last_frame_timestamp < 200) {
+  if (remote.takeLinkStatistics()) {
+    link_monitor.statisticsReceived(remote.link_statistics, micros());
+  }
+  link_monitor.update(remote.channel_frames, remote.last_channels_us, micros());
+  if (!link_monitor.isFailsafe()) {
     #ifdef DEBUG
     Serial.println("Command");
     #endif
     float throttleInput = remote.getChannelFloat(0);
     float steeringInput = remote.getChannelFloat(1);
     float modeSelect = remote.getChannelFloat(2);
-    float turn_assist_mode = remote.getChannelFloat(3);
+    assist_switch = auxSwitch(remote.getChannelFloat(3), assist_switch);
+    teach_switch = auxSwitch(remote.getChannelFloat(TEACH_CHANNEL), teach_switch);
+    tune_switch = auxSwitch(remote.getChannelFloat(AUTOTUNE_CHANNEL), tune_switch);
     #ifdef DEBUG
     Serial.println(steeringInput);
     #endif
-    if (modeSelect < 0.33) {
-      drive_mode = DriveMode::OFF;
-    } else if (modeSelect < 0.66) {
-      drive_mode = DriveMode::DIRECT;
-    } else {
+    drive_mode = selectDriveMode(modeSelect, assist_switch, teach_switch, tune_switch);
+    // a switch already up at power up doesn't drive off on its own, it has to be
+    // flipped down and up again
+    path_armed = path_armed || !assist_switch;
+    if (!path_armed && (drive_mode == DriveMode::AUTONOMOUS || drive_mode == DriveMode::REPEAT)) {
+      drive_mode = DriveMode::TURN_ASSIST;
+    }
+    // the relay swings the steering by itself, the same goes for AUTOTUNE
+    tune_armed = tune_armed || !tune_switch;
+    if (!tune_armed && drive_mode == DriveMode::AUTOTUNE) {
       drive_mode = DriveMode::TURN_ASSIST;
     }
+    if (!startup.isReady(STARTUP_GYRO) && (drive_mode == DriveMode::TURN_ASSIST || drive_mode == DriveMode::AUTONOMOUS ||
+                                           drive_mode == DriveMode::REPEAT || drive_mode == DriveMode::AUTOTUNE)) {
+      // the gyro steered modes wait for the bias, STEER_ASSIST never starts teaching a lap
+      drive_mode = DriveMode::STEER_ASSIST;
+    }
+
+    // a lap is taught in DIRECT from where the car stands when the switch goes up
+    bool teach = drive_mode == DriveMode::DIRECT && teach_switch;
+    if (teach && !teaching) {
+      odometry.reset();
+      teach_log.beginRecording(TEACH_INTERVAL);
+    } else if (!teach && teaching) {
+      teach_log.finishRecording();
+    }
+    teaching = teach;
     
     switch (drive_mode) {
       case DriveMode::DIRECT:
-        if (!steering.attached()) {
-          steering.attach(STEERING_PIN, 1000, 2000);
+        steeringCommand = stickToCommand(steeringInput);
+        throttleCommand = stickToCommand(throttleInput);
+        if (teach_log.isErasing()) {
+          // the erase stalls the loop for a row at a time, the car waits for it
+          throttleCommand = 0;
         }
-
-        steeringCommand = (steeringInput - 0.5) * 2.0;
-        throttleCommand = (throttleInput - 0.5) * 2.0;
+        break;
+      case DriveMode::STEER_ASSIST:
+        steeringCommand = stickToCommand(steeringInput);
+        throttleCommand = steerAssistThrottle(stickToCommand(throttleInput), steeringCommand);
         break;
       case DriveMode::TURN_ASSIST:
-        if (!steering.attached()) {
-          steering.attach(STEERING_PIN, 1000, 2000);
-        }
-        
         if (previous_drive_mode != drive_mode) {
-          turn_rate_pid.reset();
+          resetTurnRate();
           #ifdef DEBUG
           Serial.println("pid reset");
           #endif
         }
 
-        throttleCommand = (throttleInput - 0.5) * 2.0;
-        target_yaw_v = ((double)steeringInput - 0.5) * 2.0 * MAX_STEERING_DEG_S;
+        throttleCommand = stickToCommand(throttleInput);
+        target_yaw_v = stickToCommand(steeringInput) * MAX_STEERING_DEG_S;
       
+        break;
+      case DriveMode::AUTONOMOUS:
+        if (previous_drive_mode != drive_mode) {
+          // the path starts wherever the car is when the mode is switched in
+          resetTurnRate();
+          odometry.reset();
+          pursuit.reset();
+        }
+
+        pursuit.update(odometry.getX(), odometry.getY(), odometry.getHeading(), current_speed / 3.6f);
+        // the pursuit turns counterclockwise positive, the turn rate loop clockwise
+        target_yaw_v = -constrain(pursuit.getYawRate(), -MAX_STEERING_DEG_S, MAX_STEERING_DEG_S);
+        // the throttle stick is a dead man's switch and caps the path speed
+        throttleCommand = pathThrottle(pursuit.getSpeed(), throttleInput);
+        break;
+      case DriveMode::REPEAT: {
+        if (previous_drive_mode != drive_mode) {
+          // the taught lap starts where the car stood, it has to be put back there
+          resetTurnRate();
+          odometry.reset();
+          follower.reset();
+          if (!teach_log.openPlayback()) {
+            follower.finish();
+          }
+        }
+
+        // the lap streams in as the car uses it up
+        TrajectorySample sample;
+        while (follower.wantsSample()) {
+          if (teach_log.read(&sample)) {
+            follower.push(sample);
+          } else {
+            follower.finish();
+          }
+        }
+        follower.update(odometry.getX(), odometry.getY(), odometry.getHeading(), current_speed / 3.6f);
+        target_yaw_v = -constrain(follower.getYawRate(), -MAX_STEERING_DEG_S, MAX_STEERING_DEG_S);
+        throttleCommand = pathThrottle(follower.getSpeed(), throttleInput);
+        break;
+      }
+      case DriveMode::AUTOTUNE:
+        if (previous_drive_mode != drive_mode) {
+          // every switch in tunes all buckets again from the slowest
+          autotune.begin(PID_CONFIG_SPEED, PID_BUCKETS, AUTOTUNE_MIN_SPEED_KMH, max_speed_kmh);
+          autotune_out = 0;
+          last_autotune = millis();
+          autotune_applied = false;
+        }
+        if (autotune.getState() == AutotuneState::DONE && !autotune_applied) {
+          applyAutotune();
+          autotune_applied = true;
+        }
+
+        target_yaw_v = AUTOTUNE_YAW_RATE;
+        // the throttle stick is a dead man's switch, letting go pauses the bucket
+        throttleCommand = pathThrottle(autotune.getSpeed() / 3.6f, throttleInput);
         break;
       case DriveMode::OFF:
-        steering.detach();
         throttleCommand = 0;
         break;
+      case DriveMode::NO_CONNECTION:
+        // selectDriveMode() never picks it, a remote that is connected can't end up here
+        throttleCommand = 0;
+        steeringCommand = 0;
+        break;
+    }
+    
+    if (!startup.isArmed()) {
+      // the sticks steer but don't drive before the ESC has answered
+      throttleCommand = 0;
     }
     
     previous_drive_mode = drive_mode;
     last_update = millis();
+  } else {
+    // the car stops at once and the outputs go limp once executeCommands() times out.
+    // previous_drive_mode is kept so a mode carries on where it was after a dropout
+    drive_mode = DriveMode::NO_CONNECTION;
+    throttleCommand = 0;
+    steeringCommand = 0;
+  }
+}
+
+// The start pose faces north, x forward is north and y left is west
+void fillPoseGps(crsfGpsFrame_t *info){
+  info->latitude = ODOMETRY_ORIGIN_LAT + (int32_t)(odometry.getX() * METERS_TO_LAT);
+  info->longitude = ODOMETRY_ORIGIN_LON - (int32_t)(odometry.getY() * meters_to_lon);
+  float compass = -odometry.getHeading();
+  if (compass < 0) {
+    compass += 360;
   }
+  info->heading = (uint16_t)(compass * 100);
+  info->altitude = 1000;
 }
 
 void handleEscTelemetry(){
-  if(esc.getVescValues()){
-
-    float motor_erpm = esc.data.rpm;
-    current_speed = motor_erpm / KMH_TO_MOTOR_ERPM;
-    uint16_t speed_kmh_mul_10 = (uint16_t)abs(current_speed*10.0);
-    // Serial.printf("Read rpm %.2f battery v: %.2f\n", motor_erpm, esc.data.inpVoltage);
-    crsfGpsFrame_t info = {
-      .groundSpeed = speed_kmh_mul_10
-    };
-    remote.transmitGpsFrame(info);
-    crsfVoltageFrame_t voltageInfo = {
-      .voltage = (uint16_t)(esc.data.inpVoltage * 10.0),
-      .current = (uint16_t)(esc.data.avgInputCurrent * 100.0)
-    };
-    remote.transmitVoltageFrame(voltageInfo);
+  if(esc.takeValues()){
+    startup.ready(STARTUP_ESC, millis());
+
+    motor_erpm = esc.values.rpm;
+    updateGyroNotch();
+    float wheel_speed = motor_erpm / KMH_TO_MOTOR_ERPM;
+    // the reply is a few ms old by now, it corrects the estimate at the time the ERPM was read.
+    // A wheel the brake is locking doesn't turn with the car, the accelerometer carries on alone
+    if (!brake.isReleasing()) {
+      speed_estimator.correct(wheel_speed / 3.6f, esc.values_request_us + SPEED_ERPM_DELAY_US);
+    }
+    current_speed = speed_estimator.getSpeed() * 3.6f;
+    current_accel = speed_estimator.getAcceleration();
+    // the bias corrected gyro heading, yaw turns clockwise and the pose counterclockwise
+    odometry.update(esc.values.tachometer, (float)remainder(-yaw, 360.0));
+    uint16_t speed_kmh_mul_10 = (uint16_t)abs(wheel_speed*10.0);
+    // Serial.printf("Read rpm %.2f battery v: %.2f\n", motor_erpm, esc.values.inpVoltage);
+    // a poor link gets fewer downlink frames, they share the air with the channels
+    if (millis() - last_telemetry >= TELEMETRY_INTERVAL * link_monitor.getTelemetryDivider()) {
+      crsfGpsFrame_t info = {};
+      info.groundSpeed = speed_kmh_mul_10;
+      fillPoseGps(&info);
+      remote.transmitGpsFrame(info);
+      // capacity and remaining aren't reported and go out as 0
+      crsfVoltageFrame_t voltageInfo = {};
+      voltageInfo.voltage = (uint16_t)(esc.values.inpVoltage * 10.0);
+      voltageInfo.current = (uint16_t)(esc.values.avgInputCurrent * 100.0);
+      remote.transmitVoltageFrame(voltageInfo);
+      last_telemetry = millis();
+    }
   }
 }
 
 void executeCommands(){
   if (millis() - last_update > 500) {
-    steering.write(90);
-    steering.detach();
+    steering.disable();
     lights.write(0);
   }else{
-    steeringCommand = constrain(steeringCommand, -1., 1.);
-    throttleCommand = constrain(throttleCommand, -1., 1.);
-    float desired_kmh = throttleCommand * MAX_SPEED_KMH;
-    float desired_erpm = desired_kmh * KMH_TO_MOTOR_ERPM;
-    steering.write((int)(90. * (steeringCommand + 1.)));
-    
-    if(abs(desired_erpm) > 300) {
-      esc.setRPM(desired_erpm);
-    }else{
-      esc.setRPM(0);
+    steeringCommand = clampCommand(steeringCommand);
+    throttleCommand = clampCommand(throttleCommand);
+    // buffered in the timer, the pulse changes at the next servo frame
+    if (drive_mode == DriveMode::OFF) {
+      steering.disable();
+    } else {
+      steering.writeMicroseconds(steeringToPulseUs(steeringCommand, steering_trim, STEERING_MIN_US, STEERING_MAX_US));
+    }
+    // against the rolling direction the stick brakes, the RPM setpoint only drives
+    if (brake.getState() == BrakeState::BRAKE) {
+      esc.setBrakeCurrent(brake.getBrakeCurrent());
+    } else {
+      float drive = brake.driveCommand(throttleCommand);
+      esc.setRpm((int32_t)throttleToErpm(drive, max_speed_kmh * link_monitor.getSpeedScale(), KMH_TO_MOTOR_ERPM));
     }
   }
+  #ifdef LATENCY_PROBE
+  probeWritten();
+  #endif
+}
+
+// Samples the taught lap at a fixed rate, then gives the log its one flash operation of the pass
+void handleTeach(){
+  if (teach_log.isRecording() && millis() - last_teach_sample >= TEACH_INTERVAL) {
+    TrajectorySample sample = {
+      .x = (int32_t)lroundf(odometry.getX() * 1000.0f),
+      .y = (int32_t)lroundf(odometry.getY() * 1000.0f),
+      .heading = (int16_t)lroundf(odometry.getHeading() * 100.0f),
+      .speed = (int16_t)lroundf(current_speed / 3.6f * 100.0f),
+      .steering = (int16_t)lroundf(steeringCommand * 1000.0f)
+    };
+    teach_log.record(sample);
+    last_teach_sample = millis();
+  }
+  teach_log.service();
+}
+
+// Deferred work slot, called between the slow tasks of loop(). A channels frame that completed
+// meanwhile is parsed here, and where the sticks drive the outputs directly the new values go
+// out now instead of at the end of the pass, a stick change waits for one task, not a whole pass.
+void serviceRemoteEvent(){
+  if (!crsf_frame_event) {
+    return;
+  }
+  crsf_frame_event = false;
+  serial_mux.poll(crsf_port.getChannel());
+  #ifdef LATENCY_PROBE
+  probeParsed();
+  #endif
+  handleRemote();
+  if (drive_mode == DriveMode::DIRECT || drive_mode == DriveMode::STEER_ASSIST || drive_mode == DriveMode::OFF) {
+    executeCommands();
+    esc.update();
+  }
+}
+
+// Brings the devices up from loop(), nothing here waits on a device
+void serviceStartup(){
+  if (startup.isSettled()) {
+    return;
+  }
+  uint32_t now = millis();
+  if (!link_monitor.isFailsafe()) {
+    startup.ready(STARTUP_LINK, now);
+  }
+  if (startup.attempt(STARTUP_IMU, now)) {
+    // data ready on INT1, read back since a write to a missing chip goes nowhere
+    uint8_t int1 = 0;
+    if (imu.begin() == IMU_SUCCESS && imu.writeRegister(LSM6DS3_ACC_GYRO_INT1_CTRL, 0b00000010) == IMU_SUCCESS &&
+        imu.readRegister(&int1, LSM6DS3_ACC_GYRO_INT1_CTRL) == IMU_SUCCESS && int1 == 0b00000010) {
+      imu.readFloatGyroZ();
+      startup.ready(STARTUP_IMU, now);
+    }
+  }
+  if (gyro_cal.isCalibrated()) {
+    startup.ready(STARTUP_GYRO, now);
+  }
+  #ifdef OSD_ON
+  if (startup.attempt(STARTUP_OSD, now)) {
+    osd.beginAsync();
+  }
+  if (startup.getState(STARTUP_OSD) == StartupState::STARTING && osd.pollBegin()) {
+    osd.cmdWidgetSetConfigAhi(90, 50, 180, 150, FrSkyPixelOsd::WIDGET_AHI_STYLE_LINE, FrSkyPixelOsd::WIDGET_AHI_OPTION_NONE, 10, 1);
+    startup.ready(STARTUP_OSD, now);
+  }
+  #endif
+  #ifdef DEBUG
+  if (startup.isArmed() && !startup_reported) {
+    Serial.printf("armed after %lu ms\n", (unsigned long)startup.getArmedMs());
+  }
+  if (startup.isSettled()) {
+    for (uint8_t i = 0; i < startup.getCount(); i++) {
+      Serial.printf("%s %s after %lu ms, %u attempts\n", startup.getName(i), startup.isReady(i) ? "ready" : "failed",
+                    (unsigned long)startup.getDoneMs(i), startup.getAttempts(i));
+    }
+  }
+  startup_reported = startup.isArmed();
+  #endif
 }
 
 void setup() {
@@ -183,52 +803,183 @@ void setup() {
   pinPeripheral(26, PIO_SERCOM);
   pinPeripheral(27, PIO_SERCOM);
   pinMode(A5, INPUT);
-  turn_rate_pid.setTimeStep(1000 / 50);
-  remote.begin(&Serial2);
-  Serial1.begin(115200);
-  esc.setSerialPort(&Serial1);
+  #ifdef LATENCY_PROBE
+  pinMode(LATENCY_PROBE_PIN, OUTPUT);
+  digitalWrite(LATENCY_PROBE_PIN, LOW);
+  #endif
+  params.load();
+  applyParams();
+  #ifndef BRAKE_ABS
+  brake.setModulation(false);
+  #endif
+  turn_rate_pid.setTimeStep(1000 / PID_RATE_HZ);
+  steering.begin(STEERING_FRAME_HZ);
+  pursuit.setPath(AUTONOMOUS_PATH, sizeof(AUTONOMOUS_PATH) / sizeof(PathPoint), true);
+  remote.begin(&crsf_port);
+  crsf_port.setReceiveHook(detectCrsfFrame);
+  remote.setExtendedFrameHandler(handleParameterFrame);
+  serial_mux.attach(crsf_port.getChannel(), receiveCrsf);
+  esc.begin(&vesc_serial, VESC_BAUDRATE);
+  serial_mux.attach(vesc_serial.getChannel(), receiveVesc);
+  #ifdef CAPTURE_LOG
+  beginCapture();
+  #endif
   // lights.attach(10);
   // lights.write(0);
 
-  // attachInterrupt(A5, sensor_event, RISING);
-  #ifdef DEBUG
-  if(!imu.begin()){
-    Serial.println("Failed imu init");
-  }else{
-    Serial.println("IMU init");
-  };
-  #else
-  imu.begin();
+  // loop() still checks the line, an edge before this is picked up at the next tick
+  attachInterrupt(digitalPinToInterrupt(A5), gyroReady, RISING);
+
+  #ifdef OSD_ON
+  // the OSD library reads its port as a Stream, the mux only services it
+  serial_mux.attach(osd_port.getChannel(), NULL);
+  pinPeripheral(10, PIO_SERCOM);
+  pinPeripheral(12, PIO_SERCOM);
   #endif
-  imu.writeRegister(0x0D, 0b00000010);
-  imu.readFloatGyroZ();
+  // the IMU and the OSD are brought up by serviceStartup()
+  startup.begin(millis());
 }
 
 void loop() {
-  if(digitalRead(A5)){
-    double elapsed = (double)(micros() - last_sensor) / 1000000.0;
-    double yaw_in = -(imu.readFloatGyroZ() + GYRO_YAW_CAL);
+  // sleeps until there is something to do, every pass checks all of it. A pass woken by a
+  // channels frame writes its values first
+  loop_events.wait();
+  serviceRemoteEvent();
+  crsf_frame_event = false;
+  serial_mux.poll();
+  #ifdef LATENCY_PROBE
+  probeParsed();
+  #endif
+  serviceStartup();
+  if(digitalRead(A5) && startup.isReady(STARTUP_IMU)){
+    uint32_t sample_time = micros();
+    double elapsed = (double)(sample_time - last_sensor) / 1000000.0;
+    last_sensor = sample_time;
+    float gyro[3], accel[3];
+    readImu(gyro, accel);
+    #ifdef CAPTURE_LOG
+    CaptureImuSample sample;
+    memcpy(sample.gyro, gyro, sizeof(gyro));
+    memcpy(sample.accel, accel, sizeof(accel));
+    capture.record(CAPTURE_IMU, (const uint8_t *)&sample, sizeof(sample), sample_time);
+    #endif
+    double yaw_in = -gyro_cal.update(gyro[2], motor_erpm);
     yaw += yaw_in * elapsed;
-    yaw_v = yaw_v * (1.0 - GYRO_LOWPASS_ALPHA) + yaw_in * GYRO_LOWPASS_ALPHA;
-    last_sensor = micros();
+    speed_estimator.predict(SPEED_ACCEL_SIGN * accel[SPEED_ACCEL_AXIS] * 9.80665f, sample_time);
+    current_speed = speed_estimator.getSpeed() * 3.6f;
+    current_accel = speed_estimator.getAcceleration();
+    #ifdef GYRO_FILTER_FIXED
+    yaw_v = biquadFromFixed(yaw_filter.process(biquadToFixed((float)yaw_in)));
+    #else
+    yaw_v = yaw_filter.process((float)yaw_in);
+    #endif
+    #ifdef YAW_CONTROL_LQR
+    if (steersYawRate(drive_mode)) {
+      yaw_lqr_out = yaw_lqr.update((float)target_yaw_v, (float)yaw_v, current_speed / 3.6f, (float)elapsed);
+    }
+    #endif
+    uint32_t attitude_start = micros();
+    // the estimator takes X as the axis along the car, SPEED_ACCEL_AXIS 0
+    attitude.setSpeed(SPEED_ACCEL_SIGN * current_speed / 3.6f);
+    attitude.update(gyro[0], gyro[1], (float)-yaw_in, accel[0], accel[1], accel[2], (float)elapsed);
+    attitude_us = micros() - attitude_start;
+    if (attitude_us > ATTITUDE_BUDGET_US) {
+      attitude_overruns++;
+    }
+  }
+  serviceRemoteEvent();
+  #ifdef GYRO_TEMP_COMP
+  if (millis() - last_temperature > GYRO_TEMP_INTERVAL) {
+    gyro_cal.setTemperature(imu.readTempC());
+    last_temperature = millis();
   }
+  #endif
   handleEscTelemetry();
+  serviceRemoteEvent();
   
   handleRemote();
+  handleParams();
+  serviceRemoteEvent();
   
-  double i_term = turn_rate_pid.getIntegral();
-  if (abs(i_term) > 2) {
-    turn_rate_pid.setIntegral(2.0 * i_term / abs(i_term));
-  }
+  #ifndef YAW_CONTROL_LQR
+  int bucket = pidBucketForSpeed(current_speed);
+  turn_rate_pid.setGains((double)PID_CONFIG_VALUE[bucket], PID_CONFIG_I[bucket], PID_CONFIG_D[bucket]);
+  double i_term = clampTurnRateIntegral((float)turn_rate_pid.getIntegral(), PID_CONFIG_I[bucket]);
+  turn_rate_pid.setIntegral(i_term);
   turn_rate_pid.run();
-  if(drive_mode == DriveMode::TURN_ASSIST) {
-    steeringCommand = (float)turn_rate_out;
-    float newPValue = get_pid_p_for_speed_kmh(current_speed);
-    turn_rate_pid.setGains((double)newPValue, PID_I_TERM, PID_D_TERM);
+  // with the feed-forward steering the car into the turn the integral would only wind up
+  // against the servo and yaw lag and overshoot, it trims what the feed-forward leaves once the
+  // rate is close. Without it the integral has to carry the whole turn
+  if (ff_gain > 0 && fabs(target_yaw_v - yaw_v) > PID_INTEGRAL_BAND) {
+    turn_rate_pid.setIntegral(i_term);
+  }
+  #endif
+  if (steersYawRate(drive_mode)) {
+    #ifdef YAW_CONTROL_LQR
+    // stepped with the gyro samples above
+    steeringCommand = yaw_lqr_out;
+    #else
+    // the model predicts the steering for the target rate, the PID only corrects what it misses
+    float feed_forward = steering_ff.command((float)target_yaw_v, current_speed / 3.6f);
+    steeringCommand = ff_gain * feed_forward + (float)turn_rate_out;
+    #endif
     #ifdef DEBUG
     Serial.printf("target: %.2f current: %.2f output: %.2f\n", target_yaw_v, yaw_v, steeringCommand);
     #endif
+  } else if (drive_mode == DriveMode::AUTOTUNE) {
+    // the relay steps with the PID, the oscillation it measures then has the PID's sampling delay
+    uint32_t now = millis();
+    if (now - last_autotune >= 1000 / PID_RATE_HZ) {
+      autotune_out = autotune.update((float)yaw_v, (float)target_yaw_v, current_speed, (now - last_autotune) / 1000.0f);
+      last_autotune = now;
+    }
+    steeringCommand = ff_gain * steering_ff.command((float)target_yaw_v, current_speed / 3.6f) + autotune_out;
   }
 
+  // at a fixed rate so the lock detection differentiates the ERPM over a known step
+  uint32_t now = millis();
+  if (now - last_brake >= 1000 / BRAKE_RATE_HZ) {
+    brake.update(clampCommand(throttleCommand), motor_erpm / KMH_TO_MOTOR_ERPM / 3.6f, current_accel, (now - last_brake) / 1000.0f);
+    last_brake = now;
+  }
   executeCommands();
+  esc.update();
+  // after the outputs are out, a flash write only delays the next pass
+  handleTeach();
+  serviceRemoteEvent();
+  #ifdef CAPTURE_LOG
+  capture.flush();
+  #endif
+
+  #ifdef OSD_ON
+  if (startup.isReady(STARTUP_OSD) && millis() - last_osd > OSD_INTERVAL) {
+    osd.cmdWidgetDrawAhiDeg((int16_t)attitude.getPitch(), (int16_t)attitude.getRoll());
+    char pose[31];
+    int length = snprintf(pose, sizeof(pose), "X%6.1f Y%6.1f H%4d", odometry.getX(), odometry.getY(), (int)odometry.getHeading());
+    osd.cmdDrawGridString(OSD_POSE_COLUMN, OSD_POSE_ROW, pose, length + 1);
+    char link[16];
+    if (link_monitor.isFailsafe()) {
+      length = snprintf(link, sizeof(link), "LINK LOST     ");
+    } else {
+      length = snprintf(link, sizeof(link), "LQ%4u%5ddBm", link_monitor.getLinkQuality(), link_monitor.getRssi());
+    }
+    osd.cmdDrawGridString(OSD_LINK_COLUMN, OSD_LINK_ROW, link, length + 1);
+    char load[10];
+    length = snprintf(load, sizeof(load), "CPU%4d%%", (int)loop_events.getLoad());
+    osd.cmdDrawGridString(OSD_LOAD_COLUMN, OSD_LOAD_ROW, load, length + 1);
+    char tune[16];
+    if (drive_mode != DriveMode::AUTOTUNE) {
+      length = snprintf(tune, sizeof(tune), "              ");
+    } else if (autotune.getState() == AutotuneState::DONE) {
+      length = snprintf(tune, sizeof(tune), "TUNE DONE     ");
+    } else if (autotune.getState() == AutotuneState::SPEED) {
+      length = snprintf(tune, sizeof(tune), "TUNE %u/%u SPEED", autotune.getBucket() + 1, autotune.getCount());
+    } else {
+      length = snprintf(tune, sizeof(tune), "TUNE %u/%u CYC%2u", autotune.getBucket() + 1, autotune.getCount(), autotune.getCycles());
+    }
+    osd.cmdDrawGridString(OSD_TUNE_COLUMN, OSD_TUNE_ROW, tune, length + 1);
+    last_osd = millis();
+  }
+  serviceRemoteEvent();
+  #endif
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "GyroCalibration.h"
+#include <math.h>
+
+GyroCalibration::GyroCalibration(float initial_bias, float stationary_erpm, float stationary_stddev) {
+  this->stationary_erpm = stationary_erpm;
+  this->stationary_variance = stationary_stddev * stationary_stddev;
+  bias_mean = initial_bias;
+  bias = initial_bias;
+}
+
+float GyroCalibration::update(float raw, float motor_erpm) {
+  if (fabsf(motor_erpm) > stationary_erpm) {
+    stationary = false;
+    resetWindow();
+    return raw - bias;
+  }
+
+  window_count++;
+  float delta = raw - window_mean;
+  window_mean += delta / window_count;
+  window_m2 += delta * (raw - window_mean);
+
+  // bail out early on an obvious turn instead of waiting for the window to fill
+  if (window_count > 8 && delta * delta > 16.0f * stationary_variance) {
+    stationary = false;
+    resetWindow();
+  } else if (window_count >= GYRO_CAL_WINDOW_SAMPLES) {
+    stationary = window_m2 / (window_count - 1) < stationary_variance;
+    if (stationary) {
+      acceptWindow();
+    }
+    resetWindow();
+  }
+  return raw - bias;
+}
+
+void GyroCalibration::setTemperature(float temp_c) {
+  temperature = temp_c;
+  has_temperature = true;
+  updateBias();
+}
+
+float GyroCalibration::getBias() {
+  return bias;
+}
+
+bool GyroCalibration::isCalibrated() {
+  return calibrated;
+}
+
+bool GyroCalibration::isStationary() {
+  return stationary;
+}
+
+void GyroCalibration::resetWindow() {
+  window_count = 0;
+  window_mean = 0;
+  window_m2 = 0;
+}
+
+void GyroCalibration::acceptWindow() {
+  // Welford update over window means. Once the count is capped the estimate turns into an
+  // exponential average so slow drift is still followed.
+  if (windows < GYRO_CAL_TRACK_WINDOWS) {
+    windows++;
+  }
+  float d_bias = window_mean - bias_mean;
+  bias_mean += d_bias / windows;
+
+  if (has_temperature) {
+    if (temp_windows < GYRO_CAL_TRACK_WINDOWS) {
+      temp_windows++;
+    } else {
+      float decay = 1.0f - 1.0f / temp_windows;
+      temp_m2 *= decay;
+      temp_bias_c2 *= decay;
+    }
+    float d_temp = temperature - temp_mean;
+    temp_mean += d_temp / temp_windows;
+    temp_bias_mean += (window_mean - temp_bias_mean) / temp_windows;
+    temp_m2 += d_temp * (temperature - temp_mean);
+    temp_bias_c2 += d_temp * (window_mean - temp_bias_mean);
+    float half_span = GYRO_CAL_MIN_TEMP_SPAN / 2.0f;
+    if (temp_m2 / temp_windows > half_span * half_span) {
+      temp_slope = temp_bias_c2 / temp_m2;
+    }
+  }
+
+  updateBias();
+  if (windows >= GYRO_CAL_BOOT_WINDOWS) {
+    calibrated = true;
+  }
+}
+
+void GyroCalibration::updateBias() {
+  if (temp_slope != 0) {
+    // the fitted line, through the means of the windows it was fitted on
+    bias = temp_bias_mean + temp_slope * (temperature - temp_mean);
+  } else {
+    bias = bias_mean;
+  }
+}
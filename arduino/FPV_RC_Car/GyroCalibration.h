@@ -0,0 +1,58 @@
+#ifndef GYRO_CALIBRATION_H
+#define GYRO_CALIBRATION_H
+
+#include <stdint.h>
+
+#define GYRO_CAL_WINDOW_SAMPLES 64   // samples per stationary window (~150ms at 416Hz)
+#define GYRO_CAL_BOOT_WINDOWS 8      // stationary windows averaged before the bias is trusted
+#define GYRO_CAL_TRACK_WINDOWS 64    // history length of the online estimate, older windows fade out
+#define GYRO_CAL_MIN_TEMP_SPAN 2.0f  // deg C of spread needed before a temperature slope is fitted
+
+// Estimates the zero-rate offset of a single gyro axis.
+// Samples are collected into short windows while the car is stationary (motor ERPM near zero
+// and low gyro variance). Each accepted window mean is folded into a running Welford estimate
+// of the bias, optionally regressed against the sensor temperature.
+class GyroCalibration {
+  public:
+    GyroCalibration(float initial_bias, float stationary_erpm, float stationary_stddev);
+    // Feed one raw sample (deg/s), returns the bias corrected rate.
+    float update(float raw, float motor_erpm);
+    // Latest die temperature, only needed when temperature compensation is used.
+    void setTemperature(float temp_c);
+    float getBias();
+    bool isCalibrated();
+    bool isStationary();
+
+  private:
+    void resetWindow();
+    void acceptWindow();
+    void updateBias();
+
+    float stationary_erpm;
+    float stationary_variance;
+    float temperature = 0;
+    bool has_temperature = false;
+    bool stationary = false;
+
+    // current window
+    uint16_t window_count = 0;
+    float window_mean = 0;
+    float window_m2 = 0;
+    float window_temperature = 0;
+
+    // accepted windows
+    uint16_t windows = 0;
+    bool calibrated = false;
+    float bias_mean;
+    // windows accepted with a temperature, the regression has its own count and means since
+    // the first reading can come after the first windows
+    uint16_t temp_windows = 0;
+    float temp_bias_mean = 0;
+    float temp_mean = 0;
+    float temp_m2 = 0;
+    float temp_bias_c2 = 0;
+    float temp_slope = 0;
+    float bias;
+};
+
+#endif // GYRO_CALIBRATION_H
@@ -0,0 +1,95 @@
+#include "LinkMonitor.h"
+
+LinkMonitor::LinkMonitor(uint8_t lq_full, uint8_t lq_min, float min_speed_scale, uint8_t failsafe_frames, uint32_t failsafe_min_us, uint32_t failsafe_max_us)
+  : lq_full(lq_full), lq_min(lq_min), min_speed_scale(min_speed_scale), failsafe_frames(failsafe_frames),
+    failsafe_min_us(failsafe_min_us), failsafe_max_us(failsafe_max_us) {}
+
+void LinkMonitor::update(uint32_t channel_frames, uint32_t last_channels_us, uint32_t now_us) {
+  this->now_us = now_us;
+  uint32_t new_frames = channel_frames - frames;
+  if (new_frames > 0) {
+    if (frames_seen) {
+      measureInterval((last_channels_us - last_frame_us) / new_frames);
+    }
+    frames = channel_frames;
+    last_frame_us = last_channels_us;
+    frames_seen = true;
+    if (failsafe) {
+      recover_count += new_frames < LINK_MONITOR_RECOVER_FRAMES ? new_frames : LINK_MONITOR_RECOVER_FRAMES;
+      if (recover_count >= LINK_MONITOR_RECOVER_FRAMES) {
+        failsafe = false;
+      }
+    }
+  }
+  if (!failsafe && now_us - last_frame_us > getFailsafeGap()) {
+    failsafe = true;
+    recover_count = 0;
+    failsafes++;
+  }
+}
+
+void LinkMonitor::measureInterval(uint32_t interval) {
+  if (interval == 0) {
+    return;
+  }
+  if (frame_interval == 0) {
+    frame_interval = interval;
+  } else if (interval < frame_interval + frame_interval / 2) {
+    // lost frames make longer intervals, only the ones near the estimate move it
+    frame_interval += ((int32_t)interval - (int32_t)frame_interval) / 8;
+  }
+}
+
+void LinkMonitor::statisticsReceived(const crsfLinkStatistics_t &stats, uint32_t now_us) {
+  if (stats_seen && stats.rfMode != this->stats.rfMode) {
+    frame_interval = 0;
+  }
+  this->stats = stats;
+  stats_us = now_us;
+  stats_seen = true;
+}
+
+bool LinkMonitor::isFailsafe() {
+  return failsafe;
+}
+
+bool LinkMonitor::hasStatistics() {
+  return stats_seen && now_us - stats_us < LINK_MONITOR_STATS_TIMEOUT_US;
+}
+
+float LinkMonitor::getSpeedScale() {
+  if (!hasStatistics() || stats.uplinkLinkQuality >= lq_full) {
+    return 1.0f;
+  }
+  if (stats.uplinkLinkQuality <= lq_min) {
+    return min_speed_scale;
+  }
+  return min_speed_scale + (1.0f - min_speed_scale) * (stats.uplinkLinkQuality - lq_min) / (float)(lq_full - lq_min);
+}
+
+uint8_t LinkMonitor::getTelemetryDivider() {
+  if (!hasStatistics() || stats.uplinkLinkQuality >= lq_full) {
+    return 1;
+  }
+  return stats.uplinkLinkQuality <= lq_min ? 4 : 2;
+}
+
+uint8_t LinkMonitor::getLinkQuality() {
+  return stats.uplinkLinkQuality;
+}
+
+int16_t LinkMonitor::getRssi() {
+  return -(int16_t)(stats.activeAntenna ? stats.uplinkRssi2 : stats.uplinkRssi1);
+}
+
+uint32_t LinkMonitor::getFrameInterval() {
+  return frame_interval;
+}
+
+uint32_t LinkMonitor::getFailsafeGap() {
+  if (frame_interval == 0) {
+    return failsafe_max_us;
+  }
+  uint32_t gap = frame_interval * failsafe_frames;
+  return gap < failsafe_min_us ? failsafe_min_us : (gap > failsafe_max_us ? failsafe_max_us : gap);
+}
@@ -0,0 +1,59 @@
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include <stdint.h>
+#include "CRSFProtocol.h"
+
+#define LINK_MONITOR_RECOVER_FRAMES 3 // channels frames that end a failsafe
+#define LINK_MONITOR_STATS_TIMEOUT_US 1000000 // link statistics older than this are not used
+
+// Judges the CRSF link from the channels frame timing and the receiver's link statistics.
+// The frame interval is measured rather than looked up from the RF mode, whose numbering
+// differs between Crossfire and ELRS releases; a change of RF mode starts it over. The link
+// fails once no channels frame came for failsafe_frames intervals, kept between
+// failsafe_min_us and failsafe_max_us, the upper bound also applies while the interval is
+// unknown. Below lq_full uplink LQ the speed scale drops linearly to min_speed_scale at lq_min
+// and the telemetry divider rises.
+class LinkMonitor {
+  public:
+    LinkMonitor(uint8_t lq_full, uint8_t lq_min, float min_speed_scale, uint8_t failsafe_frames, uint32_t failsafe_min_us, uint32_t failsafe_max_us);
+    // Call every pass with CRSFLink's channels frame count and the arrival time of the newest
+    void update(uint32_t channel_frames, uint32_t last_channels_us, uint32_t now_us);
+    void statisticsReceived(const crsfLinkStatistics_t &stats, uint32_t now_us);
+    // True from startup until the first frames and after a dropout until frames come again
+    bool isFailsafe();
+    float getSpeedScale();
+    // Telemetry goes out every 1, 2 or 4 intervals as LQ drops
+    uint8_t getTelemetryDivider();
+    bool hasStatistics();
+    uint8_t getLinkQuality(); // uplink percent
+    int16_t getRssi(); // dBm of the active antenna
+    uint32_t getFrameInterval(); // us, 0 until measured
+    uint32_t getFailsafeGap(); // us without a channels frame before the link fails
+
+    uint32_t failsafes = 0; // dropouts since startup
+
+  private:
+    void measureInterval(uint32_t interval);
+
+    uint8_t lq_full;
+    uint8_t lq_min;
+    float min_speed_scale;
+    uint8_t failsafe_frames;
+    uint32_t failsafe_min_us;
+    uint32_t failsafe_max_us;
+
+    bool failsafe = true;
+    bool frames_seen = false;
+    uint32_t frames = 0;
+    uint32_t last_frame_us = 0;
+    uint32_t frame_interval = 0;
+    uint8_t recover_count = 0;
+
+    bool stats_seen = false;
+    uint32_t stats_us = 0;
+    uint32_t now_us = 0;
+    crsfLinkStatistics_t stats = {};
+};
+
+#endif // LINK_MONITOR_H
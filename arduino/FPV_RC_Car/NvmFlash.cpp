@@ -0,0 +1,37 @@
+#include <Arduino.h>
+#include "NvmFlash.h"
+
+static void nvmWaitReady() {
+  while (!NVMCTRL->INTFLAG.bit.READY);
+}
+
+void nvmRead(uint32_t address, void *data, uint32_t length) {
+  memcpy(data, (const void *)address, length);
+}
+
+void nvmEraseRow(uint32_t address) {
+  nvmWaitReady();
+  NVMCTRL->STATUS.reg |= NVMCTRL_STATUS_MASK;
+  NVMCTRL->ADDR.reg = address / 2; // ADDR is in 16 bit words
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+  nvmWaitReady();
+}
+
+void nvmWritePage(uint32_t address, const void *data) {
+  uint32_t words[NVM_PAGE_SIZE / 4];
+  memcpy(words, data, sizeof(words));
+
+  nvmWaitReady();
+  NVMCTRL->CTRLB.bit.MANW = 1;
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+  nvmWaitReady();
+
+  // the page buffer is filled by writing to the flash address space with 32 bit accesses
+  volatile uint32_t *destination = (volatile uint32_t *)address;
+  for (uint32_t i = 0; i < NVM_PAGE_SIZE / 4; i++) {
+    destination[i] = words[i];
+  }
+  NVMCTRL->ADDR.reg = address / 2;
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+  nvmWaitReady();
+}
@@ -0,0 +1,25 @@
+#ifndef NVM_FLASH_H
+#define NVM_FLASH_H
+
+#include <stdint.h>
+
+// Raw access to the SAMD21 internal flash through NVMCTRL.
+// Erase works on rows, writes on pages, an erased row reads back as 0xFF.
+
+#define NVM_PAGE_SIZE 64
+#define NVM_ROW_SIZE 256
+#define NVM_FLASH_END 0x40000 // 256KB on the SAMD21G18
+
+// Regions are carved downward from the end of flash, well above the sketch
+#define NVM_PARAM_ROWS 8
+#define NVM_PARAM_ADDRESS (NVM_FLASH_END - NVM_PARAM_ROWS * NVM_ROW_SIZE)
+#define NVM_TRAJECTORY_ROWS 128 // 32KB for a taught lap
+#define NVM_TRAJECTORY_ADDRESS (NVM_PARAM_ADDRESS - NVM_TRAJECTORY_ROWS * NVM_ROW_SIZE)
+
+void nvmRead(uint32_t address, void *data, uint32_t length);
+// Blocks for the whole row erase (several milliseconds)
+void nvmEraseRow(uint32_t address);
+// Writes one full page, address must be page aligned and the page erased
+void nvmWritePage(uint32_t address, const void *data);
+
+#endif // NVM_FLASH_H
@@ -0,0 +1,82 @@
+#include "Odometry.h"
+#include <math.h>
+
+#define FIXED_ONE (float)(1L << ODOMETRY_FRACTION_BITS)
+#define DEG_TO_RAD_F 0.017453293f
+
+static float wrapDegrees(float angle) {
+  while (angle > 180.0f) {
+    angle -= 360.0f;
+  }
+  while (angle < -180.0f) {
+    angle += 360.0f;
+  }
+  return angle;
+}
+
+Odometry::Odometry(float meters_per_count) {
+  this->meters_per_count = meters_per_count;
+}
+
+void Odometry::update(int32_t tachometer, float heading_deg) {
+  if (!started) {
+    last_tachometer = tachometer;
+    heading_origin = heading_deg;
+    started = true;
+    return;
+  }
+  // unsigned subtraction keeps the step right across a counter wrap
+  int32_t counts = (int32_t)((uint32_t)tachometer - (uint32_t)last_tachometer);
+  last_tachometer = tachometer;
+  float new_heading = wrapDegrees(heading_deg - heading_origin);
+  float mean_heading = (heading + wrapDegrees(new_heading - heading) * 0.5f) * DEG_TO_RAD_F;
+  heading = new_heading;
+  if (counts == 0) {
+    return;
+  }
+
+  float step = counts * meters_per_count * FIXED_ONE;
+  float dx = step * cosf(mean_heading) + residual_x;
+  float dy = step * sinf(mean_heading) + residual_y;
+  int32_t step_x = (int32_t)lroundf(dx);
+  int32_t step_y = (int32_t)lroundf(dy);
+  residual_x = dx - step_x;
+  residual_y = dy - step_y;
+  x += step_x;
+  y += step_y;
+  distance_counts += counts > 0 ? counts : -counts;
+}
+
+void Odometry::reset() {
+  started = false;
+  heading = 0;
+  x = 0;
+  y = 0;
+  residual_x = 0;
+  residual_y = 0;
+  distance_counts = 0;
+}
+
+float Odometry::getX() {
+  return x / FIXED_ONE;
+}
+
+float Odometry::getY() {
+  return y / FIXED_ONE;
+}
+
+float Odometry::getHeading() {
+  return heading;
+}
+
+float Odometry::getDistance() {
+  return distance_counts * meters_per_count;
+}
+
+int32_t Odometry::getXFixed() {
+  return x;
+}
+
+int32_t Odometry::getYFixed() {
+  return y;
+}
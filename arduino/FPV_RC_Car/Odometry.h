@@ -0,0 +1,43 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <stdint.h>
+
+#define ODOMETRY_FRACTION_BITS 16 // pose in Q16.16 meters, good for +-32 km
+
+// 2D dead reckoning from the VESC tachometer and the fused yaw. Every update advances the pose
+// by the distance the tachometer counted along the mean heading of the step. The position is
+// accumulated in fixed point with the rounding error carried into the next step, so a float
+// pose far from the origin can't swallow small steps and rounding doesn't add up along straights.
+// The pose frame is the car at the first update after reset(): x forward, y left, heading
+// counterclockwise.
+class Odometry {
+  public:
+    Odometry(float meters_per_count);
+    // tachometer is the signed VESC count, heading_deg counterclockwise in any range
+    void update(int32_t tachometer, float heading_deg);
+    void reset();
+    // meters
+    float getX();
+    float getY();
+    // degrees counterclockwise, -180..180
+    float getHeading();
+    // meters driven, forward and reverse
+    float getDistance();
+    int32_t getXFixed();
+    int32_t getYFixed();
+
+  private:
+    float meters_per_count;
+    bool started = false;
+    int32_t last_tachometer = 0;
+    float heading_origin = 0;
+    float heading = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    float residual_x = 0;
+    float residual_y = 0;
+    uint32_t distance_counts = 0;
+};
+
+#endif // ODOMETRY_H
@@ -0,0 +1,178 @@
+#include "ParamStore.h"
+#include <string.h>
+#include <math.h>
+
+ParamStore::ParamStore(const ParamDescriptor *params, uint8_t count) {
+  this->params = params;
+  this->count = count > PARAM_STORE_MAX ? PARAM_STORE_MAX : count;
+}
+
+uint32_t ParamStore::crc32(const uint8_t *data, uint32_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  while (length--) {
+    crc ^= *data++;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+uint32_t ParamStore::slotAddress(uint8_t slot) {
+  return NVM_PARAM_ADDRESS + (uint32_t)slot * PARAM_STORE_RECORD_SIZE;
+}
+
+bool ParamStore::readRecord(uint8_t slot, uint8_t *record) {
+  nvmRead(slotAddress(slot), record, PARAM_STORE_RECORD_SIZE);
+  RecordHeader *header = (RecordHeader *)record;
+  if (header->magic != PARAM_STORE_MAGIC || header->version != PARAM_STORE_VERSION || header->count > PARAM_STORE_MAX) {
+    return false;
+  }
+  uint32_t length = sizeof(RecordHeader) + header->count * 4;
+  uint32_t stored_crc;
+  memcpy(&stored_crc, record + length, sizeof(stored_crc));
+  return stored_crc == crc32(record, length);
+}
+
+bool ParamStore::isBlank(uint8_t slot) {
+  uint8_t record[PARAM_STORE_RECORD_SIZE];
+  nvmRead(slotAddress(slot), record, sizeof(record));
+  for (uint32_t i = 0; i < sizeof(record); i++) {
+    if (record[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParamStore::load() {
+  uint8_t record[PARAM_STORE_RECORD_SIZE];
+  int16_t best_slot = -1;
+  uint32_t best_sequence = 0;
+  for (uint8_t slot = 0; slot < PARAM_STORE_SLOTS; slot++) {
+    if (readRecord(slot, record)) {
+      uint32_t record_sequence = ((RecordHeader *)record)->sequence;
+      if (best_slot < 0 || record_sequence > best_sequence) {
+        best_slot = slot;
+        best_sequence = record_sequence;
+      }
+    }
+  }
+
+  resetToDefaults();
+  dirty = false;
+  save_failed = false;
+  if (best_slot < 0) {
+    return false;
+  }
+
+  readRecord(best_slot, record);
+  RecordHeader *header = (RecordHeader *)record;
+  uint8_t stored = header->count < count ? header->count : count;
+  for (uint8_t i = 0; i < stored; i++) {
+    float value;
+    if (params[i].type == PARAM_FLOAT) {
+      memcpy(&value, record + sizeof(RecordHeader) + i * 4, sizeof(value));
+    } else {
+      value = record[sizeof(RecordHeader) + i * 4];
+    }
+    if (!isnan(value)) {
+      setValue(i, value);
+    }
+  }
+  last_slot = best_slot;
+  sequence = best_sequence;
+  dirty = false;
+  return true;
+}
+
+bool ParamStore::save() {
+  uint8_t record[PARAM_STORE_RECORD_SIZE];
+  memset(record, 0xFF, sizeof(record));
+  RecordHeader header = {PARAM_STORE_MAGIC, PARAM_STORE_VERSION, count, sequence + 1};
+  memcpy(record, &header, sizeof(header));
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t *slot_value = record + sizeof(RecordHeader) + i * 4;
+    if (params[i].type == PARAM_FLOAT) {
+      memcpy(slot_value, params[i].value, 4);
+    } else {
+      memset(slot_value, 0, 4);
+      *slot_value = *(uint8_t *)params[i].value;
+    }
+  }
+  uint32_t length = sizeof(RecordHeader) + count * 4;
+  uint32_t crc = crc32(record, length);
+  memcpy(record + length, &crc, sizeof(crc));
+
+  uint8_t slot = (last_slot + 1) % PARAM_STORE_SLOTS;
+  if (slotAddress(slot) % NVM_ROW_SIZE != 0 && !isBlank(slot)) {
+    // a torn or corrupted write left this slot dirty, continue at the start of the next row
+    uint8_t slots_per_row = NVM_ROW_SIZE / PARAM_STORE_RECORD_SIZE;
+    slot = (slot + slots_per_row - slot % slots_per_row) % PARAM_STORE_SLOTS;
+  }
+  uint32_t address = slotAddress(slot);
+  // the latest record always lives in the previous row, so erasing here never loses it
+  if (address % NVM_ROW_SIZE == 0) {
+    nvmEraseRow(address);
+  }
+  for (uint32_t offset = 0; offset < PARAM_STORE_RECORD_SIZE; offset += NVM_PAGE_SIZE) {
+    nvmWritePage(address + offset, record + offset);
+  }
+
+  uint8_t verify[PARAM_STORE_RECORD_SIZE];
+  if (!readRecord(slot, verify) || memcmp(verify, record, length + 4) != 0) {
+    save_failed = true;
+    return false;
+  }
+  last_slot = slot;
+  sequence++;
+  dirty = false;
+  return true;
+}
+
+void ParamStore::resetToDefaults() {
+  for (uint8_t i = 0; i < count; i++) {
+    setValue(i, params[i].default_value);
+  }
+}
+
+uint8_t ParamStore::getCount() {
+  return count;
+}
+
+const ParamDescriptor *ParamStore::get(uint8_t index) {
+  return index < count ? &params[index] : NULL;
+}
+
+float ParamStore::getValue(uint8_t index) {
+  if (index >= count) {
+    return 0;
+  }
+  if (params[index].type == PARAM_FLOAT) {
+    return *(float *)params[index].value;
+  }
+  return *(uint8_t *)params[index].value;
+}
+
+bool ParamStore::setValue(uint8_t index, float value) {
+  if (index >= count) {
+    return false;
+  }
+  const ParamDescriptor *param = &params[index];
+  if (value < param->min) value = param->min;
+  if (value > param->max) value = param->max;
+  if (param->type == PARAM_FLOAT) {
+    save_failed &= *(float *)param->value == value;
+    *(float *)param->value = value;
+  } else {
+    uint8_t rounded = (uint8_t)lroundf(value);
+    save_failed &= *(uint8_t *)param->value == rounded;
+    *(uint8_t *)param->value = rounded;
+  }
+  dirty = true;
+  return true;
+}
+
+bool ParamStore::isDirty() {
+  return dirty && !save_failed;
+}
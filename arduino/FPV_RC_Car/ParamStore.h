@@ -0,0 +1,73 @@
+#ifndef PARAM_STORE_H
+#define PARAM_STORE_H
+
+#include <stdint.h>
+#include "NvmFlash.h"
+
+#define PARAM_STORE_MAGIC 0x5052 // "RP"
+#define PARAM_STORE_VERSION 1    // bump when the meaning of existing slots changes
+#define PARAM_STORE_MAX 26
+#define PARAM_STORE_RECORD_SIZE 128 // header + PARAM_STORE_MAX values + crc, rounded to whole pages
+#define PARAM_STORE_SLOTS (NVM_PARAM_ROWS * NVM_ROW_SIZE / PARAM_STORE_RECORD_SIZE)
+
+enum ParamType : uint8_t {
+  PARAM_FLOAT,
+  PARAM_UINT8
+};
+
+// Describes one tunable. value points at the variable the firmware reads directly, so a read
+// on the hot path is an ordinary memory access. Parameters are only ever appended to the
+// table, a record saved by an older firmware then still loads its prefix.
+struct ParamDescriptor {
+  const char *name;
+  ParamType type;
+  void *value;
+  float min;
+  float max;
+  float default_value;
+  uint8_t decimals; // precision exposed over the CRSF parameter protocol
+  const char *unit;
+};
+
+// Registry of tunables persisted to internal flash.
+// Every save appends a CRC protected record to the next slot of a ring spanning
+// NVM_PARAM_ROWS rows, a row is only erased right before it is reused. Load picks the valid
+// record with the highest sequence number, so a torn write falls back to the previous save.
+class ParamStore {
+  public:
+    ParamStore(const ParamDescriptor *params, uint8_t count);
+    // Returns false if no valid record was found and defaults were applied
+    bool load();
+    bool save();
+    void resetToDefaults();
+    uint8_t getCount();
+    const ParamDescriptor *get(uint8_t index);
+    float getValue(uint8_t index);
+    // Clamps to the parameter range, returns false for an unknown index
+    bool setValue(uint8_t index, float value);
+    // True while a change waits to be saved. A save that fails to verify clears it until a
+    // parameter actually changes again, so a worn row isn't erased on every loop pass
+    bool isDirty();
+
+  private:
+    struct __attribute__((packed)) RecordHeader {
+      uint16_t magic;
+      uint8_t version;
+      uint8_t count;
+      uint32_t sequence;
+    };
+
+    static uint32_t crc32(const uint8_t *data, uint32_t length);
+    static uint32_t slotAddress(uint8_t slot);
+    bool readRecord(uint8_t slot, uint8_t *record);
+    bool isBlank(uint8_t slot);
+
+    const ParamDescriptor *params;
+    uint8_t count;
+    bool dirty = false;
+    bool save_failed = false;
+    int16_t last_slot = -1;
+    uint32_t sequence = 0;
+};
+
+#endif // PARAM_STORE_H
@@ -0,0 +1,134 @@
+#include "PurePursuit.h"
+#include <math.h>
+
+#define DEG_TO_RAD_F 0.017453293f
+#define RAD_TO_DEG_F 57.29578f
+
+PurePursuit::PurePursuit(float lookahead, float cruise_speed, float max_lateral_accel) {
+  this->lookahead = lookahead;
+  this->cruise_speed = cruise_speed;
+  this->max_lateral_accel = max_lateral_accel;
+}
+
+bool PurePursuit::setPath(const PathPoint *points, uint8_t count, bool closed) {
+  if (count < 2 || count > PURE_PURSUIT_MAX_POINTS) {
+    return false;
+  }
+  this->closed = closed;
+  segment_count = closed ? count : count - 1;
+  for (uint8_t i = 0; i < segment_count; i++) {
+    const PathPoint &end = points[(i + 1) % count];
+    float dx = end.x - points[i].x;
+    float dy = end.y - points[i].y;
+    start_x[i] = points[i].x;
+    start_y[i] = points[i].y;
+    length[i] = sqrtf(dx * dx + dy * dy);
+    // a repeated waypoint becomes a zero length segment the searches step straight over
+    direction_x[i] = length[i] > 0 ? dx / length[i] : 0;
+    direction_y[i] = length[i] > 0 ? dy / length[i] : 0;
+  }
+  reset();
+  return true;
+}
+
+void PurePursuit::setTuning(float lookahead, float cruise_speed) {
+  this->lookahead = lookahead;
+  this->cruise_speed = cruise_speed;
+}
+
+void PurePursuit::reset() {
+  segment = 0;
+  finished = false;
+  laps = 0;
+  yaw_rate = 0;
+  speed_target = 0;
+  curvature = 0;
+  cross_track = 0;
+}
+
+uint8_t PurePursuit::next(uint8_t segment) {
+  return segment + 1 < segment_count ? segment + 1 : 0;
+}
+
+bool PurePursuit::update(float x, float y, float heading_deg, float speed) {
+  if (segment_count == 0 || finished) {
+    return false;
+  }
+
+  // move the projection on until the car is alongside the current segment
+  float along = 0;
+  for (uint8_t steps = 0; steps < PURE_PURSUIT_MAX_STEPS; steps++) {
+    along = (x - start_x[segment]) * direction_x[segment] + (y - start_y[segment]) * direction_y[segment];
+    if (along < length[segment]) {
+      break;
+    }
+    if (!closed && segment == segment_count - 1) {
+      finished = true;
+      yaw_rate = 0;
+      speed_target = 0;
+      curvature = 0;
+      return false;
+    }
+    segment = next(segment);
+    if (segment == 0) {
+      laps++;
+    }
+  }
+  cross_track = direction_x[segment] * (y - start_y[segment]) - direction_y[segment] * (x - start_x[segment]);
+
+  // the goal point, one lookahead further along the path than the projection
+  float remaining = lookahead + (along > 0 ? along : 0);
+  uint8_t goal = segment;
+  for (uint8_t steps = 0; steps < PURE_PURSUIT_MAX_STEPS && remaining > length[goal]; steps++) {
+    if (!closed && goal == segment_count - 1) {
+      break;
+    }
+    remaining -= length[goal];
+    goal = next(goal);
+  }
+  if (remaining > length[goal]) {
+    remaining = length[goal];
+  }
+  curvature = arcCurvature(x, y, heading_deg, start_x[goal] + direction_x[goal] * remaining, start_y[goal] + direction_y[goal] * remaining);
+
+  speed_target = cruise_speed;
+  if (fabsf(curvature) * cruise_speed * cruise_speed > max_lateral_accel) {
+    speed_target = sqrtf(max_lateral_accel / fabsf(curvature));
+  }
+  yaw_rate = fabsf(speed) * curvature * RAD_TO_DEG_F;
+  return true;
+}
+
+// arc through the goal point tangent to the heading: curvature = 2 * lateral offset / distance^2
+float PurePursuit::arcCurvature(float x, float y, float heading_deg, float goal_x, float goal_y) {
+  float dx = goal_x - x;
+  float dy = goal_y - y;
+  float heading = heading_deg * DEG_TO_RAD_F;
+  float lateral = cosf(heading) * dy - sinf(heading) * dx;
+  float distance_squared = dx * dx + dy * dy;
+  return distance_squared > 1e-4f ? 2.0f * lateral / distance_squared : 0;
+}
+
+float PurePursuit::getYawRate() {
+  return yaw_rate;
+}
+
+float PurePursuit::getSpeed() {
+  return speed_target;
+}
+
+float PurePursuit::getCurvature() {
+  return curvature;
+}
+
+float PurePursuit::getCrossTrack() {
+  return cross_track;
+}
+
+uint8_t PurePursuit::getSegment() {
+  return segment;
+}
+
+uint32_t PurePursuit::getLaps() {
+  return laps;
+}
@@ -0,0 +1,69 @@
+#ifndef PURE_PURSUIT_H
+#define PURE_PURSUIT_H
+
+#include <stdint.h>
+
+#define PURE_PURSUIT_MAX_POINTS 64
+#define PURE_PURSUIT_MAX_STEPS 8 // segments a search may walk per update, waypoints should be at least lookahead / 8 apart
+
+// Waypoint in meters, in the Odometry frame
+struct PathPoint {
+  float x;
+  float y;
+};
+
+// Pure pursuit along a waypoint polyline. setPath() precomputes every segment's direction and
+// length, and update() keeps the index of the segment the car is on, so a tick projects the car
+// onto that segment, walks forward at most PURE_PURSUIT_MAX_STEPS segments and never searches the
+// whole path. The car is steered on the arc through the point one lookahead ahead along the path,
+// which asks for a yaw rate of speed * curvature; the speed target is the cruise speed, reduced
+// where the arc would exceed the lateral acceleration limit.
+class PurePursuit {
+  public:
+    // lookahead in meters, cruise_speed in m/s, max_lateral_accel in m/s^2
+    PurePursuit(float lookahead, float cruise_speed, float max_lateral_accel);
+    // The points are copied into the segment table. A closed path is lapped, the last point joins
+    // the first. False if there are fewer than 2 or more than PURE_PURSUIT_MAX_POINTS points.
+    bool setPath(const PathPoint *points, uint8_t count, bool closed);
+    void setTuning(float lookahead, float cruise_speed);
+    // Starts over from the first segment
+    void reset();
+    // Pose in the Odometry frame and signed speed in m/s. Returns false once an open path has
+    // been driven to its end, the targets are zero from then on.
+    bool update(float x, float y, float heading_deg, float speed);
+    // deg/s counterclockwise
+    float getYawRate();
+    // m/s
+    float getSpeed();
+    // 1/m, positive turning left
+    float getCurvature();
+    // meters from the current segment, positive left of the path
+    float getCrossTrack();
+    uint8_t getSegment();
+    uint32_t getLaps();
+    // Curvature in 1/m of the arc from the pose through the goal point, positive turning left
+    static float arcCurvature(float x, float y, float heading_deg, float goal_x, float goal_y);
+
+  private:
+    uint8_t next(uint8_t segment);
+
+    float lookahead;
+    float cruise_speed;
+    float max_lateral_accel;
+    uint8_t segment_count = 0;
+    bool closed = false;
+    float start_x[PURE_PURSUIT_MAX_POINTS];
+    float start_y[PURE_PURSUIT_MAX_POINTS];
+    float direction_x[PURE_PURSUIT_MAX_POINTS];
+    float direction_y[PURE_PURSUIT_MAX_POINTS];
+    float length[PURE_PURSUIT_MAX_POINTS];
+    uint8_t segment = 0;
+    bool finished = false;
+    uint32_t laps = 0;
+    float yaw_rate = 0;
+    float speed_target = 0;
+    float curvature = 0;
+    float cross_track = 0;
+};
+
+#endif // PURE_PURSUIT_H
@@ -0,0 +1,132 @@
+#include "SerialChannel.h"
+#include <string.h>
+
+#define RX_MASK (SERIAL_CHANNEL_RX_SIZE - 1)
+#define TX_MASK (SERIAL_CHANNEL_TX_SIZE - 1)
+#define BURST_MASK (SERIAL_CHANNEL_BURSTS - 1)
+
+static_assert((SERIAL_CHANNEL_RX_SIZE & RX_MASK) == 0, "SERIAL_CHANNEL_RX_SIZE must be a power of two");
+static_assert((SERIAL_CHANNEL_TX_SIZE & TX_MASK) == 0, "SERIAL_CHANNEL_TX_SIZE must be a power of two");
+static_assert((SERIAL_CHANNEL_BURSTS & BURST_MASK) == 0, "SERIAL_CHANNEL_BURSTS must be a power of two");
+
+// The data has to be in memory before the index that publishes it, a dmb on the Cortex-M0 and
+// a real fence for the host threads
+#define PUBLISH_BARRIER() __sync_synchronize()
+
+bool SerialChannel::rxPut(uint8_t byte, uint32_t now_us) {
+  uint16_t next = (rx_head + 1) & RX_MASK;
+  if (next == rx_tail) {
+    rx_overruns++;
+    return false;
+  }
+  // only gaps between unread bytes matter, when the table is full the bursts merge
+  if (rx_head != rx_tail && now_us - last_rx_us > SERIAL_CHANNEL_GAP_US) {
+    uint8_t burst_next = (burst_head + 1) & BURST_MASK;
+    if (burst_next != burst_tail) {
+      bursts[burst_head].start = rx_head;
+      bursts[burst_head].previous_end_us = last_rx_us;
+      PUBLISH_BARRIER();
+      burst_head = burst_next;
+    }
+  }
+  rx_buffer[rx_head] = byte;
+  PUBLISH_BARRIER();
+  rx_head = next;
+  rx_bytes++;
+  last_rx_us = now_us;
+  uint16_t used = (next - rx_tail) & RX_MASK;
+  if (used > rx_high_water) {
+    rx_high_water = used;
+  }
+  return true;
+}
+
+bool SerialChannel::txTake(uint8_t *byte) {
+  if (tx_tail == tx_head) {
+    return false;
+  }
+  PUBLISH_BARRIER();
+  *byte = tx_buffer[tx_tail];
+  tx_tail = (tx_tail + 1) & TX_MASK;
+  tx_bytes++;
+  return true;
+}
+
+void SerialChannel::countHardwareOverrun() {
+  hw_overruns++;
+}
+
+uint16_t SerialChannel::rxSpan(const uint8_t **data, uint32_t *end_us) {
+  // the time before the head, a byte that slips in between arrived less than a gap later
+  uint32_t newest_us = last_rx_us;
+  uint16_t head = rx_head;
+  PUBLISH_BARRIER();
+  popBursts();
+  uint16_t end = head;
+  *end_us = newest_us;
+  if (burst_tail != burst_head) {
+    end = bursts[burst_tail].start;
+    *end_us = bursts[burst_tail].previous_end_us;
+  }
+  *data = &rx_buffer[rx_tail];
+  return end >= rx_tail ? end - rx_tail : SERIAL_CHANNEL_RX_SIZE - rx_tail;
+}
+
+void SerialChannel::rxConsume(uint16_t length) {
+  PUBLISH_BARRIER();
+  rx_tail = (rx_tail + length) & RX_MASK;
+  popBursts();
+}
+
+// A burst is over once the reader has reached the start of the next one
+void SerialChannel::popBursts() {
+  while (burst_tail != burst_head && bursts[burst_tail].start == rx_tail) {
+    burst_tail = (burst_tail + 1) & BURST_MASK;
+  }
+}
+
+uint16_t SerialChannel::rxAvailable() {
+  return (rx_head - rx_tail) & RX_MASK;
+}
+
+int SerialChannel::rxRead() {
+  int byte = rxPeek();
+  if (byte >= 0) {
+    rxConsume(1);
+  }
+  return byte;
+}
+
+int SerialChannel::rxPeek() {
+  if (rx_tail == rx_head) {
+    return -1;
+  }
+  PUBLISH_BARRIER();
+  return rx_buffer[rx_tail];
+}
+
+bool SerialChannel::txWrite(const uint8_t *data, uint16_t length) {
+  uint16_t used = (tx_head - tx_tail) & TX_MASK;
+  if (SERIAL_CHANNEL_TX_SIZE - 1 - used < length) {
+    tx_overruns++;
+    return false;
+  }
+  uint16_t head = tx_head;
+  uint16_t first = SERIAL_CHANNEL_TX_SIZE - head < length ? SERIAL_CHANNEL_TX_SIZE - head : length;
+  memcpy(&tx_buffer[head], data, first);
+  memcpy(tx_buffer, data + first, length - first);
+  PUBLISH_BARRIER();
+  tx_head = (head + length) & TX_MASK;
+  if (used + length > tx_high_water) {
+    tx_high_water = used + length;
+  }
+  return true;
+}
+
+uint16_t SerialChannel::txPending() {
+  return (tx_head - tx_tail) & TX_MASK;
+}
+
+uint32_t SerialChannel::lastReceive() {
+  return last_rx_us;
+}
@@ -0,0 +1,70 @@
+#ifndef SERIAL_CHANNEL_H
+#define SERIAL_CHANNEL_H
+
+#include <stdint.h>
+
+// Receive and transmit rings of one serial port, no hardware dependencies. The interrupt (a
+// thread on the host) is the only writer of the receive ring and the only reader of the transmit
+// ring, loop() owns the other ends, so neither side has to mask interrupts.
+
+#define SERIAL_CHANNEL_RX_SIZE 256 // power of two, one byte stays free
+#define SERIAL_CHANNEL_TX_SIZE 256 // power of two, one byte stays free
+#define SERIAL_CHANNEL_BURSTS 8 // power of two, idle gaps remembered between polls
+#define SERIAL_CHANNEL_GAP_US 250 // line idle time that ends a burst
+
+class SerialChannel {
+  public:
+    // Interrupt side. Returns false when the byte was dropped because the ring is full
+    bool rxPut(uint8_t byte, uint32_t now_us);
+    // Interrupt side. Next byte to send, false when there is nothing left
+    bool txTake(uint8_t *byte);
+    // Interrupt side, for bytes the UART lost before the interrupt ran
+    void countHardwareOverrun();
+
+    // Longest run of received bytes that is contiguous in memory and arrived without an idle
+    // gap, end_us is when its last byte arrived. Stays valid until rxConsume().
+    uint16_t rxSpan(const uint8_t **data, uint32_t *end_us);
+    void rxConsume(uint16_t length);
+    uint16_t rxAvailable();
+    int rxRead();
+    int rxPeek();
+    // Queues all of data or nothing, a refused write is counted in tx_overruns
+    bool txWrite(const uint8_t *data, uint16_t length);
+    uint16_t txPending();
+    // micros() of the newest received byte
+    uint32_t lastReceive();
+
+    // Called by SerialMux::poll() before dispatching, for ports without an interrupt of their own
+    virtual void service() {}
+
+    volatile uint32_t rx_bytes = 0;
+    volatile uint32_t tx_bytes = 0;
+    volatile uint32_t rx_overruns = 0;
+    volatile uint32_t hw_overruns = 0;
+    volatile uint32_t tx_overruns = 0;
+    volatile uint16_t rx_high_water = 0;
+    volatile uint16_t tx_high_water = 0;
+
+  private:
+    // Bytes are buffered far longer than the gaps between them on the wire, so the receive side
+    // remembers where each idle gap was to keep parser timeouts working from loop()
+    struct Burst {
+      uint16_t start;
+      uint32_t previous_end_us;
+    };
+
+    void popBursts();
+
+    uint8_t rx_buffer[SERIAL_CHANNEL_RX_SIZE];
+    uint8_t tx_buffer[SERIAL_CHANNEL_TX_SIZE];
+    volatile uint16_t rx_head = 0;
+    volatile uint16_t rx_tail = 0;
+    volatile uint16_t tx_head = 0;
+    volatile uint16_t tx_tail = 0;
+    volatile uint32_t last_rx_us = 0;
+    Burst bursts[SERIAL_CHANNEL_BURSTS];
+    volatile uint8_t burst_head = 0;
+    volatile uint8_t burst_tail = 0;
+};
+
+#endif // SERIAL_CHANNEL_H
@@ -0,0 +1,59 @@
+#include "SerialMux.h"
+#include <stddef.h>
+
+bool SerialMux::attach(SerialChannel *channel, serialSpanHandler_t handler) {
+  if (channel_count >= SERIAL_MUX_MAX_CHANNELS) {
+    return false;
+  }
+  channels[channel_count] = channel;
+  handlers[channel_count] = handler;
+  channel_count++;
+  return true;
+}
+
+uint32_t SerialMux::poll() {
+  uint32_t dispatched = 0;
+  for (uint8_t i = 0; i < channel_count; i++) {
+    dispatched += pollChannel(i);
+  }
+  return dispatched;
+}
+
+uint32_t SerialMux::poll(SerialChannel *channel) {
+  for (uint8_t i = 0; i < channel_count; i++) {
+    if (channels[i] == channel) {
+      return pollChannel(i);
+    }
+  }
+  return 0;
+}
+
+uint32_t SerialMux::pollChannel(uint8_t index) {
+  SerialChannel *channel = channels[index];
+  channel->service();
+  if (handlers[index] == NULL) {
+    return 0;
+  }
+  uint32_t dispatched = 0;
+  // bounded so a port that keeps receiving can't hold loop() here
+  for (uint8_t span = 0; span < SERIAL_MUX_MAX_SPANS; span++) {
+    const uint8_t *data;
+    uint32_t now_us;
+    uint16_t length = channel->rxSpan(&data, &now_us);
+    if (length == 0) {
+      break;
+    }
+    handlers[index](data, length, now_us);
+    channel->rxConsume(length);
+    dispatched += length;
+  }
+  return dispatched;
+}
+
+uint8_t SerialMux::getChannelCount() {
+  return channel_count;
+}
+
+SerialChannel *SerialMux::getChannel(uint8_t index) {
+  return index < channel_count ? channels[index] : NULL;
+}
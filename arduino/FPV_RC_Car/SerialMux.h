@@ -0,0 +1,35 @@
+#ifndef SERIAL_MUX_H
+#define SERIAL_MUX_H
+
+#include <stdint.h>
+#include "SerialChannel.h"
+
+#define SERIAL_MUX_MAX_CHANNELS 4
+#define SERIAL_MUX_MAX_SPANS 8 // per channel and poll, anything left waits for the next poll
+
+// Receives the buffered bytes of a port a run at a time, now_us is the arrival time of the last
+// byte of the run
+typedef void (*serialSpanHandler_t)(const uint8_t *data, uint16_t length, uint32_t now_us);
+
+// Hands the bytes buffered by the port interrupts to the protocol parsers from loop(), a span at
+// a time instead of an available()/read() pair per byte. Channels attached without a handler
+// are only serviced, their bytes stay for a library reading the port as a Stream.
+class SerialMux {
+  public:
+    bool attach(SerialChannel *channel, serialSpanHandler_t handler);
+    // Returns the number of bytes handed to parsers
+    uint32_t poll();
+    // Polls one attached channel only
+    uint32_t poll(SerialChannel *channel);
+    uint8_t getChannelCount();
+    SerialChannel *getChannel(uint8_t index);
+
+  private:
+    uint32_t pollChannel(uint8_t index);
+
+    SerialChannel *channels[SERIAL_MUX_MAX_CHANNELS];
+    serialSpanHandler_t handlers[SERIAL_MUX_MAX_CHANNELS];
+    uint8_t channel_count = 0;
+};
+
+#endif // SERIAL_MUX_H
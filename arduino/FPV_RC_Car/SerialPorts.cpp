@@ -0,0 +1,164 @@
+#include "SerialPorts.h"
+
+ChannelSerial::ChannelSerial(SerialChannel *channel) : channel(channel) {}
+
+SerialChannel *ChannelSerial::getChannel() {
+  return channel;
+}
+
+int ChannelSerial::available() {
+  // libraries poll this while waiting for a reply, polled ports have to move bytes in here
+  channel->service();
+  return channel->rxAvailable();
+}
+
+int ChannelSerial::peek() {
+  return channel->rxPeek();
+}
+
+int ChannelSerial::read() {
+  return channel->rxRead();
+}
+
+int ChannelSerial::availableForWrite() {
+  return SERIAL_CHANNEL_TX_SIZE - 1 - channel->txPending();
+}
+
+void ChannelSerial::flush() {
+  while (channel->txPending() > 0) {
+    channel->service();
+  }
+}
+
+size_t ChannelSerial::write(uint8_t byte) {
+  return write(&byte, 1);
+}
+
+size_t ChannelSerial::write(const uint8_t *buffer, size_t size) {
+  if (size > SERIAL_CHANNEL_TX_SIZE - 1 || !channel->txWrite(buffer, size)) {
+    return 0;
+  }
+  startTransmit();
+  return size;
+}
+
+SercomSerial::SercomSerial(SERCOM *sercom, SercomRXPad pad_rx, SercomUartTXPad pad_tx) : ChannelSerial(&rings) {
+  this->sercom = sercom;
+  this->pad_rx = pad_rx;
+  this->pad_tx = pad_tx;
+}
+
+void SercomSerial::begin(unsigned long baudrate) {
+  begin(baudrate, SERIAL_8N1);
+}
+
+// Same frame setup as the core Uart::begin()
+void SercomSerial::begin(unsigned long baudrate, uint16_t config) {
+  SercomUartCharSize char_size;
+  switch (config & HARDSER_DATA_MASK) {
+    case HARDSER_DATA_5:
+      char_size = UART_CHAR_SIZE_5_BITS;
+      break;
+    case HARDSER_DATA_6:
+      char_size = UART_CHAR_SIZE_6_BITS;
+      break;
+    case HARDSER_DATA_7:
+      char_size = UART_CHAR_SIZE_7_BITS;
+      break;
+    default:
+      char_size = UART_CHAR_SIZE_8_BITS;
+      break;
+  }
+  SercomParityMode parity;
+  switch (config & HARDSER_PARITY_MASK) {
+    case HARDSER_PARITY_EVEN:
+      parity = SERCOM_EVEN_PARITY;
+      break;
+    case HARDSER_PARITY_ODD:
+      parity = SERCOM_ODD_PARITY;
+      break;
+    default:
+      parity = SERCOM_NO_PARITY;
+      break;
+  }
+  SercomNumberStopBit stop_bits = (config & HARDSER_STOP_BIT_MASK) == HARDSER_STOP_BIT_2 ? SERCOM_STOP_BITS_2 : SERCOM_STOP_BIT_1;
+
+  sercom->initUART(UART_INT_CLOCK, SAMPLE_RATE_x16, baudrate);
+  sercom->initFrame(char_size, LSB_FIRST, parity, stop_bits);
+  sercom->initPads(pad_tx, pad_rx);
+  sercom->enableUART();
+}
+
+void SercomSerial::end() {
+  sercom->resetUART();
+}
+
+void SercomSerial::setReceiveHook(serialReceiveHook_t hook) {
+  receive_hook = hook;
+}
+
+void SercomSerial::IrqHandler() {
+  // one timestamp per interrupt, at 420 kbaud the UART holds at most two bytes anyway
+  uint32_t now = micros();
+  if (sercom->isFrameErrorUART()) {
+    sercom->readDataUART();
+    sercom->clearFrameErrorUART();
+  }
+  while (sercom->availableDataUART()) {
+    uint8_t byte = sercom->readDataUART();
+    rings.rxPut(byte, now);
+    if (receive_hook != NULL) {
+      receive_hook(byte, now);
+    }
+  }
+  if (sercom->isDataRegisterEmptyUART()) {
+    uint8_t byte;
+    if (rings.txTake(&byte)) {
+      sercom->writeDataUART(byte);
+    } else {
+      sercom->disableDataRegisterEmptyInterruptUART();
+    }
+  }
+  if (sercom->isUARTError()) {
+    sercom->acknowledgeUARTError();
+    if (sercom->isBufferOverflowErrorUART()) {
+      rings.countHardwareOverrun();
+    }
+    sercom->clearStatusUART();
+  }
+}
+
+void SercomSerial::startTransmit() {
+  sercom->enableDataRegisterEmptyInterruptUART();
+}
+
+PolledSerial::PolledSerial(HardwareSerial *port) : ChannelSerial(&rings) {
+  rings.port = port;
+}
+
+void PolledSerial::begin(unsigned long baudrate) {
+  rings.port->begin(baudrate);
+}
+
+void PolledSerial::begin(unsigned long baudrate, uint16_t config) {
+  rings.port->begin(baudrate, config);
+}
+
+void PolledSerial::end() {
+  rings.port->end();
+}
+
+void PolledSerial::startTransmit() {
+  rings.service();
+}
+
+void PolledSerial::PolledChannel::service() {
+  uint32_t now = micros();
+  while (port->available() > 0) {
+    rxPut(port->read(), now);
+  }
+  uint8_t byte;
+  while (port->availableForWrite() > 0 && txTake(&byte)) {
+    port->write(byte);
+  }
+}
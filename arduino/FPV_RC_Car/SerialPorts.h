@@ -0,0 +1,84 @@
+#ifndef SERIAL_PORTS_H
+#define SERIAL_PORTS_H
+
+#include <Arduino.h>
+#include "SerialChannel.h"
+
+// Sees every received byte inside the port interrupt, keep it to a few instructions
+typedef void (*serialReceiveHook_t)(uint8_t byte, uint32_t now_us);
+
+// HardwareSerial over a SerialChannel, so libraries that take a Stream (FrSkyPixelOsd)
+// read and write the same rings SerialMux dispatches from. Writes never block, a write that
+// doesn't fit the transmit ring is dropped whole and counted in tx_overruns.
+class ChannelSerial : public HardwareSerial {
+  public:
+    SerialChannel *getChannel();
+    int available();
+    int peek();
+    int read();
+    int availableForWrite();
+    void flush();
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    operator bool() { return true; }
+
+  protected:
+    ChannelSerial(SerialChannel *channel);
+    // Starts sending whatever is queued in the channel
+    virtual void startTransmit() = 0;
+
+    SerialChannel *channel;
+};
+
+// Port on a SERCOM whose interrupt handler the sketch owns, replaces the core Uart class. The
+// sketch muxes the pins with pinPeripheral().
+class SercomSerial : public ChannelSerial {
+  public:
+    SercomSerial(SERCOM *sercom, SercomRXPad pad_rx, SercomUartTXPad pad_tx);
+    void begin(unsigned long baudrate);
+    void begin(unsigned long baudrate, uint16_t config);
+    void end();
+    void setReceiveHook(serialReceiveHook_t hook);
+    // Call from the SERCOMx_Handler of the port
+    void IrqHandler();
+
+  protected:
+    void startTransmit();
+
+  private:
+    SerialChannel rings;
+    SERCOM *sercom;
+    SercomRXPad pad_rx;
+    SercomUartTXPad pad_tx;
+    serialReceiveHook_t receive_hook = NULL;
+};
+
+// Port whose interrupt handler belongs to the board variant (Serial1 on SERCOM0), the bytes are
+// moved between the core buffers and the channel from SerialMux::poll(). The variant defines
+// SERCOM0_Handler itself, so the port can't move to SercomSerial without patching the core.
+// Bytes still arrive in the core's interrupt, but they are timestamped when poll() moves them,
+// up to a loop() pass after they came in, and no receive hook sees them. The VESC replies are
+// not timed on receipt for that reason: SpeedEstimator takes the ERPM as read when the request
+// went out plus SPEED_ERPM_DELAY_US, see VescLink::values_request_us.
+class PolledSerial : public ChannelSerial {
+  public:
+    PolledSerial(HardwareSerial *port);
+    void begin(unsigned long baudrate);
+    void begin(unsigned long baudrate, uint16_t config);
+    void end();
+
+  protected:
+    void startTransmit();
+
+  private:
+    class PolledChannel : public SerialChannel {
+      public:
+        void service();
+        HardwareSerial *port;
+    };
+
+    PolledChannel rings;
+};
+
+#endif // SERIAL_PORTS_H
@@ -0,0 +1,61 @@
+#include <Arduino.h>
+#include "ServoOutput.h"
+#include "wiring_private.h"
+
+ServoOutput::ServoOutput(uint8_t pin, uint8_t channel) {
+  this->pin = pin;
+  this->channel = channel;
+}
+
+void ServoOutput::begin(uint16_t frame_rate_hz) {
+  this->frame_rate_hz = constrain(frame_rate_hz, SERVO_OUTPUT_MIN_HZ, SERVO_OUTPUT_MAX_HZ);
+  period_ticks = 1000000UL * SERVO_OUTPUT_TICKS_PER_US / this->frame_rate_hz;
+
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC0_TCC1;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  PM->APBCMASK.reg |= PM_APBCMASK_TCC0;
+
+  TCC0->CTRLA.bit.ENABLE = 0;
+  while (TCC0->SYNCBUSY.bit.ENABLE);
+  TCC0->CTRLA.reg = TCC_CTRLA_PRESCALER_DIV16 | TCC_CTRLA_PRESCSYNC_PRESC;
+  TCC0->WAVE.reg = TCC_WAVE_WAVEGEN_NPWM;
+  while (TCC0->SYNCBUSY.bit.WAVE);
+  // TCC0 is 24 bit, 50 Hz needs 60000 ticks
+  TCC0->PER.reg = period_ticks - 1;
+  while (TCC0->SYNCBUSY.bit.PER);
+  TCC0->CC[channel].reg = 0;
+  while (TCC0->SYNCBUSY.reg & TCC_SYNCBUSY_CC(1 << channel));
+  TCC0->CTRLA.bit.ENABLE = 1;
+  while (TCC0->SYNCBUSY.bit.ENABLE);
+
+  ticks = 0;
+  pinPeripheral(pin, PIO_TIMER_ALT);
+}
+
+void ServoOutput::writeMicroseconds(float pulse_us) {
+  float max_us = (float)period_ticks / SERVO_OUTPUT_TICKS_PER_US;
+  pulse_us = constrain(pulse_us, 0.0f, max_us);
+  writeTicks((uint32_t)(pulse_us * SERVO_OUTPUT_TICKS_PER_US + 0.5f));
+}
+
+void ServoOutput::disable() {
+  // a zero duty cycle keeps the line low without reconfiguring the timer
+  writeTicks(0);
+}
+
+bool ServoOutput::isEnabled() {
+  return ticks > 0;
+}
+
+uint16_t ServoOutput::getFrameRate() {
+  return frame_rate_hz;
+}
+
+void ServoOutput::writeTicks(uint32_t ticks) {
+  if (ticks == this->ticks) {
+    return;
+  }
+  this->ticks = ticks;
+  TCC0->CCB[channel].reg = ticks;
+  while (TCC0->SYNCBUSY.reg & TCC_SYNCBUSY_CCB(1 << channel));
+}
@@ -0,0 +1,36 @@
+#ifndef SERVO_OUTPUT_H
+#define SERVO_OUTPUT_H
+
+#include <stdint.h>
+
+#define SERVO_OUTPUT_TICKS_PER_US 3 // 48 MHz GCLK0 / 16
+#define SERVO_OUTPUT_MIN_HZ 50
+#define SERVO_OUTPUT_MAX_HZ 333 // fastest frame rate digital servos accept
+
+// Servo pulse generator on a TCC0 compare channel. Pulses come straight from the timer so there
+// is no interrupt jitter, and the width resolution is 1/3 us. Writes go to the buffered compare
+// register and take effect at the start of the next frame, a pulse is never cut short.
+// Only one ServoOutput can exist since it owns TCC0 and its period.
+class ServoOutput {
+  public:
+    // pin must be a TCC0 output on the alternate (F) peripheral function, channel is its
+    // compare channel (WO[n] maps to CC[n % 4])
+    ServoOutput(uint8_t pin, uint8_t channel);
+    void begin(uint16_t frame_rate_hz);
+    void writeMicroseconds(float pulse_us);
+    // Stops the pulses, the servo goes limp like after Servo::detach()
+    void disable();
+    bool isEnabled();
+    uint16_t getFrameRate();
+
+  private:
+    void writeTicks(uint32_t ticks);
+
+    uint8_t pin;
+    uint8_t channel;
+    uint16_t frame_rate_hz = SERVO_OUTPUT_MIN_HZ;
+    uint32_t period_ticks = 0;
+    uint32_t ticks = 0;
+};
+
+#endif // SERVO_OUTPUT_H
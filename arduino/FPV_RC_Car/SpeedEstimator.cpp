@@ -0,0 +1,102 @@
+#include "SpeedEstimator.h"
+
+#define SPEED_BIAS_INITIAL 0.5f // m/s^2, standard deviation of the bias before anything is known
+
+SpeedEstimator::SpeedEstimator(float accel_noise, float bias_drift, float speed_noise, uint32_t stale_us) {
+  accel_variance = accel_noise * accel_noise;
+  bias_variance = bias_drift * bias_drift;
+  speed_variance = speed_noise * speed_noise;
+  this->stale_us = stale_us;
+  p_bias = SPEED_BIAS_INITIAL * SPEED_BIAS_INITIAL;
+  reset(0);
+}
+
+void SpeedEstimator::reset(float speed) {
+  // the bias outlasts a gap in the predictions, only the speed starts over
+  this->speed = speed;
+  p_speed = speed_variance;
+  p_cross = 0;
+  history_count = 0;
+}
+
+void SpeedEstimator::predict(float accel, uint32_t sample_us) {
+  uint32_t elapsed_us = sample_us - last_predict_us;
+  last_predict_us = sample_us;
+  this->accel = accel - bias;
+  if (predicted && elapsed_us > 0) {
+    float dt = (elapsed_us < stale_us ? elapsed_us : stale_us) * 1e-6f;
+    speed += this->accel * dt;
+    // P = F P F' + Q with F = [1 -dt; 0 1], the speed integrates the acceleration less the bias
+    p_speed += dt * (dt * p_bias - 2 * p_cross + accel_variance);
+    p_cross -= dt * p_bias;
+    p_bias += dt * bias_variance;
+  }
+  predicted = true;
+
+  Prediction &entry = history[history_head];
+  entry.time_us = sample_us;
+  entry.speed = speed;
+  entry.bias = bias;
+  entry.p_speed = p_speed;
+  entry.p_cross = p_cross;
+  entry.p_bias = p_bias;
+  history_head = (history_head + 1) % SPEED_HISTORY;
+  if (history_count < SPEED_HISTORY) {
+    history_count++;
+  }
+}
+
+void SpeedEstimator::correct(float speed, uint32_t sample_us) {
+  if (!predicted || (int32_t)(sample_us - last_predict_us) > (int32_t)stale_us) {
+    reset(speed);
+    return;
+  }
+  // the newest prediction at or before the sample, the current state if there is none
+  float base_speed = this->speed;
+  float p00 = p_speed, p01 = p_cross;
+  int32_t since_base_us = (int32_t)(sample_us - last_predict_us);
+  for (uint8_t i = 1; i <= history_count; i++) {
+    const Prediction &entry = history[(history_head + SPEED_HISTORY - i) % SPEED_HISTORY];
+    int32_t since_entry_us = (int32_t)(sample_us - entry.time_us);
+    if (since_entry_us >= 0) {
+      base_speed = entry.speed;
+      p00 = entry.p_speed;
+      p01 = entry.p_cross;
+      since_base_us = since_entry_us;
+      break;
+    }
+  }
+  float innovation = speed - (base_speed + accel * since_base_us * 1e-6f);
+  float gain_speed = p00 / (p00 + speed_variance);
+  float gain_bias = p01 / (p00 + speed_variance);
+  float delta_speed = gain_speed * innovation;
+  float delta_bias = gain_bias * innovation;
+
+  // carried from the sample to now by F^n = [1 -T; 0 1]
+  int32_t late_us = (int32_t)(last_predict_us - sample_us);
+  float late = late_us > 0 ? late_us * 1e-6f : 0;
+  this->speed += delta_speed - delta_bias * late;
+  bias += delta_bias;
+  accel -= delta_bias;
+  // P -= F^n K H P F^n', K H P = [k0 p00, k0 p01; k1 p00, k1 p01] and k0 p01 = k1 p00
+  float d00 = gain_speed * p00;
+  float d01 = gain_speed * p01;
+  float d11 = gain_bias * p01;
+  p_speed -= d00 - late * (2 * d01 - late * d11);
+  p_cross -= d01 - late * d11;
+  p_bias -= d11;
+  // the next measurement is sampled after this one arrived, nothing before now is needed again
+  history_count = 0;
+}
+
+float SpeedEstimator::getSpeed() {
+  return speed;
+}
+
+float SpeedEstimator::getAcceleration() {
+  return accel;
+}
+
+float SpeedEstimator::getBias() {
+  return bias;
+}
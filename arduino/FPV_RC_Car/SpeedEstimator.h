@@ -0,0 +1,59 @@
+#ifndef SPEED_ESTIMATOR_H
+#define SPEED_ESTIMATOR_H
+
+#include <stdint.h>
+
+#define SPEED_HISTORY 16 // predictions kept for late measurements, ~38 ms at 416 Hz
+
+// Kalman filter of the car's speed and the accelerometer's bias along the car. Every IMU
+// sample predicts: the speed integrates the measured acceleration less the bias, the bias
+// wanders as a random walk and soaks up gravity on a slope as well as the sensor offset. Every
+// wheel speed from the VESC corrects, at the time the VESC sampled it. That is older than the
+// newest prediction, so the prediction stored for that time is corrected and the correction
+// carried forward to now. Measurements have to arrive in the order they were sampled, each
+// after the previous one was applied; VescLink never has more than one request out. Without
+// predictions for stale_us the estimate is set to the measurement, without an IMU it is the
+// wheel speed as before. The 2x2 covariance is kept as its three distinct entries and all the
+// math is written out.
+class SpeedEstimator {
+  public:
+    // accel_noise in m/s^2 per sqrt(Hz), bias_drift in m/s^2 per sqrt(s), speed_noise in m/s
+    SpeedEstimator(float accel_noise, float bias_drift, float speed_noise, uint32_t stale_us);
+    void reset(float speed);
+    // Acceleration in m/s^2 along the car, forward positive, at the time it was sampled
+    void predict(float accel, uint32_t sample_us);
+    // Signed speed in m/s and the time it was sampled at
+    void correct(float speed, uint32_t sample_us);
+    float getSpeed(); // m/s, negative in reverse
+    float getAcceleration(); // m/s^2, the last sample less the bias
+    float getBias(); // m/s^2
+
+  private:
+    struct Prediction {
+      uint32_t time_us;
+      float speed;
+      float bias;
+      float p_speed; // covariance entries
+      float p_cross;
+      float p_bias;
+    };
+
+    float accel_variance; // per second
+    float bias_variance; // per second
+    float speed_variance;
+    uint32_t stale_us;
+
+    float speed = 0;
+    float bias = 0;
+    float accel = 0;
+    float p_speed;
+    float p_cross = 0;
+    float p_bias;
+    bool predicted = false;
+    uint32_t last_predict_us = 0;
+    Prediction history[SPEED_HISTORY];
+    uint8_t history_head = 0; // next slot written
+    uint8_t history_count = 0;
+};
+
+#endif // SPEED_ESTIMATOR_H
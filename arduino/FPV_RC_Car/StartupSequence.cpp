@@ -0,0 +1,95 @@
+#include "StartupSequence.h"
+
+StartupSequence::StartupSequence(const StartupDevice *devices, uint8_t count, uint32_t required_mask)
+  : devices(devices), count(count < STARTUP_DEVICES_MAX ? count : STARTUP_DEVICES_MAX), required_mask(required_mask) {
+  begin(0);
+}
+
+void StartupSequence::begin(uint32_t now_ms) {
+  start_ms = now_ms;
+  armed = false;
+  armed_ms = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    states[i] = StartupState::STARTING;
+    attempts[i] = 0;
+    attempt_ms[i] = now_ms;
+    done_ms[i] = 0;
+  }
+}
+
+bool StartupSequence::attempt(uint8_t device, uint32_t now_ms) {
+  if (device >= count || states[device] != StartupState::STARTING) {
+    return false;
+  }
+  const StartupDevice &config = devices[device];
+  if (attempts[device] > 0 && (config.timeout_ms == 0 || now_ms - attempt_ms[device] < config.timeout_ms)) {
+    return false;
+  }
+  if (config.attempts > 0 && attempts[device] >= config.attempts) {
+    states[device] = StartupState::FAILED;
+    done_ms[device] = now_ms - start_ms;
+    return false;
+  }
+  attempts[device]++;
+  attempt_ms[device] = now_ms;
+  return true;
+}
+
+void StartupSequence::ready(uint8_t device, uint32_t now_ms) {
+  if (device >= count || states[device] == StartupState::READY) {
+    return;
+  }
+  states[device] = StartupState::READY;
+  done_ms[device] = now_ms - start_ms;
+  if (armed) {
+    return;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if ((required_mask & (1UL << i)) && states[i] != StartupState::READY) {
+      return;
+    }
+  }
+  armed = true;
+  armed_ms = now_ms - start_ms;
+}
+
+bool StartupSequence::isReady(uint8_t device) {
+  return device < count && states[device] == StartupState::READY;
+}
+
+StartupState StartupSequence::getState(uint8_t device) {
+  return device < count ? states[device] : StartupState::FAILED;
+}
+
+uint8_t StartupSequence::getAttempts(uint8_t device) {
+  return device < count ? attempts[device] : 0;
+}
+
+uint32_t StartupSequence::getDoneMs(uint8_t device) {
+  return device < count ? done_ms[device] : 0;
+}
+
+bool StartupSequence::isArmed() {
+  return armed;
+}
+
+uint32_t StartupSequence::getArmedMs() {
+  return armed_ms;
+}
+
+bool StartupSequence::isSettled() {
+  for (uint8_t i = 0; i < count; i++) {
+    if (states[i] == StartupState::STARTING) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint8_t StartupSequence::getCount() {
+  return count;
+}
+
+const char *StartupSequence::getName(uint8_t device) {
+  return device < count ? devices[device].name : "";
+}
@@ -0,0 +1,55 @@
+#ifndef STARTUP_SEQUENCE_H
+#define STARTUP_SEQUENCE_H
+
+#include <stdint.h>
+
+#define STARTUP_DEVICES_MAX 8
+
+// How long a device gets to come up and how often it is tried
+struct StartupDevice {
+  const char *name;
+  uint16_t timeout_ms; // per attempt, 0 waits as long as it takes
+  uint8_t attempts; // before the device is given up on, 0 for no limit
+};
+
+enum class StartupState : uint8_t { STARTING, READY, FAILED };
+
+// Brings the devices up side by side from loop() instead of one after the other in setup().
+// Every pass asks attempt() whether to start a device's init (again), its own code then polls
+// it and reports ready(). Devices that need no init, like a link waiting for its first frame,
+// only report ready(). An attempt that outlasts its timeout is started over until the attempts
+// run out and the device fails, whatever needs it stays off. The car is armed once the
+// required devices are ready. Times are kept in ms since begin().
+class StartupSequence {
+  public:
+    StartupSequence(const StartupDevice *devices, uint8_t count, uint32_t required_mask);
+    void begin(uint32_t now_ms);
+    // True when the device's init should be started now
+    bool attempt(uint8_t device, uint32_t now_ms);
+    void ready(uint8_t device, uint32_t now_ms);
+    bool isReady(uint8_t device);
+    StartupState getState(uint8_t device);
+    uint8_t getAttempts(uint8_t device);
+    // When the device came up or was given up on
+    uint32_t getDoneMs(uint8_t device);
+    bool isArmed();
+    uint32_t getArmedMs();
+    // Every device is ready or failed
+    bool isSettled();
+    uint8_t getCount();
+    const char *getName(uint8_t device);
+
+  private:
+    const StartupDevice *devices;
+    uint8_t count;
+    uint32_t required_mask;
+    uint32_t start_ms = 0;
+    bool armed = false;
+    uint32_t armed_ms = 0;
+    StartupState states[STARTUP_DEVICES_MAX];
+    uint8_t attempts[STARTUP_DEVICES_MAX];
+    uint32_t attempt_ms[STARTUP_DEVICES_MAX];
+    uint32_t done_ms[STARTUP_DEVICES_MAX];
+};
+
+#endif // STARTUP_SEQUENCE_H
@@ -0,0 +1,31 @@
+#include "SteeringFeedForward.h"
+#include <math.h>
+
+#define DEG_TO_RAD_F 0.017453293f
+
+SteeringFeedForward::SteeringFeedForward(float wheelbase, float max_steering_angle_deg) {
+  this->wheelbase = wheelbase;
+  float max_angle = max_steering_angle_deg * DEG_TO_RAD_F;
+  lut_scale = (FEED_FORWARD_LUT_SIZE - 1) / tanf(max_angle);
+  for (int i = 0; i < FEED_FORWARD_LUT_SIZE; i++) {
+    lut[i] = atanf(i / lut_scale) / max_angle;
+  }
+}
+
+float SteeringFeedForward::command(float yaw_rate_deg_s, float speed_m_s) {
+  float speed = fabsf(speed_m_s) < FEED_FORWARD_MIN_SPEED ? FEED_FORWARD_MIN_SPEED : fabsf(speed_m_s);
+  // reversing turns the other way for the same wheel angle
+  if (speed_m_s < 0) {
+    yaw_rate_deg_s = -yaw_rate_deg_s;
+  }
+  float curvature = yaw_rate_deg_s * DEG_TO_RAD_F * wheelbase / speed;
+  float index = fabsf(curvature) * lut_scale;
+  float result;
+  if (index >= FEED_FORWARD_LUT_SIZE - 1) {
+    result = 1.0f;
+  } else {
+    int i = (int)index;
+    result = lut[i] + (lut[i + 1] - lut[i]) * (index - i);
+  }
+  return curvature < 0 ? -result : result;
+}
@@ -0,0 +1,24 @@
+#ifndef STEERING_FEED_FORWARD_H
+#define STEERING_FEED_FORWARD_H
+
+#include <stdint.h>
+
+#define FEED_FORWARD_LUT_SIZE 33
+#define FEED_FORWARD_MIN_SPEED 0.5f // m/s, below this the model asks for more lock than the car has
+
+// Inverse kinematic bicycle model: the steering command that gives a yaw rate at a speed in
+// steady state, yaw_rate = speed / wheelbase * tan(wheel_angle). The atan is replaced by a
+// table over tan(wheel_angle), so a call is one divide and a linear interpolation.
+class SteeringFeedForward {
+  public:
+    SteeringFeedForward(float wheelbase, float max_steering_angle_deg);
+    // yaw rate in deg/s, signed speed in m/s, returns a steering command in -1..1
+    float command(float yaw_rate_deg_s, float speed_m_s);
+
+  private:
+    float wheelbase;
+    float lut_scale; // LUT index per unit of tan(wheel_angle)
+    float lut[FEED_FORWARD_LUT_SIZE]; // command for tan(wheel_angle) = i / lut_scale
+};
+
+#endif // STEERING_FEED_FORWARD_H
@@ -0,0 +1,93 @@
+#include "TrajectoryCodec.h"
+
+#define HEADING_TURN 36000 // centidegrees
+
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t putVarint(uint32_t value, uint8_t *out) {
+  uint8_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+// Shortest way round, so a heading crossing +-180 stays a small change
+static int32_t wrapHeading(int32_t heading) {
+  if (heading > HEADING_TURN / 2) {
+    heading -= HEADING_TURN;
+  } else if (heading < -HEADING_TURN / 2) {
+    heading += HEADING_TURN;
+  }
+  return heading;
+}
+
+void TrajectoryEncoder::reset() {
+  previous = TrajectorySample();
+  step_x = 0;
+  step_y = 0;
+  step_heading = 0;
+}
+
+uint8_t TrajectoryEncoder::encode(const TrajectorySample &sample, uint8_t *out) {
+  int32_t x = sample.x - previous.x;
+  int32_t y = sample.y - previous.y;
+  uint8_t length = putVarint(zigzag(x - step_x), out);
+  length += putVarint(zigzag(y - step_y), out + length);
+  int32_t heading = wrapHeading(sample.heading - previous.heading);
+  length += putVarint(zigzag(heading - step_heading), out + length);
+  length += putVarint(zigzag(sample.speed - previous.speed), out + length);
+  length += putVarint(zigzag(sample.steering - previous.steering), out + length);
+  step_x = x;
+  step_y = y;
+  step_heading = heading;
+  previous = sample;
+  return length;
+}
+
+void TrajectoryDecoder::reset() {
+  sample = TrajectorySample();
+  field = 0;
+  shift = 0;
+  value = 0;
+  step_x = 0;
+  step_y = 0;
+  step_heading = 0;
+}
+
+bool TrajectoryDecoder::feed(uint8_t byte) {
+  value |= (uint32_t)(byte & 0x7F) << shift;
+  if (byte & 0x80) {
+    shift += 7;
+    if (shift > 28) {
+      // longer than any value the encoder writes, resynchronize at the next field
+      shift = 0;
+      value = 0;
+    }
+    return false;
+  }
+  delta[field++] = unzigzag(value);
+  shift = 0;
+  value = 0;
+  if (field < 5) {
+    return false;
+  }
+  field = 0;
+  step_x += delta[0];
+  step_y += delta[1];
+  sample.x += step_x;
+  sample.y += step_y;
+  step_heading += delta[2];
+  sample.heading = (int16_t)wrapHeading(sample.heading + step_heading);
+  sample.speed += delta[3];
+  sample.steering += delta[4];
+  return true;
+}
@@ -0,0 +1,54 @@
+#ifndef TRAJECTORY_CODEC_H
+#define TRAJECTORY_CODEC_H
+
+#include <stdint.h>
+
+#define TRAJECTORY_SAMPLE_MAX_BYTES 25 // five varints of up to 5 bytes
+#define TRAJECTORY_SAMPLE_RAW_BYTES 14 // the sample packed, what the encoding is compared against
+
+// One sample of a taught lap, integers so the encoding is lossless
+struct TrajectorySample {
+  int32_t x; // mm, Odometry frame
+  int32_t y; // mm
+  int16_t heading; // centidegrees counterclockwise, -18000..18000
+  int16_t speed; // cm/s
+  int16_t steering; // steering command * 1000
+};
+
+// Samples as zigzag varints of their change from the previous sample. Position and heading are
+// sampled at a fixed rate while the car moves and turns smoothly, so they are coded as the
+// change of the step (a second difference), which mostly stays within a byte at any speed the
+// car reaches. The first sample after reset() is coded against zero.
+class TrajectoryEncoder {
+  public:
+    void reset();
+    // Returns the encoded length, at most TRAJECTORY_SAMPLE_MAX_BYTES
+    uint8_t encode(const TrajectorySample &sample, uint8_t *out);
+
+  private:
+    TrajectorySample previous = {};
+    int32_t step_x = 0;
+    int32_t step_y = 0;
+    int32_t step_heading = 0;
+};
+
+// Byte at a time decoder for the encoder's stream
+class TrajectoryDecoder {
+  public:
+    void reset();
+    // Returns true when the byte completed a sample, which is then in sample
+    bool feed(uint8_t byte);
+
+    TrajectorySample sample = {};
+
+  private:
+    uint8_t field = 0;
+    uint8_t shift = 0;
+    uint32_t value = 0;
+    int32_t delta[5];
+    int32_t step_x = 0;
+    int32_t step_y = 0;
+    int32_t step_heading = 0;
+};
+
+#endif // TRAJECTORY_CODEC_H
@@ -0,0 +1,117 @@
+#include "TrajectoryFollower.h"
+#include "PurePursuit.h"
+#include <math.h>
+
+#define RAD_TO_DEG_F 57.29578f
+
+TrajectoryFollower::TrajectoryFollower(float lookahead) {
+  this->lookahead = lookahead;
+}
+
+void TrajectoryFollower::setLookahead(float lookahead) {
+  this->lookahead = lookahead;
+}
+
+void TrajectoryFollower::reset() {
+  first = 0;
+  count = 0;
+  finished = false;
+  ended = false;
+  stop();
+  cross_track = 0;
+}
+
+TrajectoryFollower::Point &TrajectoryFollower::at(uint8_t index) {
+  return window[(first + index) % TRAJECTORY_WINDOW];
+}
+
+void TrajectoryFollower::stop() {
+  yaw_rate = 0;
+  speed_target = 0;
+}
+
+bool TrajectoryFollower::wantsSample() {
+  return !finished && count < TRAJECTORY_WINDOW;
+}
+
+void TrajectoryFollower::push(const TrajectorySample &sample) {
+  if (!wantsSample()) {
+    return;
+  }
+  Point &point = at(count++);
+  point.x = sample.x * 0.001f;
+  point.y = sample.y * 0.001f;
+  point.speed = sample.speed * 0.01f;
+}
+
+void TrajectoryFollower::finish() {
+  finished = true;
+}
+
+bool TrajectoryFollower::update(float x, float y, float heading_deg, float speed) {
+  if (ended) {
+    return false;
+  }
+
+  // drop the samples the car is past, a zero length step (the car stood still) goes straight away
+  float along = 0;
+  while (count >= 2) {
+    float dx = at(1).x - at(0).x;
+    float dy = at(1).y - at(0).y;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length > 0) {
+      along = ((x - at(0).x) * dx + (y - at(0).y) * dy) / length;
+      if (along < length) {
+        cross_track = (dx * (y - at(0).y) - dy * (x - at(0).x)) / length;
+        break;
+      }
+    }
+    first = (first + 1) % TRAJECTORY_WINDOW;
+    count--;
+  }
+  if (count < 2) {
+    stop();
+    // without finish() the caller hasn't kept up, hold still until more samples come
+    ended = finished;
+    return !ended;
+  }
+
+  // the goal point, one lookahead further along the taught path than the projection
+  float remaining = lookahead + (along > 0 ? along : 0);
+  float goal_x, goal_y, goal_speed;
+  for (uint8_t i = 0;; i++) {
+    Point &a = at(i);
+    Point &b = at(i + 1);
+    float length = sqrtf((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+    if (remaining <= length) {
+      float t = remaining / length;
+      goal_x = a.x + (b.x - a.x) * t;
+      goal_y = a.y + (b.y - a.y) * t;
+      goal_speed = a.speed + (b.speed - a.speed) * t;
+      break;
+    }
+    remaining -= length;
+    if (i + 2 >= count) {
+      goal_x = b.x;
+      goal_y = b.y;
+      goal_speed = b.speed;
+      break;
+    }
+  }
+
+  speed_target = goal_speed > 0 ? goal_speed : 0;
+  yaw_rate = fabsf(speed) * PurePursuit::arcCurvature(x, y, heading_deg, goal_x, goal_y) * RAD_TO_DEG_F;
+  return true;
+}
+
+float TrajectoryFollower::getYawRate() {
+  return yaw_rate;
+}
+
+float TrajectoryFollower::getSpeed() {
+  return speed_target;
+}
+
+float TrajectoryFollower::getCrossTrack() {
+  return cross_track;
+}
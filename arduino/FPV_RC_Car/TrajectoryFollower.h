@@ -0,0 +1,57 @@
+#ifndef TRAJECTORY_FOLLOWER_H
+#define TRAJECTORY_FOLLOWER_H
+
+#include <stdint.h>
+#include "TrajectoryCodec.h"
+
+#define TRAJECTORY_WINDOW 32 // samples held ahead of the car, 1.6 s at 20 Hz
+
+// Pure pursuit along a taught lap streamed in from TrajectoryLog. Only a window of the samples
+// ahead of the car is held: samples the car has passed are dropped from the front and the
+// caller tops the window up from the log, so the lap is read once, front to back. The goal
+// point is one lookahead along the taught path and the speed target is the taught speed there,
+// so the lap is repeated on the path it was taught on, at its speed, even when the car falls
+// behind the clock. Forward laps only, reversing is taught as a stop.
+class TrajectoryFollower {
+  public:
+    // lookahead in meters
+    TrajectoryFollower(float lookahead);
+    void setLookahead(float lookahead);
+    void reset();
+    // True while there is room for the next sample
+    bool wantsSample();
+    void push(const TrajectorySample &sample);
+    // No more samples are coming, the lap ends at the last one pushed
+    void finish();
+    // Pose in the Odometry frame and signed speed in m/s. Returns false once the car has passed
+    // the end of the lap, the targets are zero from then on.
+    bool update(float x, float y, float heading_deg, float speed);
+    // deg/s counterclockwise
+    float getYawRate();
+    // m/s
+    float getSpeed();
+    // meters from the taught path, positive left of it
+    float getCrossTrack();
+
+  private:
+    struct Point {
+      float x;
+      float y;
+      float speed;
+    };
+
+    Point &at(uint8_t index);
+    void stop();
+
+    float lookahead;
+    Point window[TRAJECTORY_WINDOW];
+    uint8_t first = 0;
+    uint8_t count = 0;
+    bool finished = false;
+    bool ended = false;
+    float yaw_rate = 0;
+    float speed_target = 0;
+    float cross_track = 0;
+};
+
+#endif // TRAJECTORY_FOLLOWER_H
@@ -0,0 +1,172 @@
+#include "TrajectoryLog.h"
+#include <string.h>
+
+uint32_t TrajectoryLog::crc32Update(uint32_t crc, uint8_t byte) {
+  crc ^= byte;
+  for (int i = 0; i < 8; i++) {
+    crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return crc;
+}
+
+void TrajectoryLog::beginRecording(uint16_t interval_ms) {
+  playback = false;
+  header = Header();
+  header.magic = TRAJECTORY_LOG_MAGIC;
+  header.version = TRAJECTORY_LOG_VERSION;
+  header.interval_ms = interval_ms;
+  erase_row = 0;
+  state = ERASING;
+}
+
+void TrajectoryLog::finishRecording() {
+  if (state == ERASING) {
+    // the header page is erased or still holds the previous lap, either way nothing to write
+    state = IDLE;
+  } else if (state == RECORDING) {
+    if (queue_fill_offset > 0) {
+      memset(queue[queue_fill] + queue_fill_offset, 0xFF, NVM_PAGE_SIZE - queue_fill_offset);
+      queuePage();
+    }
+    state = FLUSHING;
+  }
+}
+
+void TrajectoryLog::queuePage() {
+  queue_pending++;
+  if (queue_pending > queue_high_water) {
+    queue_high_water = queue_pending;
+  }
+  queue_fill = (queue_fill + 1) % TRAJECTORY_LOG_QUEUE;
+  queue_fill_offset = 0;
+}
+
+bool TrajectoryLog::record(const TrajectorySample &sample) {
+  if (state != RECORDING) {
+    return false;
+  }
+  uint8_t encoded[TRAJECTORY_SAMPLE_MAX_BYTES];
+  uint8_t length = encoder.encode(sample, encoded);
+  if (header.bytes + length > TRAJECTORY_LOG_CAPACITY) {
+    finishRecording();
+    return false;
+  }
+  // completing the last free page would leave no page to fill next
+  uint16_t space = (TRAJECTORY_LOG_QUEUE - 1 - queue_pending) * NVM_PAGE_SIZE + NVM_PAGE_SIZE - queue_fill_offset;
+  if (length >= space) {
+    queue_overruns++;
+    finishRecording();
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    crc = crc32Update(crc, encoded[i]);
+    queue[queue_fill][queue_fill_offset++] = encoded[i];
+    if (queue_fill_offset == NVM_PAGE_SIZE) {
+      queuePage();
+    }
+  }
+  header.samples++;
+  header.bytes += length;
+  return true;
+}
+
+void TrajectoryLog::service() {
+  if (state == ERASING) {
+    nvmEraseRow(NVM_TRAJECTORY_ADDRESS + (uint32_t)erase_row * NVM_ROW_SIZE);
+    if (++erase_row == NVM_TRAJECTORY_ROWS) {
+      encoder.reset();
+      crc = 0xFFFFFFFF;
+      write_address = NVM_TRAJECTORY_ADDRESS + NVM_PAGE_SIZE;
+      queue_fill = 0;
+      queue_fill_offset = 0;
+      queue_write = 0;
+      queue_pending = 0;
+      state = RECORDING;
+    }
+  } else if (state == RECORDING || state == FLUSHING) {
+    if (queue_pending > 0) {
+      nvmWritePage(write_address, queue[queue_write]);
+      write_address += NVM_PAGE_SIZE;
+      queue_write = (queue_write + 1) % TRAJECTORY_LOG_QUEUE;
+      queue_pending--;
+    } else if (state == FLUSHING) {
+      header.crc = ~crc;
+      memset(page, 0xFF, sizeof(page));
+      memcpy(page, &header, sizeof(header));
+      nvmWritePage(NVM_TRAJECTORY_ADDRESS, page);
+      state = IDLE;
+    }
+  }
+}
+
+bool TrajectoryLog::isErasing() {
+  return state == ERASING;
+}
+
+bool TrajectoryLog::isRecording() {
+  return state == RECORDING;
+}
+
+bool TrajectoryLog::isBusy() {
+  return state != IDLE;
+}
+
+bool TrajectoryLog::openPlayback() {
+  playback = false;
+  if (isBusy()) {
+    return false;
+  }
+  nvmRead(NVM_TRAJECTORY_ADDRESS, &header, sizeof(header));
+  if (header.magic != TRAJECTORY_LOG_MAGIC || header.version != TRAJECTORY_LOG_VERSION || header.bytes > TRAJECTORY_LOG_CAPACITY) {
+    header = Header();
+    return false;
+  }
+  uint32_t check = 0xFFFFFFFF;
+  for (uint32_t offset = 0; offset < header.bytes; offset += NVM_PAGE_SIZE) {
+    nvmRead(NVM_TRAJECTORY_ADDRESS + NVM_PAGE_SIZE + offset, page, NVM_PAGE_SIZE);
+    uint32_t length = header.bytes - offset < NVM_PAGE_SIZE ? header.bytes - offset : NVM_PAGE_SIZE;
+    for (uint32_t i = 0; i < length; i++) {
+      check = crc32Update(check, page[i]);
+    }
+  }
+  if (~check != header.crc) {
+    header = Header();
+    return false;
+  }
+  decoder.reset();
+  read_offset = 0;
+  samples_read = 0;
+  playback = true;
+  return true;
+}
+
+bool TrajectoryLog::read(TrajectorySample *sample) {
+  if (!playback) {
+    return false;
+  }
+  while (samples_read < header.samples && read_offset < header.bytes) {
+    if (read_offset % NVM_PAGE_SIZE == 0) {
+      nvmRead(NVM_TRAJECTORY_ADDRESS + NVM_PAGE_SIZE + read_offset, page, NVM_PAGE_SIZE);
+    }
+    uint8_t byte = page[read_offset % NVM_PAGE_SIZE];
+    read_offset++;
+    if (decoder.feed(byte)) {
+      samples_read++;
+      *sample = decoder.sample;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t TrajectoryLog::getSampleCount() {
+  return header.samples;
+}
+
+uint32_t TrajectoryLog::getByteCount() {
+  return header.bytes;
+}
+
+uint16_t TrajectoryLog::getInterval() {
+  return header.interval_ms;
+}
@@ -0,0 +1,89 @@
+#ifndef TRAJECTORY_LOG_H
+#define TRAJECTORY_LOG_H
+
+#include <stdint.h>
+#include "NvmFlash.h"
+#include "TrajectoryCodec.h"
+
+#define TRAJECTORY_LOG_MAGIC 0x4C54 // "TL"
+#define TRAJECTORY_LOG_VERSION 1
+#define TRAJECTORY_LOG_QUEUE 4 // pages encoded ahead of the flash writes
+#define TRAJECTORY_LOG_CAPACITY (NVM_TRAJECTORY_ROWS * NVM_ROW_SIZE - NVM_PAGE_SIZE) // bytes after the header page
+
+// One taught lap in internal flash, the header page first, then the encoded sample stream.
+// The SAMD21G18 can't read flash while it erases or writes it, the CPU stalls on the next
+// instruction fetch, so the flash work is kept off the moving car: beginRecording() erases the
+// whole region row by row from service() before it accepts samples, the firmware holds the car
+// still meanwhile. While recording, record() only encodes into a RAM page queue and service()
+// writes at most one page per call. The header with the sample count and CRC is written last,
+// a recording cut short by a reset leaves no valid lap.
+// Playback reads the stream front to back, one page at a time.
+class TrajectoryLog {
+  public:
+    // Starts erasing, samples are accepted once isRecording()
+    void beginRecording(uint16_t interval_ms);
+    // Queues the last partial page and the header, service() writes them
+    void finishRecording();
+    // Returns false if the sample wasn't taken: not recording, the log is full or the page
+    // queue is. The recording is finished in the last two cases, a gap would break the deltas.
+    bool record(const TrajectorySample &sample);
+    // One row erase or one page write per call, call from loop()
+    void service();
+    bool isErasing();
+    bool isRecording();
+    // Erasing, recording or writing out the end of a recording
+    bool isBusy();
+
+    // Checks the header and the CRC of the stream, false if there is no complete lap
+    bool openPlayback();
+    // Next sample of the lap, false at the end
+    bool read(TrajectorySample *sample);
+
+    uint32_t getSampleCount();
+    uint32_t getByteCount();
+    uint16_t getInterval();
+
+    uint32_t queue_overruns = 0; // recordings ended because service() fell behind
+    uint8_t queue_high_water = 0; // pages
+
+  private:
+    enum State : uint8_t {
+      IDLE,
+      ERASING,
+      RECORDING,
+      FLUSHING
+    };
+
+    struct __attribute__((packed)) Header {
+      uint16_t magic;
+      uint8_t version;
+      uint8_t reserved;
+      uint16_t interval_ms;
+      uint32_t samples;
+      uint32_t bytes;
+      uint32_t crc; // of the stream
+    };
+
+    static uint32_t crc32Update(uint32_t crc, uint8_t byte);
+    void queuePage();
+
+    State state = IDLE;
+    Header header = {};
+    uint32_t crc = 0;
+    uint16_t erase_row = 0;
+    uint32_t write_address = 0;
+    TrajectoryEncoder encoder;
+    uint8_t queue[TRAJECTORY_LOG_QUEUE][NVM_PAGE_SIZE];
+    uint8_t queue_fill = 0; // page being filled
+    uint8_t queue_fill_offset = 0;
+    uint8_t queue_write = 0; // oldest full page
+    uint8_t queue_pending = 0; // full pages waiting for service()
+
+    TrajectoryDecoder decoder;
+    uint8_t page[NVM_PAGE_SIZE];
+    uint32_t read_offset = 0;
+    uint32_t samples_read = 0;
+    bool playback = false;
+};
+
+#endif // TRAJECTORY_LOG_H
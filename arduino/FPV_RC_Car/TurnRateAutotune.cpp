@@ -0,0 +1,151 @@
+#include "TurnRateAutotune.h"
+#include <math.h>
+
+TurnRateAutotune::TurnRateAutotune(float relay, float hysteresis, uint8_t cycles, float settle_s, float timeout_s)
+  : relay(relay), hysteresis(hysteresis), cycles(cycles < 2 ? 2 : (cycles > AUTOTUNE_CYCLES_MAX ? AUTOTUNE_CYCLES_MAX : cycles)),
+    settle_s(settle_s), timeout_s(timeout_s) {}
+
+void TurnRateAutotune::begin(const float *bucket_speeds, uint8_t count, float min_speed_kmh, float max_speed_kmh) {
+  this->count = count < AUTOTUNE_BUCKETS_MAX ? count : AUTOTUNE_BUCKETS_MAX;
+  for (uint8_t i = 0; i < this->count; i++) {
+    AutotuneResult result = {};
+    // inner buckets in their middle, the last one at the top speed the car drives
+    float speed = i + 1 < this->count ? (bucket_speeds[i] + bucket_speeds[i + 1]) / 2 : max_speed_kmh;
+    speed = speed < min_speed_kmh ? min_speed_kmh : speed;
+    if (speed <= max_speed_kmh && speed >= bucket_speeds[i]) {
+      result.speed_kmh = speed;
+    }
+    results[i] = result;
+  }
+  bucket = 0;
+  state = AutotuneState::DONE;
+  if (this->count > 0 && results[0].speed_kmh > 0) {
+    startBucket(0);
+  } else {
+    nextBucket();
+  }
+}
+
+void TurnRateAutotune::startBucket(uint8_t bucket) {
+  this->bucket = bucket;
+  state = AutotuneState::SPEED;
+  in_band_s = 0;
+  relay_s = 0;
+  output = relay;
+  switches = 0;
+  measured = 0;
+}
+
+void TurnRateAutotune::nextBucket() {
+  for (uint8_t i = bucket + 1; i < count; i++) {
+    if (results[i].speed_kmh > 0) {
+      startBucket(i);
+      return;
+    }
+  }
+  state = AutotuneState::DONE;
+}
+
+float TurnRateAutotune::update(float yaw_rate, float setpoint, float speed_kmh, float dt) {
+  if (state == AutotuneState::DONE) {
+    return 0;
+  }
+  AutotuneResult &result = results[bucket];
+  float band = result.speed_kmh * AUTOTUNE_SPEED_BAND;
+  if (fabsf(speed_kmh - result.speed_kmh) > (band > AUTOTUNE_SPEED_BAND_MIN ? band : AUTOTUNE_SPEED_BAND_MIN)) {
+    // the loop gain changes with speed, cycles from another speed don't count
+    startBucket(bucket);
+    return 0;
+  }
+  if (state == AutotuneState::SPEED) {
+    in_band_s += dt;
+    if (in_band_s < settle_s) {
+      return 0;
+    }
+    state = AutotuneState::RELAY;
+  }
+
+  relay_s += dt;
+  step_s = dt;
+  if (relay_s > timeout_s) {
+    nextBucket();
+    return 0;
+  }
+  cycle_max = yaw_rate > cycle_max ? yaw_rate : cycle_max;
+  cycle_min = yaw_rate < cycle_min ? yaw_rate : cycle_min;
+  float error = setpoint - yaw_rate;
+  if (output < 0 && error > hysteresis) {
+    // a cycle runs from one switch to +relay to the next
+    output = relay;
+    if (switches > AUTOTUNE_SKIP_CYCLES) {
+      cycleDone((cycle_max - cycle_min) / 2, relay_s - cycle_start_s);
+    }
+    switches++;
+    cycle_start_s = relay_s;
+    cycle_max = cycle_min = yaw_rate;
+  } else if (output > 0 && error < -hysteresis) {
+    output = -relay;
+  }
+  return state == AutotuneState::RELAY ? output : 0;
+}
+
+void TurnRateAutotune::cycleDone(float amplitude, float period) {
+  amplitudes[measured % cycles] = amplitude;
+  periods[measured % cycles] = period;
+  measured++;
+  if (measured < cycles) {
+    return;
+  }
+  float a_min = amplitudes[0], a_max = amplitudes[0], a_sum = 0;
+  float t_min = periods[0], t_max = periods[0], t_sum = 0;
+  for (uint8_t i = 0; i < cycles; i++) {
+    a_min = amplitudes[i] < a_min ? amplitudes[i] : a_min;
+    a_max = amplitudes[i] > a_max ? amplitudes[i] : a_max;
+    t_min = periods[i] < t_min ? periods[i] : t_min;
+    t_max = periods[i] > t_max ? periods[i] : t_max;
+    a_sum += amplitudes[i];
+    t_sum += periods[i];
+  }
+  float a = a_sum / cycles;
+  float tu = t_sum / cycles;
+  // switches fall on update() calls, so the period is only known to a step
+  if (a_max - a_min > AUTOTUNE_TOLERANCE * a || t_max - t_min > AUTOTUNE_TOLERANCE * tu + step_s || a <= hysteresis) {
+    return;
+  }
+
+  AutotuneResult &result = results[bucket];
+  result.ultimate_gain = 4.0f * relay / (3.14159265f * sqrtf(a * a - hysteresis * hysteresis));
+  result.ultimate_period = tu;
+  // Tyreus-Luyben: Kp = 0.45 Ku, Ti = 2.2 Tu, Td = Tu / 6.3. The feed-forward already carries
+  // most of a turn, Ziegler-Nichols overshoots on top of it
+  result.kp = 0.45f * result.ultimate_gain;
+  result.ki = result.kp / (2.2f * tu);
+  result.kd = result.kp * tu / 6.3f * 1000000.0f;
+  result.seconds = relay_s;
+  result.converged = true;
+  nextBucket();
+}
+
+float TurnRateAutotune::getSpeed() {
+  return state == AutotuneState::DONE ? 0 : results[bucket].speed_kmh;
+}
+
+AutotuneState TurnRateAutotune::getState() {
+  return state;
+}
+
+uint8_t TurnRateAutotune::getBucket() {
+  return bucket;
+}
+
+uint8_t TurnRateAutotune::getCount() {
+  return count;
+}
+
+uint8_t TurnRateAutotune::getCycles() {
+  return measured;
+}
+
+const AutotuneResult &TurnRateAutotune::getResult(uint8_t bucket) {
+  return results[bucket];
+}
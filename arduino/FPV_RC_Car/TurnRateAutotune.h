@@ -0,0 +1,78 @@
+#ifndef TURN_RATE_AUTOTUNE_H
+#define TURN_RATE_AUTOTUNE_H
+
+#include <stdint.h>
+
+#define AUTOTUNE_BUCKETS_MAX 4
+#define AUTOTUNE_CYCLES_MAX 8
+#define AUTOTUNE_SKIP_CYCLES 2 // the oscillation takes a couple of cycles to find its shape
+#define AUTOTUNE_TOLERANCE 0.1f // spread of amplitude and period over the measured cycles, relative
+#define AUTOTUNE_SPEED_BAND 0.15f // share of the tuning speed the car has to stay within
+#define AUTOTUNE_SPEED_BAND_MIN 1.0f // km/h
+
+enum class AutotuneState : uint8_t { SPEED, RELAY, DONE };
+
+struct AutotuneResult {
+  float speed_kmh; // tuning speed, 0 for a bucket above the speed limit
+  float ultimate_gain; // steering per deg/s
+  float ultimate_period; // s
+  float kp; // steering per deg/s
+  float ki; // per deg/s integrated over seconds
+  float kd; // AutoPID units, its derivative is per ms and divided by another 1000
+  float seconds; // relay time until converged
+  bool converged;
+};
+
+// Relay feedback tuning of the yaw rate loop at each speed of the gain schedule. For every
+// bucket the car is held at a speed inside it, then the steering is switched between +relay
+// and -relay whenever the yaw rate crosses the setpoint by more than the hysteresis. That
+// drives the loop into a steady oscillation at its critical frequency: the period is the
+// ultimate period and 4 * relay / (pi * sqrt(a^2 - hysteresis^2)), with a the yaw rate
+// amplitude, the ultimate gain. Once cycles cycles in a row agree the gains follow from the
+// Tyreus-Luyben rule. A bucket that doesn't settle in timeout_s is left as it
+// was, leaving the speed band starts the bucket over.
+class TurnRateAutotune {
+  public:
+    TurnRateAutotune(float relay, float hysteresis, uint8_t cycles, float settle_s, float timeout_s);
+    // Buckets start at bucket_speeds (km/h, ascending), those that can't be reached under
+    // max_speed_kmh are skipped
+    void begin(const float *bucket_speeds, uint8_t count, float min_speed_kmh, float max_speed_kmh);
+    // Call at the PID step, so the oscillation includes its sampling delay. Returns the steering
+    // to add to the setpoint's feed-forward
+    float update(float yaw_rate, float setpoint, float speed_kmh, float dt);
+    float getSpeed(); // km/h to hold, 0 once done
+    AutotuneState getState();
+    uint8_t getBucket();
+    uint8_t getCount();
+    uint8_t getCycles(); // measured cycles of the current bucket
+    const AutotuneResult &getResult(uint8_t bucket);
+
+  private:
+    void startBucket(uint8_t bucket);
+    void nextBucket();
+    void cycleDone(float amplitude, float period);
+
+    float relay;
+    float hysteresis;
+    uint8_t cycles;
+    float settle_s;
+    float timeout_s;
+
+    AutotuneResult results[AUTOTUNE_BUCKETS_MAX];
+    uint8_t count = 0;
+    uint8_t bucket = 0;
+    AutotuneState state = AutotuneState::DONE;
+    float in_band_s = 0;
+    float relay_s = 0; // since the relay started
+    float step_s = 0; // between update() calls
+    float output = 0;
+    uint8_t switches = 0;
+    float cycle_start_s = 0;
+    float cycle_max = 0;
+    float cycle_min = 0;
+    float amplitudes[AUTOTUNE_CYCLES_MAX];
+    float periods[AUTOTUNE_CYCLES_MAX];
+    uint8_t measured = 0; // cycles in amplitudes and periods, oldest overwritten
+};
+
+#endif // TURN_RATE_AUTOTUNE_H
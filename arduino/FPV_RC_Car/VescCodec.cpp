@@ -0,0 +1,203 @@
+#include "VescCodec.h"
+
+static const uint16_t CRC16_TABLE[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+  0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+  0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+  0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+  0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+  0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+  0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+  0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+  0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+  0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+  0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+  0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+  0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+  0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+  0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+  0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+  0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+  0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+  0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+  0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+  0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+  0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+uint16_t vescCrc16(const uint8_t *data, uint16_t length) {
+  uint16_t crc = 0;
+  while (length--) {
+    crc = CRC16_TABLE[((crc >> 8) ^ *data++) & 0xFF] ^ (crc << 8);
+  }
+  return crc;
+}
+
+static int16_t getInt16(const uint8_t *src, uint16_t *index) {
+  int16_t value = (int16_t)(((uint16_t)src[*index] << 8) | src[*index + 1]);
+  *index += 2;
+  return value;
+}
+
+static int32_t getInt32(const uint8_t *src, uint16_t *index) {
+  int32_t value = (int32_t)(((uint32_t)src[*index] << 24) | ((uint32_t)src[*index + 1] << 16) | ((uint32_t)src[*index + 2] << 8) | src[*index + 3]);
+  *index += 4;
+  return value;
+}
+
+bool vescDecodeValues(const uint8_t *payload, uint16_t length, vescValues_t *values) {
+  if (length < 53 || payload[0] != COMM_GET_VALUES) {
+    return false;
+  }
+  uint16_t index = 1;
+  values->tempMosfet = getInt16(payload, &index) / 10.0f;
+  values->tempMotor = getInt16(payload, &index) / 10.0f;
+  values->avgMotorCurrent = getInt32(payload, &index) / 100.0f;
+  values->avgInputCurrent = getInt32(payload, &index) / 100.0f;
+  index += 8; // avg_id and avg_iq
+  values->dutyCycleNow = getInt16(payload, &index) / 1000.0f;
+  values->rpm = (float)getInt32(payload, &index);
+  values->inpVoltage = getInt16(payload, &index) / 10.0f;
+  values->ampHours = getInt32(payload, &index) / 10000.0f;
+  values->ampHoursCharged = getInt32(payload, &index) / 10000.0f;
+  values->wattHours = getInt32(payload, &index) / 10000.0f;
+  values->wattHoursCharged = getInt32(payload, &index) / 10000.0f;
+  values->tachometer = getInt32(payload, &index);
+  values->tachometerAbs = getInt32(payload, &index);
+  return true;
+}
+
+// Byte sizes of the COMM_GET_VALUES reply fields in mask bit order
+static const uint8_t VALUE_FIELD_SIZES[] = {2, 2, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, 4};
+
+bool vescDecodeValuesSelective(const uint8_t *payload, uint16_t length, vescValues_t *values, uint32_t *mask) {
+  if (length < 5 || payload[0] != COMM_GET_VALUES_SELECTIVE) {
+    return false;
+  }
+  uint16_t index = 1;
+  uint32_t fields = (uint32_t)getInt32(payload, &index);
+  // only the fields vescValues_t holds can be skipped over, anything after them is ignored
+  uint16_t needed = index;
+  for (uint8_t bit = 0; bit < sizeof(VALUE_FIELD_SIZES); bit++) {
+    if (fields & (1UL << bit)) {
+      needed += VALUE_FIELD_SIZES[bit];
+    }
+  }
+  if (length < needed) {
+    return false;
+  }
+  if (fields & VESC_FIELD_TEMP_MOSFET) values->tempMosfet = getInt16(payload, &index) / 10.0f;
+  if (fields & VESC_FIELD_TEMP_MOTOR) values->tempMotor = getInt16(payload, &index) / 10.0f;
+  if (fields & VESC_FIELD_AVG_MOTOR_CURRENT) values->avgMotorCurrent = getInt32(payload, &index) / 100.0f;
+  if (fields & VESC_FIELD_AVG_INPUT_CURRENT) values->avgInputCurrent = getInt32(payload, &index) / 100.0f;
+  if (fields & VESC_FIELD_AVG_ID) index += 4;
+  if (fields & VESC_FIELD_AVG_IQ) index += 4;
+  if (fields & VESC_FIELD_DUTY_CYCLE) values->dutyCycleNow = getInt16(payload, &index) / 1000.0f;
+  if (fields & VESC_FIELD_RPM) values->rpm = (float)getInt32(payload, &index);
+  if (fields & VESC_FIELD_INPUT_VOLTAGE) values->inpVoltage = getInt16(payload, &index) / 10.0f;
+  if (fields & VESC_FIELD_AMP_HOURS) values->ampHours = getInt32(payload, &index) / 10000.0f;
+  if (fields & VESC_FIELD_AMP_HOURS_CHARGED) values->ampHoursCharged = getInt32(payload, &index) / 10000.0f;
+  if (fields & VESC_FIELD_WATT_HOURS) values->wattHours = getInt32(payload, &index) / 10000.0f;
+  if (fields & VESC_FIELD_WATT_HOURS_CHARGED) values->wattHoursCharged = getInt32(payload, &index) / 10000.0f;
+  if (fields & VESC_FIELD_TACHOMETER) values->tachometer = getInt32(payload, &index);
+  if (fields & VESC_FIELD_TACHOMETER_ABS) values->tachometerAbs = getInt32(payload, &index);
+  *mask = fields;
+  return true;
+}
+
+static void putInt32(uint8_t *dst, uint32_t value) {
+  dst[0] = value >> 24;
+  dst[1] = value >> 16;
+  dst[2] = value >> 8;
+  dst[3] = value;
+}
+
+// Frames the payload already written at buffer + 2
+static uint8_t finishPacket(uint8_t *buffer, uint8_t length) {
+  uint16_t crc = vescCrc16(buffer + 2, length);
+  buffer[0] = 2;
+  buffer[1] = length;
+  buffer[2 + length] = crc >> 8;
+  buffer[3 + length] = crc & 0xFF;
+  buffer[4 + length] = 3;
+  return length + VESC_PACKET_OVERHEAD;
+}
+
+uint8_t vescBuildGetValues(uint8_t *buffer) {
+  buffer[2] = COMM_GET_VALUES;
+  return finishPacket(buffer, 1);
+}
+
+uint8_t vescBuildGetValuesSelective(uint8_t *buffer, uint32_t mask) {
+  buffer[2] = COMM_GET_VALUES_SELECTIVE;
+  putInt32(buffer + 3, mask);
+  return finishPacket(buffer, 5);
+}
+
+uint8_t vescBuildSetRpm(uint8_t *buffer, int32_t erpm) {
+  buffer[2] = COMM_SET_RPM;
+  putInt32(buffer + 3, (uint32_t)erpm);
+  return finishPacket(buffer, 5);
+}
+
+uint8_t vescBuildSetBrakeCurrent(uint8_t *buffer, int32_t milliamps) {
+  buffer[2] = COMM_SET_CURRENT_BRAKE;
+  putInt32(buffer + 3, (uint32_t)milliamps);
+  return finishPacket(buffer, 5);
+}
+
+bool VescPacketParser::feed(uint8_t byte) {
+  switch (state) {
+    case 0: // start byte
+      if (byte == 2) {
+        state = 2;
+      } else if (byte == 3) {
+        state = 1;
+        length = 0;
+      }
+      return false;
+    case 1: // high byte of a long packet length
+      length = (uint16_t)byte << 8;
+      state = 3;
+      return false;
+    case 2: // short packet length
+      length = 0;
+      // fall through
+    case 3:
+      length |= byte;
+      index = 0;
+      state = (length > 0 && length <= VESC_PAYLOAD_SIZE_MAX) ? 4 : 0;
+      return false;
+    case 4: // payload
+      payload[index++] = byte;
+      if (index >= length) {
+        state = 5;
+      }
+      return false;
+    case 5:
+      crc = (uint16_t)byte << 8;
+      state = 6;
+      return false;
+    case 6:
+      crc |= byte;
+      state = 7;
+      return false;
+    default: // end byte
+      state = 0;
+      if (byte == 3 && crc == vescCrc16(payload, length)) {
+        return true;
+      }
+      crc_errors++;
+      return false;
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef VESC_CODEC_H
+#define VESC_CODEC_H
+
+#include <stdint.h>
+
+// VESC UART packet framing and payload decoding, no hardware dependencies.
+// Short packets: 0x02, length, payload, crc16 (big endian), 0x03
+// Long packets:  0x03, length (16 bit), payload, crc16, 0x03
+
+#define VESC_PAYLOAD_SIZE_MAX 80
+#define VESC_PACKET_OVERHEAD 5 // start, length, crc16 and end byte of a short packet
+
+enum vescCommand_e : uint8_t {
+  COMM_GET_VALUES = 4,
+  COMM_SET_CURRENT_BRAKE = 7,
+  COMM_SET_RPM = 8,
+  COMM_GET_VALUES_SELECTIVE = 50
+};
+
+// Field mask of COMM_GET_VALUES_SELECTIVE, the bits follow the order of the COMM_GET_VALUES reply
+enum vescValueField_e : uint32_t {
+  VESC_FIELD_TEMP_MOSFET = 1UL << 0,
+  VESC_FIELD_TEMP_MOTOR = 1UL << 1,
+  VESC_FIELD_AVG_MOTOR_CURRENT = 1UL << 2,
+  VESC_FIELD_AVG_INPUT_CURRENT = 1UL << 3,
+  VESC_FIELD_AVG_ID = 1UL << 4,
+  VESC_FIELD_AVG_IQ = 1UL << 5,
+  VESC_FIELD_DUTY_CYCLE = 1UL << 6,
+  VESC_FIELD_RPM = 1UL << 7,
+  VESC_FIELD_INPUT_VOLTAGE = 1UL << 8,
+  VESC_FIELD_AMP_HOURS = 1UL << 9,
+  VESC_FIELD_AMP_HOURS_CHARGED = 1UL << 10,
+  VESC_FIELD_WATT_HOURS = 1UL << 11,
+  VESC_FIELD_WATT_HOURS_CHARGED = 1UL << 12,
+  VESC_FIELD_TACHOMETER = 1UL << 13,
+  VESC_FIELD_TACHOMETER_ABS = 1UL << 14
+};
+
+typedef struct {
+  float tempMosfet;
+  float tempMotor;
+  float avgMotorCurrent;
+  float avgInputCurrent;
+  float dutyCycleNow;
+  float rpm;
+  float inpVoltage;
+  float ampHours;
+  float ampHoursCharged;
+  float wattHours;
+  float wattHoursCharged;
+  int32_t tachometer;
+  int32_t tachometerAbs;
+} vescValues_t;
+
+uint16_t vescCrc16(const uint8_t *data, uint16_t length);
+// Decodes a COMM_GET_VALUES reply payload (starting at the command byte)
+bool vescDecodeValues(const uint8_t *payload, uint16_t length, vescValues_t *values);
+// Decodes a COMM_GET_VALUES_SELECTIVE reply, fields missing from the reply keep their value.
+// mask receives the fields the VESC sent.
+bool vescDecodeValuesSelective(const uint8_t *payload, uint16_t length, vescValues_t *values, uint32_t *mask);
+
+// Packet builders, each writes a complete short packet to buffer and returns its length.
+// buffer needs room for the payload plus VESC_PACKET_OVERHEAD.
+uint8_t vescBuildGetValues(uint8_t *buffer);
+uint8_t vescBuildGetValuesSelective(uint8_t *buffer, uint32_t mask);
+uint8_t vescBuildSetRpm(uint8_t *buffer, int32_t erpm);
+uint8_t vescBuildSetBrakeCurrent(uint8_t *buffer, int32_t milliamps);
+
+// Reassembles packets from a byte stream
+class VescPacketParser {
+  public:
+    // Returns true when byte completed a packet with a valid CRC, see payload and length
+    bool feed(uint8_t byte);
+    uint8_t payload[VESC_PAYLOAD_SIZE_MAX];
+    uint16_t length = 0;
+    uint32_t crc_errors = 0;
+
+  private:
+    uint8_t state = 0;
+    uint16_t index = 0;
+    uint16_t crc = 0;
+};
+
+#endif // VESC_CODEC_H
@@ -0,0 +1,98 @@
+#include "VescLink.h"
+
+// setpoint and request packets of one update()
+#define VESC_BATCH_SIZE (2 * (5 + VESC_PACKET_OVERHEAD))
+// a request that got no reply within this many intervals is given up
+#define VESC_REQUEST_TIMEOUT_INTERVALS 10
+
+VescLink::VescLink(uint32_t value_mask, uint16_t values_interval_ms, uint16_t setpoint_refresh_ms) {
+  this->value_mask = value_mask;
+  this->values_interval_ms = values_interval_ms;
+  this->setpoint_refresh_ms = setpoint_refresh_ms;
+}
+
+void VescLink::begin(HardwareSerial *serial, unsigned long baudrate) {
+  this->serial = serial;
+  serial->begin(baudrate);
+}
+
+void VescLink::receive(const uint8_t *data, uint16_t length, uint32_t now_us) {
+  if (receive_tap != NULL) {
+    for (uint16_t i = 0; i < length; i += 32) {
+      receive_tap(data + i, length - i < 32 ? length - i : 32, now_us);
+    }
+  }
+  for (uint16_t i = 0; i < length; i++) {
+    if (!parser.feed(data[i])) {
+      continue;
+    }
+    uint32_t mask;
+    if (vescDecodeValuesSelective(parser.payload, parser.length, &values, &mask)) {
+      request_outstanding = false;
+      values_pending = true;
+      last_values_timestamp = millis();
+      values_request_us = last_request_us;
+    }
+  }
+}
+
+void VescLink::setReceiveTap(vescReceiveTap_t tap) {
+  receive_tap = tap;
+}
+
+void VescLink::setRpm(int32_t erpm) {
+  setSetpoint(COMM_SET_RPM, erpm);
+}
+
+void VescLink::setBrakeCurrent(float amps) {
+  setSetpoint(COMM_SET_CURRENT_BRAKE, (int32_t)(amps * 1000.0f));
+}
+
+void VescLink::setSetpoint(uint8_t command, int32_t value) {
+  if (command == sent_command && value == sent_value && millis() - last_setpoint < setpoint_refresh_ms) {
+    skipped_setpoints++;
+    setpoint_queued = false;
+    return;
+  }
+  setpoint_command = command;
+  setpoint_value = value;
+  setpoint_queued = true;
+}
+
+void VescLink::update() {
+  uint8_t batch[VESC_BATCH_SIZE];
+  uint8_t length = 0;
+  uint32_t now = millis();
+  if (setpoint_queued) {
+    if (setpoint_command == COMM_SET_RPM) {
+      length += vescBuildSetRpm(batch + length, setpoint_value);
+    } else {
+      length += vescBuildSetBrakeCurrent(batch + length, setpoint_value);
+    }
+    sent_command = setpoint_command;
+    sent_value = setpoint_value;
+    last_setpoint = now;
+    setpoint_queued = false;
+    sent_packets++;
+  }
+  if (request_outstanding && now - last_request > (uint32_t)values_interval_ms * VESC_REQUEST_TIMEOUT_INTERVALS) {
+    request_outstanding = false;
+    request_timeouts++;
+  }
+  if (!request_outstanding && now - last_request >= values_interval_ms) {
+    length += vescBuildGetValuesSelective(batch + length, value_mask);
+    request_outstanding = true;
+    last_request = now;
+    last_request_us = micros();
+    sent_packets++;
+  }
+  if (length > 0) {
+    serial->write(batch, length);
+  }
+}
+
+bool VescLink::takeValues() {
+  bool pending = values_pending;
+  values_pending = false;
+  return pending;
+}
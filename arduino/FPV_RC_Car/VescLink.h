@@ -0,0 +1,58 @@
+#ifndef VESC_LINK_H
+#define VESC_LINK_H
+
+#include <Arduino.h>
+#include "VescCodec.h"
+
+// Sees the raw received bytes before they are parsed
+typedef void (*vescReceiveTap_t)(const uint8_t *data, uint8_t length, uint32_t now_us);
+
+// VESC connection that never waits for the ESC. Setpoints and the telemetry request of a loop()
+// pass go out in one write from update(), SerialMux hands the replies to receive(). A setpoint
+// equal to the last one sent is only repeated once the refresh interval has passed, callers
+// keep calling setRpm() every pass as before.
+class VescLink {
+  public:
+    // value_mask selects the COMM_GET_VALUES_SELECTIVE fields, see vescValueField_e
+    VescLink(uint32_t value_mask, uint16_t values_interval_ms, uint16_t setpoint_refresh_ms);
+    void begin(HardwareSerial *serial, unsigned long baudrate);
+    // SerialMux span handler of the port
+    void receive(const uint8_t *data, uint16_t length, uint32_t now_us);
+    void setReceiveTap(vescReceiveTap_t tap);
+    void setRpm(int32_t erpm);
+    void setBrakeCurrent(float amps);
+    // Call from loop() after the setpoints, sends what is due
+    void update();
+    // True once for every reply received since the last call, the fields are in values
+    bool takeValues();
+
+    vescValues_t values = {};
+    uint32_t last_values_timestamp = 0;
+    uint32_t values_request_us = 0; // micros() the request of values went out, the VESC reads them once it has it
+    uint32_t sent_packets = 0;
+    uint32_t skipped_setpoints = 0;
+    uint32_t request_timeouts = 0;
+
+  private:
+    void setSetpoint(uint8_t command, int32_t value);
+
+    HardwareSerial *serial = NULL;
+    VescPacketParser parser;
+    vescReceiveTap_t receive_tap = NULL;
+    uint32_t value_mask;
+    uint16_t values_interval_ms;
+    uint16_t setpoint_refresh_ms;
+    bool values_pending = false;
+    bool request_outstanding = false;
+    uint32_t last_request = 0;
+    uint32_t last_request_us = 0;
+    // the setpoint queued for update() and the last one that went out
+    uint8_t setpoint_command = 0;
+    int32_t setpoint_value = 0;
+    bool setpoint_queued = false;
+    uint8_t sent_command = 0;
+    int32_t sent_value = 0;
+    uint32_t last_setpoint = 0;
+};
+
+#endif // VESC_LINK_H
@@ -0,0 +1,46 @@
+// Generated by tools/yaw_lqr, rerun it instead of editing:
+//   ./yaw_lqr --wheelbase 0.26 --servo-tau 0.03 --delay 0.03 --yaw-tau 0.08 --rate 416 --speed-min 1 --speed-step 1 --speeds 30
+//     --rate-error 10 --heading-error 5 --wheel 5
+
+#ifndef YAW_LQR_GAINS_H
+#define YAW_LQR_GAINS_H
+
+#include "YawRateLqr.h"
+
+#define YAW_LQR_SPEED_MIN 1.0f // km/h of the first row
+#define YAW_LQR_SPEED_STEP 1.0f // km/h between rows
+
+const YawLqrGain YAW_LQR_GAINS[] = {
+  {0.110481f, 0.144385f, 0.997787f}, // 1.0 km/h
+  {0.270862f, 0.189817f, 0.994574f}, // 2.0 km/h
+  {0.441582f, 0.221347f, 0.991153f}, // 3.0 km/h
+  {0.608765f, 0.244158f, 0.987804f}, // 4.0 km/h
+  {0.768603f, 0.261411f, 0.984601f}, // 5.0 km/h
+  {0.920505f, 0.274947f, 0.981557f}, // 6.0 km/h
+  {1.064866f, 0.285877f, 0.978665f}, // 7.0 km/h
+  {1.202343f, 0.294907f, 0.975910f}, // 8.0 km/h
+  {1.333618f, 0.302506f, 0.973279f}, // 9.0 km/h
+  {1.459322f, 0.308996f, 0.970760f}, // 10.0 km/h
+  {1.580009f, 0.314607f, 0.968342f}, // 11.0 km/h
+  {1.696163f, 0.319509f, 0.966014f}, // 12.0 km/h
+  {1.808205f, 0.323830f, 0.963769f}, // 13.0 km/h
+  {1.916499f, 0.327666f, 0.961598f}, // 14.0 km/h
+  {2.021361f, 0.331095f, 0.959497f}, // 15.0 km/h
+  {2.123069f, 0.334177f, 0.957458f}, // 16.0 km/h
+  {2.221866f, 0.336961f, 0.955478f}, // 17.0 km/h
+  {2.317966f, 0.339486f, 0.953552f}, // 18.0 km/h
+  {2.411560f, 0.341786f, 0.951676f}, // 19.0 km/h
+  {2.502818f, 0.343888f, 0.949847f}, // 20.0 km/h
+  {2.591891f, 0.345816f, 0.948061f}, // 21.0 km/h
+  {2.678915f, 0.347587f, 0.946317f}, // 22.0 km/h
+  {2.764014f, 0.349220f, 0.944611f}, // 23.0 km/h
+  {2.847299f, 0.350729f, 0.942942f}, // 24.0 km/h
+  {2.928872f, 0.352125f, 0.941306f}, // 25.0 km/h
+  {3.008824f, 0.353420f, 0.939704f}, // 26.0 km/h
+  {3.087239f, 0.354623f, 0.938132f}, // 27.0 km/h
+  {3.164197f, 0.355742f, 0.936589f}, // 28.0 km/h
+  {3.239766f, 0.356785f, 0.935074f}, // 29.0 km/h
+  {3.314014f, 0.357757f, 0.933586f}, // 30.0 km/h
+};
+
+#endif // YAW_LQR_GAINS_H
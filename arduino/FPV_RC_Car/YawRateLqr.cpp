@@ -0,0 +1,75 @@
+#include "YawRateLqr.h"
+#include <math.h>
+
+YawRateLqr::YawRateLqr(const YawLqrGain *table, uint8_t count, float speed_min_kmh, float speed_step_kmh, SteeringFeedForward *feed_forward,
+                       float max_wheel_angle_deg, float servo_tau, float servo_slew_deg_s, float yaw_tau, float integral_limit)
+  : table(table), count(count), speed_min_kmh(speed_min_kmh), speed_step_kmh(speed_step_kmh), feed_forward(feed_forward),
+    max_wheel_angle_deg(max_wheel_angle_deg), servo_tau(servo_tau), servo_slew_deg_s(servo_slew_deg_s), yaw_tau(yaw_tau),
+    integral_limit(integral_limit) {}
+
+void YawRateLqr::reset(float steering) {
+  integral = 0;
+  command = steering;
+  wheel = steering * max_wheel_angle_deg;
+  reference_wheel = wheel;
+  reference_rate = 0;
+  reference_lag = 0;
+}
+
+YawLqrGain YawRateLqr::gainsForSpeed(float speed_kmh) {
+  float position = (speed_kmh - speed_min_kmh) / speed_step_kmh;
+  if (position <= 0) {
+    return table[0];
+  }
+  uint8_t i = (uint8_t)position;
+  if (i >= count - 1) {
+    return table[count - 1];
+  }
+  float t = position - i;
+  YawLqrGain gain = {
+    table[i].k_wheel + (table[i + 1].k_wheel - table[i].k_wheel) * t,
+    table[i].k_rate + (table[i + 1].k_rate - table[i].k_rate) * t,
+    table[i].k_integral + (table[i + 1].k_integral - table[i].k_integral) * t
+  };
+  return gain;
+}
+
+float YawRateLqr::servoRate(float command_deg, float angle) {
+  float rate = (command_deg - angle) / servo_tau;
+  return rate < -servo_slew_deg_s ? -servo_slew_deg_s : (rate > servo_slew_deg_s ? servo_slew_deg_s : rate);
+}
+
+float YawRateLqr::update(float target, float yaw_rate, float speed, float dt) {
+  float speed_kmh = fabsf(speed) * 3.6f;
+  // reversing turns the yaw rate around, the gains on it change sign
+  float sign = speed < 0 ? -1.0f : 1.0f;
+  YawLqrGain k = gainsForSpeed(speed_kmh);
+  float wheel_ff = feed_forward->command(target, speed) * max_wheel_angle_deg;
+  // the integral runs on the error against the response the feed-forward alone gets from the
+  // model, against the target itself it would wind up over every step and overshoot. The rate
+  // term acts on the target, it drives the wheel past the feed-forward for a faster turn in
+  reference_wheel += servoRate(wheel_ff, reference_wheel) * dt;
+  reference_lag += (target - reference_lag) * dt / (servo_tau + dt);
+  reference_rate += (reference_lag - reference_rate) * dt / (yaw_tau + dt);
+  float error = yaw_rate - reference_rate;
+  float wheel_command = wheel_ff - k.k_wheel * (wheel - reference_wheel) - sign * (k.k_rate * (yaw_rate - target) + k.k_integral * integral);
+
+  float previous = command * max_wheel_angle_deg;
+  float step = servo_slew_deg_s * dt;
+  float limited = wheel_command < previous - step ? previous - step : (wheel_command > previous + step ? previous + step : wheel_command);
+  limited = limited < -max_wheel_angle_deg ? -max_wheel_angle_deg : (limited > max_wheel_angle_deg ? max_wheel_angle_deg : limited);
+  // below the table the yaw rate hardly answers, and while a limit holds the command the
+  // integral only runs if it backs off
+  if (speed_kmh >= speed_min_kmh && (limited == wheel_command || (wheel_command - limited) * sign * error > 0)) {
+    integral += error * dt;
+    integral = integral < -integral_limit ? -integral_limit : (integral > integral_limit ? integral_limit : integral);
+  }
+
+  wheel += servoRate(limited, wheel) * dt;
+  command = limited / max_wheel_angle_deg;
+  return command;
+}
+
+float YawRateLqr::getWheelAngle() {
+  return wheel;
+}
@@ -0,0 +1,57 @@
+#ifndef YAW_RATE_LQR_H
+#define YAW_RATE_LQR_H
+
+#include <stdint.h>
+#include "SteeringFeedForward.h"
+
+// State feedback gains at one speed, wheel angle command in degrees per unit of the state
+struct YawLqrGain {
+  float k_wheel; // per degree of wheel angle away from the feed-forward's
+  float k_rate; // per deg/s of yaw rate error
+  float k_integral; // per degree of integrated yaw rate error, the heading lost
+};
+
+// Yaw rate controller on a model of the car: the servo as a rate limited first order lag
+// driving the wheel angle, the yaw rate following speed / wheelbase * wheel angle with a
+// first order lag, and the integral of the yaw rate error for zero steady-state error. The
+// gains are a discrete LQR solved offline per speed by tools/yaw_lqr into a table and
+// interpolated here. The feed-forward gives the wheel angle the target needs, the feedback
+// only moves the wheel around it, and the integral only sees what the car misses of the
+// model's response to the feed-forward. The wheel angle isn't measured, it's the servo model
+// run on the commands sent. Commands are kept within the servo's travel and slew rate, and
+// the integral stops while a limit holds the command.
+class YawRateLqr {
+  public:
+    YawRateLqr(const YawLqrGain *table, uint8_t count, float speed_min_kmh, float speed_step_kmh, SteeringFeedForward *feed_forward,
+               float max_wheel_angle_deg, float servo_tau, float servo_slew_deg_s, float yaw_tau, float integral_limit);
+    // steering is the command the servo was last given, the servo model starts from it
+    void reset(float steering);
+    // Call with every yaw rate sample, rates in deg/s, signed speed in m/s. Returns the steering
+    // command in -1..1
+    float update(float target, float yaw_rate, float speed, float dt);
+    float getWheelAngle(); // degrees, the servo model's
+
+  private:
+    YawLqrGain gainsForSpeed(float speed_kmh);
+    float servoRate(float command_deg, float angle); // deg/s the servo model moves at
+
+    const YawLqrGain *table;
+    uint8_t count;
+    float speed_min_kmh;
+    float speed_step_kmh;
+    SteeringFeedForward *feed_forward;
+    float max_wheel_angle_deg;
+    float servo_tau;
+    float servo_slew_deg_s;
+    float yaw_tau;
+    float integral_limit;
+
+    float wheel = 0; // deg
+    float integral = 0; // deg
+    float reference_wheel = 0; // deg, the servo model on the feed-forward alone
+    float reference_lag = 0; // deg/s, the target through the servo lag
+    float reference_rate = 0; // deg/s, and through the yaw lag
+    float command = 0;
+};
+
+#endif // YAW_RATE_LQR_H
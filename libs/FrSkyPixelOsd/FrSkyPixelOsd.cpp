@@ -5,6 +5,7 @@
 */
 
 #include "FrSkyPixelOsd.h"
+#include "FrSkyPixelOsdGeometry.h"
 
 void FrSkyPixelOsd::sendByte(uint8_t *crc, uint8_t byte)
 {
@@ -64,11 +65,12 @@ void FrSkyPixelOsd::updateCrc(uint8_t *crc, uint8_t data)
 FrSkyPixelOsd::FrSkyPixelOsd(OSD_SERIAL_TYPE *serial)
 {
   osdSerial = serial;
+  clearWidgetConfigCache();
 }
 
 FrSkyPixelOsd::FrSkyPixelOsd()
 {
-  // Intentionally left empty
+  clearWidgetConfigCache();
 }
 
 uint32_t FrSkyPixelOsd::begin(uint32_t baudRate)
@@ -79,6 +81,33 @@ uint32_t FrSkyPixelOsd::begin(uint32_t baudRate)
   osdSerial->begin(osdBaudrate);
   // Wait for the OSD to be responsive
   while(cmdInfo(&response) != OSD_CMD_ERR_NONE) delay(100);
+  finishBegin(baudRate);
+  
+  return osdBaudrate;
+}
+
+void FrSkyPixelOsd::beginAsync(uint32_t baudRate)
+{
+  uint8_t payload = OSD_MAX_API_VERSION;
+
+  beginBaudrate = baudRate;
+  osdSerial->begin(osdBaudrate);
+  sendCmd(FrSkyPixelOsd::CMD_INFO, &payload, sizeof(payload));
+}
+
+bool FrSkyPixelOsd::pollBegin()
+{
+  // Header, length, command ID and CRC around the info, only parse once all of it can be there so receive() does not wait for the rest
+  if(osdSerial->available() < (int)(sizeof(osd_cmd_info_response_t) + 5)) return false;
+  if(receiveInfo(NULL, 2) != OSD_CMD_ERR_NONE) return false; // At least a whole millisecond to read the buffered bytes
+  finishBegin(beginBaudrate);
+  return true;
+}
+
+void FrSkyPixelOsd::finishBegin(uint32_t baudRate)
+{
+  // The OSD may have been restarted, so nothing it had configured can be trusted
+  clearWidgetConfigCache();
   // Change baudrate if different than default requested
   if(baudRate != osdBaudrate)
   {
@@ -89,8 +118,6 @@ uint32_t FrSkyPixelOsd::begin(uint32_t baudRate)
   // Reset the OSD
   cmdDrawingReset();
   cmdClearScreen();
-  
-  return osdBaudrate;
 }
 
 FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::receive(FrSkyPixelOsd::osd_command_t expectedCmdId, const void *payload, void *response, uint32_t timeout)
@@ -147,31 +174,40 @@ FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::receive(FrSkyPixelOsd::osd_command_t e
         if((FrSkyPixelOsd::osd_command_t)(frame[0]) == expectedCmdId)
         {
           result = OSD_CMD_ERR_NONE;
-          if((expectedCmdId == FrSkyPixelOsd::CMD_INFO) && (frame[1] == 'A') && (frame[2] == 'G') && (frame[3] == 'H')) { if(response != NULL) memcpy(response, frame + 1, sizeof(osd_cmd_info_response_t)); }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_READ_FONT) { if(response != NULL) memcpy(response, frame + 3, sizeof(osd_chr_data_t)); }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_WRITE_FONT) { if(response != NULL) memcpy(response, frame + 3, sizeof(osd_chr_data_t)); }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_GET_CAMERA) { if(response != NULL) *((uint8_t*)response) = frame[1]; }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_GET_ACTIVE_CAMERA) { if(response != NULL) *((uint8_t*)response) = frame[1]; }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_GET_OSD_ENABLED) { if(response != NULL) *((bool*)response) = (frame[1] > 0) ? true : false; }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_GET_SETTINGS) { if(response != NULL) memcpy(response, frame + 1, sizeof(osd_cmd_settings_response_t)); }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_SET_SETTINGS) { if(response != NULL) memcpy(response, frame + 1, sizeof(osd_cmd_settings_response_t)); }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_SAVE_SETTINGS) { if(response != NULL) *((uint8_t*)response) = frame[1]; }
-          else if((expectedCmdId == FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG) && (payload != NULL) && (*((osd_widget_id_t*)payload) == (osd_widget_id_t)frame[1]))
+          switch(expectedCmdId)
           {
-            // Check the type of response...
-            osd_widget_id_t id = (osd_widget_id_t)frame[1];
-            uint8_t responseSize = 0;
-            if(id == FrSkyPixelOsd::WIDGET_ID_AHI) responseSize = sizeof(osd_widget_ahi_config_t);
-            else if((id == FrSkyPixelOsd::WIDGET_ID_SIDEBAR_0) || (id == FrSkyPixelOsd::WIDGET_ID_SIDEBAR_0)) responseSize = sizeof(osd_widget_sidebar_config_t);
-            else if((id == FrSkyPixelOsd::WIDGET_ID_GRAPH_0) || (id == FrSkyPixelOsd::WIDGET_ID_GRAPH_1) ||
-                    (id == FrSkyPixelOsd::WIDGET_ID_GRAPH_2) || (id == FrSkyPixelOsd::WIDGET_ID_GRAPH_3)) responseSize = sizeof(osd_widget_graph_config_t);
-            else if((id == FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_0) || (id == FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_1) ||
-                    (id == FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_2) || (id == FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_3)) responseSize = sizeof(osd_widget_chargauge_config_t);
-            // ...and populate if recognized
-            if((responseSize > 0) && (response != NULL)) memcpy(response, frame + 2, responseSize);
+            case FrSkyPixelOsd::CMD_INFO:
+              if((frame[1] != 'A') || (frame[2] != 'G') || (frame[3] != 'H')) result = OSD_CMD_ERR_RESPONSE_TIMEOUT;
+              else if(response != NULL) memcpy(response, frame + 1, sizeof(osd_cmd_info_response_t));
+              break;
+            case FrSkyPixelOsd::CMD_READ_FONT:
+            case FrSkyPixelOsd::CMD_WRITE_FONT:
+              if(response != NULL) memcpy(response, frame + 3, sizeof(osd_chr_data_t));
+              break;
+            case FrSkyPixelOsd::CMD_GET_CAMERA:
+            case FrSkyPixelOsd::CMD_GET_ACTIVE_CAMERA:
+            case FrSkyPixelOsd::CMD_SAVE_SETTINGS:
+              if(response != NULL) *((uint8_t*)response) = frame[1];
+              break;
+            case FrSkyPixelOsd::CMD_GET_OSD_ENABLED:
+              if(response != NULL) *((bool*)response) = (frame[1] > 0) ? true : false;
+              break;
+            case FrSkyPixelOsd::CMD_GET_SETTINGS:
+            case FrSkyPixelOsd::CMD_SET_SETTINGS:
+              if(response != NULL) memcpy(response, frame + 1, sizeof(osd_cmd_settings_response_t));
+              break;
+            case FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG:
+              // Only the response for the widget that was configured counts
+              if((payload == NULL) || (*((osd_widget_id_t*)payload) != (osd_widget_id_t)frame[1])) result = OSD_CMD_ERR_RESPONSE_TIMEOUT;
+              else if(response != NULL) memcpy(response, frame + 2, getWidgetConfigSize((osd_widget_id_t)frame[1]));
+              break;
+            case FrSkyPixelOsd::CMD_SET_DATA_RATE:
+              if(response != NULL) memcpy(response, frame + 1, sizeof(uint32_t));
+              break;
+            default:
+              result = OSD_CMD_ERR_RESPONSE_TIMEOUT;
+              break;
           }
-          else if(expectedCmdId == FrSkyPixelOsd::CMD_SET_DATA_RATE) { if(response != NULL) memcpy(response, frame + 1, sizeof(uint32_t)); }
-          else result = OSD_CMD_ERR_RESPONSE_TIMEOUT;
           
           if(result != OSD_CMD_ERR_RESPONSE_TIMEOUT) break;
         }
@@ -217,7 +253,25 @@ FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdInfo(FrSkyPixelOsd::osd_cmd_info_re
 {
   uint8_t payload = OSD_MAX_API_VERSION;
   sendCmd(FrSkyPixelOsd::CMD_INFO, &payload, sizeof(payload));
-  return receive(FrSkyPixelOsd::CMD_INFO, NULL, response);
+  return receiveInfo(response, OSD_CMD_RESPONSE_TIMEOUT);
+}
+
+FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::receiveInfo(FrSkyPixelOsd::osd_cmd_info_response_t *response, uint32_t timeout)
+{
+  FrSkyPixelOsd::osd_cmd_info_response_t info;
+  FrSkyPixelOsd::osd_error_t result = receive(FrSkyPixelOsd::CMD_INFO, NULL, &info, timeout);
+  if(result == OSD_CMD_ERR_NONE)
+  {
+    // The OSD answers with the highest API version both sides support, which follows the major firmware version
+    osdApiVersion = (info.versionMajor < OSD_MAX_API_VERSION) ? info.versionMajor : OSD_MAX_API_VERSION;
+    if(response != NULL) memcpy(response, &info, sizeof(info));
+  }
+  return result;
+}
+
+uint8_t FrSkyPixelOsd::getApiVersion()
+{
+  return osdApiVersion;
 }
 
 FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdReadFont(uint16_t character, FrSkyPixelOsd::osd_chr_data_t *response)
@@ -492,6 +546,8 @@ void FrSkyPixelOsd::cmdCtmSet(float m11, float m12, float m21, float m22, float
 
 void FrSkyPixelOsd::cmdCtmTranstale(float tx, float ty)
 {
+  // Whole pixel offsets fit the compact encoding without any loss
+  if((osdApiVersion >= 2) && isInt16(tx) && isInt16(ty)) { cmdCtmI16Translate((int16_t)tx, (int16_t)ty); return; }
   FrSkyPixelOsd::osd_transformation_t payload = { .x = tx, .y = ty };
   sendCmd(FrSkyPixelOsd::CMD_CTM_TRANSLATE, &payload, sizeof(payload));
 }
@@ -504,11 +560,14 @@ void FrSkyPixelOsd::cmdCtmScale(float sx, float sy)
 
 void FrSkyPixelOsd::cmdCtmRotateRad(float angle)
 {
+  // 1/65536 of a turn moves a point at the far corner of the screen by less than 0.02 pixel, so the compact encoding is always good enough
+  if(osdApiVersion >= 2) { cmdCtmU16Rotate(radToAngle(angle)); return; }
   sendCmd(FrSkyPixelOsd::CMD_CTM_ROTATE, &angle, sizeof(angle));
 }
 
 void FrSkyPixelOsd::cmdCtmRotateDeg(int16_t angle)
 {
+  if(osdApiVersion >= 2) { cmdCtmU16Rotate(FrSkyPixelOsdGeometry::degToAngle(angle)); return; }
   cmdCtmRotateRad((float)(angle * 71 / 4068.0));
 }
 
@@ -543,6 +602,7 @@ void FrSkyPixelOsd::cmdCtmMultiply(float m11, float m12, float m21, float m22, f
 
 void FrSkyPixelOsd::cmdCtmTranslateRev(float tx, float ty)
 {
+  if(isInt16(tx) && isInt16(ty)) { cmdCtmI16TranslateRev((int16_t)tx, (int16_t)ty); return; }
   FrSkyPixelOsd::osd_transformation_t payload = { .x = tx, .y = ty };
   sendCmd(FrSkyPixelOsd::CMD_CTM_TRANSLATE_REV, &payload, sizeof(payload));
 }
@@ -555,12 +615,13 @@ void FrSkyPixelOsd::cmdCtmScaleRev(float sx, float sy)
 
 void FrSkyPixelOsd::cmdCtmRotateRevRad(float angle)
 {
-  sendCmd(FrSkyPixelOsd::CMD_CTM_ROTATE_REV, &angle, sizeof(angle));
+  // Reverse commands need API >= 2 anyway, so the compact encoding is always available
+  cmdCtmU16RotateRev(radToAngle(angle));
 }
 
 void FrSkyPixelOsd::cmdCtmRotateRevDeg(int16_t angle)
 {
-  cmdCtmRotateRevRad((float)(angle * 71 / 4068.0));
+  cmdCtmU16RotateRev(FrSkyPixelOsdGeometry::degToAngle(angle));
 }
 
 void FrSkyPixelOsd::cmdCtmRotateAboutRevRad(float angle, float cx, float cy)
@@ -602,6 +663,46 @@ void FrSkyPixelOsd::cmdCtmU16Rotate(uint16_t angle)
   sendCmd(FrSkyPixelOsd::CMD_CTM_U16ROTATE, &angle, sizeof(angle));
 }
 
+void FrSkyPixelOsd::cmdCtmTranslate(int16_t tx, int16_t ty)
+{
+  if(osdApiVersion >= 2) cmdCtmI16Translate(tx, ty);
+  else cmdCtmTranstale(tx, ty);
+}
+
+void FrSkyPixelOsd::cmdCtmRotate(uint16_t angle)
+{
+  if(osdApiVersion >= 2) cmdCtmU16Rotate(angle);
+  else cmdCtmRotateRad(angle * (float)(2.0 * PI / OSD_GEOMETRY_FULL_TURN));
+}
+
+void FrSkyPixelOsd::cmdCtmSetRotateTranslate(uint16_t angle, int16_t tx, int16_t ty)
+{
+  if(osdApiVersion >= 2)
+  {
+    // 21 bytes on the wire instead of the 29 of cmdCtmSet
+    cmdCtmReset();
+    cmdCtmI16Translate(tx, ty);
+    cmdCtmU16Rotate(angle);
+  }
+  else
+  {
+    float s = FrSkyPixelOsdGeometry::sinQ15(angle) / (float)OSD_GEOMETRY_Q15_ONE;
+    float c = FrSkyPixelOsdGeometry::cosQ15(angle) / (float)OSD_GEOMETRY_Q15_ONE;
+    cmdCtmSet(c, s, -s, c, tx, ty);
+  }
+}
+
+bool FrSkyPixelOsd::isInt16(float value)
+{
+  return (value >= -32768.0f) && (value <= 32767.0f) && (value == (float)(int16_t)value);
+}
+
+uint16_t FrSkyPixelOsd::radToAngle(float angle)
+{
+  // Wraps to a single turn through the 32 bit integer, 65536 / 2PI = 10430.378
+  return (uint16_t)(int32_t)lround(angle * 10430.378f);
+}
+
 void FrSkyPixelOsd::cmdCtmI16TranslateRev(int16_t tx, int16_t ty)
 {
   FrSkyPixelOsd::osd_transformation_i16_t payload = { .x = tx, .y = ty };
@@ -668,8 +769,7 @@ FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdWidgetSetConfigAhi(int16_t x, int16
 {
   FrSkyPixelOsd::osd_widget_ahi_config_t payload = { .rect = { .point = { .x = x, .y = y }, .size = { .width = width, .height = height } },
                                                  .style = style, .options = options, .crosshairMargin = crosshairMargin, .strokeWidth = strokeWidth };
-  sendCmd(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, sizeof(id), &payload, sizeof(payload), false);
-  return receive(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, response);
+  return widgetSetConfig(id, &payload, sizeof(payload), response);
 }
 
 FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdWidgetSetConfigSidebar(int16_t x, int16_t y, int16_t width, int16_t height, uint8_t options, uint8_t divisions, uint16_t countsPerStep,
@@ -678,8 +778,7 @@ FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdWidgetSetConfigSidebar(int16_t x, i
   FrSkyPixelOsd::osd_widget_sidebar_config_t payload = { .rect = { .point = { .x = x, .y = y }, .size = { .width = width, .height = height } },
                                                      .options = options, .divisions = divisions, .countsPerStep = countsPerStep, 
                                                      .unit = { .scale = scale, .symbol = symbol, .divisor = divisor, .dividedSymbol = dividedSymbol } };
-  sendCmd(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, sizeof(id), &payload, sizeof(payload), false);
-  return receive(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, response);
+  return widgetSetConfig(id, &payload, sizeof(payload), response);
 }
 
 FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdWidgetSetConfigGraph(int16_t x, int16_t y, int16_t width, int16_t height, uint8_t options, uint8_t yLabelCount, uint8_t yLabelWidth, uint8_t initialScale,
@@ -688,15 +787,13 @@ FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdWidgetSetConfigGraph(int16_t x, int
   FrSkyPixelOsd::osd_widget_graph_config_t payload = { .rect = { .point = { .x = x, .y = y }, .size = { .width = width, .height = height } },
                                                    .options = options, .yLabelCount = yLabelCount, .yLabelWidth = yLabelWidth, .initialScale = initialScale, 
                                                    .unit = { .scale = scale, .symbol = symbol, .divisor = divisor, .dividedSymbol = dividedSymbol } };
-  sendCmd(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, sizeof(id), &payload, sizeof(payload), false);
-  return receive(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, response);
+  return widgetSetConfig(id, &payload, sizeof(payload), response);
 }
 
 FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::cmdWidgetSetConfigCharGauge(int16_t x, int16_t y, uint16_t character, osd_widget_id_t id, osd_widget_chargauge_config_t *response)
 {
   FrSkyPixelOsd::osd_widget_chargauge_config_t payload = { .point = { .x = x, .y = y }, .chr = character };
-  sendCmd(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, sizeof(id), &payload, sizeof(payload), false);
-  return receive(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, response);
+  return widgetSetConfig(id, &payload, sizeof(payload), response);
 }
 
 void FrSkyPixelOsd::cmdWidgetDrawAhiRad(float pitch, float roll, osd_widget_id_t id)
@@ -733,10 +830,115 @@ void FrSkyPixelOsd::cmdWidgetErase(osd_widget_id_t id)
   sendCmd(FrSkyPixelOsd::CMD_WIDGET_ERASE, &id, sizeof(id));
 }
 
+void FrSkyPixelOsd::widgetConfigBatchBegin()
+{
+  widgetBatchActive = true;
+  widgetBatchError = OSD_CMD_ERR_NONE;
+}
+
+FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::widgetConfigBatchEnd()
+{
+  FrSkyPixelOsd::osd_error_t result = widgetAwaitPending();
+  widgetBatchActive = false;
+  return (widgetBatchError != OSD_CMD_ERR_NONE) ? widgetBatchError : result;
+}
+
+void FrSkyPixelOsd::clearWidgetConfigCache()
+{
+#ifdef OSD_WIDGET_CONFIG_CACHE
+  for(uint8_t i = 0; i < OSD_WIDGET_COUNT; i++) widgetConfigCache[i].state = WIDGET_CACHE_EMPTY;
+#endif
+}
+
+uint8_t FrSkyPixelOsd::getWidgetConfigSize(osd_widget_id_t id)
+{
+  switch(id)
+  {
+    case FrSkyPixelOsd::WIDGET_ID_AHI:
+      return sizeof(osd_widget_ahi_config_t);
+    case FrSkyPixelOsd::WIDGET_ID_SIDEBAR_0:
+    case FrSkyPixelOsd::WIDGET_ID_SIDEBAR_1:
+      return sizeof(osd_widget_sidebar_config_t);
+    case FrSkyPixelOsd::WIDGET_ID_GRAPH_0:
+    case FrSkyPixelOsd::WIDGET_ID_GRAPH_1:
+    case FrSkyPixelOsd::WIDGET_ID_GRAPH_2:
+    case FrSkyPixelOsd::WIDGET_ID_GRAPH_3:
+      return sizeof(osd_widget_graph_config_t);
+    case FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_0:
+    case FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_1:
+    case FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_2:
+    case FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_3:
+      return sizeof(osd_widget_chargauge_config_t);
+    default:
+      return 0;
+  }
+}
+
+FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::widgetSetConfig(osd_widget_id_t id, const void *config, uint8_t configSize, void *response)
+{
+#ifdef OSD_WIDGET_CONFIG_CACHE
+  if(id < OSD_WIDGET_COUNT)
+  {
+    // An identical config (already acknowledged or waiting in the current batch) is not sent again
+    osd_widget_cache_entry_t *entry = &widgetConfigCache[id];
+    if((entry->state != WIDGET_CACHE_EMPTY) && (memcmp(&entry->config, config, configSize) == 0))
+    {
+      if(response != NULL) memcpy(response, config, configSize);
+      return OSD_CMD_ERR_NONE;
+    }
+  }
+#endif
+  // Collect the responses already sent when the batch is full, so they fit the serial receive buffer
+  if(widgetBatchActive && (widgetPendingCount >= OSD_WIDGET_BATCH_MAX))
+  {
+    FrSkyPixelOsd::osd_error_t result = widgetAwaitPending();
+    if(widgetBatchError == OSD_CMD_ERR_NONE) widgetBatchError = result;
+  }
+  sendCmd(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, sizeof(id), config, configSize, false);
+#ifdef OSD_WIDGET_CONFIG_CACHE
+  if(id < OSD_WIDGET_COUNT)
+  {
+    memcpy(&widgetConfigCache[id].config, config, configSize);
+    widgetConfigCache[id].state = WIDGET_CACHE_PENDING;
+  }
+#endif
+  if(widgetBatchActive)
+  {
+    widgetPending[widgetPendingCount].id = id;
+    widgetPending[widgetPendingCount].response = response;
+    widgetPendingCount++;
+    return OSD_CMD_ERR_NONE;
+  }
+  return widgetAwaitConfig(id, response);
+}
+
+FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::widgetAwaitConfig(osd_widget_id_t id, void *response)
+{
+  FrSkyPixelOsd::osd_error_t result = receive(FrSkyPixelOsd::CMD_WIDGET_SET_CONFIG, &id, response);
+#ifdef OSD_WIDGET_CONFIG_CACHE
+  if(id < OSD_WIDGET_COUNT) widgetConfigCache[id].state = (result == OSD_CMD_ERR_NONE) ? WIDGET_CACHE_VALID : WIDGET_CACHE_EMPTY;
+#endif
+  return result;
+}
+
+FrSkyPixelOsd::osd_error_t FrSkyPixelOsd::widgetAwaitPending()
+{
+  // Responses arrive in the order the configs were sent
+  FrSkyPixelOsd::osd_error_t firstError = OSD_CMD_ERR_NONE;
+  for(uint8_t i = 0; i < widgetPendingCount; i++)
+  {
+    FrSkyPixelOsd::osd_error_t result = widgetAwaitConfig(widgetPending[i].id, widgetPending[i].response);
+    if((result != OSD_CMD_ERR_NONE) && (firstError == OSD_CMD_ERR_NONE)) firstError = result;
+  }
+  widgetPendingCount = 0;
+  return firstError;
+}
+
 void FrSkyPixelOsd::cmdReboot(bool toBootloader)
 {
   uint8_t payload = (toBootloader == true) ? 1 : 0;
   sendCmd(FrSkyPixelOsd::CMD_REBOOT, &payload, sizeof(payload));
+  clearWidgetConfigCache();
 }
 
 void FrSkyPixelOsd::cmdWriteFlash()
@@ -15,6 +15,8 @@
 #define OSD_MAX_API_VERSION 2 // Maximum API version requested by this library (you want may edit this if your code requires lower API version)
 #define OSD_DEFAULT_BAUD_RATE 115200 // Default baudrate that this library initiates communication with (you may want to edit it if the OSD is switched to a different baudrate prior to first call to the begin method)
 #define OSD_CMD_RESPONSE_TIMEOUT 500 // Maximum waiting time for command response (you may want to increasy it of you are missing responses, but that may increase command execution time)
+#define OSD_WIDGET_CONFIG_CACHE // Remember the last acknowledged config of each widget and skip sending an identical one (you may want to comment it out to save about 210 bytes of RAM on ATmega328P based boards)
+#define OSD_WIDGET_BATCH_MAX 4 // Maximum number of widget configs sent in a batch before their responses are collected (you may want to lower it if the serial receive buffer is small, each response takes up to 24 bytes)
 
 // Do not modify the #defines below
 #if defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__) || defined(__MK66FX1M0__) || defined(__MK64FX512__) || defined(__IMXRT1062__)
@@ -26,6 +28,7 @@
 #define OSD_MAX_RESPONSE_LEN 67  
 #define OSD_MAX_FONT_DATA_SIZE 54
 #define OSD_MAX_FONT_METADATA_SIZE 10
+#define OSD_WIDGET_COUNT 11
 
 class FrSkyPixelOsd
 {
@@ -211,7 +214,10 @@ class FrSkyPixelOsd
 
     FrSkyPixelOsd(OSD_SERIAL_TYPE *serial);
     uint32_t begin(uint32_t baudRate = OSD_DEFAULT_BAUD_RATE);
+    void beginAsync(uint32_t baudRate = OSD_DEFAULT_BAUD_RATE); // Non-blocking begin, opens the serial port and asks the OSD for its info
+    bool pollBegin(); // Finishes a beginAsync() once the OSD has answered, returns false without waiting until then (call beginAsync() again to retry)
     osd_error_t cmdInfo(osd_cmd_info_response_t *response);
+    uint8_t getApiVersion(); // API version of the connected OSD, known after begin() or cmdInfo()
     osd_error_t cmdReadFont(uint16_t character, osd_chr_data_t *response);
     osd_error_t cmdWriteFont(uint16_t character, const osd_chr_data_t *font, osd_chr_data_t *response = NULL);
     osd_error_t cmdGetCamera(uint8_t *response);
@@ -281,6 +287,9 @@ class FrSkyPixelOsd
     void cmdCtmU16Rotate(uint16_t angle); // API >= 2
     void cmdCtmI16TranslateRev(int16_t tx, int16_t ty); // API >= 2
     void cmdCtmU16RotateRev(uint16_t angle); // API >= 2
+    void cmdCtmTranslate(int16_t tx, int16_t ty); // Uses cmdCtmI16Translate on API >= 2 and floats otherwise
+    void cmdCtmRotate(uint16_t angle); // Angle in 1/65536 of a turn, uses cmdCtmU16Rotate on API >= 2 and floats otherwise
+    void cmdCtmSetRotateTranslate(uint16_t angle, int16_t tx, int16_t ty); // Same as cmdCtmSet with a rotation and a translation, compact on API >= 2 and without trigonometry from libm on any API
     void cmdContextPush();
     void cmdContextPop();
     void cmdDrawGridChar(uint8_t column, uint8_t row, uint16_t character, osd_bitmap_opts_t options = BITMAP_OPT_NONE);
@@ -301,6 +310,9 @@ class FrSkyPixelOsd
     void cmdWidgetDrawGraph(int32_t value, osd_widget_id_t id = WIDGET_ID_GRAPH_0); // API >= 2
     void cmdWidgetDrawCharGauge(uint8_t value, osd_widget_id_t id = WIDGET_ID_CHARGAUGE_0); // API >= 2
     void cmdWidgetErase(osd_widget_id_t id); // API >= 2
+    void widgetConfigBatchBegin(); // API >= 2, widget configs sent until widgetConfigBatchEnd() are not waited for individually
+    osd_error_t widgetConfigBatchEnd(); // API >= 2, collects the responses of the batch, returns the first error
+    void clearWidgetConfigCache(); // Forget the cached widget configs, e.g. after the OSD was power cycled on its own
     void cmdReboot(bool toBootloader = false);
     void cmdWriteFlash();
     uint8_t setFontMetadataSize(uint8_t size, uint8_t position, uint8_t *metadata);
@@ -497,6 +509,33 @@ class FrSkyPixelOsd
       int8_t error;
     } osd_cmd_error_response_t;
 
+    typedef union
+    {
+      osd_widget_ahi_config_t ahi;
+      osd_widget_sidebar_config_t sidebar;
+      osd_widget_graph_config_t graph;
+      osd_widget_chargauge_config_t chargauge;
+    } osd_widget_config_t;
+
+    enum osd_widget_cache_state_t : uint8_t
+    {
+      WIDGET_CACHE_EMPTY = 0,
+      WIDGET_CACHE_PENDING = 1, // sent, response not received yet
+      WIDGET_CACHE_VALID = 2
+    };
+
+    typedef struct
+    {
+      osd_widget_cache_state_t state;
+      osd_widget_config_t config;
+    } osd_widget_cache_entry_t;
+
+    typedef struct
+    {
+      osd_widget_id_t id;
+      void *response;
+    } osd_widget_pending_t;
+
     enum osd_command_t : uint8_t
     {
       CMD_ERROR = 0,
@@ -592,10 +631,27 @@ class FrSkyPixelOsd
     void sendCmd(FrSkyPixelOsd::osd_command_t id, const void *payload = NULL, uint32_t payloadLen = 0, const void *varPayload = NULL, uint32_t varPayloadLen = 0, bool sendVarPayloadLen = true);
     osd_error_t receive(FrSkyPixelOsd::osd_command_t expectedCmdId, const void *payload, void *response, uint32_t timeout = OSD_CMD_RESPONSE_TIMEOUT);
     osd_error_t cmdSetDataRate(uint32_t dataRate, uint32_t *response = NULL);
+    osd_error_t receiveInfo(osd_cmd_info_response_t *response, uint32_t timeout);
+    void finishBegin(uint32_t baudRate);
     uint8_t setFontMetadata(uint8_t metadataType, const void *metadataContent, uint8_t metadataSize, uint8_t position, uint8_t *metadata);
+    uint8_t getWidgetConfigSize(osd_widget_id_t id);
+    bool isInt16(float value);
+    uint16_t radToAngle(float angle);
+    osd_error_t widgetSetConfig(osd_widget_id_t id, const void *config, uint8_t configSize, void *response);
+    osd_error_t widgetAwaitConfig(osd_widget_id_t id, void *response);
+    osd_error_t widgetAwaitPending();
 
     OSD_SERIAL_TYPE *osdSerial;
     uint32_t osdBaudrate = OSD_DEFAULT_BAUD_RATE;
+    uint32_t beginBaudrate = OSD_DEFAULT_BAUD_RATE;
+    uint8_t osdApiVersion = 1;
+#ifdef OSD_WIDGET_CONFIG_CACHE
+    osd_widget_cache_entry_t widgetConfigCache[OSD_WIDGET_COUNT];
+#endif
+    osd_widget_pending_t widgetPending[OSD_WIDGET_BATCH_MAX];
+    uint8_t widgetPendingCount = 0;
+    bool widgetBatchActive = false;
+    osd_error_t widgetBatchError = OSD_CMD_ERR_NONE;
 };
 
 #endif // __FRSKY_PIXEL_OSD__
\ No newline at end of file
@@ -10,6 +10,7 @@
 */
 
 #include "FrSkyPixelOsd.h"
+#include "FrSkyPixelOsdGeometry.h"
 
 // Create OSD object, pass the reference to the serial port to use
 #if defined(TEENSY_HW) || defined(__AVR_ATmega2560__)
@@ -18,13 +19,12 @@
   FrSkyPixelOsd osd(&Serial); // Create OSD object, pass the reference to the serial port to use
 #endif
 
-float rot, rotx, roty, rotz, rotxx, rotyy, rotxxx, rotyyy;
-int wireframe[8][2];
+FrSkyPixelOsdGeometry::osd_vec2_t wireframe[8];
 
 int originx = 180;
 int originy = 144;
 
-int cubeVertex[8][3] =
+FrSkyPixelOsdGeometry::osd_vec3_t cubeVertex[8] =
 {
   { -50, -50,  50 },
   {  50, -50,  50 },
@@ -49,33 +49,33 @@ void drawWireframe(void)
 {
   osd.cmdTransactionBegin();
   osd.cmdClearRect(90, 50, 180, 180);
-  osd.cmdMoveToPoint(wireframe[0][0], wireframe[0][1]);
-  osd.cmdStrokeLineToPoint(wireframe[1][0], wireframe[1][1]);
-  osd.cmdStrokeLineToPoint(wireframe[2][0], wireframe[2][1]);
-  osd.cmdStrokeLineToPoint(wireframe[3][0], wireframe[3][1]);
-  osd.cmdStrokeLineToPoint(wireframe[0][0], wireframe[0][1]);
+  osd.cmdMoveToPoint(wireframe[0].x, wireframe[0].y);
+  osd.cmdStrokeLineToPoint(wireframe[1].x, wireframe[1].y);
+  osd.cmdStrokeLineToPoint(wireframe[2].x, wireframe[2].y);
+  osd.cmdStrokeLineToPoint(wireframe[3].x, wireframe[3].y);
+  osd.cmdStrokeLineToPoint(wireframe[0].x, wireframe[0].y);
 
   osd.cmdSetStrokeColor(FrSkyPixelOsd::COLOR_GREY);
-  osd.cmdMoveToPoint(wireframe[1][0], wireframe[1][1]);
-  osd.cmdStrokeLineToPoint(wireframe[3][0], wireframe[3][1]);
-  osd.cmdMoveToPoint(wireframe[0][0], wireframe[0][1]);
-  osd.cmdStrokeLineToPoint(wireframe[2][0], wireframe[2][1]);
+  osd.cmdMoveToPoint(wireframe[1].x, wireframe[1].y);
+  osd.cmdStrokeLineToPoint(wireframe[3].x, wireframe[3].y);
+  osd.cmdMoveToPoint(wireframe[0].x, wireframe[0].y);
+  osd.cmdStrokeLineToPoint(wireframe[2].x, wireframe[2].y);
   osd.cmdSetStrokeColor(FrSkyPixelOsd::COLOR_WHITE);
 
-  osd.cmdMoveToPoint(wireframe[4][0], wireframe[4][1]);
-  osd.cmdStrokeLineToPoint(wireframe[5][0], wireframe[5][1]);
-  osd.cmdStrokeLineToPoint(wireframe[6][0], wireframe[6][1]);
-  osd.cmdStrokeLineToPoint(wireframe[7][0], wireframe[7][1]);
-  osd.cmdStrokeLineToPoint(wireframe[4][0], wireframe[4][1]);
+  osd.cmdMoveToPoint(wireframe[4].x, wireframe[4].y);
+  osd.cmdStrokeLineToPoint(wireframe[5].x, wireframe[5].y);
+  osd.cmdStrokeLineToPoint(wireframe[6].x, wireframe[6].y);
+  osd.cmdStrokeLineToPoint(wireframe[7].x, wireframe[7].y);
+  osd.cmdStrokeLineToPoint(wireframe[4].x, wireframe[4].y);
 
-  osd.cmdMoveToPoint(wireframe[0][0], wireframe[0][1]);
-  osd.cmdStrokeLineToPoint(wireframe[4][0], wireframe[4][1]);
-  osd.cmdMoveToPoint(wireframe[1][0], wireframe[1][1]);
-  osd.cmdStrokeLineToPoint(wireframe[5][0], wireframe[5][1]);
-  osd.cmdMoveToPoint(wireframe[2][0], wireframe[2][1]);
-  osd.cmdStrokeLineToPoint(wireframe[6][0], wireframe[6][1]);
-  osd.cmdMoveToPoint(wireframe[3][0], wireframe[3][1]);
-  osd.cmdStrokeLineToPoint(wireframe[7][0], wireframe[7][1]);
+  osd.cmdMoveToPoint(wireframe[0].x, wireframe[0].y);
+  osd.cmdStrokeLineToPoint(wireframe[4].x, wireframe[4].y);
+  osd.cmdMoveToPoint(wireframe[1].x, wireframe[1].y);
+  osd.cmdStrokeLineToPoint(wireframe[5].x, wireframe[5].y);
+  osd.cmdMoveToPoint(wireframe[2].x, wireframe[2].y);
+  osd.cmdStrokeLineToPoint(wireframe[6].x, wireframe[6].y);
+  osd.cmdMoveToPoint(wireframe[3].x, wireframe[3].y);
+  osd.cmdStrokeLineToPoint(wireframe[7].x, wireframe[7].y);
   osd.cmdTransactionCommit();
 }
 
@@ -83,21 +83,18 @@ void loop(void)
 {
   for (uint16_t angle = 0; angle <= 360; angle = angle + 2)
   {
+    // Rotate about the Y, X and Z axes in fixed point, the sine and cosine come from a table instead of the (slow without an FPU) sin and cos functions
+    FrSkyPixelOsdGeometry::osd_mat3_t rotation;
+    uint16_t turn = FrSkyPixelOsdGeometry::degToAngle(angle);
+    FrSkyPixelOsdGeometry::mat3Identity(&rotation);
+    FrSkyPixelOsdGeometry::mat3RotateY(&rotation, turn);
+    FrSkyPixelOsdGeometry::mat3RotateX(&rotation, turn);
+    FrSkyPixelOsdGeometry::mat3RotateZ(&rotation, turn);
     for (uint8_t i = 0; i < 8; i++)
     {
-      rot = angle * 0.0174532;
-      rotz = cubeVertex[i][2] * cos(rot) - cubeVertex[i][0] * sin(rot);
-      rotx = cubeVertex[i][2] * sin(rot) + cubeVertex[i][0] * cos(rot);
-      roty = cubeVertex[i][1];
-      rotyy = roty * cos(rot) - rotz * sin(rot);
-      rotxx = rotx;
-      rotxxx = rotxx * cos(rot) - rotyy * sin(rot);
-      rotyyy = rotxx * sin(rot) + rotyy * cos(rot);
-      rotxxx = rotxxx + originx;
-      rotyyy = rotyyy + originy;
-      wireframe[i][0] = rotxxx;
-      wireframe[i][1] = rotyyy;
+      FrSkyPixelOsdGeometry::osd_vec3_t rotated = FrSkyPixelOsdGeometry::mat3Apply(&rotation, &cubeVertex[i]);
+      wireframe[i] = FrSkyPixelOsdGeometry::projectOrthographic(&rotated, originx, originy);
     }
     drawWireframe();
   }
-}
\ No newline at end of file
+}
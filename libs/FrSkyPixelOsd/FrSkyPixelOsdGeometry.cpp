@@ -0,0 +1,138 @@
+/*
+  Fixed point geometry helpers for the FrSky PixelOSD library
+  Integer only (Q15 sine/cosine table, 3x3 rotation matrices, projection), meant for boards without an FPU
+*/
+
+#include "FrSkyPixelOsdGeometry.h"
+
+// Quarter wave of sine in Q15, 64 steps per quarter turn, the remaining 8 bits of the angle are interpolated (error up to 4 LSB)
+static const int16_t sinTableQ15[65] PROGMEM =
+{
+  0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+  6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+  12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+  23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+  27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+  32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+  32767
+};
+
+uint16_t FrSkyPixelOsdGeometry::degToAngle(int16_t deg)
+{
+  // 65536 / 360 = 182.044, as 46603 / 256 to stay clear of a 32 bit division
+  return (uint16_t)(((int32_t)deg * 46603 + 128) >> 8);
+}
+
+int16_t FrSkyPixelOsdGeometry::sinQ15(uint16_t angle)
+{
+  uint16_t position = angle & 0x3FFF;           // Position within the quarter
+  if(angle & 0x4000) position = 0x4000 - position; // Second and fourth quarter run the table backwards
+  uint8_t index = position >> 8;
+  uint8_t fraction = position & 0xFF;
+  int16_t value = (int16_t)pgm_read_word(&sinTableQ15[index]);
+  if(fraction > 0)
+  {
+    int16_t next = (int16_t)pgm_read_word(&sinTableQ15[index + 1]);
+    value += (int16_t)(((int32_t)(next - value) * fraction) >> 8);
+  }
+  return (angle & 0x8000) ? -value : value;     // Second half of the turn is negative
+}
+
+int16_t FrSkyPixelOsdGeometry::cosQ15(uint16_t angle)
+{
+  return sinQ15(angle + 0x4000);
+}
+
+int16_t FrSkyPixelOsdGeometry::mulQ15(int16_t a, int16_t b)
+{
+  return (int16_t)(((int32_t)a * b + 0x4000) >> 15);
+}
+
+FrSkyPixelOsdGeometry::osd_vec2_t FrSkyPixelOsdGeometry::rotate2D(const FrSkyPixelOsdGeometry::osd_vec2_t *v, uint16_t angle)
+{
+  int32_t s = sinQ15(angle);
+  int32_t c = cosQ15(angle);
+  FrSkyPixelOsdGeometry::osd_vec2_t result = { .x = (int16_t)((v->x * c - v->y * s + 0x4000) >> 15),
+                                               .y = (int16_t)((v->x * s + v->y * c + 0x4000) >> 15) };
+  return result;
+}
+
+void FrSkyPixelOsdGeometry::mat3Identity(FrSkyPixelOsdGeometry::osd_mat3_t *m)
+{
+  for(uint8_t row = 0; row < 3; row++)
+  {
+    for(uint8_t column = 0; column < 3; column++) m->m[row][column] = (row == column) ? OSD_GEOMETRY_Q15_ONE : 0;
+  }
+}
+
+void FrSkyPixelOsdGeometry::mat3Multiply(FrSkyPixelOsdGeometry::osd_mat3_t *m, const FrSkyPixelOsdGeometry::osd_mat3_t *a)
+{
+  FrSkyPixelOsdGeometry::osd_mat3_t result;
+  for(uint8_t row = 0; row < 3; row++)
+  {
+    for(uint8_t column = 0; column < 3; column++)
+    {
+      // Rows and columns of a rotation have unit length, so the sum stays within 2^30
+      int32_t sum = (int32_t)a->m[row][0] * m->m[0][column] + (int32_t)a->m[row][1] * m->m[1][column] + (int32_t)a->m[row][2] * m->m[2][column];
+      result.m[row][column] = (int16_t)((sum + 0x4000) >> 15);
+    }
+  }
+  *m = result;
+}
+
+void FrSkyPixelOsdGeometry::mat3RotateRows(FrSkyPixelOsdGeometry::osd_mat3_t *m, uint8_t first, uint8_t second, uint16_t angle)
+{
+  // A rotation about one axis only mixes two rows, 12 multiplications instead of the 27 of a full product
+  int32_t s = sinQ15(angle);
+  int32_t c = cosQ15(angle);
+  for(uint8_t column = 0; column < 3; column++)
+  {
+    int32_t a = m->m[first][column];
+    int32_t b = m->m[second][column];
+    m->m[first][column] = (int16_t)((c * a - s * b + 0x4000) >> 15);
+    m->m[second][column] = (int16_t)((s * a + c * b + 0x4000) >> 15);
+  }
+}
+
+void FrSkyPixelOsdGeometry::mat3RotateX(FrSkyPixelOsdGeometry::osd_mat3_t *m, uint16_t angle)
+{
+  mat3RotateRows(m, 1, 2, angle);
+}
+
+void FrSkyPixelOsdGeometry::mat3RotateY(FrSkyPixelOsdGeometry::osd_mat3_t *m, uint16_t angle)
+{
+  mat3RotateRows(m, 2, 0, angle);
+}
+
+void FrSkyPixelOsdGeometry::mat3RotateZ(FrSkyPixelOsdGeometry::osd_mat3_t *m, uint16_t angle)
+{
+  mat3RotateRows(m, 0, 1, angle);
+}
+
+FrSkyPixelOsdGeometry::osd_vec3_t FrSkyPixelOsdGeometry::mat3Apply(const FrSkyPixelOsdGeometry::osd_mat3_t *m, const FrSkyPixelOsdGeometry::osd_vec3_t *v)
+{
+  int16_t in[3] = { v->x, v->y, v->z };
+  int16_t out[3];
+  for(uint8_t row = 0; row < 3; row++)
+  {
+    int32_t sum = (int32_t)m->m[row][0] * in[0] + (int32_t)m->m[row][1] * in[1] + (int32_t)m->m[row][2] * in[2];
+    out[row] = (int16_t)((sum + 0x4000) >> 15);
+  }
+  FrSkyPixelOsdGeometry::osd_vec3_t result = { .x = out[0], .y = out[1], .z = out[2] };
+  return result;
+}
+
+FrSkyPixelOsdGeometry::osd_vec2_t FrSkyPixelOsdGeometry::projectOrthographic(const FrSkyPixelOsdGeometry::osd_vec3_t *v, int16_t cx, int16_t cy)
+{
+  FrSkyPixelOsdGeometry::osd_vec2_t result = { .x = (int16_t)(v->x + cx), .y = (int16_t)(v->y + cy) };
+  return result;
+}
+
+FrSkyPixelOsdGeometry::osd_vec2_t FrSkyPixelOsdGeometry::projectPerspective(const FrSkyPixelOsdGeometry::osd_vec3_t *v, int16_t focal, int16_t distance, int16_t cx, int16_t cy)
+{
+  int32_t depth = (int32_t)v->z + distance;
+  FrSkyPixelOsdGeometry::osd_vec2_t result = { .x = (int16_t)(cx + (int32_t)v->x * focal / depth), .y = (int16_t)(cy + (int32_t)v->y * focal / depth) };
+  return result;
+}
@@ -0,0 +1,54 @@
+/*
+  Fixed point geometry helpers for the FrSky PixelOSD library
+  Integer only (Q15 sine/cosine table, 3x3 rotation matrices, projection), meant for boards without an FPU
+*/
+
+#ifndef __FRSKY_PIXEL_OSD_GEOMETRY__
+#define __FRSKY_PIXEL_OSD_GEOMETRY__
+
+#include "Arduino.h"
+
+// Do not modify the #defines below
+#define OSD_GEOMETRY_Q15_ONE 32767 // 1.0 in Q15 (rounded down, 1.0 itself does not fit an int16_t)
+#define OSD_GEOMETRY_FULL_TURN 65536UL // Angles are unsigned 16 bit fractions of a turn, the same unit as cmdCtmU16Rotate
+
+class FrSkyPixelOsdGeometry
+{
+  public:
+    typedef struct
+    {
+      int16_t x;
+      int16_t y;
+    } osd_vec2_t;
+
+    typedef struct
+    {
+      int16_t x;
+      int16_t y;
+      int16_t z;
+    } osd_vec3_t;
+
+    typedef struct
+    {
+      int16_t m[3][3]; // Q15, m[row][column]
+    } osd_mat3_t;
+
+    static uint16_t degToAngle(int16_t deg);
+    static int16_t sinQ15(uint16_t angle);
+    static int16_t cosQ15(uint16_t angle);
+    static int16_t mulQ15(int16_t a, int16_t b);
+    static osd_vec2_t rotate2D(const osd_vec2_t *v, uint16_t angle);
+    static void mat3Identity(osd_mat3_t *m);
+    static void mat3Multiply(osd_mat3_t *m, const osd_mat3_t *a); // m = a * m, both have to be rotations (unit length rows and columns)
+    static void mat3RotateX(osd_mat3_t *m, uint16_t angle); // m = Rx(angle) * m
+    static void mat3RotateY(osd_mat3_t *m, uint16_t angle); // m = Ry(angle) * m
+    static void mat3RotateZ(osd_mat3_t *m, uint16_t angle); // m = Rz(angle) * m
+    static osd_vec3_t mat3Apply(const osd_mat3_t *m, const osd_vec3_t *v); // v should be shorter than 32767
+    static osd_vec2_t projectOrthographic(const osd_vec3_t *v, int16_t cx, int16_t cy);
+    static osd_vec2_t projectPerspective(const osd_vec3_t *v, int16_t focal, int16_t distance, int16_t cx, int16_t cy); // z + distance has to stay positive
+
+  private:
+    static void mat3RotateRows(osd_mat3_t *m, uint8_t first, uint8_t second, uint16_t angle);
+};
+
+#endif // __FRSKY_PIXEL_OSD_GEOMETRY__
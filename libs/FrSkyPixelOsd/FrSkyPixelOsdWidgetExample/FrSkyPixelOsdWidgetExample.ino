@@ -42,11 +42,14 @@ void setup()
     while(1);
   }
   
+  // Send the sidebar and graph configs back to back and collect their responses at the end
+  osd.widgetConfigBatchBegin();
   // Configure sidebar widgets
   osd.cmdWidgetSetConfigSidebar(10, 50, 75, 150, FrSkyPixelOsd::WIDGET_SIDEBAR_OPTION_LEFT, 10, 10, 1, 'P', 10, 'P', FrSkyPixelOsd::WIDGET_ID_SIDEBAR_0);
   osd.cmdWidgetSetConfigSidebar(275, 50, 75, 150, FrSkyPixelOsd::WIDGET_SIDEBAR_OPTION_REVERSE | FrSkyPixelOsd::WIDGET_SIDEBAR_OPTION_UNLABELED, 5, 10, 1, 'R', 0, 'R', FrSkyPixelOsd::WIDGET_ID_SIDEBAR_1);
   // Configure graph widget
   osd.cmdWidgetSetConfigGraph(4, 52, 172, 144, FrSkyPixelOsd::WIDGET_GRAPH_OPTION_NONE, 3, 4, 2, 1, 'S', 10, 'S', FrSkyPixelOsd::WIDGET_ID_GRAPH_0);
+  osd.widgetConfigBatchEnd();
   // Configure char gauge widget
   // Assumes the character #150 has the necessary metadata (rect, offset and color) defined, otherwise the gauge will not work and error will be printer.
   // Use one of the iNav fonts, e.g. Vision (you can dowlnoad them with the FrSkyOSDApp)
@@ -29,12 +29,12 @@ while True:
         values = [remote_input[i] for i in range(2, remote_input.maxlen)]
 
         # convert values from pairs of integers into floats from 0 to 1
-        for channel in range(0, len(values)/2):
+        for channel in range(0, len(values)//2):
             channel_nums = channel*2
             value = values[channel_nums] + values[channel_nums + 1]
             adjusted_value = value - pulse_low
             normalized_value = adjusted_value / 1024
-            channels[channel] = min(1, max(0, normalized_value))
+            channels[channel] = min(1.0, max(0.0, normalized_value))
             s_out.append(f'{channels[channel]:4.2}')
         #print(' '.join(s_out), end=' ')
         if channels[2] < 0.33:
@@ -0,0 +1,308 @@
+// Accuracy of the AttitudeEstimator on synthetic motion profiles with a known attitude, and its
+// per-update cost.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/attitude_sim/attitude_sim.cpp AttitudeEstimator.cpp
+//            SpeedEstimator.cpp -o attitude_sim
+// Run:     ./attitude_sim [--gyro-noise DPS] [--gyro-bias DPS] [--accel-noise G] [--seed N] [--updates N]
+//
+// Each profile gives the true roll, pitch and yaw over time and the acceleration of the car in
+// the world frame. The true attitude is integrated in double precision, the gyro reads the body
+// rates between two samples with white noise of --gyro-noise and an X/Y bias of --gyro-bias
+// deg/s (Z is left to GyroCalibration), the accelerometer the specific force in g with white
+// noise of --accel-noise. Both are sampled at the IMU rate and fed to update() as the sketch
+// does, with the speed of a SpeedEstimator predicting on the accelerometer along the car and
+// corrected by the true speed every VESC_VALUES_INTERVAL ms, VESC_REPLY_US late. The estimator starts level, the errors are taken from SETTLE_SECONDS on: RMS and max
+// of roll and pitch, and the yaw error at the end, which only the gyro noise moves. "settle" is
+// when roll and pitch last came within SETTLE_DEG of the truth. The update cost is the mean
+// over --updates calls, in nanoseconds and, on x86, TSC cycles.
+//
+// corner and stop-go accelerate the car for as long as they run, the estimator has to take
+// that acceleration out to find gravity. Either going over TILT_RMS_LIMIT, TILT_MAX_LIMIT or
+// YAW_LIMIT fails the run with exit code 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "AttitudeEstimator.h"
+#include "SpeedEstimator.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define GYRO_SAMPLE_RATE 416.0
+#define VESC_VALUES_INTERVAL 10
+#define SPEED_ACCEL_NOISE 0.5
+#define SPEED_BIAS_DRIFT 0.5
+#define SPEED_ERPM_NOISE 0.05
+#define SPEED_STALE_MS 50
+
+#define GRAVITY 9.80665
+#define SETTLE_SECONDS 3.0
+#define SETTLE_DEG 1.0
+#define DEG (M_PI / 180.0)
+#define TILT_RMS_LIMIT 1.0 // deg, corner and stop-go
+#define TILT_MAX_LIMIT 4.0
+#define YAW_LIMIT 2.0
+#define VESC_REPLY_US 3000 // from the VESC reading the ERPM to the reply reaching the sketch
+
+struct Motion {
+  double roll, pitch, yaw; // rad, yaw about z up, then pitch, then roll
+  double ax, ay, az; // m/s^2 in the world frame, gravity not included
+  double speed; // m/s along the car, what the wheels turn at
+};
+
+typedef Motion (*profile_t)(double t);
+
+struct Profile {
+  const char *name;
+  profile_t motion;
+  double seconds;
+  bool limited; // held to the TILT and YAW limits
+};
+
+// parked across a slope, the estimator has to find 12 degrees of roll and 8 of pitch
+static Motion slope(double t) {
+  (void)t;
+  Motion m = {12 * DEG, -8 * DEG, 0, 0, 0, 0, 0};
+  return m;
+}
+
+// the car rocked nose up and down by 20 degrees at 0.5 Hz
+static Motion pitchSweep(double t) {
+  Motion m = {0, 20 * DEG * sin(M_PI * t), 0, 0, 0, 0, 0};
+  return m;
+}
+
+// and side to side while it spins at 180 deg/s
+static Motion rollSpin(double t) {
+  Motion m = {15 * DEG * sin(2 * M_PI * 0.7 * t), 0, 180 * DEG * t, 0, 0, 0, 0};
+  return m;
+}
+
+// 3 m/s around a 2 m circle, leaning 3 degrees out of the turn. The centripetal acceleration
+// of 0.46 g looks like tilt to the accelerometer
+static Motion cornering(double t) {
+  double speed = 3.0, radius = 2.0;
+  double heading = speed / radius * t;
+  double centripetal = speed * speed / radius;
+  Motion m = {-3 * DEG, 0, heading, -centripetal * sin(heading), centripetal * cos(heading), 0, speed};
+  return m;
+}
+
+// launching and braking at 5 m/s^2 every 2 s, up to 10 m/s and back, pitching 2 degrees with it
+static Motion stopGo(double t) {
+  double phase = fmod(t, 4.0);
+  double accel = phase < 2.0 ? 5.0 : -5.0;
+  double speed = phase < 2.0 ? 5.0 * phase : 10.0 - 5.0 * (phase - 2.0);
+  Motion m = {0, -accel / 5.0 * 2 * DEG, 0, accel, 0, 0, speed};
+  return m;
+}
+
+// rough ground: roll and pitch shaken by a few degrees at 3 to 9 Hz, bumps of 0.5 g up and down
+static Motion rough(double t) {
+  Motion m = {3 * DEG * sin(2 * M_PI * 3.1 * t) + 1.5 * DEG * sin(2 * M_PI * 8.7 * t), 2.5 * DEG * sin(2 * M_PI * 4.3 * t + 1.0),
+              30 * DEG * sin(0.4 * t), 0, 0, 0.5 * GRAVITY * sin(2 * M_PI * 6.0 * t), 0};
+  return m;
+}
+
+static const Profile PROFILES[] = {
+  {"slope", slope, 10, false},
+  {"pitch", pitchSweep, 20, false},
+  {"roll+spin", rollSpin, 20, false},
+  {"corner", cornering, 20, true},
+  {"stop-go", stopGo, 20, true},
+  {"rough", rough, 20, false},
+};
+
+struct Quaternion {
+  double w, x, y, z;
+};
+
+static Quaternion multiply(const Quaternion &a, const Quaternion &b) {
+  Quaternion q = {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z, a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                  a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x, a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+  return q;
+}
+
+static Quaternion fromEuler(double roll, double pitch, double yaw) {
+  Quaternion qz = {cos(yaw / 2), 0, 0, sin(yaw / 2)};
+  Quaternion qy = {cos(pitch / 2), 0, sin(pitch / 2), 0};
+  Quaternion qx = {cos(roll / 2), sin(roll / 2), 0, 0};
+  return multiply(multiply(qz, qy), qx);
+}
+
+// world vector into the body frame
+static void toBody(const Quaternion &q, double x, double y, double z, double *out) {
+  Quaternion v = {0, x, y, z};
+  Quaternion conjugate = {q.w, -q.x, -q.y, -q.z};
+  Quaternion r = multiply(multiply(conjugate, v), q);
+  out[0] = r.x;
+  out[1] = r.y;
+  out[2] = r.z;
+}
+
+// body rates (rad/s) that turn a into b over dt
+static void bodyRates(const Quaternion &a, const Quaternion &b, double dt, double *rates) {
+  Quaternion conjugate = {a.w, -a.x, -a.y, -a.z};
+  Quaternion d = multiply(conjugate, b);
+  if (d.w < 0) {
+    d.w = -d.w;
+    d.x = -d.x;
+    d.y = -d.y;
+    d.z = -d.z;
+  }
+  double s = sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+  double angle = 2 * atan2(s, d.w);
+  double scale = s > 1e-12 ? angle / s / dt : 2 / dt;
+  rates[0] = d.x * scale;
+  rates[1] = d.y * scale;
+  rates[2] = d.z * scale;
+}
+
+static double wrapDegrees(double angle) {
+  return remainder(angle, 360.0);
+}
+
+struct Accuracy {
+  double rms; // roll and pitch, deg
+  double max;
+  double yaw; // deg at the end
+  double settle; // s
+};
+
+static Accuracy simulate(const Profile &profile, double gyro_noise, double gyro_bias, double accel_noise, std::mt19937 &rng) {
+  AttitudeEstimator estimator;
+  SpeedEstimator speed_estimator(SPEED_ACCEL_NOISE, SPEED_BIAS_DRIFT, SPEED_ERPM_NOISE, SPEED_STALE_MS * 1000);
+  std::normal_distribution<double> gyro_error(0, gyro_noise);
+  std::normal_distribution<double> accel_error(0, accel_noise);
+  double dt = 1.0 / GYRO_SAMPLE_RATE;
+  double squared = 0, max = 0, settle = 0;
+  long count = 0;
+  Accuracy accuracy = {};
+  Motion previous = profile.motion(0);
+  Quaternion previous_q = fromEuler(previous.roll, previous.pitch, previous.yaw);
+  speed_estimator.reset((float)previous.speed);
+  double next_request = 0, reply_time = -1, sampled_speed = 0;
+  uint32_t sampled_us = 0;
+  for (long i = 1; i * dt <= profile.seconds; i++) {
+    double t = i * dt;
+    Motion m = profile.motion(t);
+    Quaternion q = fromEuler(m.roll, m.pitch, m.yaw);
+    double rates[3], accel[3];
+    bodyRates(previous_q, q, dt, rates);
+    toBody(q, m.ax / GRAVITY, m.ay / GRAVITY, m.az / GRAVITY + 1.0, accel);
+    previous_q = q;
+    for (int axis = 0; axis < 3; axis++) {
+      accel[axis] += accel_error(rng);
+    }
+
+    // the sketch's speed path: the accelerometer along the car predicts, the VESC replies correct
+    uint32_t now_us = (uint32_t)(t * 1e6);
+    if (t >= next_request) {
+      next_request += VESC_VALUES_INTERVAL / 1000.0;
+      sampled_speed = m.speed;
+      sampled_us = now_us;
+      reply_time = t + VESC_REPLY_US * 1e-6;
+    }
+    speed_estimator.predict((float)(accel[0] * GRAVITY), now_us);
+    if (reply_time >= 0 && t >= reply_time) {
+      speed_estimator.correct((float)sampled_speed, sampled_us);
+      reply_time = -1;
+    }
+    estimator.setSpeed(speed_estimator.getSpeed());
+    estimator.update((float)(rates[0] / DEG + gyro_bias + gyro_error(rng)), (float)(rates[1] / DEG - gyro_bias + gyro_error(rng)),
+                     (float)(rates[2] / DEG + gyro_error(rng)), (float)accel[0], (float)accel[1], (float)accel[2], (float)dt);
+
+    double roll_error = wrapDegrees(estimator.getRoll() - m.roll / DEG);
+    double pitch_error = wrapDegrees(estimator.getPitch() - m.pitch / DEG);
+    double error = fmax(fabs(roll_error), fabs(pitch_error));
+    if (error > SETTLE_DEG) {
+      settle = t;
+    }
+    if (t >= SETTLE_SECONDS) {
+      squared += roll_error * roll_error + pitch_error * pitch_error;
+      count += 2;
+      max = fmax(max, error);
+    }
+    accuracy.yaw = wrapDegrees(estimator.getYaw() - m.yaw / DEG);
+  }
+  accuracy.rms = sqrt(squared / count);
+  accuracy.max = max;
+  accuracy.settle = settle;
+  return accuracy;
+}
+
+struct UpdateCost {
+  double ns;
+  double cycles; // 0 without a TSC
+};
+
+// One batch of updates between two clock reads, gently rocking so the correction always runs
+static UpdateCost updateCost(long updates) {
+  AttitudeEstimator estimator;
+  float dt = (float)(1.0 / GYRO_SAMPLE_RATE);
+  volatile float sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  #ifdef HAVE_TSC
+  uint64_t tsc_start = __rdtsc();
+  #endif
+  for (long i = 0; i < updates; i++) {
+    float wobble = 0.01f * (float)((i & 63) - 32);
+    estimator.update(wobble, -wobble, 0.5f, 0.02f * wobble, -0.01f, 1.0f, dt);
+  }
+  UpdateCost cost = {};
+  #ifdef HAVE_TSC
+  cost.cycles = (double)(__rdtsc() - tsc_start) / updates;
+  #endif
+  cost.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / updates;
+  float w, x, y, z;
+  estimator.getQuaternion(&w, &x, &y, &z);
+  sink = w;
+  (void)sink;
+  return cost;
+}
+
+int main(int argc, char **argv) {
+  double gyro_noise = 0.1, gyro_bias = 0.5, accel_noise = 0.01;
+  uint32_t seed = 1;
+  long updates = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--gyro-noise") && i + 1 < argc) {
+      gyro_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--gyro-bias") && i + 1 < argc) {
+      gyro_bias = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--accel-noise") && i + 1 < argc) {
+      accel_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--updates") && i + 1 < argc) {
+      updates = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--gyro-noise DPS] [--gyro-bias DPS] [--accel-noise G] [--seed N] [--updates N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  printf("%-10s %8s %8s %8s %8s\n", "profile", "rms", "max", "yaw", "settle s");
+  int failed = 0;
+  for (const Profile &profile : PROFILES) {
+    Accuracy accuracy = simulate(profile, gyro_noise, gyro_bias, accel_noise, rng);
+    bool over = profile.limited && (accuracy.rms > TILT_RMS_LIMIT || accuracy.max > TILT_MAX_LIMIT || fabs(accuracy.yaw) > YAW_LIMIT);
+    printf("%-10s %8.2f %8.2f %8.2f %8.2f%s\n", profile.name, accuracy.rms, accuracy.max, accuracy.yaw, accuracy.settle, over ? "  FAILED" : "");
+    failed += over;
+  }
+  printf("roll and pitch errors in degrees from %.0f s on, yaw error at the end\n", SETTLE_SECONDS);
+  printf("corner and stop-go limits %.1f rms, %.1f max, %.1f yaw, %d failed\n\n", TILT_RMS_LIMIT, TILT_MAX_LIMIT, YAW_LIMIT, failed);
+
+  UpdateCost cost = updateCost(updates);
+  printf("%8s %8s %8s\n", "update", "ns", "cycles");
+  printf("%8s %8.1f %8.1f\n", "update", cost.ns, cost.cycles);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+// The AUTOTUNE drive mode on the VehicleModel car: TurnRateAutotune relay tuning of every
+// bucket of the turn rate gain schedule, then the TURN_ASSIST step response with the tuned
+// gains against the hand tuned schedule.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. -I../../tools/common
+//            ../../tools/autotune_sim/autotune_sim.cpp TurnRateAutotune.cpp SteeringFeedForward.cpp -o autotune_sim
+// Run:     ./autotune_sim [--max-speed KMH] [--noise DPS] [--seed N]
+//
+// The tuner steps with the PID at 50 Hz on the gyro's yaw rate through the firmware low-pass,
+// with white noise of --noise deg/s added to the gyro. The VESC holds the speed the tuner asks
+// for with a first order lag. The step response is TURN_ASSIST as the sketch runs it: the
+// feed-forward plus AutoPID as loop() runs it, see TurnRatePid.h. Each car is tuned from scratch: the nominal one, one with a 15%
+// longer wheelbase and 10% less lock, and one with a servo twice as slow. Exits 1 if a bucket
+// the car can reach did not converge.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <random>
+
+#include "BiquadFilter.h"
+#include "DriveControl.h"
+#include "SteeringFeedForward.h"
+#include "TurnRateAutotune.h"
+#include "TurnRatePid.h"
+#include "VehicleModel.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define WHEELBASE 0.26f
+#define MAX_STEERING_ANGLE_DEG 25.0f
+#define MAX_SPEED_KMH 10.0f
+#define PID_I_TERM (1.0f / 32.0f)
+#define PID_D_TERM (1.0f / 64.0f)
+#define PID_RATE_HZ 50
+#define PID_INTEGRAL_BAND 20.0f
+#define FEED_FORWARD_GAIN 1.0f
+#define GYRO_SAMPLE_RATE 416.0f
+#define GYRO_LOWPASS_HZ 40.0f
+#define AUTOTUNE_RELAY 0.3f
+#define AUTOTUNE_HYSTERESIS 3.0f
+#define AUTOTUNE_YAW_RATE 0.0f
+#define AUTOTUNE_CYCLES 4
+#define AUTOTUNE_SETTLE 1.0f
+#define AUTOTUNE_TIMEOUT 15.0f
+#define AUTOTUNE_MIN_SPEED_KMH 3.0f
+static const float PID_CONFIG_SPEED[] = {0.0f, 5.0f, 15.0f};
+static const float PID_CONFIG_VALUE[] = {1.0f / 512.0f, 1.0f / 512.0f, 1.0f / 20480.0f};
+#define BUCKETS (sizeof(PID_CONFIG_SPEED) / sizeof(float))
+
+#define SIM_RATE_HZ 5000
+#define SPEED_TAU 0.3f // s, VESC speed loop
+#define TUNE_SECONDS_MAX 120.0f
+#define STEP_SECONDS 3.0f
+#define STEP_YAW_RATE 90.0f // deg/s, reduced where the car can't reach it
+#define SETTLE_BAND 0.05f
+
+struct Gains {
+  float kp[BUCKETS], ki[BUCKETS], kd[BUCKETS];
+};
+
+struct StepResult {
+  float target;
+  float overshoot; // percent of target
+  float settle_ms; // last entry into the +-5% band
+};
+
+struct Car {
+  const char *name;
+  float wheelbase_scale;
+  float lock_scale;
+  float servo_tau_scale;
+};
+
+static const Car CARS[] = {
+  {"nominal", 1.0f, 1.0f, 1.0f},
+  {"mismatch", 1.15f, 0.9f, 1.0f},
+  {"slow servo", 1.0f, 1.0f, 2.0f},
+};
+
+static VehicleParams carParams(const Car &car) {
+  VehicleParams params;
+  params.wheelbase *= car.wheelbase_scale;
+  params.max_wheel_angle_deg *= car.lock_scale;
+  params.servo_tau *= car.servo_tau_scale;
+  return params;
+}
+
+static int bucketForSpeed(float speed_kmh) {
+  int i = 0;
+  while (i < (int)BUCKETS - 1 && PID_CONFIG_SPEED[i + 1] <= speed_kmh) {
+    i++;
+  }
+  return i;
+}
+
+// Drives the whole AUTOTUNE sequence, returns the seconds it took
+static float tune(const Car &car, TurnRateAutotune &autotune, float max_speed, float noise, std::mt19937 &rng) {
+  VehicleModel model(carParams(car));
+  SteeringFeedForward feed_forward(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+  FilterChain<float, 1> lowpass;
+  lowpass.setStage(0, biquadLowpass(GYRO_LOWPASS_HZ, GYRO_SAMPLE_RATE));
+  std::normal_distribution<float> gyro_noise(0, noise);
+  autotune.begin(PID_CONFIG_SPEED, BUCKETS, AUTOTUNE_MIN_SPEED_KMH, max_speed);
+
+  float dt = 1.0f / SIM_RATE_HZ;
+  float speed_kmh = 0, command = 0, yaw_rate = 0, yaw_v = 0, next_sample = 0, next_step = 0;
+  float t = 0;
+  for (; t < TUNE_SECONDS_MAX && autotune.getState() != AutotuneState::DONE; t += dt) {
+    if (t >= next_sample) {
+      next_sample += 1.0f / GYRO_SAMPLE_RATE;
+      yaw_v = lowpass.process(yaw_rate + gyro_noise(rng));
+    }
+    if (t >= next_step) {
+      next_step += 1.0f / PID_RATE_HZ;
+      float relay = autotune.update(yaw_v, AUTOTUNE_YAW_RATE, speed_kmh, 1.0f / PID_RATE_HZ);
+      command = clampCommand(feed_forward.command(AUTOTUNE_YAW_RATE, speed_kmh / 3.6f) + relay);
+    }
+    speed_kmh += (autotune.getSpeed() - speed_kmh) * dt / SPEED_TAU;
+    yaw_rate = model.step(command, speed_kmh / 3.6f, dt);
+  }
+  return t;
+}
+
+// TURN_ASSIST, the PID as AutoPID runs it and the firmware's feed-forward
+static StepResult stepResponse(const Car &car, const Gains &gains, float speed_kmh) {
+  VehicleModel model(carParams(car));
+  SteeringFeedForward feed_forward(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+  float speed = speed_kmh / 3.6f;
+  float max_yaw_rate = speed / WHEELBASE * tanf(MAX_STEERING_ANGLE_DEG * 0.017453293f) * 57.29578f;
+  StepResult result = {};
+  result.target = fminf(STEP_YAW_RATE, 0.6f * max_yaw_rate);
+  int bucket = bucketForSpeed(speed_kmh);
+
+  float dt = 1.0f / SIM_RATE_HZ;
+  int pid_div = SIM_RATE_HZ / PID_RATE_HZ;
+  TurnRatePid pid(PID_RATE_HZ, PID_INTEGRAL_BAND);
+  float command = 0, peak = 0, settle = 0, yaw_rate = 0;
+  for (long i = 0; i < (long)(STEP_SECONDS * SIM_RATE_HZ); i++) {
+    float t = i * dt;
+    if (i % pid_div == 0) {
+      float pid_out = pid.step(result.target, yaw_rate, gains.kp[bucket], gains.ki[bucket], gains.kd[bucket], FEED_FORWARD_GAIN);
+      command = clampCommand(FEED_FORWARD_GAIN * feed_forward.command(result.target, speed) + pid_out);
+    }
+    yaw_rate = model.step(command, speed, dt);
+    peak = fmaxf(peak, yaw_rate);
+    if (fabsf(yaw_rate - result.target) > SETTLE_BAND * result.target) {
+      settle = t + dt;
+    }
+  }
+  result.overshoot = fmaxf(0, peak - result.target) / result.target * 100.0f;
+  result.settle_ms = settle < STEP_SECONDS ? settle * 1000.0f : NAN;
+  return result;
+}
+
+int main(int argc, char **argv) {
+  float max_speed = MAX_SPEED_KMH;
+  float noise = 1.0f;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--max-speed") && i + 1 < argc) {
+      max_speed = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--max-speed KMH] [--noise DPS] [--seed N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  Gains hand;
+  for (unsigned b = 0; b < BUCKETS; b++) {
+    hand.kp[b] = PID_CONFIG_VALUE[b];
+    hand.ki[b] = PID_I_TERM;
+    hand.kd[b] = PID_D_TERM;
+  }
+
+  bool failed = false;
+  std::mt19937 rng(seed);
+  for (const Car &car : CARS) {
+    TurnRateAutotune autotune(AUTOTUNE_RELAY, AUTOTUNE_HYSTERESIS, AUTOTUNE_CYCLES, AUTOTUNE_SETTLE, AUTOTUNE_TIMEOUT);
+    float seconds = tune(car, autotune, max_speed, noise, rng);
+    printf("%s car, max speed %.0f km/h, tuned in %.1f s\n", car.name, max_speed, seconds);
+    printf("%6s %6s %9s %7s %10s %9s %9s %7s %10s %8s %10s %8s\n", "bucket", "km/h", "Ku", "Tu s", "Kp", "Ki", "Kd", "relay s",
+           "hand os", "hand ms", "tuned os", "tuned ms");
+    Gains tuned = hand;
+    for (unsigned b = 0; b < BUCKETS; b++) {
+      const AutotuneResult &r = autotune.getResult(b);
+      if (r.speed_kmh == 0) {
+        printf("%6u %6s  above the max speed, left as it was\n", b + 1, "-");
+        continue;
+      }
+      if (!r.converged) {
+        printf("%6u %6.1f  did not converge\n", b + 1, r.speed_kmh);
+        failed = true;
+        continue;
+      }
+      tuned.kp[b] = r.kp;
+      tuned.ki[b] = r.ki;
+      tuned.kd[b] = r.kd;
+      StepResult before = stepResponse(car, hand, r.speed_kmh);
+      StepResult after = stepResponse(car, tuned, r.speed_kmh);
+      // nan means the response never settled within STEP_SECONDS
+      printf("%6u %6.1f %9.6f %7.3f %10.7f %9.6f %9.2f %7.1f %9.1f%% %8.0f %9.1f%% %8.0f\n", b + 1, r.speed_kmh, r.ultimate_gain,
+             r.ultimate_period, r.kp, r.ki, r.kd, r.seconds, before.overshoot, before.settle_ms, after.overshoot, after.settle_ms);
+    }
+    printf("\n");
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+// Frequency response of the yaw rate FilterChain, float and Q16.16, against the RBJ design, and
+// the cost per sample of each.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/biquad_bench/biquad_bench.cpp -o biquad_bench
+// Run:     ./biquad_bench [--notch HZ] [--amplitude DPS] [--samples N]
+//
+// The chains are the sketch's: GYRO_LOWPASS in stage 0 and the motor notch in stage 1, here at
+// --notch Hz. The design response is |H(e^jw)| of the RBJ cookbook sections with coefficients
+// computed in double precision with libm, the chains use the constexpr coefficients the sketch
+// compiles in. Each frequency is a sine of --amplitude deg/s run through a fresh chain, the gain
+// is taken by correlation over whole periods after the transient, so the Q16.16 rows include
+// the sample and coefficient rounding. The coefficient row is the largest difference between
+// the constexpr and the libm coefficients. The cost is the mean over --samples samples of a
+// two stage chain, with the one pole low-pass the biquads replaced as a reference, in
+// nanoseconds and, on x86, TSC cycles.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <complex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "BiquadFilter.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define GYRO_SAMPLE_RATE 416.0
+#define GYRO_LOWPASS_HZ 40.0
+#define GYRO_NOTCH_Q 3.0
+#define GYRO_LOWPASS_ALPHA 0.5f // the one pole filter before the biquads
+
+#define SETTLE_SECONDS 1.0
+#define MEASURE_SECONDS 2.0
+#define FLOOR_DB -80.0 // a notch reads as deep as the rounding lets it, both sides are cut here
+
+struct Design {
+  double b0, b1, b2, a1, a2;
+};
+
+static Design lowpassDesign(double cutoff, double q) {
+  double w = 2 * M_PI * cutoff / GYRO_SAMPLE_RATE, c = cos(w), alpha = sin(w) / (2 * q);
+  Design d = {(1 - c) / 2 / (1 + alpha), (1 - c) / (1 + alpha), (1 - c) / 2 / (1 + alpha), -2 * c / (1 + alpha), (1 - alpha) / (1 + alpha)};
+  return d;
+}
+
+static Design notchDesign(double center, double q) {
+  double w = 2 * M_PI * center / GYRO_SAMPLE_RATE, c = cos(w), alpha = sin(w) / (2 * q);
+  Design d = {1 / (1 + alpha), -2 * c / (1 + alpha), 1 / (1 + alpha), -2 * c / (1 + alpha), (1 - alpha) / (1 + alpha)};
+  return d;
+}
+
+static std::complex<double> response(const Design &d, double frequency) {
+  std::complex<double> z1 = std::polar(1.0, -2 * M_PI * frequency / GYRO_SAMPLE_RATE);
+  std::complex<double> z2 = z1 * z1;
+  return (d.b0 + d.b1 * z1 + d.b2 * z2) / (1.0 + d.a1 * z1 + d.a2 * z2);
+}
+
+static double toDb(double gain) {
+  return fmax(FLOOR_DB, 20 * log10(gain));
+}
+
+static double coefficientError(const BiquadCoefficients &c, const Design &d) {
+  double error = fabs(c.b0 - d.b0);
+  error = fmax(error, fabs(c.b1 - d.b1));
+  error = fmax(error, fabs(c.b2 - d.b2));
+  error = fmax(error, fabs(c.a1 - d.a1));
+  return fmax(error, fabs(c.a2 - d.a2));
+}
+
+// Gain of a sine through the chain, by correlation over whole periods after SETTLE_SECONDS
+template <typename T>
+static double measuredGain(FilterChain<T, 2> chain, double frequency, double amplitude, bool fixed) {
+  long settle = (long)(SETTLE_SECONDS * GYRO_SAMPLE_RATE);
+  double period = GYRO_SAMPLE_RATE / frequency;
+  long measure = (long)(floor(MEASURE_SECONDS * GYRO_SAMPLE_RATE / period) * period);
+  double in_phase = 0, quadrature = 0;
+  long n = 0;
+  for (long i = 0; i < settle + measure; i++) {
+    double phase = 2 * M_PI * frequency * i / GYRO_SAMPLE_RATE;
+    float x = (float)(amplitude * sin(phase));
+    double y;
+    if (fixed) {
+      y = biquadFromFixed((int32_t)chain.process((T)biquadToFixed(x)));
+    } else {
+      y = (double)chain.process((T)x);
+    }
+    if (i >= settle) {
+      in_phase += y * sin(phase);
+      quadrature += y * cos(phase);
+      n++;
+    }
+  }
+  return 2 * sqrt(in_phase * in_phase + quadrature * quadrature) / n / amplitude;
+}
+
+struct SampleCost {
+  double ns;
+  double cycles; // 0 without a TSC
+};
+
+template <typename F>
+static SampleCost batchCost(long samples, F step) {
+  auto start = std::chrono::steady_clock::now();
+  #ifdef HAVE_TSC
+  uint64_t tsc_start = __rdtsc();
+  #endif
+  for (long i = 0; i < samples; i++) {
+    step(i);
+  }
+  SampleCost cost = {};
+  #ifdef HAVE_TSC
+  cost.cycles = (double)(__rdtsc() - tsc_start) / samples;
+  #endif
+  cost.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples;
+  return cost;
+}
+
+int main(int argc, char **argv) {
+  double notch_hz = 80, amplitude = 100;
+  long samples = 10000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--notch") && i + 1 < argc) {
+      notch_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--amplitude") && i + 1 < argc) {
+      amplitude = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+      samples = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--notch HZ] [--amplitude DPS] [--samples N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  constexpr BiquadCoefficients lowpass = biquadLowpass(GYRO_LOWPASS_HZ, GYRO_SAMPLE_RATE);
+  BiquadCoefficients notch = biquadNotchRuntime((float)notch_hz, GYRO_SAMPLE_RATE, GYRO_NOTCH_Q);
+  Design lowpass_design = lowpassDesign(GYRO_LOWPASS_HZ, BIQUAD_Q_BUTTERWORTH);
+  Design notch_design = notchDesign(notch_hz, GYRO_NOTCH_Q);
+  FilterChain<float, 2> float_chain;
+  FilterChain<int32_t, 2> fixed_chain;
+  float_chain.setStage(0, lowpass);
+  float_chain.setStage(1, notch);
+  fixed_chain.setStage(0, lowpass);
+  fixed_chain.setStage(1, notch);
+
+  printf("low-pass %.0f Hz, notch %.0f Hz Q %.1f at %.0f Hz, %.0f deg/s sine\n", GYRO_LOWPASS_HZ, notch_hz, GYRO_NOTCH_Q, GYRO_SAMPLE_RATE, amplitude);
+  printf("%8s %10s %10s %10s %10s %10s\n", "Hz", "design dB", "float dB", "error", "q16 dB", "error");
+  const double frequencies[] = {1, 5, 10, 20, 30, 40, 50, 60, 70, 75, 80, 85, 90, 100, 120, 150, 180, 200};
+  double float_worst = 0, fixed_worst = 0;
+  for (double frequency : frequencies) {
+    double design = toDb(std::abs(response(lowpass_design, frequency) * response(notch_design, frequency)));
+    double float_db = toDb(measuredGain(float_chain, frequency, amplitude, false));
+    double fixed_db = toDb(measuredGain(fixed_chain, frequency, amplitude, true));
+    float_worst = fmax(float_worst, fabs(float_db - design));
+    fixed_worst = fmax(fixed_worst, fabs(fixed_db - design));
+    printf("%8.0f %10.2f %10.2f %10.3f %10.2f %10.3f\n", frequency, design, float_db, float_db - design, fixed_db, fixed_db - design);
+  }
+  printf("worst error %.3f dB float, %.3f dB Q16.16, gains floored at %.0f dB\n", float_worst, fixed_worst, FLOOR_DB);
+  printf("constexpr coefficients off libm by %.2g low-pass, %.2g notch\n\n", coefficientError(lowpass, lowpass_design),
+         coefficientError(biquadNotch((float)notch_hz, GYRO_SAMPLE_RATE, GYRO_NOTCH_Q), notch_design));
+
+  // the input changes every sample so nothing is hoisted out of the loops
+  volatile float float_sink = 0;
+  volatile int32_t fixed_sink = 0;
+  float one_pole = 0;
+  SampleCost legacy = batchCost(samples, [&](long i) {
+    one_pole = one_pole * (1 - GYRO_LOWPASS_ALPHA) + (float)((i & 255) - 128) * GYRO_LOWPASS_ALPHA;
+    float_sink = one_pole;
+  });
+  SampleCost float_cost = batchCost(samples, [&](long i) { float_sink = float_chain.process((float)((i & 255) - 128)); });
+  SampleCost fixed_cost = batchCost(samples, [&](long i) { fixed_sink = fixed_chain.process(biquadToFixed((float)((i & 255) - 128))); });
+  printf("%10s %8s %8s\n", "filter", "ns", "cycles");
+  printf("%10s %8.2f %8.1f\n", "one pole", legacy.ns, legacy.cycles);
+  printf("%10s %8.2f %8.1f\n", "float x2", float_cost.ns, float_cost.cycles);
+  printf("%10s %8.2f %8.1f\n", "q16 x2", fixed_cost.ns, fixed_cost.cycles);
+  (void)float_sink;
+  (void)fixed_sink;
+  return 0;
+}
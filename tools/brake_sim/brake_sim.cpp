@@ -0,0 +1,164 @@
+// Stopping distance of BrakeControl from full speed on surfaces of decreasing grip, with the
+// brake current modulated on wheel lock and with the plain brake curve.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/brake_sim/brake_sim.cpp BrakeControl.cpp -o brake_sim
+// Run:     ./brake_sim [--speed KMH] [--current A] [--accel-noise MPS2] [--seed N]
+//
+// The car rolls at --speed (MAX_SPEED_KMH by default) and the stick is pulled to full brake.
+// One wheel model stands for all four: the motor's brake torque through the gearing against
+// the tyre force, with the rotor inertia on the wheel. The tyre force follows the slip,
+// peaking around 15% and down to 70% of the peak on a locked wheel. The regenerative brake
+// fades below REGEN_FADE_SPEED, where the motor makes too little voltage to push the current.
+// BrakeControl steps at BRAKE_RATE_HZ on the ERPM of the last VESC reply and the latest
+// accelerometer sample, white noise of --accel-noise m/s^2 added. The distance and time run
+// until the car is below the standstill speed. Slip is the share of the time braking with the
+// wheel over BRAKE_SLIP_MAX behind the car.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <random>
+
+#include "BrakeControl.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define MAX_SPEED_KMH 10.0
+#define WHEEL_CIRCUMFERENCE 0.3676
+#define DRIVE_RATIO 10.83
+#define GYRO_SAMPLE_RATE 416.0
+#define VESC_VALUES_INTERVAL 10
+#define BRAKE_MAX_CURRENT 20.0
+#define BRAKE_EXPO 0.3
+#define BRAKE_RATE_HZ 100
+#define BRAKE_STANDSTILL_KMH 1.0
+#define BRAKE_SLIP_MAX 0.2
+#define BRAKE_DECEL_MARGIN 4.0
+#define BRAKE_RELEASE 0.85
+#define BRAKE_REAPPLY 100.0
+
+#define SIM_RATE_HZ 20000
+#define SIM_SECONDS_MAX 10.0
+#define GRAVITY 9.80665
+#define CAR_MASS 2.5 // kg
+#define MOTOR_KT 0.0032 // Nm/A, about 3000 KV
+#define WHEEL_INERTIA 6e-4 // kg m^2 at the wheel, mostly the rotor through the gearing
+#define REGEN_FADE_SPEED 0.3 // m/s of wheel speed below which the brake torque fades out
+#define TYRE_B 10.0 // slip stiffness and shape of sin(C atan(B slip))
+#define TYRE_C 1.6
+#define VESC_DELAY_US 2500 // from the ERPM sample to the reply reaching the sketch
+
+struct Surface {
+  const char *name;
+  float grip; // peak friction coefficient
+};
+
+static const Surface SURFACES[] = {
+  {"asphalt", 0.9f},
+  {"dirt", 0.5f},
+  {"wet", 0.3f},
+  {"ice", 0.12f},
+};
+
+struct Stop {
+  double distance; // m
+  double seconds;
+  double slipping; // share of the time braking
+  uint16_t locks;
+  bool stopped;
+};
+
+static Stop brake(const Surface &surface, bool modulation, double speed_kmh, double max_current, double accel_noise, std::mt19937 &rng) {
+  BrakeControl control(BRAKE_STANDSTILL_KMH / 3.6f, BRAKE_SLIP_MAX, BRAKE_DECEL_MARGIN, BRAKE_RELEASE, BRAKE_REAPPLY);
+  control.setCurve(max_current, BRAKE_EXPO);
+  control.setModulation(modulation);
+  std::normal_distribution<double> noise(0, accel_noise);
+  double radius = WHEEL_CIRCUMFERENCE / (2 * M_PI);
+  double speed = speed_kmh / 3.6, wheel = speed, accel = 0;
+  double dt = 1.0 / SIM_RATE_HZ;
+  double next_reply = 0, next_sample = 0, next_brake = 0;
+  double measured_wheel = speed, sampled_wheel = speed, sample_time = 0, measured_accel = 0;
+  bool reply_pending = false;
+  Stop stop = {};
+  long braking = 0, slipping = 0;
+  double t = 0;
+  for (; t < SIM_SECONDS_MAX; t += dt) {
+    // the VESC reads the ERPM when asked and the reply lands a few ms later
+    if (t >= next_reply) {
+      next_reply += VESC_VALUES_INTERVAL / 1000.0;
+      sampled_wheel = wheel;
+      sample_time = t;
+      reply_pending = true;
+    }
+    if (reply_pending && t >= sample_time + VESC_DELAY_US * 1e-6) {
+      measured_wheel = sampled_wheel;
+      reply_pending = false;
+    }
+    if (t >= next_sample) {
+      next_sample += 1.0 / GYRO_SAMPLE_RATE;
+      measured_accel = accel + noise(rng);
+    }
+    if (t >= next_brake) {
+      next_brake += 1.0 / BRAKE_RATE_HZ;
+      control.update(-1.0f, (float)measured_wheel, (float)measured_accel, 1.0f / BRAKE_RATE_HZ);
+      if (control.getState() != BrakeState::BRAKE) {
+        break;
+      }
+    }
+    if (speed <= BRAKE_STANDSTILL_KMH / 3.6) {
+      stop.stopped = true;
+      break;
+    }
+
+    double slip = speed > 0 ? (speed - wheel) / speed : 0;
+    double force = surface.grip * CAR_MASS * GRAVITY * sin(TYRE_C * atan(TYRE_B * slip));
+    double fade = fmin(1.0, fabs(wheel) / REGEN_FADE_SPEED);
+    double brake_torque = MOTOR_KT * control.getBrakeCurrent() * DRIVE_RATIO * fade;
+    // the brake only holds the wheel, it can't turn it backwards
+    double wheel_accel = (force * radius - brake_torque) * radius / WHEEL_INERTIA;
+    wheel = fmax(0, wheel + wheel_accel * dt);
+    accel = -force / CAR_MASS;
+    speed += accel * dt;
+    stop.distance += speed * dt;
+    braking++;
+    if (slip > BRAKE_SLIP_MAX) {
+      slipping++;
+    }
+  }
+  stop.seconds = t;
+  stop.slipping = braking > 0 ? (double)slipping / braking : 0;
+  stop.locks = control.getLockCount();
+  return stop;
+}
+
+int main(int argc, char **argv) {
+  double speed_kmh = MAX_SPEED_KMH, max_current = BRAKE_MAX_CURRENT, accel_noise = 0.5;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      speed_kmh = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--current") && i + 1 < argc) {
+      max_current = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--accel-noise") && i + 1 < argc) {
+      accel_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--speed KMH] [--current A] [--accel-noise MPS2] [--seed N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  printf("full brake from %.1f km/h at %.0f A\n", speed_kmh, max_current);
+  printf("%-8s %5s %10s %8s %8s %8s %10s %8s %8s\n", "surface", "grip", "plain m", "plain s", "slip", "abs m", "abs s", "slip", "locks");
+  for (const Surface &surface : SURFACES) {
+    Stop plain = brake(surface, false, speed_kmh, max_current, accel_noise, rng);
+    Stop modulated = brake(surface, true, speed_kmh, max_current, accel_noise, rng);
+    // a distance marked * is where the car still rolled when the simulation ran out
+    printf("%-8s %5.2f %9.2f%s %8.2f %7.0f%% %7.2f%s %10.2f %7.0f%% %8u\n", surface.name, surface.grip, plain.distance, plain.stopped ? " " : "*",
+           plain.seconds, plain.slipping * 100, modulated.distance, modulated.stopped ? " " : "*", modulated.seconds, modulated.slipping * 100,
+           modulated.locks);
+  }
+  return 0;
+}
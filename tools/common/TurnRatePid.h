@@ -0,0 +1,45 @@
+#ifndef TURN_RATE_PID_H
+#define TURN_RATE_PID_H
+
+#include <math.h>
+
+#include "DriveControl.h"
+
+// The turn rate AutoPID as loop() runs it, for the host simulations. Before every step the
+// integral is clamped with clampTurnRateIntegral(), AutoPID integrates trapezoidally over the
+// step in seconds, differentiates over the step in ms divided by 1000 once more and limits
+// the output to -1..1, and the step's integral is taken back while the feed-forward is on and
+// the error is outside the integral band.
+
+class TurnRatePid {
+  public:
+    TurnRatePid(float rate_hz, float integral_band) : dt_ms(1000.0f / rate_hz), integral_band(integral_band) {}
+
+    // One PID step, yaw rates in deg/s, returns the PID's share of the steering. ff_gain is the
+    // feed-forward's, the band only applies while there is one
+    float step(float target, float yaw_rate, float kp, float ki, float kd, float ff_gain) {
+      float error = target - yaw_rate;
+      float held = clampTurnRateIntegral(integral, ki);
+      integral = held + (error + previous_error) / 2 * dt_ms / 1000.0f;
+      float derivative = (error - previous_error) / dt_ms / 1000.0f;
+      float output = clampCommand(kp * error + ki * integral + kd * derivative);
+      if (ff_gain > 0 && fabsf(error) > integral_band) {
+        integral = held;
+      }
+      previous_error = error;
+      return output;
+    }
+
+    void reset() {
+      integral = 0;
+      previous_error = 0;
+    }
+
+  private:
+    float dt_ms;
+    float integral_band;
+    float integral = 0;
+    float previous_error = 0;
+};
+
+#endif // TURN_RATE_PID_H
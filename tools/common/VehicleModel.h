@@ -0,0 +1,52 @@
+#ifndef VEHICLE_MODEL_H
+#define VEHICLE_MODEL_H
+
+#include <math.h>
+
+// Yaw dynamics of the car for the host simulations: a kinematic bicycle behind a rate limited
+// first order servo and a first order lag between wheel angle and yaw rate. The defaults are
+// estimates for a 1/10 car, not measurements.
+
+struct VehicleParams {
+  float wheelbase = 0.26f; // m
+  float max_wheel_angle_deg = 25.0f; // at full servo travel
+  float servo_tau = 0.03f; // s
+  float servo_slew_deg_s = 400.0f; // wheel angle rate limit
+  float yaw_tau = 0.08f; // s
+};
+
+class VehicleModel {
+  public:
+    VehicleModel(const VehicleParams &params) : params(params) {}
+
+    // command is the steering position in -1..1 seen by the servo, speed in m/s,
+    // returns the yaw rate in deg/s
+    float step(float command, float speed, float dt) {
+      float wheel_target = command * params.max_wheel_angle_deg;
+      float wheel_rate = (wheel_target - wheel) / params.servo_tau;
+      if (wheel_rate > params.servo_slew_deg_s) {
+        wheel_rate = params.servo_slew_deg_s;
+      } else if (wheel_rate < -params.servo_slew_deg_s) {
+        wheel_rate = -params.servo_slew_deg_s;
+      }
+      wheel += wheel_rate * dt;
+      float yaw_rate_ss = speed / params.wheelbase * tanf(wheel * 0.017453293f) * 57.29578f;
+      yaw_rate += (yaw_rate_ss - yaw_rate) * dt / params.yaw_tau;
+      return yaw_rate;
+    }
+
+    float getWheelAngle() {
+      return wheel;
+    }
+
+    float getYawRate() {
+      return yaw_rate;
+    }
+
+  private:
+    VehicleParams params;
+    float wheel = 0;
+    float yaw_rate = 0;
+};
+
+#endif // VEHICLE_MODEL_H
@@ -0,0 +1,781 @@
+// Ground station ingest of the car's CRSF telemetry into memory-mapped column files, on Linux.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/groundstation/groundstation.cpp CRSFProtocol.cpp -o groundstation
+// Run:     ./groundstation --out DIR --serial /dev/ttyACM0 [--baud 420000]   until ctrl-c
+//          ./groundstation --out DIR --input dump.bin [--baud 420000]          raw byte dump
+//          ./groundstation --out DIR --input run.fpvc                          CAPTURE_LOG capture
+//          ./groundstation --stats DIR [--from S] [--to S]
+//          ./groundstation --bench [--frames N]
+//
+// The input is cut into frames in place: complete frames are handed on as pointers into the read
+// buffer or the mapped file and only a frame split across two reads is copied, into a 64 byte
+// carry. Framing and CRC are the CRSFProtocol ones the car uses. GPS (the car sends its speed
+// there), battery, attitude, flight mode and link statistics frames are decoded and each field is
+// appended to its own file DIR/<table>.<field>, a plain little endian array of one type that is
+// mapped and grown by doubling, then truncated to the rows written on exit. DIR/schema lists
+// table, field and type, so the columns load straight into numpy.fromfile() or similar.
+//
+// time_us is the wall clock in us for --serial, so a DIR can be appended to over several runs.
+// For a raw dump it is the position in the stream at --baud and for a capture the capture's own
+// timestamps, both from 0, so give each dump its own DIR. --stats maps the columns back and
+// prints count, min, mean and max of every field, --from and --to (seconds from the first row)
+// bisect the time column rather than scanning it.
+//
+// --bench builds N synthetic telemetry frames in memory, clean and with 1 in 1000 bytes
+// corrupted, and reports frames/s of the in-place scanner, of CRSFFrameParser fed byte by byte
+// as the car does, and of the full ingest into columns in a temporary directory, then times
+// --stats over the result.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <asm/termbits.h> // termios2, for 420000 baud that <termios.h> has no constant for
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CRSFProtocol.h"
+#include "CaptureFormat.h"
+
+#define COLUMN_MIN_ROWS 65536 // first mapping of a new column, doubled from there
+#define FLIGHT_MODE_LENGTH 16
+#define SERIAL_READ_SIZE 4096
+#define BENCH_FRAMES 2000000
+#define BENCH_CORRUPT_EVERY 1000 // bytes
+
+enum ColumnType : uint8_t { COL_I64, COL_I32, COL_U32, COL_I16, COL_U8, COL_I8, COL_F32, COL_STR16 };
+
+static const struct {
+  const char *name;
+  uint8_t size;
+} COLUMN_TYPES[] = {{"i64", 8}, {"i32", 4}, {"u32", 4}, {"i16", 2}, {"u8", 1}, {"i8", 1}, {"f32", 4}, {"str16", FLIGHT_MODE_LENGTH}};
+
+struct Field {
+  const char *name;
+  ColumnType type;
+};
+
+#define TABLE_FIELDS_MAX 11
+
+struct TableDef {
+  const char *name;
+  uint8_t frame_type;
+  uint8_t payload_min;
+  Field fields[TABLE_FIELDS_MAX];
+};
+
+enum { TABLE_GPS, TABLE_BATTERY, TABLE_ATTITUDE, TABLE_FLIGHT_MODE, TABLE_LINK, TABLE_COUNT };
+
+// The first field of every table is time_us
+static const TableDef TABLES[TABLE_COUNT] = {
+  {"gps", CRSF_FRAMETYPE_GPS, CRSF_FRAME_GPS_PAYLOAD_SIZE,
+   {{"time_us", COL_I64}, {"latitude", COL_I32}, {"longitude", COL_I32}, {"speed_kmh", COL_F32}, {"heading_deg", COL_F32},
+    {"altitude_m", COL_F32}, {"satellites", COL_U8}}},
+  {"battery", CRSF_FRAMETYPE_BATTERY_SENSOR, CRSF_FRAME_BATTERY_SENSOR_PAYLOAD_SIZE,
+   {{"time_us", COL_I64}, {"voltage_v", COL_F32}, {"current_a", COL_F32}, {"capacity_mah", COL_U32}, {"remaining_pct", COL_U8}}},
+  {"attitude", CRSF_FRAMETYPE_ATTITUDE, CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE,
+   {{"time_us", COL_I64}, {"pitch_rad", COL_F32}, {"roll_rad", COL_F32}, {"yaw_rad", COL_F32}}},
+  {"flight_mode", CRSF_FRAMETYPE_FLIGHT_MODE, 1, {{"time_us", COL_I64}, {"mode", COL_STR16}}},
+  {"link", CRSF_FRAMETYPE_LINK_STATISTICS, CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE,
+   {{"time_us", COL_I64}, {"uplink_rssi1_dbm", COL_I16}, {"uplink_rssi2_dbm", COL_I16}, {"uplink_lq", COL_U8},
+    {"uplink_snr_db", COL_I8}, {"active_antenna", COL_U8}, {"rf_mode", COL_U8}, {"uplink_tx_power", COL_U8},
+    {"downlink_rssi_dbm", COL_I16}, {"downlink_lq", COL_U8}, {"downlink_snr_db", COL_I8}}},
+};
+
+static uint8_t fieldCount(const TableDef &table) {
+  uint8_t count = 0;
+  while (count < TABLE_FIELDS_MAX && table.fields[count].name) {
+    count++;
+  }
+  return count;
+}
+
+static std::string columnPath(const std::string &dir, const TableDef &table, const Field &field) {
+  return dir + "/" + table.name + "." + field.name;
+}
+
+// One field, appended to through a shared mapping of its file
+class Column {
+  public:
+    ~Column() { close(); }
+
+    bool open(const std::string &path, ColumnType type) {
+      size = COLUMN_TYPES[type].size;
+      fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+      if (fd < 0) {
+        perror(path.c_str());
+        return false;
+      }
+      struct stat st;
+      fstat(fd, &st);
+      rows = capacity = st.st_size / size; // a partial row left by a crash is overwritten
+      return capacity > 0 ? map(capacity) : true;
+    }
+
+    template <class T> void append(T value) {
+      if (rows == capacity && !map(capacity < COLUMN_MIN_ROWS ? COLUMN_MIN_ROWS : capacity * 2)) {
+        exit(1);
+      }
+      memcpy(base + rows * size, &value, sizeof(T));
+      rows++;
+    }
+
+    void close() {
+      if (fd < 0) {
+        return;
+      }
+      if (base) {
+        munmap(base, capacity * size);
+        base = NULL;
+      }
+      if (ftruncate(fd, rows * size) != 0) {
+        perror("ftruncate");
+      }
+      ::close(fd);
+      fd = -1;
+    }
+
+    uint64_t rows = 0;
+
+  private:
+    bool map(uint64_t new_capacity) {
+      if (ftruncate(fd, new_capacity * size) != 0) {
+        perror("ftruncate");
+        return false;
+      }
+      void *mapped = base ? mremap(base, capacity * size, new_capacity * size, MREMAP_MAYMOVE)
+                          : mmap(NULL, new_capacity * size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mapped == MAP_FAILED) {
+        perror("mmap");
+        return false;
+      }
+      base = (uint8_t *)mapped;
+      capacity = new_capacity;
+      return true;
+    }
+
+    int fd = -1;
+    uint8_t size = 0;
+    uint8_t *base = NULL;
+    uint64_t capacity = 0;
+};
+
+// A whole file mapped read only
+class MappedFile {
+  public:
+    ~MappedFile() {
+      if (data && size > 0) {
+        munmap((void *)data, size);
+      }
+    }
+
+    bool open(const std::string &path) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        perror(path.c_str());
+        return false;
+      }
+      struct stat st;
+      fstat(fd, &st);
+      size = st.st_size;
+      if (size > 0) {
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? NULL : (const uint8_t *)mapped;
+      }
+      ::close(fd);
+      if (size > 0 && !data) {
+        perror("mmap");
+        return false;
+      }
+      madvise((void *)data, size, MADV_SEQUENTIAL);
+      return true;
+    }
+
+    const uint8_t *data = NULL;
+    size_t size = 0;
+};
+
+static uint32_t getBE(const uint8_t *src, uint8_t bytes) {
+  uint32_t value = 0;
+  while (bytes-- > 0) {
+    value = value << 8 | *src++;
+  }
+  return value;
+}
+
+// Frames to columns
+class ColumnStore {
+  public:
+    bool open(const std::string &dir) {
+      mkdir(dir.c_str(), 0755);
+      FILE *schema = fopen((dir + "/schema").c_str(), "w");
+      if (!schema) {
+        perror(dir.c_str());
+        return false;
+      }
+      for (int t = 0; t < TABLE_COUNT; t++) {
+        for (uint8_t f = 0; f < fieldCount(TABLES[t]); f++) {
+          const Field &field = TABLES[t].fields[f];
+          fprintf(schema, "%s %s %s\n", TABLES[t].name, field.name, COLUMN_TYPES[field.type].name);
+          if (!columns[t][f].open(columnPath(dir, TABLES[t], field), field.type)) {
+            fclose(schema);
+            return false;
+          }
+        }
+      }
+      fclose(schema);
+      return true;
+    }
+
+    void close() {
+      for (int t = 0; t < TABLE_COUNT; t++) {
+        for (uint8_t f = 0; f < fieldCount(TABLES[t]); f++) {
+          columns[t][f].close();
+        }
+      }
+    }
+
+    // Payload length is checked against the table before this is called
+    void append(int table, const uint8_t *p, uint8_t length, int64_t time_us) {
+      Column *c = columns[table];
+      c[0].append(time_us);
+      switch (table) {
+        case TABLE_GPS:
+          c[1].append((int32_t)getBE(p, 4));
+          c[2].append((int32_t)getBE(p + 4, 4));
+          c[3].append(getBE(p + 8, 2) / 10.0f);
+          c[4].append(getBE(p + 10, 2) / 100.0f);
+          c[5].append((float)getBE(p + 12, 2) - 1000.0f);
+          c[6].append(p[14]);
+          break;
+        case TABLE_BATTERY:
+          c[1].append(getBE(p, 2) / 10.0f);
+          c[2].append(getBE(p + 2, 2) / 10.0f);
+          c[3].append(getBE(p + 4, 3));
+          c[4].append(p[7]);
+          break;
+        case TABLE_ATTITUDE:
+          for (int i = 0; i < 3; i++) {
+            c[1 + i].append((int16_t)getBE(p + 2 * i, 2) / 10000.0f);
+          }
+          break;
+        case TABLE_FLIGHT_MODE: {
+          char mode[FLIGHT_MODE_LENGTH] = {};
+          for (uint8_t i = 0; i < length && i < FLIGHT_MODE_LENGTH - 1 && p[i]; i++) {
+            mode[i] = (char)p[i];
+          }
+          c[1].append(*(const Str16 *)mode);
+          break;
+        }
+        case TABLE_LINK:
+          c[1].append((int16_t)-p[0]);
+          c[2].append((int16_t)-p[1]);
+          c[3].append(p[2]);
+          c[4].append((int8_t)p[3]);
+          c[5].append(p[4]);
+          c[6].append(p[5]);
+          c[7].append(p[6]);
+          c[8].append((int16_t)-p[7]);
+          c[9].append(p[8]);
+          c[10].append((int8_t)p[9]);
+          break;
+      }
+    }
+
+    uint64_t rows(int table) {
+      return columns[table][0].rows;
+    }
+
+  private:
+    struct Str16 {
+      char c[FLIGHT_MODE_LENGTH];
+    };
+
+    Column columns[TABLE_COUNT][TABLE_FIELDS_MAX];
+};
+
+struct IngestStats {
+  uint64_t bytes;
+  uint64_t frames;
+  uint64_t stored;
+  uint64_t crc_errors;
+  uint64_t skipped; // bytes dropped while looking for a frame
+};
+
+// Cuts spans of the stream into frames where they lie
+class Ingest {
+  public:
+    // store may be NULL to only frame the stream. Frame n of the span is stamped time_us plus
+    // byte_us for every byte up to its end.
+    Ingest(ColumnStore *store) : store(store) {
+      for (int t = 0; t < TABLE_COUNT; t++) {
+        table_of_type[TABLES[t].frame_type] = t + 1;
+      }
+    }
+
+    void push(const uint8_t *data, size_t length, int64_t time_us, double byte_us) {
+      stats.bytes += length;
+      size_t used = 0;
+      if (carry_length > 0) {
+        // the frame split over the end of the last span, finished with the start of this one
+        size_t take = length < CRSF_FRAME_SIZE_MAX ? length : CRSF_FRAME_SIZE_MAX;
+        uint8_t joined[2 * CRSF_FRAME_SIZE_MAX];
+        memcpy(joined, carry, carry_length);
+        memcpy(joined + carry_length, data, take);
+        size_t end = scan(joined, carry_length + take, carry_length, time_us, 0);
+        if (end < carry_length) {
+          // still incomplete, only possible when this span was shorter than a frame
+          memmove(carry, joined + end, carry_length + take - end);
+          carry_length = carry_length + take - end;
+          return;
+        }
+        used = end - carry_length;
+        carry_length = 0;
+      }
+      size_t end = used + scan(data + used, length - used, length - used, time_us + used * byte_us, byte_us);
+      carry_length = length - end;
+      memcpy(carry, data + end, carry_length);
+    }
+
+    IngestStats stats = {};
+
+  private:
+    // Frames starting before start_limit, returns where the first incomplete one starts
+    size_t scan(const uint8_t *data, size_t length, size_t start_limit, double time_us, double byte_us) {
+      size_t i = 0;
+      while (i < start_limit && i + 2 <= length) {
+        const crsfFrame_t *frame = (const crsfFrame_t *)(data + i);
+        uint8_t frame_length = frame->frame.frameLength;
+        if (frame_length < CRSF_FRAME_LENGTH_TYPE_CRC || frame_length > CRSF_FRAME_SIZE_MAX - 2) {
+          i++;
+          stats.skipped++;
+          continue;
+        }
+        uint8_t size = crsfFrameSize(frame);
+        if (i + size > length) {
+          break;
+        }
+        if (data[i + size - 1] != crsfFrameCRC(frame)) {
+          // resynchronise from the next byte rather than behind the bad frame
+          stats.crc_errors++;
+          stats.skipped++;
+          i++;
+          continue;
+        }
+        stats.frames++;
+        i += size;
+        uint8_t table = table_of_type[frame->frame.type];
+        uint8_t payload_length = frame_length - CRSF_FRAME_LENGTH_TYPE_CRC;
+        if (store && table && payload_length >= TABLES[table - 1].payload_min) {
+          store->append(table - 1, frame->frame.payload, payload_length, (int64_t)(time_us + i * byte_us));
+          stats.stored++;
+        }
+      }
+      return i;
+    }
+
+    ColumnStore *store;
+    uint8_t table_of_type[256] = {}; // table + 1, 0 for frames that aren't stored
+    uint8_t carry[CRSF_FRAME_SIZE_MAX];
+    size_t carry_length = 0;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+  stopping = 1;
+}
+
+static int64_t wallclockUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int openSerial(const char *device, uint32_t baud) {
+  int fd = open(device, O_RDONLY | O_NOCTTY);
+  if (fd < 0) {
+    perror(device);
+    return -1;
+  }
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) == 0) {
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    tio.c_cflag = (tio.c_cflag & ~(CBAUD | CSIZE | PARENB | CSTOPB)) | BOTHER | CS8 | CREAD | CLOCAL;
+    tio.c_ispeed = tio.c_ospeed = baud;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (ioctl(fd, TCSETS2, &tio) != 0) {
+      perror("TCSETS2");
+    }
+  } // not a tty, a fifo or file is read as it is
+  return fd;
+}
+
+static void printIngest(const IngestStats &s, ColumnStore &store) {
+  fprintf(stderr, "%llu bytes, %llu frames, %llu stored, %llu crc errors, %llu bytes skipped |", (unsigned long long)s.bytes,
+          (unsigned long long)s.frames, (unsigned long long)s.stored, (unsigned long long)s.crc_errors, (unsigned long long)s.skipped);
+  for (int t = 0; t < TABLE_COUNT; t++) {
+    fprintf(stderr, " %s %llu", TABLES[t].name, (unsigned long long)store.rows(t));
+  }
+  fprintf(stderr, "\n");
+}
+
+static int ingestSerial(const char *device, uint32_t baud, ColumnStore &store) {
+  int fd = openSerial(device, baud);
+  if (fd < 0) {
+    return 1;
+  }
+  struct sigaction action = {};
+  action.sa_handler = onSignal; // no SA_RESTART, read() returns on ctrl-c
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  Ingest ingest(&store);
+  uint8_t buffer[SERIAL_READ_SIZE];
+  int64_t last_report = wallclockUs();
+  while (!stopping) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    int64_t now = wallclockUs();
+    if (n > 0) {
+      ingest.push(buffer, n, now, 0);
+    } else if (n == 0 || errno != EINTR) {
+      if (n < 0) {
+        perror(device);
+      }
+      break;
+    }
+    if (now - last_report >= 1000000) {
+      last_report = now;
+      printIngest(ingest.stats, store);
+    }
+  }
+  close(fd);
+  printIngest(ingest.stats, store);
+  return 0;
+}
+
+static bool isCapture(const MappedFile &file) {
+  const uint32_t magic = CAPTURE_MAGIC;
+  return file.size >= sizeof(CaptureRecord) + sizeof(CaptureHeader) && file.data[4] == CAPTURE_HEADER &&
+         memcmp(file.data + sizeof(CaptureRecord), &magic, sizeof(magic)) == 0;
+}
+
+static int ingestFile(const char *path, uint32_t baud, ColumnStore &store) {
+  MappedFile file;
+  if (!file.open(path)) {
+    return 1;
+  }
+  Ingest ingest(&store);
+  if (isCapture(file)) {
+    // the receiver bytes of each record, on the capture clock unwrapped to 64 bits
+    int64_t high = 0;
+    uint32_t previous = 0;
+    size_t offset = 0;
+    while (offset + sizeof(CaptureRecord) <= file.size) {
+      const CaptureRecord *record = (const CaptureRecord *)(file.data + offset);
+      offset += sizeof(CaptureRecord);
+      if (offset + record->length > file.size) {
+        break;
+      }
+      if (record->timestamp_us < previous) {
+        high += (int64_t)1 << 32;
+      }
+      previous = record->timestamp_us;
+      if (record->kind == CAPTURE_CRSF_RX) {
+        ingest.push(file.data + offset, record->length, high + record->timestamp_us, 0);
+      }
+      offset += record->length;
+    }
+  } else {
+    ingest.push(file.data, file.size, 0, 10.0 * 1000000.0 / baud);
+  }
+  printIngest(ingest.stats, store);
+  return 0;
+}
+
+struct Schema {
+  std::string table, field;
+  ColumnType type;
+};
+
+static bool readSchema(const std::string &dir, std::vector<Schema> &schema) {
+  FILE *f = fopen((dir + "/schema").c_str(), "r");
+  if (!f) {
+    perror(dir.c_str());
+    return false;
+  }
+  char table[64], field[64], type[16];
+  while (fscanf(f, "%63s %63s %15s", table, field, type) == 3) {
+    for (uint8_t i = 0; i < sizeof(COLUMN_TYPES) / sizeof(COLUMN_TYPES[0]); i++) {
+      if (!strcmp(type, COLUMN_TYPES[i].name)) {
+        schema.push_back({table, field, (ColumnType)i});
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static double columnValue(const uint8_t *p, ColumnType type) {
+  switch (type) {
+    case COL_I64: return (double)*(const int64_t *)p;
+    case COL_I32: return *(const int32_t *)p;
+    case COL_U32: return *(const uint32_t *)p;
+    case COL_I16: return *(const int16_t *)p;
+    case COL_U8: return *p;
+    case COL_I8: return (int8_t)*p;
+    case COL_F32: return *(const float *)p;
+    default: return NAN;
+  }
+}
+
+// First row at or after time_us in a sorted time column
+static uint64_t lowerBound(const int64_t *time, uint64_t rows, int64_t time_us) {
+  uint64_t low = 0, high = rows;
+  while (low < high) {
+    uint64_t mid = (low + high) / 2;
+    if (time[mid] < time_us) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static int stats(const std::string &dir, double from_s, double to_s, bool quiet) {
+  std::vector<Schema> schema;
+  if (!readSchema(dir, schema)) {
+    return 1;
+  }
+  uint64_t first = 0, last = 0;
+  for (const Schema &column : schema) {
+    MappedFile file;
+    if (!file.open(dir + "/" + column.table + "." + column.field)) {
+      return 1;
+    }
+    uint8_t size = COLUMN_TYPES[column.type].size;
+    uint64_t rows = file.size / size;
+    if (column.field == "time_us") {
+      // every other field of the table is read over the rows found here
+      const int64_t *time = (const int64_t *)file.data;
+      first = last = 0;
+      if (rows > 0) {
+        first = lowerBound(time, rows, time[0] + (int64_t)(from_s * 1000000.0));
+        last = to_s < 0 ? rows : lowerBound(time, rows, time[0] + (int64_t)(to_s * 1000000.0));
+      }
+      if (!quiet) {
+        printf("%s: %llu of %llu rows", column.table.c_str(), (unsigned long long)(last > first ? last - first : 0),
+               (unsigned long long)rows);
+        if (last > first) {
+          printf(", %.3f s", (time[last - 1] - time[first]) / 1000000.0);
+        }
+        printf("\n");
+      }
+      continue;
+    }
+    if (column.type == COL_STR16) {
+      if (!quiet && last > first) {
+        printf("  %-18s last \"%.*s\"\n", column.field.c_str(), FLIGHT_MODE_LENGTH, (const char *)file.data + (last - 1) * size);
+      }
+      continue;
+    }
+    double min = INFINITY, max = -INFINITY, sum = 0;
+    for (uint64_t row = first; row < last && row < rows; row++) {
+      double value = columnValue(file.data + row * size, column.type);
+      min = value < min ? value : min;
+      max = value > max ? value : max;
+      sum += value;
+    }
+    if (!quiet && last > first) {
+      printf("  %-18s min %12.4f  mean %12.4f  max %12.4f\n", column.field.c_str(), min, sum / (last - first), max);
+    }
+  }
+  return 0;
+}
+
+// Telemetry as the car and a receiver send it, about 1:1:1:1 with a flight mode now and then
+static std::vector<uint8_t> syntheticStream(uint32_t frames, bool corrupt, std::mt19937 &rng) {
+  std::vector<uint8_t> stream;
+  stream.reserve((size_t)frames * 20);
+  uint8_t frame[CRSF_FRAME_SIZE_MAX];
+  for (uint32_t n = 0; n < frames; n++) {
+    uint8_t length;
+    switch (n % 9) {
+      case 0:
+      case 4: {
+        crsfGpsFrame_t gps = {(int32_t)(435000000 + n), (int32_t)(-794000000 - n), (uint16_t)(rng() % 600), (uint16_t)(rng() % 36000),
+                              1000, 0};
+        length = crsfBuildGpsFrame(frame, &gps);
+        break;
+      }
+      case 1:
+      case 5: {
+        crsfVoltageFrame_t voltage = {(uint16_t)(160 - n % 40), (uint16_t)(rng() % 400), n / 1000, 80};
+        length = crsfBuildVoltageFrame(frame, &voltage);
+        break;
+      }
+      case 2:
+      case 6: {
+        uint8_t attitude[CRSF_FRAME_ATTITUDE_PAYLOAD_SIZE];
+        for (uint8_t &b : attitude) {
+          b = (uint8_t)rng();
+        }
+        length = crsfBuildFrame(frame, CRSF_FRAMETYPE_ATTITUDE, attitude, sizeof(attitude));
+        break;
+      }
+      case 3:
+      case 7: {
+        uint8_t link[CRSF_FRAME_LINK_STATISTICS_PAYLOAD_SIZE] = {60, 62, (uint8_t)(rng() % 101), 8, 0, 4, 2, 70, 100, 6};
+        length = crsfBuildFrame(frame, CRSF_FRAMETYPE_LINK_STATISTICS, link, sizeof(link));
+        break;
+      }
+      default: {
+        const char *mode = n % 2 ? "DIRECT" : "STEER_ASSIST";
+        length = crsfBuildFrame(frame, CRSF_FRAMETYPE_FLIGHT_MODE, (const uint8_t *)mode, strlen(mode) + 1);
+        break;
+      }
+    }
+    stream.insert(stream.end(), frame, frame + length);
+  }
+  if (corrupt) {
+    for (size_t i = rng() % BENCH_CORRUPT_EVERY; i < stream.size(); i += BENCH_CORRUPT_EVERY) {
+      stream[i] ^= 1 << (rng() % 8);
+    }
+  }
+  return stream;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int bench(uint32_t frames) {
+  char dir[] = "/tmp/groundstation.XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::mt19937 rng(1);
+  const char *names[] = {"clean", "corrupted"};
+  printf("%u frames per stream\n", frames);
+  printf("%-10s %-14s %12s %10s %10s %10s\n", "stream", "path", "frames/s", "MB/s", "frames", "crc errors");
+  for (int corrupt = 0; corrupt < 2; corrupt++) {
+    std::vector<uint8_t> stream = syntheticStream(frames, corrupt, rng);
+    double mb = stream.size() / 1e6;
+
+    auto start = std::chrono::steady_clock::now();
+    Ingest scanner(NULL);
+    scanner.push(stream.data(), stream.size(), 0, 0);
+    double t = seconds(start);
+    printf("%-10s %-14s %12.0f %10.1f %10llu %10llu\n", names[corrupt], "scan", scanner.stats.frames / t, mb / t,
+           (unsigned long long)scanner.stats.frames, (unsigned long long)scanner.stats.crc_errors);
+
+    start = std::chrono::steady_clock::now();
+    CRSFFrameParser parser;
+    uint64_t parsed = 0;
+    for (uint8_t byte : stream) {
+      parsed += parser.feed(byte, 0);
+    }
+    t = seconds(start);
+    printf("%-10s %-14s %12.0f %10.1f %10llu %10u\n", names[corrupt], "byte parser", parsed / t, mb / t, (unsigned long long)parsed,
+           parser.crc_errors);
+
+    // into columns, in reads the size the serial path uses
+    std::string out = std::string(dir) + "/" + names[corrupt];
+    ColumnStore store;
+    if (!store.open(out)) {
+      return 1;
+    }
+    start = std::chrono::steady_clock::now();
+    Ingest ingest(&store);
+    for (size_t i = 0; i < stream.size(); i += SERIAL_READ_SIZE) {
+      size_t n = stream.size() - i < SERIAL_READ_SIZE ? stream.size() - i : SERIAL_READ_SIZE;
+      ingest.push(stream.data() + i, n, (int64_t)i * 24, 24); // 420 kbaud
+    }
+    store.close();
+    t = seconds(start);
+    printf("%-10s %-14s %12.0f %10.1f %10llu %10llu\n", names[corrupt], "ingest", ingest.stats.frames / t, mb / t,
+           (unsigned long long)ingest.stats.frames, (unsigned long long)ingest.stats.crc_errors);
+
+    start = std::chrono::steady_clock::now();
+    stats(out, 0, -1, true);
+    double all = seconds(start);
+    start = std::chrono::steady_clock::now();
+    stats(out, 60, 70, true);
+    printf("%-10s %-14s %9.1f ms all rows, %.3f ms for 10 s\n", names[corrupt], "stats", all * 1000, seconds(start) * 1000);
+  }
+  std::string remove = std::string("rm -rf ") + dir;
+  return system(remove.c_str()) == 0 ? 0 : 1;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: groundstation --out DIR (--serial DEVICE | --input FILE) [--baud N]\n"
+          "       groundstation --stats DIR [--from S] [--to S]\n"
+          "       groundstation --bench [--frames N]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *out = NULL, *device = NULL, *input = NULL, *stats_dir = NULL;
+  uint32_t baud = CRSF_BAUDRATE;
+  uint32_t frames = BENCH_FRAMES;
+  double from_s = 0, to_s = -1;
+  bool run_bench = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      out = argv[++i];
+    } else if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc) {
+      device = argv[++i];
+    } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+      input = argv[++i];
+    } else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+      baud = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      stats_dir = argv[++i];
+    } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+      from_s = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+      to_s = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--bench") == 0) {
+      run_bench = true;
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (run_bench) {
+    return frames > 0 ? bench(frames) : 1;
+  }
+  if (stats_dir) {
+    return stats(stats_dir, from_s, to_s, false);
+  }
+  if (!out || (device == NULL) == (input == NULL) || baud == 0) {
+    usage();
+    return 1;
+  }
+  ColumnStore store;
+  if (!store.open(out)) {
+    return 1;
+  }
+  int result = device ? ingestSerial(device, baud, store) : ingestFile(input, baud, store);
+  store.close();
+  return result;
+}
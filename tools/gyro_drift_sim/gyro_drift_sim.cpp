@@ -0,0 +1,164 @@
+// Residual yaw drift of the GyroCalibration bias estimate on synthetic drifting gyro traces,
+// against the fixed GYRO_YAW_CAL offset the firmware used before it.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/gyro_drift_sim/gyro_drift_sim.cpp GyroCalibration.cpp -o gyro_drift_sim
+// Run:     ./gyro_drift_sim [--minutes M] [--noise DPS] [--seed N] [--updates N]
+//
+// Every trace starts with BOOT_SECONDS standing still, then the car drives for DRIVE_SECONDS
+// weaving left and right and stops for STOP_SECONDS, over and over. The gyro is sampled at the
+// IMU rate with white noise of --noise deg/s on top of a bias that follows the die temperature
+// of the trace. The temperature is read every GYRO_TEMP_INTERVAL ms as the sketch does, the
+// first reading a second after power up, in the LSM6DS3's 1/16 degree steps. The drift is the
+// heading error at the end over the minutes driven: "fixed" subtracts GYRO_YAW_CAL, "online"
+// is GyroCalibration without and "temp" with the temperature fed. The slope columns are the
+// bias to temperature slope of the trace and the one GyroCalibration fitted. The update cost is
+// the mean over --updates stationary samples, in nanoseconds and, on x86, TSC cycles.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "GyroCalibration.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define GYRO_YAW_CAL 1.2
+#define GYRO_STATIONARY_ERPM 150
+#define GYRO_STATIONARY_STDDEV 0.5
+#define GYRO_TEMP_INTERVAL 1000
+#define GYRO_SAMPLE_RATE 416.0
+
+#define BOOT_SECONDS 3.0
+#define DRIVE_SECONDS 26.0
+#define STOP_SECONDS 4.0
+#define DRIVE_ERPM 8000.0
+#define WEAVE_DPS 90.0 // peak yaw rate of the weave
+#define WEAVE_SECONDS 3.0
+
+// Die temperature (deg C) and raw gyro bias (deg/s) of a trace at time t
+struct Trace {
+  const char *name;
+  double temp_start;
+  double temp_end; // approached with TEMP_TAU
+  double bias; // at 25 C, GYRO_YAW_CAL is taken off the raw rate
+  double slope; // deg/s per deg C
+};
+
+#define TEMP_TAU 180.0 // s, the board warming up
+
+static const Trace TRACES[] = {
+  {"steady", 30, 30, -GYRO_YAW_CAL, 0.0},
+  {"offset", 30, 30, -GYRO_YAW_CAL - 0.8, 0.0},
+  {"warmup", 25, 45, -GYRO_YAW_CAL, 0.04},
+  {"cooldown", 45, 25, -GYRO_YAW_CAL, -0.03},
+};
+
+struct Drift {
+  double fixed; // deg/min
+  double online;
+  double temp;
+  double fitted_slope;
+};
+
+static Drift simulate(const Trace &trace, double minutes, double noise, std::mt19937 &rng) {
+  GyroCalibration online(-GYRO_YAW_CAL, GYRO_STATIONARY_ERPM, GYRO_STATIONARY_STDDEV);
+  GyroCalibration temp(-GYRO_YAW_CAL, GYRO_STATIONARY_ERPM, GYRO_STATIONARY_STDDEV);
+  std::normal_distribution<double> gyro_noise(0, noise);
+  double dt = 1.0 / GYRO_SAMPLE_RATE;
+  double seconds = minutes * 60.0;
+  double yaw = 0, fixed_yaw = 0, online_yaw = 0, temp_yaw = 0;
+  double next_temperature = GYRO_TEMP_INTERVAL / 1000.0;
+  for (double t = 0; t < seconds; t += dt) {
+    double temperature = trace.temp_end + (trace.temp_start - trace.temp_end) * exp(-t / TEMP_TAU);
+    double bias = trace.bias + trace.slope * (temperature - 25.0);
+    double rate = 0, erpm = 0;
+    if (t >= BOOT_SECONDS && fmod(t - BOOT_SECONDS, DRIVE_SECONDS + STOP_SECONDS) < DRIVE_SECONDS) {
+      erpm = DRIVE_ERPM;
+      rate = WEAVE_DPS * sin(2.0 * M_PI * (t - BOOT_SECONDS) / WEAVE_SECONDS);
+    }
+    if (t >= next_temperature) {
+      next_temperature += GYRO_TEMP_INTERVAL / 1000.0;
+      temp.setTemperature((float)(round(temperature * 16.0) / 16.0));
+    }
+    float raw = (float)(rate + bias + gyro_noise(rng));
+    yaw += rate * dt;
+    fixed_yaw += (raw + GYRO_YAW_CAL) * dt;
+    online_yaw += online.update(raw, (float)erpm) * dt;
+    temp_yaw += temp.update(raw, (float)erpm) * dt;
+  }
+  Drift drift;
+  drift.fixed = (fixed_yaw - yaw) / minutes;
+  drift.online = (online_yaw - yaw) / minutes;
+  drift.temp = (temp_yaw - yaw) / minutes;
+  // the fitted slope shows in how the bias moves between two temperatures
+  temp.setTemperature(30.0f);
+  float bias_30 = temp.getBias();
+  temp.setTemperature(40.0f);
+  drift.fitted_slope = (temp.getBias() - bias_30) / 10.0;
+  return drift;
+}
+
+struct UpdateCost {
+  double ns;
+  double cycles; // 0 without a TSC
+};
+
+// One batch of stationary samples between two clock reads, every window is accepted
+static UpdateCost updateCost(long updates) {
+  GyroCalibration cal(-GYRO_YAW_CAL, GYRO_STATIONARY_ERPM, GYRO_STATIONARY_STDDEV);
+  cal.setTemperature(30.0f);
+  volatile float sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  #ifdef HAVE_TSC
+  uint64_t tsc_start = __rdtsc();
+  #endif
+  for (long i = 0; i < updates; i++) {
+    sink = cal.update(-1.2f + 0.01f * (float)((i & 31) - 16), 0);
+  }
+  UpdateCost cost = {};
+  #ifdef HAVE_TSC
+  cost.cycles = (double)(__rdtsc() - tsc_start) / updates;
+  #endif
+  cost.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / updates;
+  (void)sink;
+  return cost;
+}
+
+int main(int argc, char **argv) {
+  double minutes = 10, noise = 0.15;
+  uint32_t seed = 1;
+  long updates = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--minutes") && i + 1 < argc) {
+      minutes = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--updates") && i + 1 < argc) {
+      updates = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--minutes M] [--noise DPS] [--seed N] [--updates N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  printf("%-9s %10s %10s %10s %10s %10s\n", "trace", "fixed", "online", "temp", "slope", "fitted");
+  for (const Trace &trace : TRACES) {
+    Drift drift = simulate(trace, minutes, noise, rng);
+    printf("%-9s %10.2f %10.2f %10.2f %10.3f %10.3f\n", trace.name, drift.fixed, drift.online, drift.temp, trace.slope, drift.fitted_slope);
+  }
+  printf("yaw drift in deg/min over %.0f minutes, slopes in deg/s per deg C\n\n", minutes);
+
+  UpdateCost cost = updateCost(updates);
+  printf("%8s %8s %8s\n", "update", "ns", "cycles");
+  printf("%8s %8.1f %8.1f\n", "sample", cost.ns, cost.cycles);
+  return 0;
+}
@@ -0,0 +1,146 @@
+// Just enough of the Arduino SAMD core to build the whole sketch on the host for latency_bench.
+// Time is virtual and the SERCOM interrupts are raised by the bench, latency_bench.cpp defines
+// everything declared here.
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <cmath>
+#include <type_traits>
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define RISING 4
+#define A5 19
+#define PIO_SERCOM 2
+
+using std::abs;
+
+template <class T, class U> typename std::common_type<T, U>::type min(T a, U b) {
+  return a < b ? a : b;
+}
+
+template <class T, class U> typename std::common_type<T, U>::type max(T a, U b) {
+  return a < b ? b : a;
+}
+
+template <class T, class L, class H> T constrain(T x, L low, H high) {
+  return x < low ? low : (x > high ? high : x);
+}
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void pinMode(int pin, int mode);
+int digitalRead(int pin);
+void digitalWrite(int pin, int value);
+void noInterrupts();
+void interrupts();
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int interrupt, void (*handler)(), int mode);
+
+// CMSIS core, WFI sleeps until the next interrupt the bench raises
+void __WFI();
+void __DSB();
+void __disable_irq();
+void __enable_irq();
+uint32_t __get_PRIMASK();
+void __set_PRIMASK(uint32_t primask);
+
+#define HARDSER_STOP_BIT_1 0x0001
+#define HARDSER_STOP_BIT_2 0x0003
+#define HARDSER_STOP_BIT_MASK 0x000F
+#define HARDSER_PARITY_EVEN 0x0010
+#define HARDSER_PARITY_ODD 0x0020
+#define HARDSER_PARITY_NONE 0x0030
+#define HARDSER_PARITY_MASK 0x00F0
+#define HARDSER_DATA_5 0x0100
+#define HARDSER_DATA_6 0x0200
+#define HARDSER_DATA_7 0x0300
+#define HARDSER_DATA_8 0x0400
+#define HARDSER_DATA_MASK 0x0F00
+#define SERIAL_8N1 (HARDSER_STOP_BIT_1 | HARDSER_PARITY_NONE | HARDSER_DATA_8)
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+      for (size_t i = 0; i < size; i++) {
+        write(buffer[i]);
+      }
+      return size;
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    virtual void begin(unsigned long baud) = 0;
+    virtual void begin(unsigned long baud, uint16_t config) = 0;
+    virtual void end() = 0;
+    virtual void flush() = 0;
+    virtual int availableForWrite() = 0;
+};
+
+extern HardwareSerial &Serial1;
+
+enum SercomRXPad { SERCOM_RX_PAD_0, SERCOM_RX_PAD_1, SERCOM_RX_PAD_2, SERCOM_RX_PAD_3 };
+enum SercomUartTXPad { UART_TX_PAD_0, UART_TX_PAD_2 };
+enum SercomUartMode { UART_EXT_CLOCK, UART_INT_CLOCK };
+enum SercomUartSampleRate { SAMPLE_RATE_x16 };
+enum SercomUartCharSize { UART_CHAR_SIZE_8_BITS, UART_CHAR_SIZE_5_BITS = 5, UART_CHAR_SIZE_6_BITS, UART_CHAR_SIZE_7_BITS };
+enum SercomParityMode { SERCOM_EVEN_PARITY, SERCOM_ODD_PARITY, SERCOM_NO_PARITY };
+enum SercomNumberStopBit { SERCOM_STOP_BIT_1, SERCOM_STOP_BITS_2 };
+enum SercomDataOrder { MSB_FIRST, LSB_FIRST };
+
+// A USART whose line the bench drives. Received bytes wait in the two byte hardware buffer until
+// the interrupt reads them, transmitted bytes leave at the baud rate.
+class SERCOM {
+  public:
+    void initUART(SercomUartMode mode, SercomUartSampleRate sample_rate, uint32_t baudrate);
+    void initFrame(SercomUartCharSize, SercomDataOrder, SercomParityMode, SercomNumberStopBit) {}
+    void initPads(SercomUartTXPad, SercomRXPad) {}
+    void resetUART() {}
+    void enableUART() {}
+    bool availableDataUART();
+    uint8_t readDataUART();
+    bool isFrameErrorUART() { return false; }
+    void clearFrameErrorUART() {}
+    bool isDataRegisterEmptyUART();
+    int writeDataUART(uint8_t byte);
+    bool isUARTError() { return overflow; }
+    void acknowledgeUARTError() {}
+    bool isBufferOverflowErrorUART() { return overflow; }
+    void clearStatusUART() { overflow = false; }
+    void enableDataRegisterEmptyInterruptUART();
+    void disableDataRegisterEmptyInterruptUART() { transmitting = false; }
+
+    double byte_us = 0;
+    uint8_t rx[2];
+    uint8_t rx_count = 0;
+    bool overflow = false;
+    bool transmitting = false;
+    double tx_free_us = 0;
+    uint32_t tx_bytes = 0;
+};
+
+extern SERCOM sercom1, sercom3;
+
+#endif // ARDUINO_H
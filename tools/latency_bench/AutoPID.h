@@ -0,0 +1,55 @@
+// The parts of the AutoPID library the sketch uses, same step and integral behaviour. run() is
+// defined in latency_bench.cpp, which charges its time.
+
+#ifndef AUTOPID_H
+#define AUTOPID_H
+
+#include <Arduino.h>
+
+class AutoPID {
+  public:
+    AutoPID(double *input, double *setpoint, double *output, double output_min, double output_max, double kp, double ki, double kd)
+      : input(input), setpoint(setpoint), output(output), output_min(output_min), output_max(output_max), kp(kp), ki(ki), kd(kd) {}
+
+    void setGains(double kp, double ki, double kd) {
+      this->kp = kp;
+      this->ki = ki;
+      this->kd = kd;
+    }
+
+    void setTimeStep(unsigned long time_step) {
+      this->time_step = time_step;
+    }
+
+    void reset() {
+      last_step = millis();
+      integral = 0;
+      previous_error = 0;
+    }
+
+    double getIntegral() {
+      return integral;
+    }
+
+    void setIntegral(double integral) {
+      this->integral = integral;
+    }
+
+    void run();
+
+  private:
+    double *input;
+    double *setpoint;
+    double *output;
+    double output_min;
+    double output_max;
+    double kp;
+    double ki;
+    double kd;
+    unsigned long time_step = 1000;
+    unsigned long last_step = 0;
+    double integral = 0;
+    double previous_error = 0;
+};
+
+#endif // AUTOPID_H
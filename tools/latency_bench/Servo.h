@@ -0,0 +1,12 @@
+// The lights output, unused by the bench
+
+#ifndef SERVO_H
+#define SERVO_H
+
+class Servo {
+  public:
+    void attach(int) {}
+    void write(int) {}
+};
+
+#endif // SERVO_H
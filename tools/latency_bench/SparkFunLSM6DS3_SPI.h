@@ -0,0 +1,40 @@
+// The LSM6DS3 driver calls the sketch makes. The data ready pin and the SPI transfer time are
+// simulated in latency_bench.cpp, the car stands still and level.
+
+#ifndef SPARKFUN_LSM6DS3_SPI_H
+#define SPARKFUN_LSM6DS3_SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE 1
+#define LSM6DS3_ACC_GYRO_INT1_CTRL 0x0D
+#define LSM6DS3_ACC_GYRO_OUTX_L_G 0x22
+#define IMU_SUCCESS 0
+#define IMU_HW_ERROR 1
+
+typedef int status_t;
+
+class LSM6DS3 {
+  public:
+    LSM6DS3(int, int) {}
+    status_t writeRegister(uint8_t address, uint8_t value) {
+      registers[address] = value;
+      return IMU_SUCCESS;
+    }
+    status_t readRegister(uint8_t *output, uint8_t address) {
+      *output = registers[address];
+      return IMU_SUCCESS;
+    }
+    float readFloatGyroZ() { return 0; }
+    float readTempC() { return 25; }
+    // Defined by latency_bench.cpp
+    status_t begin();
+    status_t readRegisterRegion(uint8_t *output, uint8_t address, uint8_t length);
+    float calcGyro(int16_t raw) { return raw * 0.0175f; } // 500 dps range
+    float calcAccel(int16_t raw) { return raw * 0.000122f; } // 4 g range
+
+  private:
+    uint8_t registers[128] = {};
+};
+
+#endif // SPARKFUN_LSM6DS3_SPI_H
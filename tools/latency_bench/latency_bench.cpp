@@ -0,0 +1,839 @@
+// Stick to actuator latency of the whole sketch, per drive mode and loop configuration, with a
+// regression check against a saved run.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=gnu++11 -O2 -I../../tools/latency_bench -I. ../../tools/latency_bench/latency_bench.cpp
+//            AttitudeEstimator.cpp CRSFLink.cpp CRSFParameters.cpp CRSFProtocol.cpp EventLoop.cpp GyroCalibration.cpp
+//            LinkMonitor.cpp Odometry.cpp ParamStore.cpp PurePursuit.cpp SerialChannel.cpp SerialMux.cpp SerialPorts.cpp
+//            StartupSequence.cpp SteeringFeedForward.cpp TrajectoryCodec.cpp TrajectoryFollower.cpp TrajectoryLog.cpp
+//            TurnRateAutotune.cpp VescCodec.cpp VescLink.cpp YawRateLqr.cpp SpeedEstimator.cpp BrakeControl.cpp
+//            -o latency_bench
+//          add -DLATENCY_PROBE to also time the probe pin the way a logic analyzer sees it
+// Run:     ./latency_bench [--seconds S] [--rates HZ,HZ..] [--cpu-scale X] [--save FILE]
+//            [--check FILE] [--tolerance PCT] [--slack US] [--imu-failures N]
+//
+// FPV_RC_Car.ino runs unchanged on a virtual clock, only the hardware below it is replaced. CRSF
+// frames at 420 kbaud go through the SERCOM3 interrupt as on the board, channel 16 of each frame
+// carries its sequence number, and the bench timestamps steering.writeMicroseconds() and the
+// COMM_SET_RPM packet leaving the VESC UART against the end of the frame whose values they carry.
+// The servo then waits for its next frame, the same in every configuration, so that isn't counted.
+// A frame replaced by a newer one before it reached an output is counted as superseded. OFF
+// writes no outputs and REPEAT needs a taught lap, it shares its path with AUTONOMOUS.
+//
+// The sketch's work is charged from the table below, the estimated SAMD21 durations also used by
+// tools/latency_sim, at the point in the pass where the bench sees it: the data ready check, the
+// IMU read, telemetry frames queued, the PID run and the servo write. SPI and flash stalls are
+// charged at board timings, and CRSF bytes arriving during a flash stall are lost past the two
+// the UART holds. The run is deterministic, so a change to the loop's structure shows up exactly.
+// --cpu-scale X also charges the host CPU time of the sketch code times X, which catches slower
+// code but varies between machines.
+//
+// The loop sleeps in WFI between events. The bench wakes it for the interrupts it raises: CRSF
+// bytes, IMU data ready edges, the SysTick every millisecond and the telemetry transmitter. The
+// time spent asleep gives the CPU load, which is checked against the load the sketch accounts
+// for itself (exit status 2 if they differ by more than LOAD_TOLERANCE points), and with the
+// MCU currents below an estimate of what sleeping saves over the busy loop.
+//
+// The startup is reported from the sketch's own accounting: when it armed and when each device
+// came up. --imu-failures N fails the first N IMU inits to see the retries.
+//
+// ./latency_bench --save base.txt before a change, then ./latency_bench --check base.txt after it
+// fails (exit status 2) when a p50 or p99 got worse by more than --tolerance percent plus --slack.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "NvmFlash.h"
+#include "ServoOutput.h"
+
+#define IMU_RATE_HZ 416.0 // LSM6DS3 data ready
+#define NVM_ERASE_US 6000 // SAMD21 datasheet row erase, maximum
+#define NVM_PAGE_US 2500 // page write, maximum
+#define UART_FIFO 2 // received bytes a SERCOM holds before it overruns
+#define CORE_TX_BUFFER 64 // Serial1 transmit ring of the Arduino core
+#define VESC_TURNAROUND_US 60
+#define HOST_SLICE_MAX_US 20.0 // with --cpu-scale, a longer host gap between two clock reads was the scheduler
+
+// estimated task durations on the SAMD21 at 48 MHz, us
+#define CRSF_BYTE_US 3 // the port interrupt and its share of parsing a frame
+#define PASS_US 55 // poll, handleRemote() and handleParams() of a pass, charged at the data ready check
+#define IMU_US 330 // SPI read, gyro filter, attitude update
+#define TELEMETRY_FRAME_US 90 // building and queueing a CRSF telemetry frame, odometry in the first
+#define PID_US 60 // turn rate PID and feed forward
+#define OUTPUT_US 45 // executeCommands() and esc.update()
+#define ISR_US 2 // SysTick or data ready interrupt
+#define IMU_BEGIN_US 1500 // SPI setup, the driver's settling loop and the configuration writes
+#define WARMUP_US 1000000 // after a mode change, also covers the erase before teaching
+#define MARKER_CHANNEL 15
+#define MARKER_RANGE 1024 // sequence numbers wrap within the valid channel range
+#define CHANNEL_LOW CRSF_CHANNEL_MIN
+#define CHANNEL_MID 992
+#define CHANNEL_HIGH CRSF_CHANNEL_MAX
+#define LOAD_TOLERANCE 2.0 // percent points between the bench's and the sketch's CPU load
+// SAMD21 at 48 MHz on the DFLL, datasheet typicals, rounded
+#define MCU_RUN_MA 3.9
+#define MCU_IDLE_MA 1.9 // IDLE0, the CPU clock stopped
+
+enum Output { OUTPUT_SERVO, OUTPUT_ESC, OUTPUT_PROBE, OUTPUT_COUNT };
+static const char *OUTPUT_NAMES[OUTPUT_COUNT] = {"servo", "esc", "probe"};
+
+struct TimedByte {
+  double time_us;
+  uint8_t value;
+};
+
+// Bench state, ahead of the sketch since its globals call millis() while they are constructed
+static double now_us = 0;
+static double cpu_scale = 0; // SAMD21 us per host us of sketch code
+static double clock_overhead_us = 0; // host time of reading the clock, not the sketch's
+static uint32_t passes = 0;
+static std::chrono::steady_clock::time_point host_mark = std::chrono::steady_clock::now();
+static bool in_interrupt = false;
+static bool interrupts_enabled = true;
+static double next_imu_us = 0;
+static bool imu_edge = true; // the data ready line went low, its next rise interrupts
+static void (*imu_handler)() = NULL;
+static double next_tick_us = 1000;
+static double asleep_us = 0;
+static int imu_failures = 0;
+static std::deque<TimedByte> crsf_line;
+static std::vector<double> frame_end_us; // channels frames by sequence number
+static bool recording = false;
+static long written[OUTPUT_COUNT] = {-1, -1, -1};
+static std::vector<double> latencies[OUTPUT_COUNT];
+static uint32_t superseded[OUTPUT_COUNT];
+#ifdef LATENCY_PROBE
+static double probe_rise_us = -1;
+#endif
+static std::vector<uint8_t> flash(NVM_FLASH_END, 0xFF);
+
+#include "FPV_RC_Car.ino"
+
+SERCOM sercom1, sercom3;
+
+static void deliverInterrupts();
+
+// Charges the sketch for the host time it ran since the last call, then raises the interrupts
+// that came due meanwhile
+static void charge() {
+  if (cpu_scale > 0) {
+    std::chrono::steady_clock::time_point host = std::chrono::steady_clock::now();
+    double us = std::chrono::duration<double, std::micro>(host - host_mark).count() - clock_overhead_us;
+    now_us += std::min(std::max(us, 0.0), HOST_SLICE_MAX_US) * cpu_scale;
+  }
+  if (!in_interrupt && interrupts_enabled) {
+    deliverInterrupts();
+  }
+  if (cpu_scale > 0) {
+    host_mark = std::chrono::steady_clock::now();
+  }
+}
+
+// Scope of a call from the sketch into the bench, the bench's own host time isn't charged
+struct BenchCall {
+  BenchCall() {
+    charge();
+  }
+  ~BenchCall() {
+    if (cpu_scale > 0) {
+      host_mark = std::chrono::steady_clock::now();
+    }
+  }
+};
+
+// Time the CPU spends waiting on a peripheral, interrupts still run
+static void spend(double us) {
+  charge();
+  now_us += us;
+  charge();
+}
+
+// Flash operations stall the CPU and with it the interrupts, received bytes pile up in the UART
+static void stall(double us) {
+  charge();
+  double end_us = now_us + us;
+  while (!crsf_line.empty() && crsf_line.front().time_us <= end_us) {
+    if (sercom3.rx_count < UART_FIFO) {
+      sercom3.rx[sercom3.rx_count++] = crsf_line.front().value;
+    } else {
+      sercom3.overflow = true;
+    }
+    crsf_line.pop_front();
+  }
+  now_us = end_us;
+  charge();
+}
+
+static void deliverInterrupts() {
+  in_interrupt = true;
+  while (next_tick_us <= now_us) {
+    next_tick_us += 1000;
+    now_us += ISR_US;
+    sysTickHook();
+  }
+  if (imu_handler != NULL && imu_edge && next_imu_us <= now_us) {
+    imu_edge = false;
+    now_us += ISR_US;
+    imu_handler();
+  }
+  while (true) {
+    bool receive = !crsf_line.empty() && crsf_line.front().time_us <= now_us;
+    bool transmit = sercom3.transmitting && sercom3.tx_free_us <= now_us;
+    if (!receive && !transmit && sercom3.rx_count == 0) {
+      break;
+    }
+    if (receive && sercom3.rx_count < UART_FIFO) {
+      sercom3.rx[sercom3.rx_count++] = crsf_line.front().value;
+      crsf_line.pop_front();
+    }
+    now_us += CRSF_BYTE_US;
+    SERCOM3_Handler();
+    charge();
+  }
+  in_interrupt = false;
+}
+
+uint32_t millis() {
+  charge();
+  return (uint32_t)(now_us / 1000.0);
+}
+
+uint32_t micros() {
+  charge();
+  return (uint32_t)now_us;
+}
+
+void delay(uint32_t ms) {
+  spend(ms * 1000.0);
+}
+
+void pinMode(int, int) {}
+
+// Once per pass, at the top of loop()
+int digitalRead(int pin) {
+  BenchCall call;
+  if (pin != A5) {
+    return LOW;
+  }
+  passes++;
+  spend(PASS_US);
+  return now_us >= next_imu_us;
+}
+
+void digitalWrite(int pin, int value) {
+  #ifdef LATENCY_PROBE
+  BenchCall call;
+  if (pin != LATENCY_PROBE_PIN) {
+    return;
+  }
+  if (value == HIGH && probe_rise_us < 0) {
+    probe_rise_us = now_us;
+  } else if (value == LOW && probe_rise_us >= 0) {
+    if (recording) {
+      latencies[OUTPUT_PROBE].push_back(now_us - probe_rise_us);
+    }
+    probe_rise_us = -1;
+  }
+  #else
+  (void)pin;
+  (void)value;
+  #endif
+}
+
+void noInterrupts() {
+  charge();
+  interrupts_enabled = false;
+}
+
+void interrupts() {
+  interrupts_enabled = true;
+  charge();
+}
+
+int digitalPinToInterrupt(int pin) {
+  return pin;
+}
+
+void attachInterrupt(int interrupt, void (*handler)(), int) {
+  if (interrupt == A5) {
+    imu_handler = handler;
+  }
+}
+
+// Sleeps until the next interrupt would be raised, with interrupts masked it only runs once
+// they are unmasked
+void __WFI() {
+  BenchCall call;
+  double wake_us = next_tick_us;
+  if (!crsf_line.empty()) {
+    wake_us = std::min(wake_us, crsf_line.front().time_us);
+  }
+  if (sercom3.transmitting) {
+    wake_us = std::min(wake_us, sercom3.tx_free_us);
+  }
+  if (imu_handler != NULL && imu_edge) {
+    wake_us = std::min(wake_us, next_imu_us);
+  }
+  if (wake_us > now_us) {
+    asleep_us += wake_us - now_us;
+    now_us = wake_us;
+  }
+}
+
+void __DSB() {}
+
+void __disable_irq() {
+  noInterrupts();
+}
+
+void __enable_irq() {
+  interrupts();
+}
+
+uint32_t __get_PRIMASK() {
+  return interrupts_enabled ? 0 : 1;
+}
+
+void __set_PRIMASK(uint32_t primask) {
+  if (primask) {
+    noInterrupts();
+  } else {
+    interrupts();
+  }
+}
+
+void SERCOM::initUART(SercomUartMode, SercomUartSampleRate, uint32_t baudrate) {
+  byte_us = 10.0 * 1000000.0 / baudrate;
+}
+
+bool SERCOM::availableDataUART() {
+  return rx_count > 0;
+}
+
+uint8_t SERCOM::readDataUART() {
+  uint8_t byte = rx[0];
+  rx[0] = rx[1];
+  rx_count--;
+  return byte;
+}
+
+bool SERCOM::isDataRegisterEmptyUART() {
+  return tx_free_us <= now_us;
+}
+
+// The sketch queued a telemetry frame
+void SERCOM::enableDataRegisterEmptyInterruptUART() {
+  BenchCall call;
+  spend(TELEMETRY_FRAME_US);
+  transmitting = true;
+}
+
+int SERCOM::writeDataUART(uint8_t) {
+  tx_free_us = std::max(tx_free_us, now_us) + byte_us;
+  tx_bytes++;
+  return 1;
+}
+
+// Sequence number of the newest frame whose marker is value
+static long markerSequence(uint16_t value) {
+  long newest = (long)(std::upper_bound(frame_end_us.begin(), frame_end_us.end(), now_us) - frame_end_us.begin()) - 1;
+  long marker = (long)value - CHANNEL_LOW;
+  if (newest < 0 || marker < 0 || marker >= MARKER_RANGE) {
+    return -1;
+  }
+  return newest - ((newest - marker) % MARKER_RANGE + MARKER_RANGE) % MARKER_RANGE;
+}
+
+// An output took the values of the frame the sketch parsed last
+static void recordOutput(Output output, double at_us) {
+  long sequence = markerSequence(remote.getChannelRaw(MARKER_CHANNEL));
+  if (sequence < 0 || sequence <= written[output]) {
+    return;
+  }
+  if (recording) {
+    latencies[output].push_back(at_us - frame_end_us[sequence]);
+    if (written[output] >= 0) {
+      superseded[output] += sequence - written[output] - 1;
+    }
+  }
+  written[output] = sequence;
+}
+
+ServoOutput::ServoOutput(uint8_t pin, uint8_t channel) {
+  this->pin = pin;
+  this->channel = channel;
+}
+
+void ServoOutput::begin(uint16_t frame_rate_hz) {
+  this->frame_rate_hz = frame_rate_hz;
+}
+
+void ServoOutput::writeMicroseconds(float pulse_us) {
+  BenchCall call;
+  spend(OUTPUT_US);
+  ticks = (uint32_t)(pulse_us * SERVO_OUTPUT_TICKS_PER_US);
+  recordOutput(OUTPUT_SERVO, now_us);
+}
+
+void ServoOutput::disable() {
+  ticks = 0;
+}
+
+bool ServoOutput::isEnabled() {
+  return ticks != 0;
+}
+
+uint16_t ServoOutput::getFrameRate() {
+  return frame_rate_hz;
+}
+
+void nvmRead(uint32_t address, void *data, uint32_t length) {
+  BenchCall call;
+  memcpy(data, &flash[address], length);
+}
+
+void nvmEraseRow(uint32_t address) {
+  BenchCall call;
+  stall(NVM_ERASE_US);
+  memset(&flash[address], 0xFF, NVM_ROW_SIZE);
+}
+
+void nvmWritePage(uint32_t address, const void *data) {
+  BenchCall call;
+  stall(NVM_PAGE_US);
+  for (uint32_t i = 0; i < NVM_PAGE_SIZE; i++) {
+    flash[address + i] &= ((const uint8_t *)data)[i];
+  }
+}
+
+// The VESC at the far end of Serial1. Setpoints are timed when their last byte is on the wire,
+// value requests are answered with a car standing still.
+class MockVesc : public HardwareSerial {
+  public:
+    using HardwareSerial::write;
+
+    void begin(unsigned long baud) {
+      byte_us = 10.0 * 1000000.0 / baud;
+    }
+
+    void begin(unsigned long baud, uint16_t) {
+      begin(baud);
+    }
+
+    void end() {}
+    void flush() {}
+
+    int available() {
+      BenchCall call;
+      int count = 0;
+      for (const TimedByte &byte : rx) {
+        if (byte.time_us > now_us) {
+          break;
+        }
+        count++;
+      }
+      return count;
+    }
+
+    int read() {
+      if (available() == 0) {
+        return -1;
+      }
+      uint8_t value = rx.front().value;
+      rx.pop_front();
+      return value;
+    }
+
+    int peek() {
+      return available() > 0 ? rx.front().value : -1;
+    }
+
+    int availableForWrite() {
+      BenchCall call;
+      int queued = (int)ceil((tx_free_us - now_us) / byte_us);
+      return CORE_TX_BUFFER - std::max(queued, 0);
+    }
+
+    size_t write(uint8_t byte) {
+      BenchCall call;
+      tx_free_us = std::max(tx_free_us, now_us) + byte_us;
+      if (parser.feed(byte)) {
+        if (parser.payload[0] == COMM_SET_RPM) {
+          recordOutput(OUTPUT_ESC, tx_free_us);
+        } else if (parser.payload[0] == COMM_GET_VALUES_SELECTIVE) {
+          reply(tx_free_us + VESC_TURNAROUND_US);
+        }
+      }
+      return 1;
+    }
+
+  private:
+    void reply(double start_us) {
+      // the mask echoed, then the selected fields in mask order, all zero
+      uint8_t payload[VESC_PAYLOAD_SIZE_MAX] = {};
+      memcpy(payload, parser.payload, 5);
+      uint8_t length = 5;
+      uint32_t mask = ((uint32_t)parser.payload[1] << 24) | ((uint32_t)parser.payload[2] << 16) | ((uint32_t)parser.payload[3] << 8) | parser.payload[4];
+      static const uint8_t sizes[] = {2, 2, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, 4};
+      for (uint8_t bit = 0; bit < sizeof(sizes); bit++) {
+        if (mask & (1UL << bit)) {
+          length += sizes[bit];
+        }
+      }
+      uint8_t packet[VESC_PAYLOAD_SIZE_MAX + VESC_PACKET_OVERHEAD];
+      uint16_t crc = vescCrc16(payload, length);
+      packet[0] = 2;
+      packet[1] = length;
+      memcpy(packet + 2, payload, length);
+      packet[2 + length] = crc >> 8;
+      packet[3 + length] = crc & 0xFF;
+      packet[4 + length] = 3;
+      for (uint8_t i = 0; i < length + VESC_PACKET_OVERHEAD; i++) {
+        rx.push_back({start_us + (i + 1) * byte_us, packet[i]});
+      }
+    }
+
+    VescPacketParser parser;
+    std::deque<TimedByte> rx;
+    double byte_us = 1;
+    double tx_free_us = 0;
+};
+
+static MockVesc vesc;
+HardwareSerial &Serial1 = vesc;
+
+void AutoPID::run() {
+  BenchCall call;
+  spend(PID_US);
+  unsigned long dt = millis() - last_step;
+  if (dt < time_step) {
+    return;
+  }
+  last_step = millis();
+  double error = *setpoint - *input;
+  integral += (error + previous_error) / 2 * dt / 1000.0;
+  double derivative = (error - previous_error) / dt / 1000.0;
+  previous_error = error;
+  double pid = kp * error + ki * integral + kd * derivative;
+  *output = constrain(pid, output_min, output_max);
+}
+
+status_t LSM6DS3::begin() {
+  BenchCall call;
+  spend(IMU_BEGIN_US);
+  if (imu_failures > 0) {
+    imu_failures--;
+    return IMU_HW_ERROR;
+  }
+  return IMU_SUCCESS;
+}
+
+status_t LSM6DS3::readRegisterRegion(uint8_t *output, uint8_t, uint8_t length) {
+  BenchCall call;
+  spend(IMU_US);
+  memset(output, 0, length);
+  // gravity on z
+  output[10] = 8197 & 0xFF;
+  output[11] = 8197 >> 8;
+  double period_us = 1000000.0 / IMU_RATE_HZ;
+  next_imu_us = (floor(now_us / period_us) + 1) * period_us;
+  imu_edge = true;
+  return IMU_SUCCESS;
+}
+
+struct Mode {
+  const char *name;
+  DriveMode mode;
+  uint16_t select; // channel 3
+  uint16_t assist; // channel 4
+};
+
+static const Mode MODES[] = {
+  {"DIRECT", DriveMode::DIRECT, CHANNEL_MID, CHANNEL_LOW},
+  {"STEER_ASSIST", DriveMode::STEER_ASSIST, CHANNEL_MID, CHANNEL_HIGH},
+  {"TURN_ASSIST", DriveMode::TURN_ASSIST, CHANNEL_HIGH, CHANNEL_LOW},
+  {"AUTONOMOUS", DriveMode::AUTONOMOUS, CHANNEL_HIGH, CHANNEL_HIGH},
+};
+
+struct Row {
+  std::string mode;
+  std::string config;
+  Output output;
+  size_t frames;
+  double min, p50, p99, max;
+  uint32_t superseded;
+  double pass_hz;
+};
+
+struct LoadRow {
+  std::string mode;
+  std::string config;
+  double pass_hz;
+  double load; // percent awake, from the time the bench kept the core asleep
+  double sketch_load; // what the sketch accounted
+};
+
+static void packChannels(const uint16_t *channels, uint8_t *payload) {
+  memset(payload, 0, 22);
+  for (int i = 0; i < CRSF_CHANNEL_COUNT; i++) {
+    uint32_t bit = i * 11;
+    for (int b = 0; b < 11; b++, bit++) {
+      if (channels[i] & (1 << b)) {
+        payload[bit / 8] |= 1 << (bit % 8);
+      }
+    }
+  }
+}
+
+// Queues channels frames on the CRSF line until end_us, a link statistics frame behind every tenth
+static void queueFrames(const Mode &mode, bool teach, double crsf_hz, double end_us) {
+  static double next_frame_us = 0;
+  double byte_us = 10.0 * 1000000.0 / CRSF_BAUDRATE;
+  uint8_t frame[CRSF_FRAME_SIZE_MAX];
+  uint8_t payload[22];
+  next_frame_us = std::max(next_frame_us, now_us);
+  while (next_frame_us < end_us) {
+    long sequence = (long)frame_end_us.size();
+    uint16_t channels[CRSF_CHANNEL_COUNT];
+    for (int i = 0; i < CRSF_CHANNEL_COUNT; i++) {
+      channels[i] = CHANNEL_MID;
+    }
+    // moving sticks, every frame changes the throttle setpoint so each one reaches the ESC
+    channels[0] = CHANNEL_MID + 50 + (sequence % 16) * 25;
+    channels[1] = CHANNEL_MID - 100 + (sequence * 37) % 200;
+    channels[2] = mode.select;
+    channels[3] = mode.assist;
+    channels[TEACH_CHANNEL] = teach ? CHANNEL_HIGH : CHANNEL_LOW;
+    channels[AUTOTUNE_CHANNEL] = CHANNEL_LOW;
+    channels[MARKER_CHANNEL] = CHANNEL_LOW + sequence % MARKER_RANGE;
+    packChannels(channels, payload);
+    uint8_t length = crsfBuildFrame(frame, CRSF_FRAMETYPE_RC_CHANNELS_PACKED, payload, sizeof(payload));
+    double t = next_frame_us;
+    for (uint8_t i = 0; i < length; i++) {
+      t += byte_us;
+      crsf_line.push_back({t, frame[i]});
+    }
+    frame_end_us.push_back(t);
+    if (sequence % 10 == 9) {
+      // a clean link: -40 dBm, 100% LQ, 10 dB SNR
+      uint8_t stats[10] = {40, 40, 100, 10};
+      length = crsfBuildFrame(frame, CRSF_FRAMETYPE_LINK_STATISTICS, stats, sizeof(stats));
+      for (uint8_t i = 0; i < length; i++) {
+        t += byte_us;
+        crsf_line.push_back({t, frame[i]});
+      }
+    }
+    next_frame_us += 1000000.0 / crsf_hz;
+  }
+}
+
+// Host cost of a clock read, taken out of what --cpu-scale charges
+static void calibrateClock() {
+  const int reads = 1000000;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reads; i++) {
+    host_mark = std::chrono::steady_clock::now();
+  }
+  clock_overhead_us = std::chrono::duration<double, std::micro>(host_mark - start).count() / reads;
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return NAN;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1))];
+}
+
+static void runConfig(const Mode &mode, bool teach, double crsf_hz, double seconds, std::vector<Row> &rows, std::vector<LoadRow> &loads) {
+  double start_us = now_us;
+  queueFrames(mode, teach, crsf_hz, start_us + WARMUP_US + seconds * 1000000.0);
+  recording = false;
+  while (now_us < start_us + WARMUP_US) {
+    loop();
+  }
+  for (int output = 0; output < OUTPUT_COUNT; output++) {
+    latencies[output].clear();
+    superseded[output] = 0;
+  }
+  recording = true;
+  passes = 0;
+  asleep_us = 0;
+  while (now_us < start_us + WARMUP_US + seconds * 1000000.0) {
+    loop();
+  }
+  recording = false;
+  if (drive_mode != mode.mode) {
+    fprintf(stderr, "%s didn't engage\n", mode.name);
+  }
+
+  char config[32];
+  snprintf(config, sizeof(config), "%.0fHz%s", crsf_hz, teach ? "+teach" : "");
+  for (int output = 0; output < OUTPUT_COUNT; output++) {
+    const std::vector<double> &values = latencies[output];
+    if (values.empty()) {
+      continue;
+    }
+    rows.push_back({mode.name, config, (Output)output, values.size(), percentile(values, 0), percentile(values, 0.5),
+                    percentile(values, 0.99), percentile(values, 1), superseded[output], passes / seconds});
+  }
+  loads.push_back({mode.name, config, passes / seconds, 100.0 * (1.0 - asleep_us / (seconds * 1000000.0)), loop_events.getLoad()});
+}
+
+static std::string rowKey(const Row &row) {
+  return row.mode + " " + row.config + " " + OUTPUT_NAMES[row.output];
+}
+
+static bool saveRows(const char *path, const std::vector<Row> &rows) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return false;
+  }
+  for (const Row &row : rows) {
+    fprintf(file, "%s %.0f %.0f\n", rowKey(row).c_str(), row.p50, row.p99);
+  }
+  fclose(file);
+  return true;
+}
+
+// Returns the number of rows that got slower than the baseline allows, -1 if it can't be read
+static int checkRows(const char *path, const std::vector<Row> &rows, double tolerance, double slack) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+  int regressions = 0;
+  char mode[32], config[32], output[16];
+  double p50, p99;
+  while (fscanf(file, "%31s %31s %15s %lf %lf", mode, config, output, &p50, &p99) == 5) {
+    std::string key = std::string(mode) + " " + config + " " + output;
+    for (const Row &row : rows) {
+      if (rowKey(row) != key) {
+        continue;
+      }
+      double limit50 = p50 * (1 + tolerance / 100) + slack;
+      double limit99 = p99 * (1 + tolerance / 100) + slack;
+      if (row.p50 > limit50 || row.p99 > limit99) {
+        printf("REGRESSION %s: p50 %.0f us (was %.0f), p99 %.0f us (was %.0f)\n", key.c_str(), row.p50, p50, row.p99, p99);
+        regressions++;
+      }
+    }
+  }
+  fclose(file);
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  double seconds = 5;
+  std::vector<double> rates = {50, 150, 500};
+  const char *save_path = NULL;
+  const char *check_path = NULL;
+  double tolerance = 15;
+  double slack = 50;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--rates") && i + 1 < argc) {
+      rates.clear();
+      for (char *rate = strtok(argv[++i], ","); rate != NULL; rate = strtok(NULL, ",")) {
+        rates.push_back(atof(rate));
+      }
+    } else if (!strcmp(argv[i], "--cpu-scale") && i + 1 < argc) {
+      cpu_scale = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--save") && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (!strcmp(argv[i], "--check") && i + 1 < argc) {
+      check_path = argv[++i];
+    } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--slack") && i + 1 < argc) {
+      slack = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--imu-failures") && i + 1 < argc) {
+      imu_failures = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds S] [--rates HZ,HZ..] [--cpu-scale X] [--save FILE] [--check FILE] [--tolerance PCT] [--slack US] [--imu-failures N]\n", argv[0]);
+      return 1;
+    }
+  }
+  for (double rate : rates) {
+    if (rate <= 0) {
+      fprintf(stderr, "rates must be above 0\n");
+      return 1;
+    }
+  }
+  if (seconds <= 0 || cpu_scale < 0) {
+    fprintf(stderr, "seconds must be above 0 and the cpu scale not negative\n");
+    return 1;
+  }
+
+  if (cpu_scale > 0) {
+    calibrateClock();
+  }
+  setup();
+  std::vector<Row> rows;
+  std::vector<LoadRow> loads;
+  for (double rate : rates) {
+    for (const Mode &mode : MODES) {
+      runConfig(mode, false, rate, seconds, rows, loads);
+      if (mode.mode == DriveMode::DIRECT) {
+        runConfig(mode, true, rate, seconds, rows, loads);
+      }
+    }
+  }
+
+  printf("startup: armed after %u ms\n", startup.getArmedMs());
+  for (uint8_t i = 0; i < startup.getCount(); i++) {
+    const char *state = startup.isReady(i) ? "ready" : (startup.getState(i) == StartupState::FAILED ? "failed" : "starting");
+    printf("  %-6s %-8s %6u ms %3u attempts\n", startup.getName(i), state, startup.getDoneMs(i), startup.getAttempts(i));
+  }
+  printf("\n");
+
+  printf("%.0f s per configuration, cpu scale %.0f\n", seconds, cpu_scale);
+  printf("%-12s %-12s %-6s %7s %7s %7s %7s %7s %10s %7s\n", "mode", "config", "output", "frames", "min us", "p50 us", "p99 us", "max us",
+         "superseded", "pass/s");
+  for (const Row &row : rows) {
+    printf("%-12s %-12s %-6s %7zu %7.0f %7.0f %7.0f %7.0f %10u %7.0f\n", row.mode.c_str(), row.config.c_str(), OUTPUT_NAMES[row.output],
+           row.frames, row.min, row.p50, row.p99, row.max, row.superseded, row.pass_hz);
+  }
+  printf("%u CRSF bytes lost to flash stalls\n\n", crsf_port.getChannel()->hw_overruns);
+
+  printf("MCU current at %.1f mA running, %.1f mA asleep\n", MCU_RUN_MA, MCU_IDLE_MA);
+  printf("%-12s %-12s %7s %7s %7s %7s %7s\n", "mode", "config", "pass/s", "load %", "sketch", "mA", "saved");
+  int accounting_errors = 0;
+  for (const LoadRow &row : loads) {
+    double ma = MCU_IDLE_MA + (MCU_RUN_MA - MCU_IDLE_MA) * row.load / 100.0;
+    printf("%-12s %-12s %7.0f %7.1f %7.1f %7.2f %6.0f%%\n", row.mode.c_str(), row.config.c_str(), row.pass_hz, row.load, row.sketch_load, ma,
+           100.0 * (1.0 - ma / MCU_RUN_MA));
+    if (fabs(row.load - row.sketch_load) > LOAD_TOLERANCE) {
+      accounting_errors++;
+    }
+  }
+  if (accounting_errors > 0) {
+    printf("the sketch's CPU load is off by more than %.0f points in %d configurations\n", LOAD_TOLERANCE, accounting_errors);
+    return 2;
+  }
+
+  if (save_path != NULL && !saveRows(save_path, rows)) {
+    fprintf(stderr, "can't write %s\n", save_path);
+    return 1;
+  }
+  if (check_path != NULL) {
+    int regressions = checkRows(check_path, rows, tolerance, slack);
+    if (regressions < 0) {
+      fprintf(stderr, "can't read %s\n", check_path);
+      return 1;
+    }
+    if (regressions > 0) {
+      return 2;
+    }
+    printf("no regressions against %s\n", check_path);
+  }
+  return 0;
+}
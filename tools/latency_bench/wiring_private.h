@@ -0,0 +1,8 @@
+// Pin muxing is a no-op on the host, see Arduino.h
+
+#ifndef WIRING_PRIVATE_H
+#define WIRING_PRIVATE_H
+
+inline void pinPeripheral(int, int) {}
+
+#endif // WIRING_PRIVATE_H
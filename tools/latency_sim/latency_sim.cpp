@@ -0,0 +1,253 @@
+// Stick to output latency of the DIRECT mode with the outputs written once per loop() pass,
+// against the deferred work slots run on the CRSF frame-complete event.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/latency_sim/latency_sim.cpp CRSFProtocol.cpp -o latency_sim
+// Run:     ./latency_sim [--seconds S] [--crsf-hz HZ] [--teach] [--no-osd] [--seed N]
+//
+// The loop() tasks run for the estimated SAMD21 durations below, each jittered by +-20%. The
+// CRSF stream is real frames at 420 kbaud, RC channels plus a link statistics frame every tenth,
+// and the event comes from CRSFFrameDetector fed byte by byte as the port interrupt does.
+// Latency runs from the last byte of a channels frame to the write of its values; the servo
+// then picks the pulse up at its next frame, the same wait in both. A frame replaced by a newer
+// one before it was written is counted as superseded. --teach adds the page writes of a lap
+// being taught.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "CRSFProtocol.h"
+
+#define BYTE_US (10.0 * 1000000.0 / CRSF_BAUDRATE)
+#define BIN_US 250
+#define BINS 20 // the last bin holds everything longer
+
+// estimated task durations on the SAMD21 at 48 MHz, us
+#define POLL_US 15
+#define PARSE_US 45 // a channels frame through the parser and unpack
+#define REMOTE_US 35 // handleRemote() in DIRECT
+#define OUTPUT_US 45 // executeCommands() and esc.update()
+
+struct Task {
+  const char *name;
+  double us;
+  double period_us; // 0 runs every pass
+  bool slot_after; // serviceRemoteEvent() follows the task
+};
+
+// loop() in order, outputs marks where executeCommands() runs
+static std::vector<Task> loopTasks(bool teach, bool osd) {
+  std::vector<Task> tasks = {
+    {"imu", 330, 1000000.0 / 416, true}, // SPI read, gyro filter, attitude update
+    {"esc telemetry", 180, 10000, true}, // odometry, GPS and voltage frames
+    {"remote", REMOTE_US, 0, false},
+    {"params", 4, 0, true},
+    {"turn rate pid", 60, 0, false},
+    {"outputs", OUTPUT_US, 0, false},
+    {"teach", teach ? 2500.0 : 0.0, 630000, true}, // a page write per 64 bytes of taught lap
+    {"osd", osd ? 900.0 : 0.0, 100000, true}, // AHI and pose string
+  };
+  return tasks;
+}
+
+struct Stream {
+  std::vector<double> byte_us;
+  std::vector<uint8_t> bytes;
+  std::vector<double> frame_end_us; // channels frames only
+};
+
+static Stream buildStream(double seconds, double crsf_hz, std::mt19937 &rng) {
+  Stream stream;
+  std::uniform_real_distribution<double> phase(0, 1000000.0 / crsf_hz);
+  uint8_t frame[CRSF_FRAME_SIZE_MAX];
+  uint8_t payload[22] = {};
+  double t = phase(rng);
+  for (uint32_t n = 0; t < seconds * 1000000.0; n++, t += 1000000.0 / crsf_hz) {
+    payload[0] = (uint8_t)n; // a moving stick
+    uint8_t length = crsfBuildFrame(frame, CRSF_FRAMETYPE_RC_CHANNELS_PACKED, payload, sizeof(payload));
+    double byte_time = t;
+    for (uint8_t i = 0; i < length; i++) {
+      byte_time += BYTE_US;
+      stream.byte_us.push_back(byte_time);
+      stream.bytes.push_back(frame[i]);
+    }
+    stream.frame_end_us.push_back(byte_time);
+    if (n % 10 == 9) {
+      // link statistics right behind it, the detector must not fire on it
+      uint8_t stats[10] = {};
+      length = crsfBuildFrame(frame, CRSF_FRAMETYPE_LINK_STATISTICS, stats, sizeof(stats));
+      for (uint8_t i = 0; i < length; i++) {
+        byte_time += BYTE_US;
+        stream.byte_us.push_back(byte_time);
+        stream.bytes.push_back(frame[i]);
+      }
+    }
+  }
+  return stream;
+}
+
+struct Result {
+  uint32_t histogram[BINS];
+  std::vector<double> latencies;
+  uint32_t superseded;
+  uint32_t passes;
+  uint32_t events;
+  double seconds;
+};
+
+class Simulation {
+  public:
+    Simulation(const Stream &stream, bool slots) : stream(stream), slots(slots) {}
+
+    Result run(const std::vector<Task> &tasks, double seconds, std::mt19937 &rng) {
+      std::uniform_real_distribution<double> jitter(0.8, 1.2);
+      std::vector<double> last_run(tasks.size(), -1e12);
+      double t = 0;
+      while (t < seconds * 1000000.0) {
+        // loop() starts by clearing the event and polling every port
+        feedDetector(t);
+        event = false;
+        t += POLL_US + (parse(t) ? PARSE_US : 0);
+        for (size_t i = 0; i < tasks.size(); i++) {
+          const Task &task = tasks[i];
+          if (task.period_us == 0 || t - last_run[i] >= task.period_us) {
+            last_run[i] = t;
+            t += task.us * jitter(rng);
+          }
+          if (!strcmp(task.name, "outputs")) {
+            output(t);
+          }
+          if (slots && task.slot_after) {
+            feedDetector(t);
+            if (event) {
+              event = false;
+              result.events++;
+              double start = t;
+              t += POLL_US + (parse(start) ? PARSE_US : 0) + REMOTE_US + OUTPUT_US;
+              output(t);
+            }
+          }
+        }
+        result.passes++;
+      }
+      result.seconds = t / 1000000.0;
+      return result;
+    }
+
+  private:
+    // the port interrupt, for every byte that has arrived by now
+    void feedDetector(double now_us) {
+      while (next_byte < stream.bytes.size() && stream.byte_us[next_byte] <= now_us) {
+        if (detector.feed(stream.bytes[next_byte], (uint32_t)stream.byte_us[next_byte])) {
+          event = true;
+        }
+        next_byte++;
+      }
+    }
+
+    // True if a channels frame newer than the last parsed one is in by now
+    bool parse(double now_us) {
+      bool parsed = false;
+      while (next_frame < stream.frame_end_us.size() && stream.frame_end_us[next_frame] <= now_us) {
+        latest = next_frame++;
+        parsed = true;
+      }
+      return parsed;
+    }
+
+    void output(double now_us) {
+      if (latest < 0 || latest == written) {
+        return;
+      }
+      double latency = now_us - stream.frame_end_us[latest];
+      result.latencies.push_back(latency);
+      int bin = (int)(latency / BIN_US);
+      result.histogram[bin < BINS ? bin : BINS - 1]++;
+      result.superseded += latest - written - 1;
+      written = latest;
+    }
+
+    const Stream &stream;
+    bool slots;
+    CRSFFrameDetector detector;
+    bool event = false;
+    size_t next_byte = 0;
+    size_t next_frame = 0;
+    long latest = -1;
+    long written = -1;
+    Result result = {};
+};
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return NAN;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1))];
+}
+
+int main(int argc, char **argv) {
+  double seconds = 60;
+  double crsf_hz = 150;
+  bool teach = false, osd = true;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--crsf-hz") && i + 1 < argc) {
+      crsf_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--teach")) {
+      teach = true;
+    } else if (!strcmp(argv[i], "--no-osd")) {
+      osd = false;
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds S] [--crsf-hz HZ] [--teach] [--no-osd] [--seed N]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (seconds <= 0 || crsf_hz <= 0) {
+    fprintf(stderr, "seconds and rate must be above 0\n");
+    return 1;
+  }
+
+  std::mt19937 stream_rng(seed);
+  Stream stream = buildStream(seconds, crsf_hz, stream_rng);
+  std::vector<Task> tasks = loopTasks(teach, osd);
+  const char *names[] = {"per pass", "event"};
+  Result results[2];
+  for (int slots = 0; slots < 2; slots++) {
+    std::mt19937 rng(seed);
+    results[slots] = Simulation(stream, slots).run(tasks, seconds, rng);
+  }
+
+  printf("%.0f s, %.0f Hz CRSF, osd %s, teach %s\n", seconds, crsf_hz, osd ? "on" : "off", teach ? "on" : "off");
+  printf("%-9s %8s %8s %8s %8s %8s %10s %8s\n", "outputs", "p50 us", "p90 us", "p99 us", "max us", "frames", "superseded", "pass/s");
+  for (int i = 0; i < 2; i++) {
+    const Result &r = results[i];
+    printf("%-9s %8.0f %8.0f %8.0f %8.0f %8zu %10u %8.0f\n", names[i], percentile(r.latencies, 0.5), percentile(r.latencies, 0.9),
+           percentile(r.latencies, 0.99), percentile(r.latencies, 1.0), r.latencies.size(), r.superseded, r.passes / r.seconds);
+  }
+  printf("%u frame events for %zu channels frames\n\n", results[1].events, stream.frame_end_us.size());
+
+  printf("%-13s %9s %9s\n", "latency us", names[0], names[1]);
+  for (int bin = 0; bin < BINS; bin++) {
+    if (results[0].histogram[bin] == 0 && results[1].histogram[bin] == 0) {
+      continue;
+    }
+    char label[24];
+    if (bin < BINS - 1) {
+      snprintf(label, sizeof(label), "%5d-%-5d", bin * BIN_US, (bin + 1) * BIN_US);
+    } else {
+      snprintf(label, sizeof(label), "%5d+", bin * BIN_US);
+    }
+    printf("%-13s %8.1f%% %8.1f%%\n", label, 100.0 * results[0].histogram[bin] / results[0].latencies.size(),
+           100.0 * results[1].histogram[bin] / results[1].latencies.size());
+  }
+  return 0;
+}
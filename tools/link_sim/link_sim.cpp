@@ -0,0 +1,222 @@
+// Reaction of LinkMonitor to synthetic degrading CRSF links, against the fixed 200 ms remote and
+// 500 ms output timeouts it replaced.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/link_sim/link_sim.cpp LinkMonitor.cpp CRSFProtocol.cpp -o link_sim
+// Run:     ./link_sim [--rates HZ,HZ..] [--seed N]
+//
+// Channels frames are sent at the packet rate and each arrives with a chance set by the scenario.
+// The receiver sends link statistics every 100 ms with the LQ of its last 100 packets, and the
+// monitor is polled every 200 us as loop() does, with the sketch's defaults.
+//   cut    a clean link stops dead, the delay from the last frame to the car stopping
+//   fade   delivery falls from 100% to 0 over 20 s, when the speed is cut and the link dropped
+//   burst  a clean link loses everything for a while once a second, stops per burst
+// The old code held the last command until 500 ms after the last frame and then stopped
+// commanding the VESC, which only stops on its own timeout, so its stop times are a lower bound.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "LinkMonitor.h"
+
+// FPV_RC_Car.ino defaults
+#define LINK_LQ_FULL 70
+#define LINK_LQ_MIN 30
+#define LINK_MIN_SPEED_SCALE 0.3f
+#define LINK_FAILSAFE_FRAMES 8
+#define LINK_FAILSAFE_MIN_US 20000
+#define LINK_FAILSAFE_MAX_US 200000
+#define OLD_REMOTE_TIMEOUT_US 200000
+#define OLD_OUTPUT_TIMEOUT_US 500000
+
+#define PASS_US 200
+#define STATS_INTERVAL_US 100000
+#define LQ_WINDOW 100 // packets
+
+// What the monitor made of a run
+struct Trace {
+  std::vector<double> failsafe_on_us; // startup excluded
+  std::vector<double> failsafe_off_us;
+  std::vector<double> last_frame_before_us; // newest frame before each failsafe
+  double first_scaled_us = -1; // speed scale first below 1
+  double first_min_scale_us = -1;
+  double first_stats_below_full_us = -1; // first statistics under LINK_LQ_FULL
+  double old_stop_us = -1; // first frame gap the old 500 ms timeout would have stopped on
+  double old_lost_us = -1; // first gap over the old 200 ms remote timeout
+  uint32_t frames = 0;
+  uint32_t slots = 0;
+};
+
+typedef std::function<bool(double t_us, std::mt19937 &rng)> Delivery;
+
+static Trace run(double rate_hz, double seconds, const Delivery &delivered, std::mt19937 &rng) {
+  LinkMonitor monitor(LINK_LQ_FULL, LINK_LQ_MIN, LINK_MIN_SPEED_SCALE, LINK_FAILSAFE_FRAMES, LINK_FAILSAFE_MIN_US, LINK_FAILSAFE_MAX_US);
+  Trace trace;
+  double period_us = 1000000.0 / rate_hz;
+  double next_slot_us = period_us;
+  double next_stats_us = STATS_INTERVAL_US;
+  std::vector<bool> window;
+  uint32_t window_hits = 0;
+  uint32_t channel_frames = 0;
+  uint32_t last_channels_us = 0;
+  double last_frame_us = -1;
+  bool was_failsafe = true;
+  bool started = false;
+  for (double t = 0; t < seconds * 1000000.0; t += PASS_US) {
+    while (next_slot_us <= t) {
+      bool hit = delivered(next_slot_us, rng);
+      window.push_back(hit);
+      window_hits += hit;
+      if (window.size() > LQ_WINDOW) {
+        window_hits -= window[window.size() - LQ_WINDOW - 1];
+      }
+      trace.slots++;
+      if (hit) {
+        if (last_frame_us >= 0 && trace.old_lost_us < 0 && next_slot_us - last_frame_us > OLD_REMOTE_TIMEOUT_US) {
+          trace.old_lost_us = last_frame_us + OLD_REMOTE_TIMEOUT_US;
+        }
+        if (last_frame_us >= 0 && trace.old_stop_us < 0 && next_slot_us - last_frame_us > OLD_OUTPUT_TIMEOUT_US) {
+          trace.old_stop_us = last_frame_us + OLD_OUTPUT_TIMEOUT_US;
+        }
+        channel_frames++;
+        last_channels_us = (uint32_t)next_slot_us;
+        last_frame_us = next_slot_us;
+        trace.frames++;
+      }
+      next_slot_us += period_us;
+    }
+    if (next_stats_us <= t) {
+      // statistics need a packet to ride on
+      if (last_frame_us >= 0 && t - last_frame_us < STATS_INTERVAL_US) {
+        crsfLinkStatistics_t stats = {};
+        stats.uplinkRssi1 = 60;
+        stats.uplinkLinkQuality = (uint8_t)(100 * window_hits / (window.size() < LQ_WINDOW ? window.size() : LQ_WINDOW));
+        monitor.statisticsReceived(stats, (uint32_t)t);
+        if (trace.first_stats_below_full_us < 0 && stats.uplinkLinkQuality < LINK_LQ_FULL) {
+          trace.first_stats_below_full_us = t;
+        }
+      }
+      next_stats_us += STATS_INTERVAL_US;
+    }
+    monitor.update(channel_frames, last_channels_us, (uint32_t)t);
+
+    bool failsafe = monitor.isFailsafe();
+    if (failsafe != was_failsafe) {
+      if (!failsafe) {
+        if (started) {
+          trace.failsafe_off_us.push_back(t);
+        }
+        started = true;
+      } else {
+        trace.failsafe_on_us.push_back(t);
+        trace.last_frame_before_us.push_back(last_frame_us);
+      }
+      was_failsafe = failsafe;
+    }
+    float scale = monitor.getSpeedScale();
+    if (trace.first_scaled_us < 0 && scale < 1.0f) {
+      trace.first_scaled_us = t;
+    }
+    if (trace.first_min_scale_us < 0 && scale <= LINK_MIN_SPEED_SCALE) {
+      trace.first_min_scale_us = t;
+    }
+  }
+  // a link that never came back
+  if (last_frame_us >= 0 && trace.old_lost_us < 0 && seconds * 1000000.0 - last_frame_us > OLD_REMOTE_TIMEOUT_US) {
+    trace.old_lost_us = last_frame_us + OLD_REMOTE_TIMEOUT_US;
+  }
+  if (last_frame_us >= 0 && trace.old_stop_us < 0 && seconds * 1000000.0 - last_frame_us > OLD_OUTPUT_TIMEOUT_US) {
+    trace.old_stop_us = last_frame_us + OLD_OUTPUT_TIMEOUT_US;
+  }
+  return trace;
+}
+
+static void cut(const std::vector<double> &rates, uint32_t seed) {
+  printf("cut: clean link lost at 2 s\n");
+  printf("%8s %12s %12s\n", "rate Hz", "stop ms", "old stop ms");
+  for (double rate : rates) {
+    std::mt19937 rng(seed);
+    Trace trace = run(rate, 3, [](double t, std::mt19937 &) { return t < 2000000.0; }, rng);
+    double stop = trace.failsafe_on_us.empty() ? -1 : (trace.failsafe_on_us[0] - trace.last_frame_before_us[0]) / 1000.0;
+    printf("%8.0f %12.1f %12.1f\n", rate, stop, OLD_OUTPUT_TIMEOUT_US / 1000.0);
+  }
+  printf("\n");
+}
+
+static void fade(const std::vector<double> &rates, uint32_t seed) {
+  const double fade_us = 20000000.0;
+  // delivery chance at a time of the fade
+  auto chance = [=](double t) { return t < 1000000.0 ? 1.0 : std::max(0.0, 1.0 - (t - 1000000.0) / fade_us); };
+  printf("fade: delivery 100%% at 1 s to 0 at 21 s, columns give the delivery %% at that moment\n");
+  printf("%8s %10s %10s %10s %12s %12s %12s\n", "rate Hz", "LQ<full", "scaled", "min speed", "first stop", "stops>=50%", "old stop");
+  for (double rate : rates) {
+    std::mt19937 rng(seed);
+    Trace trace = run(rate, 22, [&](double t, std::mt19937 &r) { return std::uniform_real_distribution<double>(0, 1)(r) < chance(t); }, rng);
+    auto at = [&](double t) { return t < 0 ? -1.0 : 100.0 * chance(t); };
+    int early = 0;
+    for (double t : trace.failsafe_on_us) {
+      early += chance(t) >= 0.5;
+    }
+    printf("%8.0f %9.0f%% %9.0f%% %9.0f%% %11.0f%% %12d %11.0f%%\n", rate, at(trace.first_stats_below_full_us), at(trace.first_scaled_us),
+           at(trace.first_min_scale_us), at(trace.failsafe_on_us.empty() ? -1 : trace.failsafe_on_us[0]), early, at(trace.old_stop_us));
+  }
+  printf("\n");
+}
+
+static void burst(const std::vector<double> &rates, uint32_t seed) {
+  const double bursts_ms[] = {10, 25, 50, 100, 150, 250};
+  printf("burst: everything lost for a while once a second for 20 s\n");
+  printf("%8s %9s %10s %12s %12s %10s\n", "rate Hz", "burst ms", "stops", "stop ms", "stopped ms", "old stops");
+  for (double rate : rates) {
+    for (double burst_ms : bursts_ms) {
+      std::mt19937 rng(seed);
+      auto delivered = [=](double t, std::mt19937 &) { return t < 1000000.0 || fmod(t, 1000000.0) >= burst_ms * 1000.0; };
+      Trace trace = run(rate, 21, delivered, rng);
+      double stop = 0, stopped = 0;
+      for (size_t i = 0; i < trace.failsafe_on_us.size(); i++) {
+        stop += trace.failsafe_on_us[i] - trace.last_frame_before_us[i];
+        if (i < trace.failsafe_off_us.size()) {
+          stopped += trace.failsafe_off_us[i] - trace.failsafe_on_us[i];
+        }
+      }
+      size_t stops = trace.failsafe_on_us.size();
+      // the old code stopped on a burst longer than its output timeout, never for these
+      int old_stops = burst_ms * 1000.0 > OLD_OUTPUT_TIMEOUT_US ? 20 : 0;
+      printf("%8.0f %9.0f %6zu/20 %12.1f %12.1f %10d\n", rate, burst_ms, stops, stops ? stop / stops / 1000.0 : 0.0,
+             stops ? stopped / stops / 1000.0 : 0.0, old_stops);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  std::vector<double> rates = {50, 150, 500};
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--rates") && i + 1 < argc) {
+      rates.clear();
+      for (char *rate = strtok(argv[++i], ","); rate != NULL; rate = strtok(NULL, ",")) {
+        rates.push_back(atof(rate));
+      }
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--rates HZ,HZ..] [--seed N]\n", argv[0]);
+      return 1;
+    }
+  }
+  for (double rate : rates) {
+    if (rate <= 0) {
+      fprintf(stderr, "rates must be above 0\n");
+      return 1;
+    }
+  }
+  cut(rates, seed);
+  fade(rates, seed);
+  burst(rates, seed);
+  return 0;
+}
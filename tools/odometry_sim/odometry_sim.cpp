@@ -0,0 +1,209 @@
+// Closure error and per-update cost of the Odometry dead reckoning on simulated closed
+// trajectories, against the same integration with a float pose and with the sketch's heading.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/odometry_sim/odometry_sim.cpp Odometry.cpp
+//            GyroCalibration.cpp -o odometry_sim
+// Run:     ./odometry_sim [--rate HZ] [--heading-noise DEG] [--gyro-noise DPS]
+//
+// The trajectories end where they started except longhaul, whose end is printed. The car is
+// integrated at 10 kHz in double precision, the odometry is fed the integer VESC tachometer and
+// the heading at --rate (the VESC telemetry rate, 100 Hz by default). "fixed" and "float" get
+// the true heading, so their error at the end is the integration and rounding error of the
+// estimator, not sensor error. --heading-noise adds white noise to those heading samples.
+// "gyro" gets the heading the sketch gives it: the gyro Z sampled at the IMU rate with the
+// GYRO_YAW_CAL bias and white noise of --gyro-noise deg/s, through GyroCalibration and
+// integrated as loop() does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+
+#include "GyroCalibration.h"
+#include "Odometry.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define MOTOR_POLES 2.0
+#define DRIVE_RATIO 10.83
+#define WHEEL_CIRCUMFERENCE 0.3676
+#define METERS_PER_TACHO_COUNT (WHEEL_CIRCUMFERENCE / (6.0 * MOTOR_POLES * DRIVE_RATIO))
+#define KMH_TO_MOTOR_ERPM ((DRIVE_RATIO * MOTOR_POLES * 16.66667) / WHEEL_CIRCUMFERENCE)
+#define GYRO_YAW_CAL 1.2
+#define GYRO_STATIONARY_ERPM 150
+#define GYRO_STATIONARY_STDDEV 0.5
+#define GYRO_SAMPLE_RATE 416.0
+
+#define SIM_RATE_HZ 10000
+
+// Speed (m/s, negative in reverse) and yaw rate (deg/s) of a trajectory at time t
+typedef void (*trajectory_t)(double t, double *speed, double *yaw_rate);
+
+struct Trajectory {
+  const char *name;
+  trajectory_t motion;
+  double seconds;
+};
+
+// 2 m radius at 3 m/s, 20 laps
+static void circle(double t, double *speed, double *yaw_rate) {
+  (void)t;
+  *speed = 3.0;
+  *yaw_rate = 3.0 / 2.0 * 57.29577951;
+}
+
+// Left and right 1.5 m loops alternating, 10 figure eights
+static void figureEight(double t, double *speed, double *yaw_rate) {
+  double loop = 2.0 * M_PI * 1.5 / 2.5;
+  *speed = 2.5;
+  *yaw_rate = (fmod(t, 2.0 * loop) < loop ? 1.0 : -1.0) * 2.5 / 1.5 * 57.29577951;
+}
+
+// 10 m forward and 10 m back in reverse, 20 times, with a slight weave
+static void shuttle(double t, double *speed, double *yaw_rate) {
+  double leg = fmod(t, 10.0);
+  *speed = leg < 5.0 ? 2.0 : -2.0;
+  *yaw_rate = 10.0 * sin(2.0 * M_PI * leg / 5.0);
+}
+
+// 1 km out at 8 m/s, 30 laps of a 3 m circle out there, and back
+static void longHaul(double t, double *speed, double *yaw_rate) {
+  double straight = 1000.0 / 8.0;
+  double lap = 2.0 * M_PI * 3.0 / 4.0;
+  double turn = M_PI * 2.0 / 4.0; // 180 degrees on a 2 m radius
+  *speed = 8.0;
+  *yaw_rate = 0;
+  if (t >= straight && t < straight + 30 * lap) {
+    *speed = 4.0;
+    *yaw_rate = 4.0 / 3.0 * 57.29577951;
+  } else if (t >= straight + 30 * lap && t < straight + 30 * lap + turn) {
+    *speed = 4.0;
+    *yaw_rate = 4.0 / 2.0 * 57.29577951;
+  }
+}
+
+static const Trajectory TRAJECTORIES[] = {
+  {"circle", circle, 20 * 2.0 * M_PI * 2.0 / 3.0},
+  {"figure8", figureEight, 10 * 2.0 * (2.0 * M_PI * 1.5 / 2.5)},
+  {"shuttle", shuttle, 20 * 10.0},
+  // the U turn shifts the return leg 4 m sideways
+  {"longhaul", longHaul, 1000.0 / 8.0 + 30 * (2.0 * M_PI * 3.0 / 4.0) + M_PI * 2.0 / 4.0 + 1000.0 / 8.0},
+};
+
+// The same integration with a float pose, what the fixed point accumulation replaces
+struct FloatOdometry {
+  float x = 0, y = 0, heading = 0;
+  int32_t last = 0;
+  bool started = false;
+
+  void update(int32_t tachometer, float heading_deg) {
+    if (!started) {
+      last = tachometer;
+      started = true;
+      return;
+    }
+    float distance = (tachometer - last) * (float)METERS_PER_TACHO_COUNT;
+    last = tachometer;
+    float mean = (heading + (heading_deg - heading) * 0.5f) * 0.017453293f;
+    heading = heading_deg;
+    x += distance * cosf(mean);
+    y += distance * sinf(mean);
+  }
+};
+
+struct Run {
+  double distance;
+  double fixed_error;
+  double float_error;
+  double gyro_error;
+  double end_x, end_y;
+};
+
+static Run simulate(const Trajectory &trajectory, double rate_hz, double heading_noise, double gyro_noise, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, heading_noise);
+  std::normal_distribution<double> gyro_error(0.0, gyro_noise);
+  Odometry odometry(METERS_PER_TACHO_COUNT);
+  FloatOdometry float_odometry;
+  Odometry gyro_odometry(METERS_PER_TACHO_COUNT);
+  GyroCalibration gyro_cal(-GYRO_YAW_CAL, GYRO_STATIONARY_ERPM, GYRO_STATIONARY_STDDEV);
+  double yaw = 0, next_sample = 0; // the sketch's, clockwise
+  double x = 0, y = 0, heading = 0, counts = 0, distance = 0;
+  double dt = 1.0 / SIM_RATE_HZ;
+  int steps_per_update = (int)(SIM_RATE_HZ / rate_hz);
+  long steps = (long)(trajectory.seconds * SIM_RATE_HZ);
+  for (long i = 0; i <= steps; i++) {
+    if (i % steps_per_update == 0) {
+      int32_t tachometer = (int32_t)floor(counts);
+      double sample = heading + noise(rng);
+      odometry.update(tachometer, (float)(fmod(sample + 180.0, 360.0) - 180.0));
+      float_odometry.update(tachometer, (float)sample);
+      gyro_odometry.update(tachometer, (float)remainder(-yaw, 360.0));
+    }
+    double speed, yaw_rate;
+    trajectory.motion(i * dt, &speed, &yaw_rate);
+    if (i * dt >= next_sample) {
+      next_sample += 1.0 / GYRO_SAMPLE_RATE;
+      float raw = (float)(yaw_rate - GYRO_YAW_CAL + gyro_error(rng));
+      double yaw_in = -gyro_cal.update(raw, (float)(speed * 3.6 * KMH_TO_MOTOR_ERPM));
+      yaw += yaw_in / GYRO_SAMPLE_RATE;
+    }
+    double mean = (heading + yaw_rate * dt * 0.5) * M_PI / 180.0;
+    x += speed * dt * cos(mean);
+    y += speed * dt * sin(mean);
+    heading += yaw_rate * dt;
+    counts += speed * dt / METERS_PER_TACHO_COUNT;
+    distance += fabs(speed * dt);
+  }
+  Run run;
+  run.distance = distance;
+  run.end_x = x;
+  run.end_y = y;
+  run.fixed_error = hypot(odometry.getX() - x, odometry.getY() - y);
+  run.float_error = hypot(float_odometry.x - x, float_odometry.y - y);
+  run.gyro_error = hypot(gyro_odometry.getX() - x, gyro_odometry.getY() - y);
+  return run;
+}
+
+static volatile float sink;
+
+static double updateNs(int repeat) {
+  Odometry odometry(METERS_PER_TACHO_COUNT);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeat; i++) {
+    odometry.update(i * 10, (float)(i % 3600) * 0.1f);
+  }
+  auto end = std::chrono::steady_clock::now();
+  sink = odometry.getX();
+  return std::chrono::duration<double, std::nano>(end - start).count() / repeat;
+}
+
+int main(int argc, char **argv) {
+  double rate_hz = 100;
+  double heading_noise = 0, gyro_noise = 0.1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--heading-noise") && i + 1 < argc) {
+      heading_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--gyro-noise") && i + 1 < argc) {
+      gyro_noise = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--rate HZ] [--heading-noise DEG] [--gyro-noise DPS]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("updates at %.0f Hz, heading noise %.2f deg, gyro noise %.2f deg/s, %.3f mm per tachometer count\n", rate_hz, heading_noise, gyro_noise,
+         METERS_PER_TACHO_COUNT * 1000.0);
+  printf("%-10s %10s %12s %12s %12s %14s\n", "trajectory", "driven m", "fixed mm", "float mm", "gyro mm", "true end m");
+  for (const Trajectory &trajectory : TRAJECTORIES) {
+    Run run = simulate(trajectory, rate_hz, heading_noise, gyro_noise, 1);
+    printf("%-10s %10.1f %12.2f %12.2f %12.2f %6.2f,%6.2f\n", trajectory.name, run.distance, run.fixed_error * 1000.0, run.float_error * 1000.0,
+           run.gyro_error * 1000.0, run.end_x, run.end_y);
+  }
+  printf("errors are against the true end position, the closure error of the estimator\n");
+  printf("update() %.1f ns on this host\n", updateNs(2000000));
+  return 0;
+}
@@ -0,0 +1,43 @@
+// Just enough of the Arduino core to build libs/FrSkyPixelOsd on the host for osd_bench.
+// Time is virtual, the serial port implementation advances it.
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#define PI 3.1415926535897932384626433832795
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+class HardwareSerial {
+  public:
+    virtual ~HardwareSerial() {}
+    virtual void begin(unsigned long baud) = 0;
+    virtual void end() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t write(uint8_t byte) = 0;
+    virtual void flush() = 0;
+    size_t print(const char *str) {
+      size_t n = 0;
+      while (*str) {
+        n += write((uint8_t)*str++);
+      }
+      return n;
+    }
+};
+
+#endif // ARDUINO_H
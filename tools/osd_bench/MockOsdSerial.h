@@ -0,0 +1,184 @@
+// Serial port with a simulated PixelOSD on the other end and the virtual clock behind the
+// Arduino.h shim, shared by the host benchmarks in this directory. Include it from exactly one
+// translation unit, it defines millis(), micros() and delay().
+
+#ifndef MOCK_OSD_SERIAL_H
+#define MOCK_OSD_SERIAL_H
+
+#include <stdint.h>
+#include <deque>
+
+#include "Arduino.h"
+
+#define OSD_CMD_INFO 1
+#define OSD_CMD_WIDGET_SET_CONFIG 115
+#define POLL_US 5 // virtual time spent by one empty available() poll
+
+static double now_us = 0;
+
+uint32_t millis() {
+  return (uint32_t)(now_us / 1000.0);
+}
+
+uint32_t micros() {
+  return (uint32_t)now_us;
+}
+
+void delay(uint32_t ms) {
+  now_us += ms * 1000.0;
+}
+
+static uint8_t crcStep(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for (int i = 0; i < 8; i++) {
+    crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0xD5) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+// Serial port with a PixelOSD on the other end. Replies to CMD_INFO and echoes widget configs,
+// everything else is accepted silently like the drawing commands on the real OSD.
+class MockOsdSerial : public HardwareSerial {
+  public:
+    double latency_us = 1000;
+    uint8_t version_major = 2; // firmware version reported to CMD_INFO, 1 gets the library to fall back to API 1
+    double byte_us = 10.0 * 1e6 / 115200;
+
+    uint32_t round_trips = 0;
+    uint32_t tx_bytes = 0;
+    uint32_t rx_bytes = 0;
+
+    void begin(unsigned long baud) {
+      byte_us = 10.0 * 1e6 / baud;
+    }
+
+    int available() {
+      if (!rx.empty() && rx.front().time <= now_us) {
+        return 1;
+      }
+      if (waiting) {
+        round_trips++;
+        waiting = false;
+      }
+      now_us += POLL_US;
+      return 0;
+    }
+
+    int read() {
+      if (rx.empty() || rx.front().time > now_us) {
+        return -1;
+      }
+      uint8_t byte = rx.front().byte;
+      rx.pop_front();
+      rx_bytes++;
+      return byte;
+    }
+
+    size_t write(uint8_t byte) {
+      host_tx_end = (host_tx_end > now_us ? host_tx_end : now_us) + byte_us;
+      tx_bytes++;
+      waiting = true;
+      osdReceive(byte, host_tx_end);
+      return 1;
+    }
+
+    void flush() {
+      if (host_tx_end > now_us) {
+        now_us = host_tx_end;
+      }
+    }
+
+    void reset() {
+      rx.clear();
+      round_trips = tx_bytes = rx_bytes = 0;
+      waiting = false;
+    }
+
+  private:
+    struct Timed {
+      double time;
+      uint8_t byte;
+    };
+
+    std::deque<Timed> rx;
+    bool waiting = false;
+    double host_tx_end = 0;
+    double osd_tx_end = 0;
+
+    uint8_t state = 0;
+    uint32_t length = 0;
+    uint8_t length_shift = 0;
+    uint8_t crc = 0;
+    uint8_t frame[256];
+    uint32_t index = 0;
+
+    void osdReceive(uint8_t byte, double time) {
+      switch (state) {
+        case 0:
+          state = (byte == '$') ? 1 : 0;
+          break;
+        case 1:
+          state = (byte == 'A') ? 2 : 0;
+          length = 0;
+          length_shift = 0;
+          crc = 0;
+          index = 0;
+          break;
+        case 2:
+          crc = crcStep(crc, byte);
+          length |= (uint32_t)(byte & 0x7F) << length_shift;
+          length_shift += 7;
+          if (byte < 0x80) {
+            state = (length > 0 && length <= sizeof(frame)) ? 3 : 0;
+          }
+          break;
+        case 3:
+          crc = crcStep(crc, byte);
+          frame[index++] = byte;
+          if (index >= length) {
+            state = 4;
+          }
+          break;
+        case 4:
+          state = 0;
+          if (byte == crc) {
+            osdHandle(time);
+          }
+          break;
+      }
+    }
+
+    void osdHandle(double time) {
+      if (frame[0] == OSD_CMD_INFO) {
+        uint8_t info[] = {OSD_CMD_INFO, 'A', 'G', 'H', version_major, 0, 0, 16, 30, 104, 1, 32, 1, 0, 1, 0, 0, 8};
+        osdSend(info, sizeof(info), time);
+      } else if (frame[0] == OSD_CMD_WIDGET_SET_CONFIG) {
+        // the config payload comes straight back
+        osdSend(frame, length, time);
+      }
+    }
+
+    void osdSend(const uint8_t *data, uint8_t len, double time) {
+      double t = time + latency_us;
+      if (osd_tx_end > t) {
+        t = osd_tx_end;
+      }
+      uint8_t out_crc = crcStep(0, len);
+      push('$', t);
+      push('A', t);
+      push(len, t);
+      for (uint8_t i = 0; i < len; i++) {
+        out_crc = crcStep(out_crc, data[i]);
+        push(data[i], t);
+      }
+      push(out_crc, t);
+      osd_tx_end = t;
+    }
+
+    void push(uint8_t byte, double &t) {
+      t += byte_us;
+      rx.push_back(Timed{t, byte});
+    }
+};
+
+#endif // MOCK_OSD_SERIAL_H
@@ -0,0 +1,235 @@
+// Per frame CPU time and wire bytes of the FrSkyPixelOsdCubeExample animation, float against the
+// fixed point FrSkyPixelOsdGeometry version, and the CTM encodings the library picks per API.
+//
+// Build:   cd libs/FrSkyPixelOsd && g++ -std=gnu++11 -O2 -I../../tools/osd_bench -I. ../../tools/osd_bench/cube_bench.cpp FrSkyPixelOsd.cpp FrSkyPixelOsdGeometry.cpp -o cube_bench
+// Run:     ./cube_bench [--repeat N]
+//
+// CPU time is measured on the host, which has an FPU, so the float version looks far better
+// than it is on an ATmega328P or a SAMD21 where all of it is software floating point. The
+// operation counts per frame are also turned into an ATmega328P estimate with the approximate
+// avr-gcc/avr-libc costs below. avr-libc declares sin and cos const, so the compiler may merge
+// the calls that share an argument; both ends of that range are printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+
+#include "Arduino.h"
+#include "FrSkyPixelOsd.h"
+#include "FrSkyPixelOsdGeometry.h"
+#include "MockOsdSerial.h"
+
+#define CUBE_FRAMES 181 // angle 0..360 in steps of 2 as in the example
+#define ORIGIN_X 180
+#define ORIGIN_Y 144
+
+#define AVR_MHZ 16
+#define AVR_CYCLES_FADD 110 // __addsf3/__subsf3
+#define AVR_CYCLES_FMUL 150 // __mulsf3
+#define AVR_CYCLES_FCONV 80 // int <-> float
+#define AVR_CYCLES_TRIG 1800 // sin or cos
+#define AVR_CYCLES_MUL32 40 // 16x16 -> 32 bit multiply and accumulate
+#define AVR_CYCLES_TABLE 60 // sinQ15 lookup and interpolation, without its multiply
+
+struct OpCount {
+  uint32_t trig, trig_merged, fmul, fadd, fconv, mul32, table;
+};
+
+// Per vertex the float version does 10 sin/cos calls (2 distinct values), 11 multiplications,
+// 7 additions and 10 int/float conversions. The fixed point version does 12 multiplications
+// for each of its 3 axis rotations, 6 table lookups with one multiply each, and 9 multiplications
+// per vertex.
+static const OpCount floatOps = {8 * 10, 2, 8 * 11, 8 * 7, 8 * 10, 0, 0};
+static const OpCount fixedOps = {0, 0, 0, 0, 0, 3 * 12 + 6 + 8 * 9, 6};
+
+static double avrUs(const OpCount &ops, bool merged) {
+  uint32_t cycles = (merged ? ops.trig_merged : ops.trig) * AVR_CYCLES_TRIG + ops.fmul * AVR_CYCLES_FMUL + ops.fadd * AVR_CYCLES_FADD +
+                    ops.fconv * AVR_CYCLES_FCONV + ops.mul32 * AVR_CYCLES_MUL32 + ops.table * AVR_CYCLES_TABLE;
+  return (double)cycles / AVR_MHZ;
+}
+
+static const int cubeVertex[8][3] = {
+  {-50, -50, 50}, {50, -50, 50}, {50, 50, 50}, {-50, 50, 50},
+  {-50, -50, -50}, {50, -50, -50}, {50, 50, -50}, {-50, 50, -50}
+};
+
+static uint32_t trig_calls = 0;
+
+__attribute__((noinline)) static float countedSin(float x) {
+  trig_calls++;
+  return sin(x);
+}
+
+__attribute__((noinline)) static float countedCos(float x) {
+  trig_calls++;
+  return cos(x);
+}
+
+// The loop() body of the example before the geometry helpers
+static void floatFrame(uint16_t angle, int wireframe[8][2]) {
+  float rot, rotx, roty, rotz, rotxx, rotyy, rotxxx, rotyyy;
+  for (uint8_t i = 0; i < 8; i++) {
+    rot = angle * 0.0174532;
+    rotz = cubeVertex[i][2] * countedCos(rot) - cubeVertex[i][0] * countedSin(rot);
+    rotx = cubeVertex[i][2] * countedSin(rot) + cubeVertex[i][0] * countedCos(rot);
+    roty = cubeVertex[i][1];
+    rotyy = roty * countedCos(rot) - rotz * countedSin(rot);
+    rotxx = rotx;
+    rotxxx = rotxx * countedCos(rot) - rotyy * countedSin(rot);
+    rotyyy = rotxx * countedSin(rot) + rotyy * countedCos(rot);
+    rotxxx = rotxxx + ORIGIN_X;
+    rotyyy = rotyyy + ORIGIN_Y;
+    wireframe[i][0] = rotxxx;
+    wireframe[i][1] = rotyyy;
+  }
+}
+
+static void fixedFrame(uint16_t angle, int wireframe[8][2]) {
+  FrSkyPixelOsdGeometry::osd_mat3_t rotation;
+  uint16_t turn = FrSkyPixelOsdGeometry::degToAngle(angle);
+  FrSkyPixelOsdGeometry::mat3Identity(&rotation);
+  FrSkyPixelOsdGeometry::mat3RotateY(&rotation, turn);
+  FrSkyPixelOsdGeometry::mat3RotateX(&rotation, turn);
+  FrSkyPixelOsdGeometry::mat3RotateZ(&rotation, turn);
+  for (uint8_t i = 0; i < 8; i++) {
+    FrSkyPixelOsdGeometry::osd_vec3_t vertex = {(int16_t)cubeVertex[i][0], (int16_t)cubeVertex[i][1], (int16_t)cubeVertex[i][2]};
+    FrSkyPixelOsdGeometry::osd_vec3_t rotated = FrSkyPixelOsdGeometry::mat3Apply(&rotation, &vertex);
+    FrSkyPixelOsdGeometry::osd_vec2_t point = FrSkyPixelOsdGeometry::projectOrthographic(&rotated, ORIGIN_X, ORIGIN_Y);
+    wireframe[i][0] = point.x;
+    wireframe[i][1] = point.y;
+  }
+}
+
+static volatile int sink;
+
+static double nsPerFrame(void (*frame)(uint16_t, int[8][2]), int repeat) {
+  int wireframe[8][2];
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; r++) {
+    for (uint16_t angle = 0; angle <= 360; angle += 2) {
+      frame(angle, wireframe);
+      sink = wireframe[7][1];
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / ((double)repeat * CUBE_FRAMES);
+}
+
+// drawWireframe() of the example
+static void drawWireframe(FrSkyPixelOsd &osd, int w[8][2]) {
+  osd.cmdTransactionBegin();
+  osd.cmdClearRect(90, 50, 180, 180);
+  osd.cmdMoveToPoint(w[0][0], w[0][1]);
+  osd.cmdStrokeLineToPoint(w[1][0], w[1][1]);
+  osd.cmdStrokeLineToPoint(w[2][0], w[2][1]);
+  osd.cmdStrokeLineToPoint(w[3][0], w[3][1]);
+  osd.cmdStrokeLineToPoint(w[0][0], w[0][1]);
+  osd.cmdSetStrokeColor(FrSkyPixelOsd::COLOR_GREY);
+  osd.cmdMoveToPoint(w[1][0], w[1][1]);
+  osd.cmdStrokeLineToPoint(w[3][0], w[3][1]);
+  osd.cmdMoveToPoint(w[0][0], w[0][1]);
+  osd.cmdStrokeLineToPoint(w[2][0], w[2][1]);
+  osd.cmdSetStrokeColor(FrSkyPixelOsd::COLOR_WHITE);
+  osd.cmdMoveToPoint(w[4][0], w[4][1]);
+  osd.cmdStrokeLineToPoint(w[5][0], w[5][1]);
+  osd.cmdStrokeLineToPoint(w[6][0], w[6][1]);
+  osd.cmdStrokeLineToPoint(w[7][0], w[7][1]);
+  osd.cmdStrokeLineToPoint(w[4][0], w[4][1]);
+  for (int i = 0; i < 4; i++) {
+    osd.cmdMoveToPoint(w[i][0], w[i][1]);
+    osd.cmdStrokeLineToPoint(w[i + 4][0], w[i + 4][1]);
+  }
+  osd.cmdTransactionCommit();
+}
+
+static MockOsdSerial serial;
+
+static double bytesPerFrame(void (*frame)(uint16_t, int[8][2])) {
+  FrSkyPixelOsd osd(&serial);
+  osd.begin();
+  serial.reset();
+  int wireframe[8][2];
+  for (uint16_t angle = 0; angle <= 360; angle += 2) {
+    frame(angle, wireframe);
+    drawWireframe(osd, wireframe);
+  }
+  return (double)serial.tx_bytes / CUBE_FRAMES;
+}
+
+// Bytes of one CTM update per frame for a rotating overlay centered on the screen
+static double ctmBytes(uint8_t version_major, int variant) {
+  serial.version_major = version_major;
+  FrSkyPixelOsd osd(&serial);
+  osd.begin();
+  serial.reset();
+  for (uint16_t angle = 0; angle <= 360; angle += 2) {
+    float rad = angle * 0.0174532f;
+    switch (variant) {
+      case 0:
+        osd.cmdCtmSet(cos(rad), sin(rad), -sin(rad), cos(rad), ORIGIN_X, ORIGIN_Y);
+        break;
+      case 1:
+        osd.cmdCtmReset();
+        osd.cmdCtmTranstale(ORIGIN_X, ORIGIN_Y);
+        osd.cmdCtmRotateDeg(angle);
+        break;
+      case 2:
+        osd.cmdCtmSetRotateTranslate(FrSkyPixelOsdGeometry::degToAngle(angle), ORIGIN_X, ORIGIN_Y);
+        break;
+    }
+  }
+  serial.version_major = 2;
+  return (double)serial.tx_bytes / CUBE_FRAMES;
+}
+
+int main(int argc, char **argv) {
+  int repeat = 2000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--repeat N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  int max_error = 0;
+  for (uint16_t angle = 0; angle <= 360; angle += 2) {
+    int a[8][2], b[8][2];
+    floatFrame(angle, a);
+    fixedFrame(angle, b);
+    for (int i = 0; i < 8; i++) {
+      for (int j = 0; j < 2; j++) {
+        int error = abs(a[i][j] - b[i][j]);
+        if (error > max_error) {
+          max_error = error;
+        }
+      }
+    }
+  }
+
+  trig_calls = 0;
+  int wireframe[8][2];
+  floatFrame(0, wireframe);
+  if (trig_calls != floatOps.trig) {
+    fprintf(stderr, "float op counts are out of date (%u trig calls)\n", trig_calls);
+    return 1;
+  }
+
+  printf("cube animation, %d frames x %d\n", CUBE_FRAMES, repeat);
+  printf("%-8s %12s %16s %12s\n", "variant", "host ns", "avr328p us est", "bytes/frame");
+  printf("%-8s %12.1f %7.0f..%-7.0f %12.1f\n", "float", nsPerFrame(floatFrame, repeat), avrUs(floatOps, true), avrUs(floatOps, false), bytesPerFrame(floatFrame));
+  printf("%-8s %12.1f %16.0f %12.1f\n", "q15", nsPerFrame(fixedFrame, repeat), avrUs(fixedOps, false), bytesPerFrame(fixedFrame));
+  printf("largest vertex difference %d px (float truncates, q15 rounds)\n\n", max_error);
+
+  printf("CTM update per frame, bytes on the wire\n");
+  printf("%-40s %8s %8s\n", "calls", "API 1", "API 2");
+  const char *names[] = {"cmdCtmSet (floats)", "cmdCtmReset+Transtale+RotateDeg", "cmdCtmSetRotateTranslate"};
+  for (int variant = 0; variant < 3; variant++) {
+    printf("%-40s %8.1f %8.1f\n", names[variant], ctmBytes(1, variant), ctmBytes(2, variant));
+  }
+  return 0;
+}
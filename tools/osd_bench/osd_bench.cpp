@@ -0,0 +1,135 @@
+// Round trips and serial time of the FrSkyPixelOsd widget configuration, with the library
+// running against a simulated OSD on a virtual clock.
+//
+// Build:   cd libs/FrSkyPixelOsd && g++ -std=gnu++11 -O2 -I../../tools/osd_bench -I. ../../tools/osd_bench/osd_bench.cpp FrSkyPixelOsd.cpp
+//            FrSkyPixelOsdGeometry.cpp -o osd_bench
+// Run:     ./osd_bench [--latency-us US] [--passes N] [--baud BAUD]
+//
+// Each scenario runs twice. "uncached" clears the widget config cache before every config and
+// never batches, which puts the same bytes on the wire as the library did before the cache.
+// "cached" is the library as shipped: FrSkyPixelOsdWidgetExample setup() batching the sidebar
+// and graph configs, and identical configs skipped.
+//
+// A round trip is counted whenever the library has to wait for the OSD after sending something,
+// the time is from the first byte sent until the last response was read.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Arduino.h"
+#include "FrSkyPixelOsd.h"
+#include "MockOsdSerial.h"
+
+struct Result {
+  uint32_t round_trips, tx_bytes, rx_bytes;
+  double time_ms;
+};
+
+static MockOsdSerial serial;
+
+static Result measure(void (*scenario)(FrSkyPixelOsd &, bool), bool cached, uint32_t baud) {
+  FrSkyPixelOsd osd(&serial);
+  osd.begin(baud);
+  serial.reset();
+  double start = now_us;
+  scenario(osd, cached);
+  Result r = {serial.round_trips, serial.tx_bytes, serial.rx_bytes, (now_us - start) / 1000.0};
+  return r;
+}
+
+static void uncache(FrSkyPixelOsd &osd, bool cached) {
+  if (!cached) {
+    osd.clearWidgetConfigCache();
+  }
+}
+
+// FrSkyPixelOsdWidgetExample setup() after begin()
+static void exampleSetup(FrSkyPixelOsd &osd, bool cached) {
+  FrSkyPixelOsd::osd_cmd_info_response_t info;
+  FrSkyPixelOsd::osd_widget_chargauge_config_t gauge;
+  char string[31];
+  sprintf(string, " PAWELSKY FRSKY PIXELOSD TEST ");
+  osd.cmdDrawGridString(0, 1, string, strlen(string) + 1);
+  osd.cmdInfo(&info);
+
+  if (cached) {
+    osd.widgetConfigBatchBegin();
+  }
+  uncache(osd, cached);
+  osd.cmdWidgetSetConfigSidebar(10, 50, 75, 150, FrSkyPixelOsd::WIDGET_SIDEBAR_OPTION_LEFT, 10, 10, 1, 'P', 10, 'P', FrSkyPixelOsd::WIDGET_ID_SIDEBAR_0);
+  uncache(osd, cached);
+  osd.cmdWidgetSetConfigSidebar(275, 50, 75, 150, FrSkyPixelOsd::WIDGET_SIDEBAR_OPTION_REVERSE | FrSkyPixelOsd::WIDGET_SIDEBAR_OPTION_UNLABELED, 5, 10, 1, 'R', 0, 'R', FrSkyPixelOsd::WIDGET_ID_SIDEBAR_1);
+  uncache(osd, cached);
+  osd.cmdWidgetSetConfigGraph(4, 52, 172, 144, FrSkyPixelOsd::WIDGET_GRAPH_OPTION_NONE, 3, 4, 2, 1, 'S', 10, 'S', FrSkyPixelOsd::WIDGET_ID_GRAPH_0);
+  if (cached) {
+    osd.widgetConfigBatchEnd();
+  }
+  uncache(osd, cached);
+  osd.cmdWidgetSetConfigCharGauge(132, 216, 150, FrSkyPixelOsd::WIDGET_ID_CHARGAUGE_0, &gauge);
+}
+
+static uint32_t passes = 100;
+
+// FrSkyPixelOsdWidgetExample loop() configs, the AHI alternates between two styles every pass
+static void exampleLoop(FrSkyPixelOsd &osd, bool cached) {
+  for (uint32_t i = 0; i < passes; i++) {
+    uncache(osd, cached);
+    osd.cmdWidgetSetConfigAhi(90, 50, 180, 150, FrSkyPixelOsd::WIDGET_AHI_STYLE_STAIRCASE, FrSkyPixelOsd::WIDGET_AHI_OPTION_NONE, 10, 1, FrSkyPixelOsd::WIDGET_ID_AHI);
+    uncache(osd, cached);
+    osd.cmdWidgetSetConfigAhi(185, 50, 170, 150, FrSkyPixelOsd::WIDGET_AHI_STYLE_LINE, FrSkyPixelOsd::WIDGET_AHI_OPTION_SHOW_CORNERS, 10, 2, FrSkyPixelOsd::WIDGET_ID_AHI);
+  }
+}
+
+// A sketch that re-applies the same config at the start of every pass, as the example does for
+// a single style
+static void repeatedConfig(FrSkyPixelOsd &osd, bool cached) {
+  for (uint32_t i = 0; i < passes; i++) {
+    uncache(osd, cached);
+    osd.cmdWidgetSetConfigAhi(90, 50, 180, 150, FrSkyPixelOsd::WIDGET_AHI_STYLE_STAIRCASE, FrSkyPixelOsd::WIDGET_AHI_OPTION_NONE, 10, 1, FrSkyPixelOsd::WIDGET_ID_AHI);
+    osd.cmdWidgetDrawAhiDeg(0, (int16_t)(i % 90));
+  }
+}
+
+static void printRow(const char *name, const char *variant, const Result &r) {
+  printf("%-16s %-9s %11u %9u %9u %10.2f\n", name, variant, r.round_trips, r.tx_bytes, r.rx_bytes, r.time_ms);
+}
+
+int main(int argc, char **argv) {
+  uint32_t baud = OSD_DEFAULT_BAUD_RATE;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--latency-us") && i + 1 < argc) {
+      serial.latency_us = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--passes") && i + 1 < argc) {
+      passes = (uint32_t)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = (uint32_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--latency-us US] [--passes N] [--baud BAUD]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  size_t largest = sizeof(FrSkyPixelOsd::osd_widget_ahi_config_t);
+  if (sizeof(FrSkyPixelOsd::osd_widget_sidebar_config_t) > largest) largest = sizeof(FrSkyPixelOsd::osd_widget_sidebar_config_t);
+  if (sizeof(FrSkyPixelOsd::osd_widget_graph_config_t) > largest) largest = sizeof(FrSkyPixelOsd::osd_widget_graph_config_t);
+  if (sizeof(FrSkyPixelOsd::osd_widget_chargauge_config_t) > largest) largest = sizeof(FrSkyPixelOsd::osd_widget_chargauge_config_t);
+  printf("osd latency %.0f us, %u baud, %u loop passes, cache %u bytes (AVR)\n\n", serial.latency_us, baud, passes,
+         (unsigned)(OSD_WIDGET_COUNT * (largest + 1)));
+  printf("%-16s %-9s %11s %9s %9s %10s\n", "scenario", "variant", "round trips", "tx bytes", "rx bytes", "time ms");
+
+  struct {
+    const char *name;
+    void (*run)(FrSkyPixelOsd &, bool);
+  } scenarios[] = {
+    {"example setup", exampleSetup},
+    {"example loop", exampleLoop},
+    {"repeated config", repeatedConfig},
+  };
+  for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    printRow(scenarios[i].name, "uncached", measure(scenarios[i].run, false, baud));
+    printRow(scenarios[i].name, "cached", measure(scenarios[i].run, true, baud));
+  }
+  return 0;
+}
@@ -0,0 +1,314 @@
+// Recovery of ParamStore from damaged flash on a simulated SAMD21 flash, and what the parameters
+// cost the loop() hot path.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/param_store_sim/param_store_sim.cpp ParamStore.cpp -o param_store_sim
+// Run:     ./param_store_sim [--saves N] [--reads N]
+//
+// Every case starts from an erased flash, saves a few known sets of values and then damages the
+// flash the way a power cut or a worn row would: a save cut off half way through its values, a
+// flipped bit in the newest record, rows erased under it, a bit that no longer programs so
+// every save fails to verify. A fresh ParamStore then loads and has to come back with the
+// newest set that survived whole, or the defaults. The stuck bit case also runs the sketch's
+// handleParams() condition for a while and counts the row erases: after a failed verify no save
+// may be attempted until a parameter changes. The wrap case saves --saves times around the
+// ring. Prints one line per case and exits 1 if any failed.
+//
+// The hot path reads parameters straight from the variables the descriptors point at, the
+// overhead is the mean over --reads loop passes of the handleParams() check, and getValue() for
+// comparison, in nanoseconds and, on x86, TSC cycles.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "NvmFlash.h"
+#include "ParamStore.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define MAX_SPEED_KMH 10.0f
+#define STEERING_TRIM 0.0f
+#define GYRO_LOWPASS_HZ 40.0f
+#define PARAM_SAVE_DELAY 1000
+
+#define LOOP_PASSES 10000 // of the stuck bit case, 1 ms each
+
+static uint8_t flash[NVM_FLASH_END];
+static uint32_t erases = 0;
+static int32_t bytes_left = -1; // bytes programmed before the power is cut, -1 never
+static bool stuck_bit = false; // the low bit of the first value of every slot no longer programs
+
+void nvmRead(uint32_t address, void *data, uint32_t length) {
+  memcpy(data, flash + address, length);
+}
+
+void nvmEraseRow(uint32_t address) {
+  memset(flash + address - address % NVM_ROW_SIZE, 0xFF, NVM_ROW_SIZE);
+  erases++;
+}
+
+void nvmWritePage(uint32_t address, const void *data) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (uint32_t i = 0; i < NVM_PAGE_SIZE && bytes_left != 0; i++) {
+    if (bytes_left > 0) {
+      bytes_left--;
+    }
+    flash[address + i] &= bytes[i];
+    if (stuck_bit && address + i >= NVM_PARAM_ADDRESS && (address + i - NVM_PARAM_ADDRESS) % PARAM_STORE_RECORD_SIZE == 8) {
+      flash[address + i] |= 0x01;
+    }
+  }
+}
+
+static float max_speed_kmh, steering_trim, gyro_lowpass_hz;
+static uint8_t mode_channel;
+
+static const ParamDescriptor PARAMS[] = {
+  {"Max Speed", PARAM_FLOAT, &max_speed_kmh, 0, 40, MAX_SPEED_KMH, 1, "km/h"},
+  {"Steer Trim", PARAM_FLOAT, &steering_trim, -0.25, 0.25, STEERING_TRIM, 3, ""},
+  {"Gyro LPF", PARAM_FLOAT, &gyro_lowpass_hz, 5, 150, GYRO_LOWPASS_HZ, 0, "Hz"},
+  {"Mode Chan", PARAM_UINT8, &mode_channel, 0, 15, 4, 0, ""},
+};
+#define PARAM_COUNT (sizeof(PARAMS) / sizeof(ParamDescriptor))
+
+// A known set of values, n = 0 are the defaults
+static void setSet(ParamStore &store, int n) {
+  if (n == 0) {
+    store.resetToDefaults();
+    return;
+  }
+  store.setValue(0, 5.0f + n % 30);
+  store.setValue(1, 0.01f * (n % 20));
+  store.setValue(2, 20.0f + n % 100);
+  store.setValue(3, (float)(n % 16));
+}
+
+static bool isSet(int n) {
+  if (n == 0) {
+    return max_speed_kmh == MAX_SPEED_KMH && steering_trim == STEERING_TRIM && gyro_lowpass_hz == GYRO_LOWPASS_HZ && mode_channel == 4;
+  }
+  return max_speed_kmh == 5.0f + n % 30 && steering_trim == 0.01f * (n % 20) && gyro_lowpass_hz == 20.0f + n % 100 && mode_channel == n % 16;
+}
+
+static void eraseFlash() {
+  memset(flash, 0xFF, sizeof(flash));
+  erases = 0;
+  bytes_left = -1;
+  stuck_bit = false;
+}
+
+// Saves sets first..last, each on a fresh store as if the car rebooted in between
+static bool saveSets(int first, int last) {
+  for (int n = first; n <= last; n++) {
+    ParamStore store(PARAMS, PARAM_COUNT);
+    store.load();
+    setSet(store, n);
+    if (!store.save()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Loads on a fresh store, scribbling over the variables first so stale values can't pass
+static bool loadsSet(int n, bool expect_record) {
+  ParamStore store(PARAMS, PARAM_COUNT);
+  max_speed_kmh = steering_trim = gyro_lowpass_hz = NAN;
+  mode_channel = 0xAA;
+  bool found = store.load();
+  return found == expect_record && isSet(n) && !store.isDirty();
+}
+
+// Address of the newest record, the one load() would pick
+static uint32_t newestRecord() {
+  uint32_t best = 0, best_sequence = 0;
+  for (uint32_t slot = 0; slot < PARAM_STORE_SLOTS; slot++) {
+    uint32_t address = NVM_PARAM_ADDRESS + slot * PARAM_STORE_RECORD_SIZE;
+    uint16_t magic;
+    uint32_t sequence;
+    memcpy(&magic, flash + address, sizeof(magic));
+    memcpy(&sequence, flash + address + 4, sizeof(sequence));
+    if (magic == PARAM_STORE_MAGIC && sequence != 0xFFFFFFFF && sequence >= best_sequence) {
+      best = address;
+      best_sequence = sequence;
+    }
+  }
+  return best;
+}
+
+static bool blank() {
+  eraseFlash();
+  return loadsSet(0, false);
+}
+
+static bool roundTrip() {
+  eraseFlash();
+  return saveSets(1, 3) && loadsSet(3, true);
+}
+
+static bool wrap(int saves) {
+  eraseFlash();
+  return saveSets(1, saves) && loadsSet(saves, true) && saveSets(saves + 1, saves + 1) && loadsSet(saves + 1, true);
+}
+
+// The power goes after the header and two values, the store keeps the record before and the
+// next save finds a usable slot past the torn one
+static bool tornWrite() {
+  eraseFlash();
+  if (!saveSets(1, 3)) {
+    return false;
+  }
+  bytes_left = 16;
+  if (saveSets(4, 4)) {
+    return false;
+  }
+  bytes_left = -1;
+  return loadsSet(3, true) && saveSets(5, 5) && loadsSet(5, true);
+}
+
+static bool badCrc() {
+  eraseFlash();
+  if (!saveSets(1, 3)) {
+    return false;
+  }
+  flash[newestRecord() + sizeof(uint32_t) * 3] ^= 0x10;
+  return loadsSet(2, true) && saveSets(4, 4) && loadsSet(4, true);
+}
+
+// The row holding the newest record is erased, the store falls back to the previous row
+static bool erasedRow() {
+  eraseFlash();
+  int per_row = NVM_ROW_SIZE / PARAM_STORE_RECORD_SIZE;
+  if (!saveSets(1, per_row + 1)) {
+    return false;
+  }
+  nvmEraseRow(newestRecord());
+  return loadsSet(per_row, true);
+}
+
+static bool erasedAll() {
+  eraseFlash();
+  if (!saveSets(1, 3)) {
+    return false;
+  }
+  for (uint32_t row = 0; row < NVM_PARAM_ROWS; row++) {
+    nvmEraseRow(NVM_PARAM_ADDRESS + row * NVM_ROW_SIZE);
+  }
+  return loadsSet(0, false);
+}
+
+// Every save verifies bad. handleParams() may erase once for the change and not again until
+// a value changes, writing the same value back over CRSF doesn't count
+static bool stuckBit() {
+  eraseFlash();
+  if (!saveSets(1, 1)) {
+    return false;
+  }
+  ParamStore store(PARAMS, PARAM_COUNT);
+  store.load();
+  stuck_bit = true;
+  erases = 0;
+  uint32_t last_param_change = 0;
+  uint32_t attempts = 0, expected = 0;
+  for (uint32_t millis = 0; millis < LOOP_PASSES; millis++) {
+    if (millis == 0 || millis == LOOP_PASSES / 2) {
+      store.setValue(0, max_speed_kmh + 1.0f);
+      last_param_change = millis;
+      expected++;
+    }
+    if (millis == LOOP_PASSES / 4) {
+      store.setValue(0, max_speed_kmh);
+      last_param_change = millis;
+    }
+    if (store.isDirty() && millis - last_param_change > PARAM_SAVE_DELAY) {
+      attempts++;
+      if (store.save()) {
+        return false;
+      }
+    }
+  }
+  stuck_bit = false;
+  return attempts == expected && erases <= expected && loadsSet(1, true);
+}
+
+struct ReadCost {
+  double ns;
+  double cycles; // 0 without a TSC
+};
+
+template <typename F>
+static ReadCost batchCost(long passes, F step) {
+  auto start = std::chrono::steady_clock::now();
+  #ifdef HAVE_TSC
+  uint64_t tsc_start = __rdtsc();
+  #endif
+  for (long i = 0; i < passes; i++) {
+    step(i);
+  }
+  ReadCost cost = {};
+  #ifdef HAVE_TSC
+  cost.cycles = (double)(__rdtsc() - tsc_start) / passes;
+  #endif
+  cost.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / passes;
+  return cost;
+}
+
+int main(int argc, char **argv) {
+  int saves = 100;
+  long reads = 20000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--saves") && i + 1 < argc) {
+      saves = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--reads") && i + 1 < argc) {
+      reads = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--saves N] [--reads N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  struct Case {
+    const char *name;
+    bool passed;
+  };
+  Case cases[] = {
+    {"blank flash loads defaults", blank()},
+    {"save and load", roundTrip()},
+    {"wrap around the ring", wrap(saves)},
+    {"torn write", tornWrite()},
+    {"bad crc", badCrc()},
+    {"newest row erased", erasedRow()},
+    {"all rows erased", erasedAll()},
+    {"stuck bit, no retry", stuckBit()},
+  };
+  int failed = 0;
+  for (const Case &c : cases) {
+    printf("%-28s %s\n", c.name, c.passed ? "ok" : "FAILED");
+    failed += !c.passed;
+  }
+  printf("%d slots in %d rows, %d of %d cases failed\n\n", PARAM_STORE_SLOTS, NVM_PARAM_ROWS, failed, (int)(sizeof(cases) / sizeof(Case)));
+
+  eraseFlash();
+  ParamStore store(PARAMS, PARAM_COUNT);
+  store.load();
+  volatile float float_sink = 0;
+  volatile bool bool_sink = false;
+  volatile uint32_t last_param_change = 0;
+  ReadCost direct = batchCost(reads, [&](long i) { float_sink = max_speed_kmh * (float)(i & 15); });
+  ReadCost check = batchCost(reads, [&](long i) {
+    bool_sink = store.isDirty() && (uint32_t)i - last_param_change > PARAM_SAVE_DELAY;
+  });
+  ReadCost get = batchCost(reads, [&](long i) { float_sink = store.getValue(i & 3) * (float)(i & 15); });
+  printf("%12s %8s %8s\n", "read", "ns", "cycles");
+  printf("%12s %8.2f %8.1f\n", "variable", direct.ns, direct.cycles);
+  printf("%12s %8.2f %8.1f\n", "save check", check.ns, check.cycles);
+  printf("%12s %8.2f %8.1f\n", "getValue", get.ns, get.cycles);
+  (void)float_sink;
+  (void)bool_sink;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+"""Stick-to-servo latency of python/main.py on a recorded PPM edge stream.
+
+Runs the unmodified main.py under CPython with the CircuitPython modules it imports replaced
+by stand-ins driven from a virtual clock, and prints the same summary as ppm_bench.cpp so
+the two paths can be compared on one stream.
+
+    python3 tools/ppm_bench/main_py_bench.py [--idle-us US] [--frame-us US] edges.txt
+
+CPython runs far faster than CircuitPython on the M0, so the time main.py spends is charged
+to the virtual clock instead of measured: --idle-us for a loop iteration without a frame and
+--frame-us for one that decodes a frame, prints and updates the outputs. Measure both on the
+ItsyBitsy with time.monotonic_ns() around the loop body before trusting the numbers.
+"""
+import argparse
+import math
+import os
+import sys
+import types
+
+PPM_SYNC_MIN_US = 3000
+PPM_PULSE_LOW = 986
+PPM_PULSE_SPAN = 1024
+STEERING_CHANNEL = 1
+MATCH_TOLERANCE = 0.01
+PWM_HZ = 50
+MAIN_PY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'python', 'main.py')
+
+
+class EndOfStream(Exception):
+    pass
+
+
+class Clock:
+    def __init__(self, edges):
+        self.now_us = 0
+        self.edges = edges
+        self.next_edge = 0
+        self.listeners = []
+
+    def advance(self, us):
+        self.now_us += us
+        while self.next_edge < len(self.edges) and self.edges[self.next_edge][0] <= self.now_us:
+            t, level = self.edges[self.next_edge]
+            for listener in self.listeners:
+                listener(t, level)
+            self.next_edge += 1
+        if self.next_edge >= len(self.edges):
+            raise EndOfStream()
+
+
+class PulseIn:
+    """pulseio.PulseIn: durations between consecutive edges, oldest overwritten when full."""
+
+    def __init__(self, clock, idle_us, frame_us, maxlen):
+        self.clock = clock
+        self.idle_us = idle_us
+        self.frame_us = frame_us
+        self.maxlen = maxlen
+        self.buffer = []
+        self.paused = False
+        self.last_edge = None
+        clock.listeners.append(self.edge)
+
+    def edge(self, t, level):
+        if self.paused:
+            return
+        if self.last_edge is not None:
+            self.buffer.append(t - self.last_edge)
+            if len(self.buffer) > self.maxlen:
+                self.buffer.pop(0)
+        self.last_edge = t
+
+    # main.py tests the buffer first thing every loop, that is where an iteration is charged
+    def __bool__(self):
+        self.clock.advance(self.idle_us)
+        return len(self.buffer) > 0
+
+    def __len__(self):
+        return len(self.buffer)
+
+    def __getitem__(self, index):
+        return self.buffer[index]
+
+    def popleft(self):
+        return self.buffer.pop(0)
+
+    def pause(self):
+        self.paused = True
+        self.clock.advance(self.frame_us)
+
+    def resume(self):
+        self.paused = False
+        self.last_edge = None
+
+    def clear(self):
+        self.buffer = []
+
+
+class Servo:
+    def __init__(self, clock, outputs, pwm, min_pulse=1000, max_pulse=2000):
+        self.clock = clock
+        self.outputs = outputs
+        self._angle = 90
+
+    @property
+    def angle(self):
+        return self._angle
+
+    @angle.setter
+    def angle(self, value):
+        self._angle = value
+        self.outputs.append((self.clock.now_us, value / 180))
+
+
+class ContinuousServo:
+    def __init__(self, pwm, min_pulse=1000, max_pulse=2000):
+        self.throttle = 0
+
+
+def stub_modules(clock, outputs, idle_us, frame_us):
+    modules = {}
+    board = types.ModuleType('board')
+    for pin in ('D13', 'D5', 'SDA', 'APA102_SCK', 'APA102_MOSI'):
+        setattr(board, pin, pin)
+    modules['board'] = board
+
+    time_module = types.ModuleType('time')
+    time_module.monotonic = lambda: clock.now_us / 1e6
+    modules['time'] = time_module
+
+    pwmio = types.ModuleType('pwmio')
+    pwmio.PWMOut = lambda pin, duty_cycle=0, frequency=500: None
+    modules['pwmio'] = pwmio
+
+    pulseio = types.ModuleType('pulseio')
+    pulseio.PulseIn = lambda pin, maxlen=2: PulseIn(clock, idle_us, frame_us, maxlen)
+    modules['pulseio'] = pulseio
+
+    servo = types.ModuleType('adafruit_motor.servo')
+    servo.Servo = lambda pwm, min_pulse=1000, max_pulse=2000: Servo(clock, outputs, pwm, min_pulse, max_pulse)
+    servo.ContinuousServo = ContinuousServo
+    motor = types.ModuleType('adafruit_motor')
+    motor.servo = servo
+    modules['adafruit_motor'] = motor
+    modules['adafruit_motor.servo'] = servo
+
+    class DotStar(list):
+        def __init__(self, clock_pin, data_pin, count):
+            super().__init__([(0, 0, 0)] * count)
+
+        def show(self):
+            pass
+
+    dotstar = types.ModuleType('adafruit_dotstar')
+    dotstar.DotStar = DotStar
+    modules['adafruit_dotstar'] = dotstar
+    return modules
+
+
+def load_edges(path):
+    edges = []
+    with open(path) as f:
+        for line in f:
+            parts = line.split()
+            if len(parts) == 2 and not line.startswith('#'):
+                edges.append((int(parts[0]), int(parts[1])))
+    return edges
+
+
+def find_stick_changes(edges):
+    """Same ground truth as ppm_bench.cpp: steering value and the edge that closed its slot."""
+    changes = []
+    last_rising = 0
+    index = -1
+    previous = -1
+    for t, level in edges:
+        if level != 1:
+            continue
+        interval = t - last_rising
+        last_rising = t
+        if interval > PPM_SYNC_MIN_US:
+            index = 0
+        elif index >= 0:
+            if index == STEERING_CHANNEL:
+                value = min(1, max(0, (interval - PPM_PULSE_LOW) / PPM_PULSE_SPAN))
+                if abs(value - previous) > MATCH_TOLERANCE:
+                    if previous >= 0:
+                        changes.append((t, value))
+                    previous = value
+            index += 1
+    return changes
+
+
+def report(name, changes, latencies_ms):
+    latencies_ms.sort()
+    print('%s: %d of %d stick changes reached the servo' % (name, len(latencies_ms), len(changes)))
+    if not latencies_ms:
+        return
+    n = len(latencies_ms)
+    print('latency ms: min %.2f  mean %.2f  p50 %.2f  p99 %.2f  max %.2f' % (
+        latencies_ms[0], sum(latencies_ms) / n, latencies_ms[n // 2], latencies_ms[min(n - 1, int(n * 0.99))],
+        latencies_ms[-1]))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('edges')
+    parser.add_argument('--idle-us', type=float, default=1000)
+    parser.add_argument('--frame-us', type=float, default=15000)
+    args = parser.parse_args()
+
+    edges = load_edges(args.edges)
+    changes = find_stick_changes(edges)
+    clock = Clock(edges)
+    outputs = []
+
+    saved = {}
+    for name, module in stub_modules(clock, outputs, args.idle_us, args.frame_us).items():
+        saved[name] = sys.modules.get(name)
+        sys.modules[name] = module
+    try:
+        with open(MAIN_PY) as f:
+            code = compile(f.read(), MAIN_PY, 'exec')
+        exec(code, {'__name__': '__main__', 'print': lambda *a, **k: None})
+    except EndOfStream:
+        pass
+    finally:
+        for name, module in saved.items():
+            if module is None:
+                del sys.modules[name]
+            else:
+                sys.modules[name] = module
+
+    # PWMOut picks up a new duty cycle at the start of its next period
+    period_us = 1e6 / PWM_HZ
+    latencies_ms = []
+    next_output = 0
+    for t, value in changes:
+        while next_output < len(outputs) and (outputs[next_output][0] < t or abs(outputs[next_output][1] - value) > MATCH_TOLERANCE):
+            next_output += 1
+        if next_output == len(outputs):
+            break
+        applied = math.ceil(outputs[next_output][0] / period_us) * period_us
+        latencies_ms.append((applied - t) / 1000)
+
+    print('python/main.py (idle %.0f us, frame %.0f us, servo %d Hz)' % (args.idle_us, args.frame_us, PWM_HZ))
+    report('python', changes, latencies_ms)
+
+
+if __name__ == '__main__':
+    main()
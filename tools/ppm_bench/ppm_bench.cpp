@@ -0,0 +1,251 @@
+// Stick-to-servo latency of the C++ drive path on a recorded PPM edge stream. The same stream
+// goes through python/main.py with main_py_bench.py, both print the same summary.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/ppm_bench/ppm_bench.cpp -o ppm_bench
+// Run:     ./ppm_bench --generate edges.txt [--seconds S]
+//          ./ppm_bench [--loop-us US] [--servo-hz HZ] edges.txt
+//
+// Edge files have one "timestamp_us level" pair per line, as exported by a logic analyzer on
+// the receiver PPM pin, lines starting with # are ignored. Latency runs from the edge that
+// completes a new steering value on the wire to the start of the first servo pulse carrying it.
+//
+// The C++ path decodes on the rising edge interrupt, loop() picks the frame up within --loop-us
+// (worst case loop time measured on the car) and ServoOutput applies it at the next servo frame.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "DriveControl.h"
+#include "ServoOutput.h"
+
+#define PPM_CHANNELS 8
+#define PPM_SYNC_MIN_US 3000 // a gap this long separates frames
+#define PPM_PULSE_LOW 986 // same normalisation as python/main.py
+#define PPM_PULSE_SPAN 1024
+#define PPM_SEPARATOR_US 400
+#define PPM_FRAME_US 22500
+#define STEERING_CHANNEL 1
+#define STEERING_MIN_US 1000.0f
+#define STEERING_MAX_US 2000.0f
+#define MATCH_TOLERANCE 0.01f // normalised stick units
+
+struct Edge {
+  uint64_t time_us;
+  int level;
+};
+
+struct StickChange {
+  uint64_t time_us; // edge that completes the value on the wire
+  float value; // 0..1
+};
+
+// Channel decoder on rising edges, the interval between two rising edges is one channel
+class PpmDecoder {
+  public:
+    // Returns true when the edge completed a frame
+    bool rising(uint64_t now_us) {
+      uint64_t interval = now_us - last_rising;
+      last_rising = now_us;
+      if (interval > PPM_SYNC_MIN_US) {
+        index = 0;
+        synced = true;
+        return false;
+      }
+      if (!synced) {
+        return false;
+      }
+      channels[index++] = (uint16_t)interval;
+      if (index == PPM_CHANNELS) {
+        synced = false;
+        return true;
+      }
+      return false;
+    }
+
+    float getChannelFloat(int channel) {
+      float value = (float)(channels[channel] - PPM_PULSE_LOW) / PPM_PULSE_SPAN;
+      return value < 0 ? 0 : (value > 1 ? 1 : value);
+    }
+
+  private:
+    uint64_t last_rising = 0;
+    uint16_t channels[PPM_CHANNELS] = {0};
+    int index = 0;
+    bool synced = false;
+};
+
+static bool loadEdges(const char *path, std::vector<Edge> *edges) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long long t;
+    int level;
+    if (line[0] != '#' && sscanf(line, "%llu %d", &t, &level) == 2) {
+      Edge e = {t, level};
+      edges->push_back(e);
+    }
+  }
+  bool failed = ferror(f);
+  fclose(f);
+  if (failed) {
+    fprintf(stderr, "%s: read failed\n", path);
+    return false;
+  }
+  if (edges->empty()) {
+    fprintf(stderr, "%s: no edges\n", path);
+    return false;
+  }
+  return true;
+}
+
+// Ground truth, the steering value and the time its channel slot closed
+static std::vector<StickChange> findStickChanges(const std::vector<Edge> &edges) {
+  std::vector<StickChange> changes;
+  uint64_t last_rising = 0;
+  int index = -1;
+  float previous = -1;
+  for (size_t i = 0; i < edges.size(); i++) {
+    if (edges[i].level != 1) {
+      continue;
+    }
+    uint64_t interval = edges[i].time_us - last_rising;
+    last_rising = edges[i].time_us;
+    if (interval > PPM_SYNC_MIN_US) {
+      index = 0;
+    } else if (index >= 0) {
+      if (index == STEERING_CHANNEL) {
+        float value = (float)((int)interval - PPM_PULSE_LOW) / PPM_PULSE_SPAN;
+        value = value < 0 ? 0 : (value > 1 ? 1 : value);
+        if (fabsf(value - previous) > MATCH_TOLERANCE) {
+          StickChange c = {edges[i].time_us, value};
+          if (previous >= 0) {
+            changes.push_back(c);
+          }
+          previous = value;
+        }
+      }
+      index++;
+    }
+  }
+  return changes;
+}
+
+static void generate(const char *path, float seconds) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(f, "# synthetic %d channel PPM, steering steps every ~0.4 s, mode select on steer assist\n", PPM_CHANNELS);
+  uint32_t rng = 12345;
+  float channels[PPM_CHANNELS] = {0.5f, 0.5f, 0.5f, 1.0f, 0.5f, 0.5f, 0.5f, 0.5f};
+  uint64_t t = 1000;
+  uint64_t next_change = 300000;
+  while (t < (uint64_t)(seconds * 1e6)) {
+    if (t >= next_change) {
+      rng = rng * 1664525u + 1013904223u;
+      channels[STEERING_CHANNEL] = 0.1f + 0.8f * (float)(rng >> 8) / 16777216.0f;
+      // not a multiple of the frame or servo period, so the phase walks through every case
+      next_change = t + 400000 + (rng % 37) * 1000;
+    }
+    uint64_t frame_start = t;
+    for (int ch = 0; ch <= PPM_CHANNELS; ch++) {
+      fprintf(f, "%llu 0\n%llu 1\n", (unsigned long long)t, (unsigned long long)(t + PPM_SEPARATOR_US));
+      if (ch == PPM_CHANNELS) {
+        break;
+      }
+      t += (uint64_t)(PPM_PULSE_LOW + channels[ch] * PPM_PULSE_SPAN + 0.5f);
+    }
+    t = frame_start + PPM_FRAME_US;
+  }
+  fclose(f);
+}
+
+static void report(const char *name, const std::vector<StickChange> &changes, std::vector<double> &latencies_ms) {
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  printf("%s: %zu of %zu stick changes reached the servo\n", name, latencies_ms.size(), changes.size());
+  if (latencies_ms.empty()) {
+    return;
+  }
+  double sum = 0;
+  for (size_t i = 0; i < latencies_ms.size(); i++) {
+    sum += latencies_ms[i];
+  }
+  size_t n = latencies_ms.size();
+  printf("latency ms: min %.2f  mean %.2f  p50 %.2f  p99 %.2f  max %.2f\n", latencies_ms[0], sum / n, latencies_ms[n / 2],
+         latencies_ms[std::min(n - 1, (size_t)(n * 0.99))], latencies_ms[n - 1]);
+}
+
+static int usage() {
+  fprintf(stderr, "usage: ppm_bench --generate edges.txt [--seconds S] | [--loop-us US] [--servo-hz HZ] edges.txt\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  const char *generate_path = NULL;
+  float seconds = 60;
+  float loop_us = 500;
+  float servo_hz = SERVO_OUTPUT_MIN_HZ;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      generate_path = argv[++i];
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loop_us = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--servo-hz") == 0 && i + 1 < argc) {
+      servo_hz = atof(argv[++i]);
+    } else if (argv[i][0] != '-' && path == NULL) {
+      path = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (generate_path != NULL) {
+    generate(generate_path, seconds);
+    return 0;
+  }
+  if (path == NULL) {
+    return usage();
+  }
+  std::vector<Edge> edges;
+  if (!loadEdges(path, &edges)) {
+    return 1;
+  }
+  std::vector<StickChange> changes = findStickChanges(edges);
+
+  PpmDecoder decoder;
+  double servo_period_us = 1e6 / servo_hz;
+  std::vector<double> latencies_ms;
+  size_t next = 0;
+  for (size_t i = 0; i < edges.size() && next < changes.size(); i++) {
+    if (edges[i].level != 1 || !decoder.rising(edges[i].time_us)) {
+      continue;
+    }
+    // loop() runs the STEER_ASSIST mapping, the timer latches it at the next frame start
+    float command = stickToCommand(decoder.getChannelFloat(STEERING_CHANNEL));
+    float pulse = steeringToPulseUs(command, 0, STEERING_MIN_US, STEERING_MAX_US);
+    float value = (pulse - STEERING_MIN_US) / (STEERING_MAX_US - STEERING_MIN_US);
+    double written = edges[i].time_us + loop_us;
+    double applied = ceil(written / servo_period_us) * servo_period_us;
+    while (next < changes.size() && changes[next].time_us <= edges[i].time_us) {
+      if (fabsf(value - changes[next].value) < MATCH_TOLERANCE) {
+        latencies_ms.push_back((applied - changes[next].time_us) / 1000.0);
+      }
+      next++;
+    }
+  }
+  printf("c++ (loop %.0f us, servo %.0f Hz)\n", loop_us, servo_hz);
+  report("c++", changes, latencies_ms);
+  return 0;
+}
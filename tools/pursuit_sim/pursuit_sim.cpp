@@ -0,0 +1,216 @@
+// Path following of the AUTONOMOUS mode: the PurePursuit yaw rate target closed through the
+// TURN_ASSIST turn rate loop and the feed-forward on the VehicleModel car, with the speed target
+// sent to a VESC speed loop. Reports cross-track error, lap time and the CPU cost of a pursuit
+// update on each path.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. -I../../tools/common
+//            ../../tools/pursuit_sim/pursuit_sim.cpp PurePursuit.cpp SteeringFeedForward.cpp -o pursuit_sim
+// Run:     ./pursuit_sim [--speed KMH] [--lookahead M] [--laps N] [--offset M]
+//
+// The pursuit gets the true pose at the odometry rate, odometry_sim covers the pose error. The
+// PID is AutoPID as loop() runs it, see TurnRatePid.h. --offset starts the car that far
+// left of the path to show it converging.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "DriveControl.h"
+#include "PurePursuit.h"
+#include "SteeringFeedForward.h"
+#include "TurnRatePid.h"
+#include "VehicleModel.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define WHEELBASE 0.26f
+#define MAX_STEERING_ANGLE_DEG 25.0f
+#define MAX_STEERING_DEG_S 180.0f
+#define PID_I_TERM (1.0f / 32.0f)
+#define PID_D_TERM (1.0f / 64.0f)
+#define PID_RATE_HZ 50
+#define PID_INTEGRAL_BAND 20.0f
+#define FEED_FORWARD_GAIN 1.0f
+#define PATH_LOOKAHEAD 1.0f
+#define PATH_SPEED_KMH 6.0f
+#define PATH_MAX_LATERAL_ACCEL 4.0f
+static const float PID_CONFIG_SPEED[] = {0.0f, 5.0f, 15.0f};
+static const float PID_CONFIG_VALUE[] = {1.0f / 512.0f, 1.0f / 512.0f, 1.0f / 20480.0f};
+
+#define SIM_RATE_HZ 5000
+#define POSE_RATE_HZ 100 // VESC telemetry, the odometry rate
+#define SPEED_TAU 0.3f // s, VESC speed loop
+#define TIMEOUT_SECONDS 600.0f
+
+struct Path {
+  const char *name;
+  std::vector<PathPoint> points;
+  bool closed;
+};
+
+// the AUTONOMOUS_PATH oval of the firmware
+static Path oval() {
+  Path path = {"oval", {}, true};
+  path.points = {
+    {0.00, 0.00}, {2.00, 0.00}, {4.00, 0.00}, {4.57, 0.11}, {5.06, 0.44}, {5.39, 0.93}, {5.50, 1.50},
+    {5.39, 2.07}, {5.06, 2.56}, {4.57, 2.89}, {4.00, 3.00}, {2.00, 3.00}, {0.00, 3.00}, {-0.57, 2.89},
+    {-1.06, 2.56}, {-1.39, 2.07}, {-1.50, 1.50}, {-1.39, 0.93}, {-1.06, 0.44}, {-0.57, 0.11},
+  };
+  return path;
+}
+
+// 2 m loops left then right, the path crosses itself at the start
+static Path figureEight() {
+  Path path = {"figure8", {}, true};
+  for (int i = 0; i < 24; i++) {
+    float a = i * 2.0f * (float)M_PI / 24;
+    path.points.push_back({2.0f * sinf(a), 2.0f - 2.0f * cosf(a)});
+  }
+  for (int i = 0; i < 24; i++) {
+    float a = i * 2.0f * (float)M_PI / 24;
+    path.points.push_back({2.0f * sinf(a), -2.0f + 2.0f * cosf(a)});
+  }
+  return path;
+}
+
+// 20 m of 1 m weaves, driven once
+static Path slalom() {
+  Path path = {"slalom", {}, false};
+  for (int i = 0; i <= 40; i++) {
+    float x = i * 0.5f;
+    path.points.push_back({x, sinf(x * 2.0f * (float)M_PI / 5.0f)});
+  }
+  return path;
+}
+
+static float scheduledP(float speed_kmh) {
+  int n = sizeof(PID_CONFIG_SPEED) / sizeof(float);
+  int i = 0;
+  while (i < n - 1 && PID_CONFIG_SPEED[i + 1] <= speed_kmh) {
+    i++;
+  }
+  return PID_CONFIG_VALUE[i];
+}
+
+struct Pose {
+  float x, y, heading, speed;
+};
+
+struct Run {
+  float rms_cross_track;
+  float max_cross_track;
+  float lap_seconds; // mean over the laps, or the time to the end of an open path
+  uint32_t laps;
+  std::vector<Pose> poses; // what the pursuit was fed, for timing it
+};
+
+static Run simulate(const Path &path, float speed_kmh, float lookahead, uint32_t laps, float offset) {
+  PurePursuit pursuit(lookahead, speed_kmh / 3.6f, PATH_MAX_LATERAL_ACCEL);
+  pursuit.setPath(path.points.data(), path.points.size(), path.closed);
+  VehicleParams params;
+  VehicleModel car(params);
+  SteeringFeedForward feed_forward(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+
+  Run run = {};
+  double x = 0, y = offset, heading = 0; // heading counterclockwise, the car's yaw rate is clockwise
+  float speed = 0, speed_target = 0, target_yaw_v = 0, yaw_rate = 0, command = 0;
+  TurnRatePid pid(PID_RATE_HZ, PID_INTEGRAL_BAND);
+  double square_sum = 0;
+  uint32_t samples = 0;
+  float dt = 1.0f / SIM_RATE_HZ;
+  int pose_div = SIM_RATE_HZ / POSE_RATE_HZ;
+  int pid_div = SIM_RATE_HZ / PID_RATE_HZ;
+  bool driving = true;
+  long i = 0;
+  for (; driving && i < (long)(TIMEOUT_SECONDS * SIM_RATE_HZ); i++) {
+    if (i % pose_div == 0) {
+      Pose pose = {(float)x, (float)y, (float)heading, speed};
+      run.poses.push_back(pose);
+      driving = pursuit.update(pose.x, pose.y, pose.heading, pose.speed);
+      target_yaw_v = -fmaxf(-MAX_STEERING_DEG_S, fminf(MAX_STEERING_DEG_S, pursuit.getYawRate()));
+      speed_target = pursuit.getSpeed();
+      float error = pursuit.getCrossTrack();
+      square_sum += error * error;
+      samples++;
+      run.max_cross_track = fmaxf(run.max_cross_track, fabsf(error));
+      if (path.closed && pursuit.getLaps() >= laps) {
+        driving = false;
+      }
+    }
+    if (i % pid_div == 0) {
+      float pid_out = pid.step(target_yaw_v, yaw_rate, scheduledP(speed * 3.6f), PID_I_TERM, PID_D_TERM, FEED_FORWARD_GAIN);
+      command = clampCommand(pid_out + FEED_FORWARD_GAIN * feed_forward.command(target_yaw_v, speed));
+    }
+    speed += (speed_target - speed) * dt / SPEED_TAU;
+    yaw_rate = car.step(command, speed, dt);
+    double mean = (heading - yaw_rate * dt * 0.5) * M_PI / 180.0;
+    x += speed * dt * cos(mean);
+    y += speed * dt * sin(mean);
+    heading -= yaw_rate * dt;
+  }
+  run.laps = path.closed ? pursuit.getLaps() : 1;
+  run.lap_seconds = i * dt / (run.laps > 0 ? run.laps : 1);
+  run.rms_cross_track = samples > 0 ? sqrtf(square_sum / samples) : 0;
+  return run;
+}
+
+static volatile float sink;
+
+// Host ns per update(), replaying the poses of a run
+static double updateNs(const Path &path, const std::vector<Pose> &poses, float speed_kmh, float lookahead) {
+  PurePursuit pursuit(lookahead, speed_kmh / 3.6f, PATH_MAX_LATERAL_ACCEL);
+  pursuit.setPath(path.points.data(), path.points.size(), path.closed);
+  int repeat = 0;
+  size_t updates = 0;
+  auto start = std::chrono::steady_clock::now();
+  do {
+    pursuit.reset();
+    for (const Pose &pose : poses) {
+      pursuit.update(pose.x, pose.y, pose.heading, pose.speed);
+    }
+    updates += poses.size();
+    repeat++;
+  } while (updates < 2000000);
+  auto end = std::chrono::steady_clock::now();
+  sink = pursuit.getYawRate();
+  return std::chrono::duration<double, std::nano>(end - start).count() / updates;
+}
+
+int main(int argc, char **argv) {
+  float speed_kmh = PATH_SPEED_KMH;
+  float lookahead = PATH_LOOKAHEAD;
+  uint32_t laps = 5;
+  float offset = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      speed_kmh = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--lookahead") && i + 1 < argc) {
+      lookahead = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--laps") && i + 1 < argc) {
+      laps = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--offset") && i + 1 < argc) {
+      offset = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--speed KMH] [--lookahead M] [--laps N] [--offset M]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (speed_kmh <= 0 || lookahead <= 0 || laps == 0) {
+    fprintf(stderr, "speed, lookahead and laps must be above 0\n");
+    return 1;
+  }
+
+  printf("cruise %.1f km/h, lookahead %.2f m, %u laps, start %.2f m off the path\n", speed_kmh, lookahead, laps, offset);
+  printf("%-8s %7s %10s %10s %9s %11s\n", "path", "points", "rms xte m", "max xte m", "lap s", "update ns");
+  const Path paths[] = {oval(), figureEight(), slalom()};
+  for (const Path &path : paths) {
+    Run run = simulate(path, speed_kmh, lookahead, laps, offset);
+    // a lap time of nan means the car didn't get round within TIMEOUT_SECONDS
+    printf("%-8s %7zu %10.3f %10.3f %9.2f %11.1f\n", path.name, path.points.size(), run.rms_cross_track, run.max_cross_track,
+           run.laps > 0 ? run.lap_seconds : NAN, updateNs(path, run.poses, speed_kmh, lookahead));
+  }
+  printf("cross-track error is from the segment the pursuit tracks, sampled at %d Hz\n", POSE_RATE_HZ);
+  return 0;
+}
@@ -0,0 +1,464 @@
+// Replays a capture from a CAPTURE_LOG build of arduino/FPV_RC_Car through the same parsing,
+// filtering and command mapping code the car runs, on a virtual clock taken from the capture.
+//
+// Record:  stty -F /dev/ttyACM0 raw && cat /dev/ttyACM0 > run.fpvc
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/replay/replay.cpp
+//            CRSFProtocol.cpp VescCodec.cpp GyroCalibration.cpp AttitudeEstimator.cpp LinkMonitor.cpp -o replay
+// Run:     ./replay [--speed N] [--runs N] [--outputs] run.fpvc
+//
+// --speed N  paces the virtual clock at N times real time, 0 (default) runs as fast as possible
+// --runs N   replays N times and fails if the output digests differ
+// --outputs  prints every control output as CSV
+//
+// Outputs only depend on the capture, so the digest is a regression check for parser and control
+// changes and the latency numbers are a benchmark on real input. TURN_ASSIST steering comes from
+// the AutoPID library, which isn't in this tree, so in that mode the PID target is reported instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "CaptureFormat.h"
+#include "CRSFProtocol.h"
+#include "VescCodec.h"
+#include "GyroCalibration.h"
+#include "AttitudeEstimator.h"
+#include "BiquadFilter.h"
+#include "DriveControl.h"
+#include "LinkMonitor.h"
+
+#define FAILSAFE_MS 500 // same as executeCommands()
+// link defaults of FPV_RC_Car.ino, the capture header predates them
+#define LINK_LQ_FULL 70
+#define LINK_LQ_MIN 30
+#define LINK_MIN_SPEED_SCALE 0.3f
+#define LINK_FAILSAFE_FRAMES 8
+#define LINK_FAILSAFE_MIN_US 20000
+#define LINK_FAILSAFE_MAX_US 200000
+#define TELEMETRY_INTERVAL 50 // ms
+
+typedef std::chrono::steady_clock Clock;
+
+struct Record {
+  uint64_t time_us; // unwrapped
+  uint8_t kind;
+  uint8_t length;
+  const uint8_t *data;
+};
+
+struct __attribute__((packed)) ControlOutput {
+  uint64_t time_us;
+  uint8_t mode;
+  uint8_t failsafe;
+  float servo_us; // 0 while the servo output is off
+  float erpm;
+  float target_yaw_v;
+  float yaw_v;
+  float roll;
+  float pitch;
+};
+
+enum Stage {
+  STAGE_CRSF,
+  STAGE_VESC,
+  STAGE_IMU,
+  STAGE_CONTROL,
+  STAGE_COUNT
+};
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {"crsf", "vesc", "imu", "control"};
+
+struct StageStats {
+  std::vector<uint32_t> ns;
+  uint64_t bytes = 0;
+};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t length) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= p[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+// Firmware state rebuilt from scratch for every run
+class Replay {
+  public:
+    Replay(const CaptureHeader &header, bool print_outputs)
+      : header(header),
+        gyro_cal(-header.gyro_yaw_cal, header.gyro_stationary_erpm, header.gyro_stationary_stddev),
+        print_outputs(print_outputs) {
+      filter_fixed = header.flags & CAPTURE_FLAG_FILTER_FIXED;
+      BiquadCoefficients lowpass = biquadLowpass(header.gyro_lowpass_hz, header.gyro_sample_rate);
+      yaw_filter.setStage(0, lowpass);
+      yaw_filter_fixed.setStage(0, lowpass);
+    }
+
+    void process(const Record &rec, StageStats *stats) {
+      now_us = rec.time_us;
+      Clock::time_point start = Clock::now();
+      Stage stage;
+      switch (rec.kind) {
+        case CAPTURE_CRSF_RX:
+          stage = STAGE_CRSF;
+          for (int i = 0; i < rec.length; i++) {
+            if (crsf_parser.feed(rec.data[i], (uint32_t)now_us)) {
+              handleCrsfFrame(&crsf_parser.frame);
+            }
+          }
+          break;
+        case CAPTURE_VESC_RX:
+          stage = STAGE_VESC;
+          for (int i = 0; i < rec.length; i++) {
+            if (vesc_parser.feed(rec.data[i])) {
+              handleVescPacket();
+            }
+          }
+          break;
+        case CAPTURE_IMU:
+          if (rec.length != sizeof(CaptureImuSample)) {
+            return;
+          }
+          stage = STAGE_IMU;
+          handleImu((const CaptureImuSample *)rec.data);
+          break;
+        default:
+          return;
+      }
+      Clock::time_point parsed = Clock::now();
+      stats[stage].ns.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(parsed - start).count());
+      stats[stage].bytes += rec.length;
+
+      // loop() runs the control tail after every input
+      control();
+      stats[STAGE_CONTROL].ns.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - parsed).count());
+    }
+
+    uint64_t digest = 0xCBF29CE484222325ULL;
+    uint32_t crsf_frames = 0;
+    uint32_t vesc_packets = 0;
+
+  private:
+    uint32_t nowMs() {
+      return (uint32_t)(now_us / 1000);
+    }
+
+    void handleCrsfFrame(const crsfFrame_t *frame) {
+      crsf_frames++;
+      if (frame->frame.type == CRSF_FRAMETYPE_RC_CHANNELS_PACKED) {
+        crsfUnpackChannels(frame->frame.payload, channels);
+        last_channels_us = (uint32_t)now_us;
+        channel_frames++;
+      } else if (frame->frame.type == CRSF_FRAMETYPE_LINK_STATISTICS) {
+        crsfLinkStatistics_t stats;
+        if (crsfUnpackLinkStatistics(frame, &stats)) {
+          link.statisticsReceived(stats, (uint32_t)now_us);
+        }
+      }
+    }
+
+    void handleVescPacket() {
+      // captures before VescLink hold full COMM_GET_VALUES replies
+      uint32_t mask;
+      if (!vescDecodeValuesSelective(vesc_parser.payload, vesc_parser.length, &values, &mask) &&
+          !vescDecodeValues(vesc_parser.payload, vesc_parser.length, &values)) {
+        return;
+      }
+      vesc_packets++;
+      motor_erpm = values.rpm;
+      BiquadCoefficients notch = biquadMotorNotch(motor_erpm, header.motor_poles, header.gyro_sample_rate, header.gyro_notch_q, header.gyro_notch_min_hz);
+      yaw_filter.setStage(1, notch);
+      yaw_filter_fixed.setStage(1, notch);
+      current_speed = motor_erpm / header.kmh_to_motor_erpm;
+
+      // telemetry sent back to the radio, part of the output
+      if (has_telemetry && nowMs() - last_telemetry_ms < TELEMETRY_INTERVAL * link.getTelemetryDivider()) {
+        return;
+      }
+      last_telemetry_ms = nowMs();
+      has_telemetry = true;
+      uint8_t buffer[CRSF_FRAME_SIZE_MAX];
+      crsfGpsFrame_t info = {};
+      info.groundSpeed = (uint16_t)fabsf(current_speed * 10.0f);
+      digest = fnv1a(digest, buffer, crsfBuildGpsFrame(buffer, &info));
+      crsfVoltageFrame_t voltage = {};
+      voltage.voltage = (uint16_t)(values.inpVoltage * 10.0f);
+      voltage.current = (uint16_t)(values.avgInputCurrent * 100.0f);
+      digest = fnv1a(digest, buffer, crsfBuildVoltageFrame(buffer, &voltage));
+    }
+
+    void handleImu(const CaptureImuSample *sample) {
+      double elapsed = (double)(now_us - last_sensor_us) / 1000000.0;
+      last_sensor_us = now_us;
+      double yaw_in = -gyro_cal.update(sample->gyro[2], motor_erpm);
+      if (filter_fixed) {
+        yaw_v = biquadFromFixed(yaw_filter_fixed.process(biquadToFixed((float)yaw_in)));
+      } else {
+        yaw_v = yaw_filter.process((float)yaw_in);
+      }
+      // the capture has no SpeedEstimator, the ERPM speed stands in for it
+      attitude.setSpeed(current_speed / 3.6f);
+      attitude.update(sample->gyro[0], sample->gyro[1], (float)-yaw_in, sample->accel[0], sample->accel[1], sample->accel[2], (float)elapsed);
+    }
+
+    void control() {
+      link.update(channel_frames, last_channels_us, (uint32_t)now_us);
+      if (!link.isFailsafe()) {
+        assist_switch = auxSwitch(crsfChannelToFloat(channels[3]), assist_switch);
+        teach_switch = auxSwitch(crsfChannelToFloat(channels[4]), teach_switch);
+        drive_mode = selectDriveMode(crsfChannelToFloat(channels[2]), assist_switch, teach_switch);
+        float throttle_input = crsfChannelToFloat(channels[0]);
+        float steering_input = crsfChannelToFloat(channels[1]);
+        switch (drive_mode) {
+          case DriveMode::DIRECT:
+            steering_command = stickToCommand(steering_input);
+            throttle_command = stickToCommand(throttle_input);
+            break;
+          case DriveMode::STEER_ASSIST:
+            steering_command = stickToCommand(steering_input);
+            throttle_command = steerAssistThrottle(stickToCommand(throttle_input), steering_command);
+            break;
+          case DriveMode::TURN_ASSIST:
+            throttle_command = stickToCommand(throttle_input);
+            target_yaw_v = stickToCommand(steering_input) * header.max_steering_deg_s;
+            break;
+          case DriveMode::OFF:
+            throttle_command = 0;
+            break;
+          // AUTONOMOUS and REPEAT aren't replayed, the capture has neither path, the commands are held
+          default:
+            break;
+        }
+        last_update_ms = nowMs();
+        has_update = true;
+      } else {
+        drive_mode = DriveMode::NO_CONNECTION;
+        throttle_command = 0;
+        steering_command = 0;
+      }
+
+      ControlOutput out = {};
+      out.time_us = now_us;
+      out.mode = drive_mode;
+      out.failsafe = !has_update || nowMs() - last_update_ms > FAILSAFE_MS;
+      if (!out.failsafe) {
+        steering_command = clampCommand(steering_command);
+        throttle_command = clampCommand(throttle_command);
+        if (drive_mode != DriveMode::OFF) {
+          out.servo_us = steeringToPulseUs(steering_command, header.steering_trim, header.steering_min_us, header.steering_max_us);
+        }
+        out.erpm = throttleToErpm(throttle_command, header.max_speed_kmh * link.getSpeedScale(), header.kmh_to_motor_erpm);
+      }
+      out.target_yaw_v = target_yaw_v;
+      out.yaw_v = yaw_v;
+      out.roll = attitude.getRoll();
+      out.pitch = attitude.getPitch();
+      digest = fnv1a(digest, &out, sizeof(out));
+      if (print_outputs) {
+        printf("%llu,%d,%d,%.2f,%.1f,%.3f,%.3f,%.2f,%.2f\n", (unsigned long long)out.time_us, out.mode, out.failsafe,
+               out.servo_us, out.erpm, out.target_yaw_v, out.yaw_v, out.roll, out.pitch);
+      }
+    }
+
+    CaptureHeader header;
+    CRSFFrameParser crsf_parser;
+    VescPacketParser vesc_parser;
+    vescValues_t values = {};
+    GyroCalibration gyro_cal;
+    AttitudeEstimator attitude;
+    FilterChain<float, 2> yaw_filter;
+    FilterChain<int32_t, 2> yaw_filter_fixed;
+    bool filter_fixed;
+    bool print_outputs;
+
+    uint64_t now_us = 0;
+    uint64_t last_sensor_us = 0;
+    uint16_t channels[CRSF_CHANNEL_COUNT] = {0};
+    LinkMonitor link{LINK_LQ_FULL, LINK_LQ_MIN, LINK_MIN_SPEED_SCALE, LINK_FAILSAFE_FRAMES, LINK_FAILSAFE_MIN_US, LINK_FAILSAFE_MAX_US};
+    uint32_t channel_frames = 0;
+    uint32_t last_channels_us = 0;
+    bool has_update = false;
+    bool has_telemetry = false;
+    uint32_t last_update_ms = 0;
+    uint32_t last_telemetry_ms = 0;
+    DriveMode drive_mode = DriveMode::NO_CONNECTION;
+    bool assist_switch = false;
+    bool teach_switch = false;
+    float steering_command = 0;
+    float throttle_command = 0;
+    float target_yaw_v = 0;
+    float yaw_v = 0;
+    float motor_erpm = 0;
+    float current_speed = 0;
+};
+
+// Splits the capture into records, timestamps are unwrapped into 64 bits. Returns false when
+// no header is found.
+static bool loadRecords(const std::vector<uint8_t> &file, CaptureHeader *header, std::vector<Record> *records) {
+  // the capture may start mid-stream if the port was opened late, skip to the header record
+  size_t offset = 0;
+  const uint32_t magic = CAPTURE_MAGIC;
+  for (; offset + sizeof(CaptureRecord) + sizeof(CaptureHeader) <= file.size(); offset++) {
+    const CaptureRecord *rec = (const CaptureRecord *)&file[offset];
+    if (rec->kind == CAPTURE_HEADER && rec->length == sizeof(CaptureHeader) &&
+        memcmp(&file[offset + sizeof(CaptureRecord)], &magic, sizeof(magic)) == 0) {
+      break;
+    }
+  }
+  if (offset + sizeof(CaptureRecord) + sizeof(CaptureHeader) > file.size()) {
+    return false;
+  }
+  memcpy(header, &file[offset + sizeof(CaptureRecord)], sizeof(CaptureHeader));
+  if (header->version != CAPTURE_VERSION) {
+    fprintf(stderr, "capture version %d, expected %d\n", header->version, CAPTURE_VERSION);
+    return false;
+  }
+
+  uint64_t time_us = 0;
+  uint32_t last_stamp = 0;
+  bool first = true;
+  while (offset + sizeof(CaptureRecord) <= file.size()) {
+    CaptureRecord rec;
+    memcpy(&rec, &file[offset], sizeof(rec));
+    offset += sizeof(rec);
+    if (offset + rec.length > file.size()) {
+      break; // truncated tail
+    }
+    // records from the ISR can land slightly out of order, never step the clock backwards
+    int32_t delta = (int32_t)(rec.timestamp_us - last_stamp);
+    if (first) {
+      first = false;
+      last_stamp = rec.timestamp_us;
+    } else if (delta > 0) {
+      time_us += delta;
+      last_stamp = rec.timestamp_us;
+    }
+    if (rec.kind == CAPTURE_DROPPED && rec.length == sizeof(uint32_t)) {
+      uint32_t dropped;
+      memcpy(&dropped, &file[offset], sizeof(dropped));
+      fprintf(stderr, "warning: %u bytes were dropped on the car before t=%llu us\n", dropped, (unsigned long long)time_us);
+    }
+    Record r = {time_us, rec.kind, rec.length, &file[offset]};
+    records->push_back(r);
+    offset += rec.length;
+  }
+  return true;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+static void report(StageStats *stats, double wall_s, const std::vector<Record> &records) {
+  printf("%-8s %9s %9s %9s %9s %9s %10s\n", "stage", "calls", "mean ns", "p50 ns", "p99 ns", "max ns", "MB/s");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    std::vector<uint32_t> &ns = stats[i].ns;
+    if (ns.empty()) {
+      continue;
+    }
+    uint64_t total = 0;
+    for (size_t j = 0; j < ns.size(); j++) {
+      total += ns[j];
+    }
+    std::sort(ns.begin(), ns.end());
+    char throughput[16] = "-";
+    if (stats[i].bytes > 0 && total > 0) {
+      snprintf(throughput, sizeof(throughput), "%.1f", (double)stats[i].bytes / (double)total * 1000.0);
+    }
+    printf("%-8s %9zu %9llu %9u %9u %9u %10s\n", STAGE_NAMES[i], ns.size(), (unsigned long long)(total / ns.size()),
+           percentile(ns, 0.5), percentile(ns, 0.99), ns.back(), throughput);
+  }
+  double span_s = records.empty() ? 0 : (double)records.back().time_us / 1e6;
+  printf("%zu records, %.1f s of capture replayed in %.3f s (%.0fx)\n", records.size(), span_s, wall_s, wall_s > 0 ? span_s / wall_s : 0);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: replay [--speed N] [--runs N] [--outputs] capture.fpvc\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  double speed = 0;
+  int runs = 1;
+  bool print_outputs = false;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--outputs") == 0) {
+      print_outputs = true;
+    } else if (argv[i][0] != '-' && path == NULL) {
+      path = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (path == NULL || runs < 1 || speed < 0) {
+    usage();
+  }
+
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return 1;
+  }
+  std::vector<uint8_t> file;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    file.insert(file.end(), chunk, chunk + n);
+  }
+  fclose(f);
+
+  CaptureHeader header;
+  std::vector<Record> records;
+  if (!loadRecords(file, &header, &records)) {
+    fprintf(stderr, "%s: no capture header found\n", path);
+    return 1;
+  }
+
+  uint64_t first_digest = 0;
+  for (int run = 0; run < runs; run++) {
+    // outputs are only printed once, timing stats come from the last run
+    Replay replay(header, print_outputs && run == 0);
+    StageStats stats[STAGE_COUNT];
+    for (int i = 0; i < STAGE_COUNT; i++) {
+      stats[i].ns.reserve(records.size());
+    }
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < records.size(); i++) {
+      if (speed > 0) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)(records[i].time_us / speed)));
+      }
+      replay.process(records[i], stats);
+    }
+    double wall_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (run == 0) {
+      first_digest = replay.digest;
+    } else if (replay.digest != first_digest) {
+      fprintf(stderr, "run %d digest %016llx differs from %016llx\n", run, (unsigned long long)replay.digest, (unsigned long long)first_digest);
+      return 1;
+    }
+    if (run == runs - 1) {
+      fprintf(print_outputs ? stderr : stdout, "%u CRSF frames, %u VESC packets, %d run(s), digest %016llx\n",
+              replay.crsf_frames, replay.vesc_packets, runs, (unsigned long long)replay.digest);
+      if (!print_outputs) {
+        report(stats, wall_s, records);
+      }
+    }
+  }
+  return 0;
+}
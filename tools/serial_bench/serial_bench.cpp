@@ -0,0 +1,318 @@
+// Throughput of the SerialChannel/SerialMux receive path of arduino/FPV_RC_Car, with pseudo
+// terminals standing in for the CRSF and VESC UARTs.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -pthread -I. ../../tools/serial_bench/serial_bench.cpp
+//            SerialChannel.cpp SerialMux.cpp CRSFProtocol.cpp VescCodec.cpp -o serial_bench
+// Run:     ./serial_bench [--seconds S] [--crsf-hz HZ] [--vesc-hz HZ] [--loop-us US] [--per-byte]
+//
+// A device thread writes RC channel frames and VESC packets into the master side of each pty,
+// an "interrupt" thread reads the slave sides byte by byte into the channel rings and drains the
+// CRSF transmit ring, and the main thread plays loop(): SerialMux::poll() into the CRSF and VESC
+// parsers, a GPS telemetry frame per received RC frame, then --loop-us of other work.
+// --per-byte reads the rings with rxAvailable()/rxRead() and one timestamp per pass like the
+// Stream based code did, for comparison.
+//
+// The rings are sized for the car, so a --loop-us longer than the ring holds at the chosen
+// rates shows up as overruns. On a single core the threads share the CPU and the consumer cost
+// includes some scheduling noise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "SerialChannel.h"
+#include "SerialMux.h"
+#include "CRSFProtocol.h"
+#include "VescCodec.h"
+
+#define VESC_PAYLOAD_LENGTH 60 // about a COMM_GET_VALUES reply
+
+static const auto start_time = std::chrono::steady_clock::now();
+
+static uint32_t micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+struct Port {
+  int master;
+  int slave;
+  SerialChannel channel;
+  uint64_t sent_frames;
+  uint64_t sent_bytes;
+  uint64_t echoed_bytes;
+};
+
+static bool openPort(Port *port) {
+  port->master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (port->master < 0 || grantpt(port->master) != 0 || unlockpt(port->master) != 0) {
+    return false;
+  }
+  port->slave = open(ptsname(port->master), O_RDWR | O_NOCTTY);
+  if (port->slave < 0) {
+    return false;
+  }
+  struct termios tio;
+  tcgetattr(port->slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(port->slave, TCSANOW, &tio);
+  port->sent_frames = 0;
+  port->sent_bytes = 0;
+  port->echoed_bytes = 0;
+  return true;
+}
+
+static bool writeAll(int fd, const uint8_t *data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+static uint8_t buildCrsfFrame(uint8_t *buffer, uint32_t sequence) {
+  uint8_t payload[22];
+  for (uint8_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)(sequence * 31 + i * 7);
+  }
+  return crsfBuildFrame(buffer, CRSF_FRAMETYPE_RC_CHANNELS_PACKED, payload, sizeof(payload));
+}
+
+static uint8_t buildVescPacket(uint8_t *buffer, uint32_t sequence) {
+  buffer[0] = 0x02;
+  buffer[1] = VESC_PAYLOAD_LENGTH;
+  buffer[2] = COMM_GET_VALUES;
+  for (uint8_t i = 1; i < VESC_PAYLOAD_LENGTH; i++) {
+    buffer[2 + i] = (uint8_t)(sequence * 13 + i);
+  }
+  uint16_t crc = vescCrc16(buffer + 2, VESC_PAYLOAD_LENGTH);
+  buffer[2 + VESC_PAYLOAD_LENGTH] = crc >> 8;
+  buffer[3 + VESC_PAYLOAD_LENGTH] = crc & 0xFF;
+  buffer[4 + VESC_PAYLOAD_LENGTH] = 0x03;
+  return VESC_PAYLOAD_LENGTH + 5;
+}
+
+static Port crsf;
+static Port vesc;
+static std::atomic<bool> running(true);
+static std::atomic<bool> sending(true);
+
+// Sends frames at the given rates, interleaved on one thread like two devices on a shared clock
+static void deviceThread(double crsf_hz, double vesc_hz, double seconds) {
+  uint8_t buffer[128];
+  auto begin = std::chrono::steady_clock::now();
+  auto end = begin + std::chrono::duration<double>(seconds);
+  double crsf_next = 0;
+  double vesc_next = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    bool wrote = false;
+    if (now >= crsf_next) {
+      uint8_t length = buildCrsfFrame(buffer, crsf.sent_frames);
+      writeAll(crsf.master, buffer, length);
+      crsf.sent_frames++;
+      crsf.sent_bytes += length;
+      crsf_next += 1.0 / crsf_hz;
+      wrote = true;
+    }
+    if (now >= vesc_next) {
+      uint8_t length = buildVescPacket(buffer, vesc.sent_frames);
+      writeAll(vesc.master, buffer, length);
+      vesc.sent_frames++;
+      vesc.sent_bytes += length;
+      vesc_next += 1.0 / vesc_hz;
+      wrote = true;
+    }
+    if (!wrote) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  sending = false;
+}
+
+// Reads telemetry the car sent back on the CRSF port
+static void echoThread() {
+  uint8_t buffer[256];
+  while (running) {
+    struct pollfd fd = {crsf.master, POLLIN, 0};
+    if (poll(&fd, 1, 10) > 0) {
+      ssize_t length = read(crsf.master, buffer, sizeof(buffer));
+      if (length > 0) {
+        crsf.echoed_bytes += length;
+      }
+    }
+  }
+}
+
+// Plays the SERCOM interrupts, a byte per rxPut() with the time it was read
+static void interruptThread() {
+  Port *ports[2] = {&crsf, &vesc};
+  uint8_t buffer[64];
+  while (running) {
+    struct pollfd fds[2] = {{crsf.slave, POLLIN, 0}, {vesc.slave, POLLIN, 0}};
+    poll(fds, 2, 1);
+    for (int i = 0; i < 2; i++) {
+      if (fds[i].revents & POLLIN) {
+        ssize_t length = read(ports[i]->slave, buffer, sizeof(buffer));
+        for (ssize_t j = 0; j < length; j++) {
+          ports[i]->channel.rxPut(buffer[j], micros());
+        }
+      }
+    }
+    uint8_t byte;
+    uint16_t count = 0;
+    while (count < sizeof(buffer) && crsf.channel.txTake(&byte)) {
+      buffer[count++] = byte;
+    }
+    if (count > 0) {
+      writeAll(crsf.slave, buffer, count);
+    }
+  }
+}
+
+static CRSFFrameParser crsf_parser;
+static VescPacketParser vesc_parser;
+static uint64_t crsf_frames = 0;
+static uint64_t vesc_packets = 0;
+static uint64_t telemetry_refused = 0;
+
+static void feedCrsf(uint8_t byte, uint32_t now_us) {
+  if (crsf_parser.feed(byte, now_us)) {
+    crsf_frames++;
+    crsfGpsFrame_t gps = {};
+    gps.groundSpeed = (uint16_t)crsf_frames;
+    uint8_t buffer[CRSF_FRAME_SIZE_MAX];
+    if (!crsf.channel.txWrite(buffer, crsfBuildGpsFrame(buffer, &gps))) {
+      telemetry_refused++;
+    }
+  }
+}
+
+static void feedVesc(uint8_t byte) {
+  if (vesc_parser.feed(byte)) {
+    vesc_packets++;
+  }
+}
+
+static void receiveCrsf(const uint8_t *data, uint16_t length, uint32_t now_us) {
+  for (uint16_t i = 0; i < length; i++) {
+    feedCrsf(data[i], now_us);
+  }
+}
+
+static void receiveVesc(const uint8_t *data, uint16_t length, uint32_t now_us) {
+  (void)now_us;
+  for (uint16_t i = 0; i < length; i++) {
+    feedVesc(data[i]);
+  }
+}
+
+// The available()/read() loop of the Stream based code, one timestamp per pass
+static uint32_t pollPerByte() {
+  uint32_t count = 0;
+  uint32_t now_us = micros();
+  while (crsf.channel.rxAvailable() > 0) {
+    feedCrsf(crsf.channel.rxRead(), now_us);
+    count++;
+  }
+  while (vesc.channel.rxAvailable() > 0) {
+    feedVesc(vesc.channel.rxRead());
+    count++;
+  }
+  return count;
+}
+
+static void printPort(const char *name, Port *port, uint64_t parsed, uint32_t crc_errors) {
+  printf("%-5s %8llu %10llu %10llu %8u %8u %8u %6u\n", name, (unsigned long long)port->sent_frames, (unsigned long long)parsed,
+         (unsigned long long)port->channel.rx_bytes, (unsigned)crc_errors, (unsigned)port->channel.rx_overruns,
+         (unsigned)port->channel.rx_high_water, (unsigned)port->channel.tx_high_water);
+}
+
+int main(int argc, char **argv) {
+  double seconds = 5;
+  double crsf_hz = 500;
+  double vesc_hz = 100;
+  uint32_t loop_us = 1000;
+  bool per_byte = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--crsf-hz") && i + 1 < argc) {
+      crsf_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--vesc-hz") && i + 1 < argc) {
+      vesc_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--loop-us") && i + 1 < argc) {
+      loop_us = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--per-byte")) {
+      per_byte = true;
+    } else {
+      fprintf(stderr, "usage: %s [--seconds S] [--crsf-hz HZ] [--vesc-hz HZ] [--loop-us US] [--per-byte]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (crsf_hz <= 0 || vesc_hz <= 0) {
+    fprintf(stderr, "rates have to be above 0\n");
+    return 1;
+  }
+  if (!openPort(&crsf) || !openPort(&vesc)) {
+    perror("pty");
+    return 1;
+  }
+
+  SerialMux mux;
+  mux.attach(&crsf.channel, receiveCrsf);
+  mux.attach(&vesc.channel, receiveVesc);
+
+  std::thread interrupts(interruptThread);
+  std::thread echo(echoThread);
+  std::thread device(deviceThread, crsf_hz, vesc_hz, seconds);
+
+  double busy_ns = 0;
+  uint64_t dispatched = 0;
+  uint64_t polls = 0;
+  auto begin = std::chrono::steady_clock::now();
+  uint32_t idle_polls = 0;
+  // keep polling until the device has stopped and the rings stayed empty for a while
+  while (sending || idle_polls < 100) {
+    auto poll_start = std::chrono::steady_clock::now();
+    uint32_t count = per_byte ? pollPerByte() : mux.poll();
+    auto poll_end = std::chrono::steady_clock::now();
+    polls++;
+    if (count > 0) {
+      busy_ns += std::chrono::duration<double, std::nano>(poll_end - poll_start).count();
+      dispatched += count;
+      idle_polls = 0;
+    } else if (!sending) {
+      idle_polls++;
+    }
+    if (loop_us > 0) {
+      std::this_thread::sleep_until(poll_end + std::chrono::microseconds(loop_us));
+    }
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  running = false;
+  device.join();
+  interrupts.join();
+  echo.join();
+
+  printf("%s, %.1f s, loop %u us, %llu polls\n", per_byte ? "per byte reads" : "SerialMux spans", elapsed, loop_us, (unsigned long long)polls);
+  printf("%-5s %8s %10s %10s %8s %8s %8s %6s\n", "port", "sent", "parsed", "rx bytes", "crc err", "overrun", "rx hw", "tx hw");
+  printPort("crsf", &crsf, crsf_frames, crsf_parser.crc_errors);
+  printPort("vesc", &vesc, vesc_packets, vesc_parser.crc_errors);
+  printf("throughput %.1f kB/s, consumer %.1f ns/byte\n", dispatched / elapsed / 1000.0, dispatched > 0 ? busy_ns / dispatched : 0.0);
+  printf("telemetry %llu bytes sent, %llu bytes received, %llu frames refused\n", (unsigned long long)crsf.channel.tx_bytes,
+         (unsigned long long)crsf.echoed_bytes, (unsigned long long)telemetry_refused);
+  bool lost = crsf_frames != crsf.sent_frames || vesc_packets != vesc.sent_frames;
+  return lost && crsf.channel.rx_overruns == 0 && vesc.channel.rx_overruns == 0 ? 2 : 0;
+}
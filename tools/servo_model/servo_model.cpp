@@ -0,0 +1,179 @@
+// Host model of steering servo quantization and its effect on TURN_ASSIST yaw rate tracking.
+// Compares the old Servo library path (whole degree writes, timer interrupt jitter) with
+// ServoOutput (1/3 us steps straight from TCC0) at a few speeds and servo frame rates.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. -I../../tools/common ../../tools/servo_model/servo_model.cpp -o servo_model
+// Run:     ./servo_model [--jitter US] [--noise DEG_S]
+//
+// --jitter  peak pulse jitter of the Servo library interrupt in us (default 2)
+// --noise   gyro noise in deg/s rms after filtering (default 0.3)
+//
+// The car is tools/common/VehicleModel and the controller a PI on yaw rate at the firmware PID
+// rate. Absolute numbers depend on the model guesses, the comparison between output schemes is
+// the useful part.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "DriveControl.h"
+#include "ServoOutput.h"
+#include "VehicleModel.h"
+
+#define STEERING_MIN_US 1000.0f
+#define STEERING_MAX_US 2000.0f
+#define MAX_STEERING_DEG_S 180.0f
+#define PID_RATE_HZ 50 // turn_rate_pid.setTimeStep(1000 / 50)
+#define PID_P 1.0f / 200.0f
+#define PID_I 1.0f / 40.0f
+#define SIM_RATE_HZ 10000
+#define SIM_SECONDS 20.0f
+
+enum Scheme {
+  SCHEME_SERVO_DEGREES, // Servo::write(int), 1000 us / 180 steps plus interrupt jitter
+  SCHEME_SERVO_US, // Servo::writeMicroseconds(int), 1 us steps plus interrupt jitter
+  SCHEME_TCC, // ServoOutput, 1/3 us steps
+  SCHEME_IDEAL, // unquantized reference
+  SCHEME_COUNT
+};
+
+static const char *SCHEME_NAMES[SCHEME_COUNT] = {"servo deg", "servo us", "tcc", "ideal"};
+
+struct Result {
+  float step_us; // worst case quantization step
+  float rms_quant_us; // rms error between the requested and emitted pulse
+  float rms_track; // rms yaw rate tracking error, deg/s
+  float p2p_wheel; // wheel angle ripple while holding a constant turn, deg
+};
+
+// Deterministic noise so every run prints the same table
+static uint32_t rng_state = 1;
+
+static float uniform() {
+  rng_state = rng_state * 1664525u + 1013904223u;
+  return (float)(rng_state >> 8) / 16777216.0f;
+}
+
+static float gaussian() {
+  float u1 = uniform() + 1e-7f, u2 = uniform();
+  return sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+}
+
+static float emitPulse(Scheme scheme, float pulse_us, float jitter_us) {
+  switch (scheme) {
+    case SCHEME_SERVO_DEGREES: {
+      // steering.write((int)(90. * (command + 1.))) then map() to 1000..2000 us
+      int angle = (int)((pulse_us - STEERING_MIN_US) / (STEERING_MAX_US - STEERING_MIN_US) * 180.0f);
+      int us = (int)(STEERING_MIN_US + (long)angle * (long)(STEERING_MAX_US - STEERING_MIN_US) / 180);
+      return us + (uniform() * 2.0f - 1.0f) * jitter_us;
+    }
+    case SCHEME_SERVO_US:
+      return (int)pulse_us + (uniform() * 2.0f - 1.0f) * jitter_us;
+    case SCHEME_TCC:
+      return floorf(pulse_us * SERVO_OUTPUT_TICKS_PER_US + 0.5f) / SERVO_OUTPUT_TICKS_PER_US;
+    default:
+      return pulse_us;
+  }
+}
+
+static float targetYawRate(float t) {
+  // slow sweep with steps, the last quarter holds a constant turn for the ripple measurement
+  if (t < SIM_SECONDS * 0.25f) {
+    return 60.0f * sinf(0.8f * t);
+  } else if (t < SIM_SECONDS * 0.5f) {
+    return ((int)(t * 0.5f) % 2 ? 1.0f : -1.0f) * 45.0f;
+  } else if (t < SIM_SECONDS * 0.75f) {
+    return 3.0f * t - 45.0f; // slow ramp where small steps show up as limit cycling
+  }
+  return 12.0f;
+}
+
+static Result simulate(Scheme scheme, float speed_kmh, int frame_hz, float jitter_us, float noise) {
+  rng_state = 1;
+  Result result = {};
+  float dt = 1.0f / SIM_RATE_HZ;
+  float speed = speed_kmh / 3.6f;
+  VehicleModel car((VehicleParams()));
+  float yaw_rate = 0, integral = 0, command = 0, pulse = 0;
+  float wheel_min = 1e9f, wheel_max = -1e9f;
+  double track_sq = 0, quant_sq = 0;
+  long track_n = 0, quant_n = 0;
+  int pid_div = SIM_RATE_HZ / PID_RATE_HZ, frame_div = SIM_RATE_HZ / frame_hz;
+
+  for (long i = 0; i < (long)(SIM_SECONDS * SIM_RATE_HZ); i++) {
+    float t = i * dt;
+    float target = targetYawRate(t);
+    if (i % pid_div == 0) {
+      float error = target - (yaw_rate + gaussian() * noise);
+      integral += error * PID_I * (1.0f / PID_RATE_HZ);
+      integral = integral < -1 ? -1 : (integral > 1 ? 1 : integral);
+      command = clampCommand(error * PID_P + integral);
+    }
+    // the servo only sees a new width at the start of its frame
+    if (i % frame_div == 0) {
+      float requested = steeringToPulseUs(command, 0, STEERING_MIN_US, STEERING_MAX_US);
+      pulse = emitPulse(scheme, requested, jitter_us);
+      quant_sq += (pulse - requested) * (pulse - requested);
+      quant_n++;
+    }
+    float center = (STEERING_MIN_US + STEERING_MAX_US) / 2;
+    yaw_rate = car.step((pulse - center) / (STEERING_MAX_US - center), speed, dt);
+    float wheel = car.getWheelAngle();
+
+    // only the ramp and hold count, on the steps the transient swamps the quantization
+    if (t > SIM_SECONDS * 0.5f + 0.5f) {
+      track_sq += (target - yaw_rate) * (target - yaw_rate);
+      track_n++;
+    }
+    if (t > SIM_SECONDS * 0.85f) {
+      wheel_min = wheel < wheel_min ? wheel : wheel_min;
+      wheel_max = wheel > wheel_max ? wheel : wheel_max;
+    }
+  }
+
+  switch (scheme) {
+    case SCHEME_SERVO_DEGREES: result.step_us = (STEERING_MAX_US - STEERING_MIN_US) / 180.0f; break;
+    case SCHEME_SERVO_US: result.step_us = 1.0f; break;
+    case SCHEME_TCC: result.step_us = 1.0f / SERVO_OUTPUT_TICKS_PER_US; break;
+    default: result.step_us = 0; break;
+  }
+  result.rms_quant_us = sqrtf(quant_sq / quant_n);
+  result.rms_track = sqrtf(track_sq / track_n);
+  result.p2p_wheel = wheel_max - wheel_min;
+  return result;
+}
+
+int main(int argc, char **argv) {
+  float jitter_us = 2.0f;
+  float noise = 0.3f;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+      jitter_us = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+      noise = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: servo_model [--jitter US] [--noise DEG_S]\n");
+      return 2;
+    }
+  }
+
+  const float speeds[] = {5, 10, 20};
+  const int frame_rates[] = {SERVO_OUTPUT_MIN_HZ, 200, SERVO_OUTPUT_MAX_HZ};
+  printf("%-10s %6s %5s %8s %10s %12s %12s\n", "output", "km/h", "Hz", "step us", "rms q us", "rms err dps", "ripple deg");
+  for (unsigned s = 0; s < sizeof(speeds) / sizeof(float); s++) {
+    for (unsigned f = 0; f < sizeof(frame_rates) / sizeof(int); f++) {
+      for (int scheme = 0; scheme < SCHEME_COUNT; scheme++) {
+        // the Servo library runs at its fixed 50 Hz
+        if (scheme <= SCHEME_SERVO_US && frame_rates[f] != SERVO_OUTPUT_MIN_HZ) {
+          continue;
+        }
+        Result r = simulate((Scheme)scheme, speeds[s], frame_rates[f], jitter_us, noise);
+        printf("%-10s %6.0f %5d %8.2f %10.2f %12.3f %12.3f\n", SCHEME_NAMES[scheme], speeds[s], frame_rates[f], r.step_us,
+               r.rms_quant_us, r.rms_track, r.p2p_wheel);
+      }
+    }
+  }
+  return 0;
+}
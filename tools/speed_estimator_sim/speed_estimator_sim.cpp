@@ -0,0 +1,229 @@
+// Accuracy and per-update cost of the SpeedEstimator Kalman filter on simulated drives, against
+// the speed the firmware used before it: the last VESC ERPM, held until the next reply.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. ../../tools/speed_estimator_sim/speed_estimator_sim.cpp SpeedEstimator.cpp
+//            -o speed_estimator_sim
+// Run:     ./speed_estimator_sim [--accel-noise MPS2] [--erpm-noise ERPM] [--offset MPS2] [--seed N] [--updates N]
+//
+// The car follows each profile exactly, integrated at 10 kHz. The accelerometer is sampled at
+// the gyro ODR with white noise of --accel-noise m/s^2, an offset of --offset m/s^2 and gravity
+// along the car on slopes. The VESC is asked for values every VESC_VALUES_INTERVAL ms, samples
+// its ERPM once the request has crossed the wire and the reply arrives after it crossed back,
+// the ERPM is rounded and gets white noise of --erpm-noise. The control code reads the speed
+// at every IMU sample, the errors are taken there against the true speed: "erpm" is the held
+// reply, "kalman" the estimator with replies at the time the VESC sampled them, as the sketch
+// feeds it, and "late" the estimator fed the arrival time instead. The acceleration error is
+// the estimator's against the true acceleration, mostly the accelerometer noise it passes on.
+// The update cost is the mean over --updates predicts, in nanoseconds and, on x86, TSC cycles.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "SpeedEstimator.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define MOTOR_POLES 2.0
+#define DRIVE_RATIO 10.83
+#define WHEEL_CIRCUMFERENCE 0.3676
+#define KMH_TO_MOTOR_ERPM ((DRIVE_RATIO * MOTOR_POLES * 16.66667) / WHEEL_CIRCUMFERENCE)
+#define GYRO_SAMPLE_RATE 416.0
+#define VESC_BAUDRATE 115200
+#define VESC_VALUES_INTERVAL 10
+#define SPEED_ACCEL_NOISE 0.5
+#define SPEED_BIAS_DRIFT 0.5
+#define SPEED_ERPM_NOISE 0.05
+#define SPEED_ERPM_DELAY_US 1000
+#define SPEED_STALE_MS 50
+
+#define SIM_RATE_HZ 10000
+#define GRAVITY 9.80665
+#define REQUEST_BYTES 10 // COMM_GET_VALUES_SELECTIVE with its framing
+#define REPLY_BYTES 26 // the four selected fields
+#define VESC_TURNAROUND_US 300
+
+struct Segment {
+  double seconds;
+  double accel; // m/s^2
+  double grade; // rise over run
+};
+
+struct Profile {
+  const char *name;
+  Segment segments[8];
+};
+
+static const Profile PROFILES[] = {
+  {"launch", {{1.0, 0, 0}, {1.4, 6.0, 0}, {1.5, 0, 0}, {1.1, -7.5, 0}, {1.0, 0, 0}}},
+  {"stop-go", {{0.5, 0, 0}, {1.0, 3.0, 0}, {0.75, -4.0, 0}, {0.5, 0, 0}, {1.0, 3.0, 0}, {0.75, -4.0, 0}, {0.5, 0, 0}}},
+  {"reverse", {{0.5, 0, 0}, {1.0, 2.0, 0}, {2.0, -2.0, 0}, {1.0, 0, 0}, {1.0, 2.0, 0}, {0.5, 0, 0}}},
+  {"slope", {{1.0, 2.0, 0}, {1.0, 0, 0}, {2.0, 0, 0.15}, {1.0, -0.5, 0.15}, {2.0, 0.5, -0.15}, {1.0, -1.5, 0}, {1.0, 0, 0}}},
+};
+
+struct Errors {
+  double rms;
+  double max;
+  double accel_rms;
+};
+
+struct Stats {
+  double squared = 0, max = 0, accel_squared = 0;
+  long count = 0;
+
+  void add(double error, double accel_error) {
+    squared += error * error;
+    max = fmax(max, fabs(error));
+    accel_squared += accel_error * accel_error;
+    count++;
+  }
+
+  Errors result() {
+    Errors errors = {sqrt(squared / count), max, sqrt(accel_squared / count)};
+    return errors;
+  }
+};
+
+struct Reply {
+  uint32_t sampled_us;
+  uint32_t arrives_us;
+  float speed;
+};
+
+static void simulate(const Profile &profile, double accel_noise, double erpm_noise, double offset, std::mt19937 &rng, Errors *erpm,
+                     Errors *aligned, Errors *late) {
+  SpeedEstimator kalman(SPEED_ACCEL_NOISE, SPEED_BIAS_DRIFT, SPEED_ERPM_NOISE, SPEED_STALE_MS * 1000);
+  SpeedEstimator unaligned(SPEED_ACCEL_NOISE, SPEED_BIAS_DRIFT, SPEED_ERPM_NOISE, SPEED_STALE_MS * 1000);
+  std::normal_distribution<double> accel_error(0, accel_noise);
+  std::normal_distribution<double> erpm_error(0, erpm_noise);
+  double byte_us = 10e6 / VESC_BAUDRATE;
+  Stats erpm_stats, aligned_stats, late_stats;
+
+  double speed = 0, held = 0, t = 0, next_sample = 0, next_request = 0;
+  bool outstanding = false;
+  Reply reply = {};
+  for (const Segment &segment : profile.segments) {
+    for (double end = t + segment.seconds; t < end; t += 1.0 / SIM_RATE_HZ) {
+      double accel = segment.accel;
+      speed += accel / SIM_RATE_HZ;
+      uint32_t now_us = (uint32_t)(t * 1e6);
+      if (!outstanding && t >= next_request) {
+        next_request += VESC_VALUES_INTERVAL / 1000.0;
+        outstanding = true;
+        reply.sampled_us = now_us + (uint32_t)(REQUEST_BYTES * byte_us);
+        reply.arrives_us = reply.sampled_us + (uint32_t)(VESC_TURNAROUND_US + REPLY_BYTES * byte_us);
+        double erpm = round(speed * 3.6 * KMH_TO_MOTOR_ERPM + erpm_error(rng));
+        reply.speed = erpm / KMH_TO_MOTOR_ERPM / 3.6;
+      }
+      if (outstanding && now_us >= reply.arrives_us) {
+        outstanding = false;
+        held = reply.speed;
+        // the sketch stamps the reply with the request time plus SPEED_ERPM_DELAY_US
+        kalman.correct(reply.speed, reply.sampled_us - (uint32_t)(REQUEST_BYTES * byte_us) + SPEED_ERPM_DELAY_US);
+        unaligned.correct(reply.speed, now_us);
+      }
+      if (t >= next_sample) {
+        next_sample += 1.0 / GYRO_SAMPLE_RATE;
+        double measured = accel + GRAVITY * segment.grade / sqrt(1 + segment.grade * segment.grade) + offset + accel_error(rng);
+        kalman.predict(measured, now_us);
+        unaligned.predict(measured, now_us);
+        erpm_stats.add(held - speed, 0);
+        aligned_stats.add(kalman.getSpeed() - speed, kalman.getAcceleration() - accel);
+        late_stats.add(unaligned.getSpeed() - speed, unaligned.getAcceleration() - accel);
+      }
+    }
+  }
+  *erpm = erpm_stats.result();
+  *aligned = aligned_stats.result();
+  *late = late_stats.result();
+}
+
+struct UpdateCost {
+  double ns;
+  double cycles; // 0 without a TSC
+};
+
+// Batches of calls between two clock reads, a correct comes every VESC_VALUES_INTERVAL of
+// predicts as in the sketch and its cost is what the predicts alone don't explain
+static UpdateCost batchCost(long updates, bool with_correct) {
+  SpeedEstimator estimator(SPEED_ACCEL_NOISE, SPEED_BIAS_DRIFT, SPEED_ERPM_NOISE, SPEED_STALE_MS * 1000);
+  int per_correct = (int)(GYRO_SAMPLE_RATE * VESC_VALUES_INTERVAL / 1000.0);
+  uint32_t now_us = 0;
+  volatile float sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  #ifdef HAVE_TSC
+  uint64_t tsc_start = __rdtsc();
+  #endif
+  for (long i = 0; i < updates; i++) {
+    now_us += 2404;
+    estimator.predict((float)((i & 255) - 128) * 0.05f, now_us);
+    if (with_correct && i % per_correct == 0) {
+      estimator.correct(estimator.getSpeed() + 0.01f * (float)((i & 15) - 8), now_us - 3000);
+    }
+    sink = estimator.getSpeed();
+  }
+  UpdateCost cost = {};
+  #ifdef HAVE_TSC
+  cost.cycles = (double)(__rdtsc() - tsc_start);
+  #endif
+  cost.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  (void)sink;
+  return cost;
+}
+
+static void updateCost(long updates, UpdateCost *predict, UpdateCost *correct) {
+  int per_correct = (int)(GYRO_SAMPLE_RATE * VESC_VALUES_INTERVAL / 1000.0);
+  long corrects = (updates + per_correct - 1) / per_correct;
+  UpdateCost alone = batchCost(updates, false);
+  UpdateCost both = batchCost(updates, true);
+  predict->ns = alone.ns / updates;
+  predict->cycles = alone.cycles / updates;
+  correct->ns = (both.ns - alone.ns) / corrects;
+  correct->cycles = (both.cycles - alone.cycles) / corrects;
+}
+
+int main(int argc, char **argv) {
+  double accel_noise = 0.5, erpm_noise = 20, offset = 0.2;
+  uint32_t seed = 1;
+  long updates = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--accel-noise") && i + 1 < argc) {
+      accel_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--erpm-noise") && i + 1 < argc) {
+      erpm_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--offset") && i + 1 < argc) {
+      offset = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--updates") && i + 1 < argc) {
+      updates = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--accel-noise MPS2] [--erpm-noise ERPM] [--offset MPS2] [--seed N] [--updates N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "profile", "erpm rms", "erpm max", "kf rms", "kf max", "kf accel", "late rms",
+         "late max", "late accel");
+  for (const Profile &profile : PROFILES) {
+    Errors erpm, aligned, late;
+    simulate(profile, accel_noise, erpm_noise, offset, rng, &erpm, &aligned, &late);
+    printf("%-8s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", profile.name, erpm.rms, erpm.max, aligned.rms, aligned.max,
+           aligned.accel_rms, late.rms, late.max, late.accel_rms);
+  }
+  printf("speed errors in m/s, acceleration in m/s^2\n\n");
+
+  UpdateCost predict, correct;
+  updateCost(updates, &predict, &correct);
+  printf("%8s %8s %8s\n", "update", "ns", "cycles");
+  printf("%8s %8.1f %8.1f\n", "predict", predict.ns, predict.cycles);
+  printf("%8s %8.1f %8.1f\n", "correct", correct.ns, correct.cycles);
+  return 0;
+}
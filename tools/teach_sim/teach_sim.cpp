@@ -0,0 +1,341 @@
+// Teach and repeat: a lap is taught into TrajectoryLog on a simulated SAMD21 flash, then
+// repeated by TrajectoryFollower through the turn rate loop on the VehicleModel car. Reports the
+// encoding ratio, the longest flash stall of a loop() pass and how closely the repeat follows
+// the taught lap.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. -I../../tools/common ../../tools/teach_sim/teach_sim.cpp
+//            TrajectoryLog.cpp TrajectoryCodec.cpp TrajectoryFollower.cpp PurePursuit.cpp SteeringFeedForward.cpp -o teach_sim
+// Run:     ./teach_sim [--speed KMH] [--interval MS] [--lookahead M] [--weave M]
+//
+// The lap is taught by a PurePursuit driver standing in for the hand on the sticks, --weave
+// adds a slow sideways wander to its path. The flash costs the datasheet maximum for every
+// operation, the CPU is stalled for all of it. The repeat starts from the taught start pose.
+// Cross-track error is against the taught samples.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "DriveControl.h"
+#include "NvmFlash.h"
+#include "PurePursuit.h"
+#include "SteeringFeedForward.h"
+#include "TrajectoryFollower.h"
+#include "TrajectoryLog.h"
+#include "TurnRatePid.h"
+#include "VehicleModel.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define WHEELBASE 0.26f
+#define MAX_STEERING_ANGLE_DEG 25.0f
+#define MAX_STEERING_DEG_S 180.0f
+#define PID_I_TERM (1.0f / 32.0f)
+#define PID_D_TERM (1.0f / 64.0f)
+#define PID_RATE_HZ 50
+#define PID_INTEGRAL_BAND 20.0f
+#define FEED_FORWARD_GAIN 1.0f
+#define PATH_LOOKAHEAD 1.0f
+#define PATH_SPEED_KMH 6.0f
+#define PATH_MAX_LATERAL_ACCEL 4.0f
+#define TEACH_INTERVAL 50
+static const float PID_CONFIG_SPEED[] = {0.0f, 5.0f, 15.0f};
+static const float PID_CONFIG_VALUE[] = {1.0f / 512.0f, 1.0f / 512.0f, 1.0f / 20480.0f};
+
+#define SIM_RATE_HZ 5000
+#define LOOP_US 1000 // loop() pass
+#define POSE_RATE_HZ 100 // VESC telemetry, the odometry rate
+#define SPEED_TAU 0.3f // s, VESC speed loop
+#define TIMEOUT_SECONDS 300.0f
+
+// SAMD21 datasheet maximums
+#define ROW_ERASE_US 6000
+#define PAGE_WRITE_US 2500
+
+static uint8_t flash[NVM_FLASH_END];
+static uint32_t flash_us = 0; // stall of the current loop() pass
+static uint32_t write_errors = 0;
+
+void nvmRead(uint32_t address, void *data, uint32_t length) {
+  memcpy(data, flash + address, length);
+}
+
+void nvmEraseRow(uint32_t address) {
+  memset(flash + address - address % NVM_ROW_SIZE, 0xFF, NVM_ROW_SIZE);
+  flash_us += ROW_ERASE_US;
+}
+
+void nvmWritePage(uint32_t address, const void *data) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (uint32_t i = 0; i < NVM_PAGE_SIZE; i++) {
+    // programming only clears bits, a page written twice without an erase is corrupt
+    if (flash[address + i] != 0xFF) {
+      write_errors++;
+    }
+    flash[address + i] &= bytes[i];
+  }
+  flash_us += PAGE_WRITE_US;
+}
+
+struct Path {
+  const char *name;
+  std::vector<PathPoint> points;
+};
+
+// the AUTONOMOUS_PATH oval of the firmware
+static Path oval() {
+  Path path = {"oval", {}};
+  path.points = {
+    {0.00, 0.00}, {2.00, 0.00}, {4.00, 0.00}, {4.57, 0.11}, {5.06, 0.44}, {5.39, 0.93}, {5.50, 1.50},
+    {5.39, 2.07}, {5.06, 2.56}, {4.57, 2.89}, {4.00, 3.00}, {2.00, 3.00}, {0.00, 3.00}, {-0.57, 2.89},
+    {-1.06, 2.56}, {-1.39, 2.07}, {-1.50, 1.50}, {-1.39, 0.93}, {-1.06, 0.44}, {-0.57, 0.11},
+  };
+  return path;
+}
+
+// 2 m loops left then right, the path crosses itself at the start
+static Path figureEight() {
+  Path path = {"figure8", {}};
+  for (int i = 0; i < 24; i++) {
+    float a = i * 2.0f * (float)M_PI / 24;
+    path.points.push_back({2.0f * sinf(a), 2.0f - 2.0f * cosf(a)});
+  }
+  for (int i = 0; i < 24; i++) {
+    float a = i * 2.0f * (float)M_PI / 24;
+    path.points.push_back({2.0f * sinf(a), -2.0f + 2.0f * cosf(a)});
+  }
+  return path;
+}
+
+// Sideways wander of the teaching driver, a few slow sines so the lap isn't the waypoint polygon
+static Path weave(const Path &path, float amplitude) {
+  Path woven = {path.name, {}};
+  for (size_t i = 0; i < path.points.size(); i++) {
+    const PathPoint &a = path.points[i];
+    const PathPoint &b = path.points[(i + 1) % path.points.size()];
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float length = sqrtf(dx * dx + dy * dy);
+    float offset = amplitude * (sinf(i * 0.7f) + 0.5f * sinf(i * 1.9f));
+    woven.points.push_back({a.x - dy / length * offset, a.y + dx / length * offset});
+  }
+  return woven;
+}
+
+static float scheduledP(float speed_kmh) {
+  int n = sizeof(PID_CONFIG_SPEED) / sizeof(float);
+  int i = 0;
+  while (i < n - 1 && PID_CONFIG_SPEED[i + 1] <= speed_kmh) {
+    i++;
+  }
+  return PID_CONFIG_VALUE[i];
+}
+
+// The car and the firmware below the yaw rate and speed targets: TURN_ASSIST PID and
+// feed-forward at 50 Hz, the VESC speed loop
+struct Car {
+  VehicleModel model{VehicleParams()};
+  SteeringFeedForward feed_forward{WHEELBASE, MAX_STEERING_ANGLE_DEG};
+  double x = 0, y = 0, heading = 0; // heading counterclockwise, the yaw rate clockwise
+  float speed = 0, yaw_rate = 0, command = 0;
+  TurnRatePid pid{PID_RATE_HZ, PID_INTEGRAL_BAND};
+
+  void step(long i, float target_yaw_v, float speed_target) {
+    float dt = 1.0f / SIM_RATE_HZ;
+    if (i % (SIM_RATE_HZ / PID_RATE_HZ) == 0) {
+      float pid_out = pid.step(target_yaw_v, yaw_rate, scheduledP(speed * 3.6f), PID_I_TERM, PID_D_TERM, FEED_FORWARD_GAIN);
+      command = clampCommand(pid_out + FEED_FORWARD_GAIN * feed_forward.command(target_yaw_v, speed));
+    }
+    speed += (speed_target - speed) * dt / SPEED_TAU;
+    yaw_rate = model.step(command, speed, dt);
+    double mean = (heading - yaw_rate * dt * 0.5) * M_PI / 180.0;
+    x += speed * dt * cos(mean);
+    y += speed * dt * sin(mean);
+    heading -= yaw_rate * dt;
+  }
+
+  float wrappedHeading() {
+    return (float)(remainder(heading, 360.0));
+  }
+};
+
+struct Result {
+  uint32_t samples;
+  uint32_t bytes;
+  float erase_seconds; // standing still before the first sample
+  uint32_t max_stall_us; // longest flash stall of a pass while driving
+  uint8_t queue_high_water;
+  float teach_seconds;
+  float repeat_seconds;
+  float rms_cross_track;
+  float max_cross_track;
+  bool lossless;
+  double read_ns; // read() + update() per taught sample
+};
+
+static Result teachAndRepeat(const Path &path, float speed_kmh, uint16_t interval_ms, float lookahead) {
+  Result result = {};
+  memset(flash, 0x5A, sizeof(flash)); // whatever the last sketch left there
+  write_errors = 0;
+  TrajectoryLog log;
+  std::vector<TrajectorySample> taught;
+
+  // teach: the switch goes up with the car standing at the start
+  log.beginRecording(interval_ms);
+  long passes = 0;
+  while (log.isErasing()) {
+    flash_us = 0;
+    log.service();
+    passes++;
+  }
+  result.erase_seconds = passes * ROW_ERASE_US / 1e6f;
+
+  PurePursuit driver(lookahead, speed_kmh / 3.6f, PATH_MAX_LATERAL_ACCEL);
+  driver.setPath(path.points.data(), path.points.size(), true);
+  Car car;
+  int loop_div = SIM_RATE_HZ * LOOP_US / 1000000;
+  int pose_div = SIM_RATE_HZ / POSE_RATE_HZ;
+  long sample_div = (long)SIM_RATE_HZ * interval_ms / 1000;
+  float target_yaw_v = 0, speed_target = 0;
+  long i = 0;
+  for (; driver.getLaps() < 1 && i < (long)(TIMEOUT_SECONDS * SIM_RATE_HZ); i++) {
+    if (i % pose_div == 0) {
+      driver.update((float)car.x, (float)car.y, car.wrappedHeading(), car.speed);
+      target_yaw_v = -fmaxf(-MAX_STEERING_DEG_S, fminf(MAX_STEERING_DEG_S, driver.getYawRate()));
+      speed_target = driver.getSpeed();
+    }
+    if (i % sample_div == 0) {
+      TrajectorySample sample = {(int32_t)lround(car.x * 1000.0), (int32_t)lround(car.y * 1000.0), (int16_t)lroundf(car.wrappedHeading() * 100.0f),
+                                 (int16_t)lroundf(car.speed * 100.0f), (int16_t)lroundf(car.command * 1000.0f)};
+      if (log.record(sample)) {
+        taught.push_back(sample);
+      }
+    }
+    if (i % loop_div == 0) {
+      flash_us = 0;
+      log.service();
+      result.max_stall_us = flash_us > result.max_stall_us ? flash_us : result.max_stall_us;
+    }
+    car.step(i, target_yaw_v, speed_target);
+  }
+  result.teach_seconds = i / (float)SIM_RATE_HZ;
+  log.finishRecording();
+  while (log.isBusy()) {
+    flash_us = 0;
+    log.service();
+    result.max_stall_us = flash_us > result.max_stall_us ? flash_us : result.max_stall_us;
+  }
+  result.samples = log.getSampleCount();
+  result.bytes = log.getByteCount();
+  result.queue_high_water = log.queue_high_water;
+  if (write_errors > 0 || !log.openPlayback()) {
+    fprintf(stderr, "%s: the lap didn't make it to flash\n", path.name);
+    return result;
+  }
+
+  // the stream decodes to exactly what was taught
+  result.lossless = log.getSampleCount() == taught.size();
+  TrajectorySample sample;
+  for (size_t n = 0; log.read(&sample); n++) {
+    result.lossless = result.lossless && n < taught.size() && !memcmp(&sample, &taught[n], sizeof(sample));
+  }
+
+  // repeat from the start pose
+  log.openPlayback();
+  TrajectoryFollower follower(lookahead);
+  car = Car();
+  double square_sum = 0;
+  uint32_t count = 0;
+  bool driving = true;
+  target_yaw_v = 0;
+  speed_target = 0;
+  for (i = 0; driving && i < (long)(TIMEOUT_SECONDS * SIM_RATE_HZ); i++) {
+    if (i % pose_div == 0) {
+      while (follower.wantsSample()) {
+        if (log.read(&sample)) {
+          follower.push(sample);
+        } else {
+          follower.finish();
+        }
+      }
+      driving = follower.update((float)car.x, (float)car.y, car.wrappedHeading(), car.speed);
+      target_yaw_v = -fmaxf(-MAX_STEERING_DEG_S, fminf(MAX_STEERING_DEG_S, follower.getYawRate()));
+      speed_target = follower.getSpeed();
+      float error = follower.getCrossTrack();
+      square_sum += error * error;
+      count++;
+      result.max_cross_track = fmaxf(result.max_cross_track, fabsf(error));
+    }
+    car.step(i, target_yaw_v, speed_target);
+  }
+  result.repeat_seconds = i / (float)SIM_RATE_HZ;
+  result.rms_cross_track = count > 0 ? sqrtf(square_sum / count) : 0;
+
+  // host cost of streaming the lap: decode plus a follower update per sample
+  auto start = std::chrono::steady_clock::now();
+  uint32_t updates = 0;
+  while (updates < 1000000) {
+    log.openPlayback();
+    follower.reset();
+    size_t n = 0;
+    while (true) {
+      while (follower.wantsSample()) {
+        if (log.read(&sample)) {
+          follower.push(sample);
+        } else {
+          follower.finish();
+        }
+      }
+      if (n >= taught.size()) {
+        break;
+      }
+      const TrajectorySample &pose = taught[n++];
+      follower.update(pose.x * 0.001f, pose.y * 0.001f, pose.heading * 0.01f, pose.speed * 0.01f);
+      updates++;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  // openPlayback() CRC passes are included, one per lap
+  result.read_ns = std::chrono::duration<double, std::nano>(end - start).count() / updates;
+  return result;
+}
+
+int main(int argc, char **argv) {
+  float speed_kmh = PATH_SPEED_KMH;
+  int interval_ms = TEACH_INTERVAL;
+  float lookahead = PATH_LOOKAHEAD;
+  float wander = 0.3f;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      speed_kmh = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+      interval_ms = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--lookahead") && i + 1 < argc) {
+      lookahead = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--weave") && i + 1 < argc) {
+      wander = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--speed KMH] [--interval MS] [--lookahead M] [--weave M]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (speed_kmh <= 0 || interval_ms <= 0 || interval_ms % 5 != 0 || lookahead <= 0) {
+    fprintf(stderr, "speed and lookahead must be above 0, the interval a multiple of 5 ms\n");
+    return 1;
+  }
+
+  printf("taught at %.1f km/h, a sample every %d ms, lookahead %.2f m, %.2f m weave\n", speed_kmh, interval_ms, lookahead, wander);
+  printf("%-8s %7s %7s %6s %9s %9s %6s %8s %8s %8s %8s %8s\n", "path", "samples", "B/smpl", "ratio", "erase s", "stall ms", "queue",
+         "teach s", "repeat s", "rms xte", "max xte", "read ns");
+  const Path paths[] = {oval(), figureEight()};
+  for (const Path &path : paths) {
+    Result r = teachAndRepeat(weave(path, wander), speed_kmh, interval_ms, lookahead);
+    printf("%-8s %7u %7.2f %5.1fx %9.2f %9.1f %6u %8.2f %8.2f %8.3f %8.3f %8.1f%s\n", path.name, r.samples, (float)r.bytes / r.samples,
+           TRAJECTORY_SAMPLE_RAW_BYTES * (float)r.samples / r.bytes, r.erase_seconds, r.max_stall_us / 1000.0f, r.queue_high_water,
+           r.teach_seconds, r.repeat_seconds, r.rms_cross_track, r.max_cross_track, r.read_ns, r.lossless ? "" : "  NOT LOSSLESS");
+  }
+  printf("ratio is against %d byte raw samples; stall is the longest flash stall of a loop() pass after the erase,\n", TRAJECTORY_SAMPLE_RAW_BYTES);
+  printf("erasing a row as the recording reaches it would stall %.1f ms\n", (ROW_ERASE_US + PAGE_WRITE_US) / 1000.0f);
+  return 0;
+}
@@ -0,0 +1,124 @@
+// Step response of TURN_ASSIST with and without the bicycle model feed-forward.
+// The PID is TurnRatePid, the sketch's AutoPID with its integral clamp and band, with the
+// firmware gain schedule, I/D terms and 50 Hz step.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. -I../../tools/common
+//            ../../tools/turn_assist_sim/turn_assist_sim.cpp SteeringFeedForward.cpp -o turn_assist_sim
+// Run:     ./turn_assist_sim
+//
+// "mismatch" runs the feed-forward against a car with a 15% longer wheelbase and 10% less
+// steering lock than the firmware assumes, the integral has to make up the difference. "pid"
+// is the firmware with FF Gain at 0, the integral band is off then and the integral alone
+// holds the step.
+
+#include <stdio.h>
+#include <math.h>
+
+#include "DriveControl.h"
+#include "SteeringFeedForward.h"
+#include "TurnRatePid.h"
+#include "VehicleModel.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define WHEELBASE 0.26f
+#define MAX_STEERING_ANGLE_DEG 25.0f
+#define PID_I_TERM (1.0f / 32.0f)
+#define PID_D_TERM (1.0f / 64.0f)
+#define PID_RATE_HZ 50
+#define PID_INTEGRAL_BAND 20.0f
+#define FEED_FORWARD_GAIN 1.0f
+static const float PID_CONFIG_SPEED[] = {0.0f, 5.0f, 15.0f};
+static const float PID_CONFIG_VALUE[] = {1.0f / 512.0f, 1.0f / 512.0f, 1.0f / 20480.0f};
+
+#define SIM_RATE_HZ 5000
+#define SIM_SECONDS 3.0f
+#define STEP_YAW_RATE 90.0f // deg/s, reduced where the car can't reach it
+#define SETTLE_BAND 0.05f
+
+enum Controller {
+  CONTROLLER_PID,
+  CONTROLLER_FF_PID,
+  CONTROLLER_FF_PID_MISMATCH,
+  CONTROLLER_COUNT
+};
+
+static const char *CONTROLLER_NAMES[CONTROLLER_COUNT] = {"pid", "ff+pid", "mismatch"};
+
+struct StepResult {
+  float target;
+  float rise_ms; // 10% to 90%
+  float overshoot; // percent of target
+  float settle_ms; // last entry into the +-5% band
+  float final_error; // deg/s
+};
+
+static float scheduledP(float speed_kmh) {
+  int n = sizeof(PID_CONFIG_SPEED) / sizeof(float);
+  int i = 0;
+  while (i < n - 1 && PID_CONFIG_SPEED[i + 1] <= speed_kmh) {
+    i++;
+  }
+  return PID_CONFIG_VALUE[i];
+}
+
+static StepResult stepResponse(Controller controller, float speed_kmh) {
+  VehicleParams params;
+  if (controller == CONTROLLER_FF_PID_MISMATCH) {
+    params.wheelbase *= 1.15f;
+    params.max_wheel_angle_deg *= 0.9f;
+  }
+  VehicleModel car(params);
+  SteeringFeedForward feed_forward(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+
+  float speed = speed_kmh / 3.6f;
+  // same target for every controller, taken from the nominal car
+  float max_yaw_rate = speed / WHEELBASE * tanf(MAX_STEERING_ANGLE_DEG * 0.017453293f) * 57.29578f;
+  StepResult result = {};
+  result.target = fminf(STEP_YAW_RATE, 0.6f * max_yaw_rate);
+
+  float dt = 1.0f / SIM_RATE_HZ;
+  int pid_div = SIM_RATE_HZ / PID_RATE_HZ;
+  TurnRatePid pid(PID_RATE_HZ, PID_INTEGRAL_BAND);
+  float ff_gain = controller == CONTROLLER_PID ? 0 : FEED_FORWARD_GAIN;
+  float command = 0, peak = 0;
+  float t10 = -1, t90 = -1, settle = 0;
+  float yaw_rate = 0;
+  for (long i = 0; i < (long)(SIM_SECONDS * SIM_RATE_HZ); i++) {
+    float t = i * dt;
+    if (i % pid_div == 0) {
+      float pid_out = pid.step(result.target, yaw_rate, scheduledP(speed_kmh), PID_I_TERM, PID_D_TERM, ff_gain);
+      command = clampCommand(ff_gain * feed_forward.command(result.target, speed) + pid_out);
+    }
+    yaw_rate = car.step(command, speed, dt);
+
+    if (t10 < 0 && yaw_rate >= 0.1f * result.target) {
+      t10 = t;
+    }
+    if (t90 < 0 && yaw_rate >= 0.9f * result.target) {
+      t90 = t;
+    }
+    peak = fmaxf(peak, yaw_rate);
+    if (fabsf(yaw_rate - result.target) > SETTLE_BAND * result.target) {
+      settle = t + dt;
+    }
+  }
+  result.rise_ms = t10 >= 0 && t90 >= 0 ? (t90 - t10) * 1000.0f : NAN;
+  result.overshoot = fmaxf(0, peak - result.target) / result.target * 100.0f;
+  result.settle_ms = settle < SIM_SECONDS ? settle * 1000.0f : NAN;
+  result.final_error = result.target - yaw_rate;
+  return result;
+}
+
+int main() {
+  const float speeds[] = {3, 5, 10, 20};
+  printf("%-9s %6s %10s %9s %10s %10s %11s\n", "control", "km/h", "step dps", "rise ms", "overshoot", "settle ms", "final err");
+  for (unsigned s = 0; s < sizeof(speeds) / sizeof(float); s++) {
+    for (int c = 0; c < CONTROLLER_COUNT; c++) {
+      StepResult r = stepResponse((Controller)c, speeds[s]);
+      // nan means the response never got there within SIM_SECONDS
+      printf("%-9s %6.0f %10.1f %9.0f %9.1f%% %10.0f %11.2f\n", CONTROLLER_NAMES[c], speeds[s], r.target, r.rise_ms,
+             r.overshoot, r.settle_ms, r.final_error);
+    }
+  }
+  return 0;
+}
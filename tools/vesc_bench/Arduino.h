@@ -0,0 +1,29 @@
+// Just enough of the Arduino core to build VescLink on the host for vesc_bench. Time is virtual,
+// vesc_bench.cpp defines millis() and micros().
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+uint32_t millis();
+uint32_t micros();
+
+class HardwareSerial {
+  public:
+    virtual ~HardwareSerial() {}
+    virtual void begin(unsigned long baud) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t write(uint8_t byte) = 0;
+    size_t write(const uint8_t *buffer, size_t size) {
+      for (size_t i = 0; i < size; i++) {
+        write(buffer[i]);
+      }
+      return size;
+    }
+};
+
+#endif // ARDUINO_H
@@ -0,0 +1,306 @@
+// Bytes on the VESC wire and CPU per packet of VescLink against the VescUart usage it replaced,
+// on a virtual clock with a simulated VESC at the far end of a 115200 baud link.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I../../tools/vesc_bench -I. ../../tools/vesc_bench/vesc_bench.cpp
+//            VescLink.cpp VescCodec.cpp -o vesc_bench
+// Run:     ./vesc_bench [--seconds S] [--loop-us US] [--repeat N]
+//
+// VescUart isn't in this tree, its traffic is reproduced packet for packet: every loop() pass
+// sent COMM_SET_RPM, then COMM_GET_VALUES and waited for the full reply (73 byte payload on
+// firmware 5.x). VescLink runs unchanged. loop() spends --loop-us on everything else and the
+// throttle setpoint comes from a 150 Hz RC link, held still for the first half of the run and
+// swept for the second half. CPU time per packet is the encode, parse and decode work measured
+// on the host.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+#include <deque>
+
+#include "Arduino.h"
+#include "VescCodec.h"
+#include "VescLink.h"
+
+#define VESC_BAUDRATE 115200
+#define BYTE_US (10.0 * 1000000.0 / VESC_BAUDRATE)
+#define VESC_TURNAROUND_US 60 // VESC firmware time from request to first reply byte
+#define FULL_VALUES_LENGTH 73
+#define RC_FRAME_US 6667 // 150 Hz
+#define DRIVE_MAX_ERPM 20000
+
+static double now_us = 0;
+
+uint32_t millis() {
+  return (uint32_t)(now_us / 1000.0);
+}
+
+uint32_t micros() {
+  return (uint32_t)now_us;
+}
+
+// The VESC end of the link. Requests are answered once they have been fully sent, replies
+// arrive at the wire rate.
+class MockVesc : public HardwareSerial {
+  public:
+    using HardwareSerial::write;
+
+    void begin(unsigned long baud) {
+      (void)baud;
+    }
+
+    int available() {
+      int count = 0;
+      for (const Byte &byte : rx) {
+        if (byte.time_us > now_us) {
+          break;
+        }
+        count++;
+      }
+      return count;
+    }
+
+    int read() {
+      if (rx.empty() || rx.front().time_us > now_us) {
+        return -1;
+      }
+      uint8_t value = rx.front().value;
+      rx.pop_front();
+      return value;
+    }
+
+    size_t write(uint8_t byte) {
+      tx_free_us = fmax(tx_free_us, now_us) + BYTE_US;
+      tx_bytes++;
+      if (parser.feed(byte)) {
+        if (parser.payload[0] == COMM_SET_RPM) {
+          setpoints++;
+        }
+        reply(tx_free_us + VESC_TURNAROUND_US);
+      }
+      return 1;
+    }
+
+    // Time the next queued reply byte arrives
+    double nextArrival() {
+      return rx.empty() ? now_us : rx.front().time_us;
+    }
+
+    uint32_t tx_bytes = 0;
+    uint32_t rx_bytes = 0;
+    uint32_t setpoints = 0;
+
+  private:
+    struct Byte {
+      double time_us;
+      uint8_t value;
+    };
+
+    void reply(double start_us) {
+      uint8_t payload[VESC_PAYLOAD_SIZE_MAX];
+      uint8_t length;
+      if (parser.payload[0] == COMM_GET_VALUES) {
+        length = FULL_VALUES_LENGTH;
+        memset(payload, 0x11, length);
+        payload[0] = COMM_GET_VALUES;
+      } else if (parser.payload[0] == COMM_GET_VALUES_SELECTIVE) {
+        // the reply echoes the mask, then the selected fields in mask order
+        memcpy(payload, parser.payload, 5);
+        length = 5;
+        uint32_t mask = ((uint32_t)parser.payload[1] << 24) | ((uint32_t)parser.payload[2] << 16) | ((uint32_t)parser.payload[3] << 8) | parser.payload[4];
+        static const uint8_t sizes[] = {2, 2, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, 4};
+        for (uint8_t bit = 0; bit < sizeof(sizes); bit++) {
+          if (mask & (1UL << bit)) {
+            memset(payload + length, 0x11, sizes[bit]);
+            length += sizes[bit];
+          }
+        }
+      } else {
+        return;
+      }
+      uint8_t packet[VESC_PAYLOAD_SIZE_MAX + VESC_PACKET_OVERHEAD];
+      uint16_t crc = vescCrc16(payload, length);
+      packet[0] = 2;
+      packet[1] = length;
+      memcpy(packet + 2, payload, length);
+      packet[2 + length] = crc >> 8;
+      packet[3 + length] = crc & 0xFF;
+      packet[4 + length] = 3;
+      for (uint8_t i = 0; i < length + VESC_PACKET_OVERHEAD; i++) {
+        rx.push_back({start_us + (i + 1) * BYTE_US, packet[i]});
+        rx_bytes++;
+      }
+    }
+
+    VescPacketParser parser;
+    std::deque<Byte> rx;
+    double tx_free_us = 0;
+};
+
+// Throttle setpoint of the RC link at time t, quantized like CRSF channel values
+static int32_t throttleErpm(double t_us, double seconds) {
+  double t = t_us / 1000000.0;
+  double frame = floor(t_us / RC_FRAME_US) * RC_FRAME_US / 1000000.0;
+  double stick = t < seconds / 2 ? 0.4 : 0.4 + 0.4 * sin(frame * 2.0 * M_PI * 0.5);
+  return (int32_t)(round(stick * 1639.0) / 1639.0 * DRIVE_MAX_ERPM);
+}
+
+struct Result {
+  double seconds;
+  uint32_t passes;
+  uint32_t telemetry;
+  uint32_t tx_bytes;
+  uint32_t rx_bytes;
+  uint32_t setpoints;
+};
+
+static void printResult(const char *name, const Result &r) {
+  printf("%-10s %9.0f %9.0f %9.0f %9.0f %9.0f %9.0f\n", name, r.passes / r.seconds, r.telemetry / r.seconds, r.setpoints / r.seconds,
+         r.tx_bytes / r.seconds, r.rx_bytes / r.seconds, (r.tx_bytes + r.rx_bytes) / r.seconds);
+}
+
+static Result runVescUart(double seconds, uint32_t loop_us) {
+  MockVesc vesc;
+  VescPacketParser parser;
+  vescValues_t values;
+  Result result = {};
+  now_us = 0;
+  while (now_us < seconds * 1000000.0) {
+    uint8_t packet[16];
+    // esc.setRPM() in executeCommands()
+    uint8_t length = vescBuildSetRpm(packet, throttleErpm(now_us, seconds));
+    vesc.write(packet, length);
+    // esc.getVescValues() in handleEscTelemetry(), blocks until the reply is in
+    length = vescBuildGetValues(packet);
+    vesc.write(packet, length);
+    bool received = false;
+    while (!received) {
+      now_us = fmax(now_us, vesc.nextArrival());
+      int byte;
+      while (!received && (byte = vesc.read()) >= 0) {
+        received = parser.feed((uint8_t)byte) && vescDecodeValues(parser.payload, parser.length, &values);
+      }
+    }
+    result.telemetry++;
+    result.passes++;
+    now_us += loop_us;
+  }
+  result.seconds = now_us / 1000000.0;
+  result.tx_bytes = vesc.tx_bytes;
+  result.rx_bytes = vesc.rx_bytes;
+  result.setpoints = vesc.setpoints;
+  return result;
+}
+
+static Result runVescLink(double seconds, uint32_t loop_us, uint16_t interval_ms) {
+  MockVesc vesc;
+  VescLink esc(VESC_FIELD_AVG_INPUT_CURRENT | VESC_FIELD_RPM | VESC_FIELD_INPUT_VOLTAGE, interval_ms, 100);
+  esc.begin(&vesc, VESC_BAUDRATE);
+  Result result = {};
+  now_us = 0;
+  while (now_us < seconds * 1000000.0) {
+    // serial_mux.poll()
+    uint8_t span[64];
+    uint16_t length = 0;
+    int byte;
+    while (length < sizeof(span) && (byte = vesc.read()) >= 0) {
+      span[length++] = (uint8_t)byte;
+    }
+    esc.receive(span, length, micros());
+    if (esc.takeValues()) {
+      result.telemetry++;
+    }
+    esc.setRpm(throttleErpm(now_us, seconds));
+    esc.update();
+    result.passes++;
+    now_us += loop_us;
+  }
+  result.seconds = now_us / 1000000.0;
+  result.tx_bytes = vesc.tx_bytes;
+  result.rx_bytes = vesc.rx_bytes;
+  result.setpoints = vesc.setpoints;
+  return result;
+}
+
+static volatile uint32_t sink;
+
+// Host ns per telemetry round trip plus setpoint: building both packets and parsing and decoding
+// the reply
+static double cpuNs(bool selective, int repeat) {
+  uint8_t reply[VESC_PAYLOAD_SIZE_MAX + VESC_PACKET_OVERHEAD];
+  uint8_t payload[VESC_PAYLOAD_SIZE_MAX];
+  uint8_t length;
+  if (selective) {
+    uint8_t request[16];
+    vescBuildGetValuesSelective(request, VESC_FIELD_AVG_INPUT_CURRENT | VESC_FIELD_RPM | VESC_FIELD_INPUT_VOLTAGE);
+    memcpy(payload, request + 2, 5);
+    memset(payload + 5, 0x11, 10);
+    length = 15;
+  } else {
+    payload[0] = COMM_GET_VALUES;
+    memset(payload + 1, 0x11, FULL_VALUES_LENGTH - 1);
+    length = FULL_VALUES_LENGTH;
+  }
+  uint16_t crc = vescCrc16(payload, length);
+  reply[0] = 2;
+  reply[1] = length;
+  memcpy(reply + 2, payload, length);
+  reply[2 + length] = crc >> 8;
+  reply[3 + length] = crc & 0xFF;
+  reply[4 + length] = 3;
+
+  VescPacketParser parser;
+  vescValues_t values = {};
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeat; r++) {
+    uint8_t packet[32];
+    uint8_t sent = vescBuildSetRpm(packet, r);
+    sent += selective ? vescBuildGetValuesSelective(packet + sent, VESC_FIELD_AVG_INPUT_CURRENT | VESC_FIELD_RPM | VESC_FIELD_INPUT_VOLTAGE)
+                      : vescBuildGetValues(packet + sent);
+    for (uint8_t i = 0; i < length + VESC_PACKET_OVERHEAD; i++) {
+      if (parser.feed(reply[i])) {
+        uint32_t mask;
+        if (selective) {
+          vescDecodeValuesSelective(parser.payload, parser.length, &values, &mask);
+        } else {
+          vescDecodeValues(parser.payload, parser.length, &values);
+        }
+      }
+    }
+    sink = packet[sent - 3] + (uint32_t)values.rpm;
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / repeat;
+}
+
+int main(int argc, char **argv) {
+  double seconds = 10;
+  uint32_t loop_us = 500;
+  int repeat = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--loop-us") && i + 1 < argc) {
+      loop_us = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--seconds S] [--loop-us US] [--repeat N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%.0f s at 115200 baud, loop() work %u us, per second:\n", seconds, loop_us);
+  printf("%-10s %9s %9s %9s %9s %9s %9s\n", "", "passes", "telemetry", "setpoints", "tx bytes", "rx bytes", "wire");
+  printResult("VescUart", runVescUart(seconds, loop_us));
+  printResult("VescLink", runVescLink(seconds, loop_us, 10));
+  printResult("VescLink/7", runVescLink(seconds, loop_us, 7));
+  printf("VescLink/7 requests telemetry at the rate VescUart got it\n\n");
+
+  printf("host CPU per setpoint + telemetry round trip\n");
+  printf("%-10s %9.1f ns\n", "full", cpuNs(false, repeat));
+  printf("%-10s %9.1f ns\n", "selective", cpuNs(true, repeat));
+  return 0;
+}
@@ -0,0 +1,279 @@
+// The two yaw rate controllers the sketch can build with on the VehicleModel car: the AutoPID
+// gain schedule with the feed-forward, as TURN_ASSIST runs it by default, and YawRateLqr with
+// the generated gain table, as it runs with YAW_CONTROL_LQR. Step response and tracking of a
+// weaving target for each, and the cost of one controller tick on the host.
+//
+// Build:   cd arduino/FPV_RC_Car && g++ -std=c++11 -O2 -I. -I../../tools/common
+//            ../../tools/yaw_control_bench/yaw_control_bench.cpp YawRateLqr.cpp SteeringFeedForward.cpp -o yaw_control_bench
+// Run:     ./yaw_control_bench [--noise DPS] [--seed N] [--ticks N]
+//
+// The gyro is sampled at its ODR through the firmware low-pass with white noise of --noise
+// deg/s added. The PID is AutoPID as loop() runs it, see TurnRatePid.h, at 50 Hz, the LQR runs
+// on every gyro sample. Either command reaches the servo at its frame rate. Rise is 10% to 90% of the
+// target, settle the last entry into the +-5% band, nan if it never settled. The tracking
+// target is a sine of 40% of the yaw rate the car can reach at the speed, the error is the
+// RMS after the first period. Each car runs with the gains of the nominal one: the nominal
+// car, one with a 15% longer wheelbase and 10% less lock, and one with a servo twice as slow.
+// The tick cost is the mean over --ticks calls with changing inputs, in nanoseconds and, on
+// x86, TSC cycles; per second it is that at each controller's rate. The sketch's target has
+// no FPU, there the float work of a tick costs far more than here, the ratio is what carries.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "BiquadFilter.h"
+#include "DriveControl.h"
+#include "SteeringFeedForward.h"
+#include "TurnRatePid.h"
+#include "VehicleModel.h"
+#include "YawLqrGains.h"
+#include "YawRateLqr.h"
+
+// firmware defaults, see FPV_RC_Car.ino
+#define WHEELBASE 0.26f
+#define MAX_STEERING_ANGLE_DEG 25.0f
+#define PID_I_TERM (1.0f / 32.0f)
+#define PID_D_TERM (1.0f / 64.0f)
+#define PID_RATE_HZ 50
+#define PID_INTEGRAL_BAND 20.0f
+#define FEED_FORWARD_GAIN 1.0f
+#define GYRO_SAMPLE_RATE 416.0f
+#define GYRO_LOWPASS_HZ 40.0f
+#define STEERING_FRAME_HZ 50
+#define YAW_LQR_SERVO_TAU 0.03f
+#define YAW_LQR_SERVO_SLEW 400.0f
+#define YAW_LQR_YAW_TAU 0.08f
+#define YAW_LQR_INTEGRAL_LIMIT 20.0f
+static const float PID_CONFIG_SPEED[] = {0.0f, 5.0f, 15.0f};
+static const float PID_CONFIG_VALUE[] = {1.0f / 512.0f, 1.0f / 512.0f, 1.0f / 20480.0f};
+#define BUCKETS (sizeof(PID_CONFIG_SPEED) / sizeof(float))
+
+#define SIM_RATE_HZ 5000
+#define STEP_SECONDS 3.0f
+#define STEP_YAW_RATE 90.0f // deg/s, reduced where the car can't reach it
+#define SETTLE_BAND 0.05f
+#define TRACK_SECONDS 6.0f
+#define TRACK_HZ 1.0f
+#define TRACK_SHARE 0.4f
+
+enum Controller { CONTROLLER_PID, CONTROLLER_LQR, CONTROLLER_COUNT };
+
+static const char *CONTROLLER_NAMES[CONTROLLER_COUNT] = {"pid", "lqr"};
+
+struct Car {
+  const char *name;
+  float wheelbase_scale;
+  float lock_scale;
+  float servo_tau_scale;
+};
+
+static const Car CARS[] = {
+  {"nominal", 1.0f, 1.0f, 1.0f},
+  {"mismatch", 1.15f, 0.9f, 1.0f},
+  {"slow servo", 1.0f, 1.0f, 2.0f},
+};
+
+static const float STEP_SPEEDS[] = {3.0f, 5.0f, 10.0f, 20.0f};
+static const float TRACK_SPEEDS[] = {5.0f, 10.0f};
+
+struct Response {
+  float target;
+  float rise_ms;
+  float overshoot; // percent of target
+  float settle_ms;
+  float rms; // deg/s, tracking
+};
+
+// The sketch's turn rate PID with its gain schedule
+class SchedulePid {
+  public:
+    float update(float target, float yaw_rate, float speed_kmh) {
+      int bucket = 0;
+      while (bucket < (int)BUCKETS - 1 && PID_CONFIG_SPEED[bucket + 1] <= speed_kmh) {
+        bucket++;
+      }
+      return pid.step(target, yaw_rate, PID_CONFIG_VALUE[bucket], PID_I_TERM, PID_D_TERM, FEED_FORWARD_GAIN);
+    }
+
+  private:
+    TurnRatePid pid = TurnRatePid(PID_RATE_HZ, PID_INTEGRAL_BAND);
+};
+
+static VehicleParams carParams(const Car &car) {
+  VehicleParams params;
+  params.wheelbase *= car.wheelbase_scale;
+  params.max_wheel_angle_deg *= car.lock_scale;
+  params.servo_tau *= car.servo_tau_scale;
+  return params;
+}
+
+static YawRateLqr makeLqr(SteeringFeedForward *feed_forward) {
+  return YawRateLqr(YAW_LQR_GAINS, sizeof(YAW_LQR_GAINS) / sizeof(YawLqrGain), YAW_LQR_SPEED_MIN, YAW_LQR_SPEED_STEP, feed_forward,
+                    MAX_STEERING_ANGLE_DEG, YAW_LQR_SERVO_TAU, YAW_LQR_SERVO_SLEW, YAW_LQR_YAW_TAU, YAW_LQR_INTEGRAL_LIMIT);
+}
+
+static float maxYawRate(float speed_kmh) {
+  return speed_kmh / 3.6f / WHEELBASE * tanf(MAX_STEERING_ANGLE_DEG * 0.017453293f) * 57.29578f;
+}
+
+// target(t) is the yaw rate asked for, tracking selects the metrics
+static Response run(Controller controller, const Car &car, float speed_kmh, bool tracking, float noise, std::mt19937 &rng) {
+  VehicleModel model(carParams(car));
+  SteeringFeedForward feed_forward(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+  SchedulePid pid;
+  YawRateLqr lqr = makeLqr(&feed_forward);
+  FilterChain<float, 1> lowpass;
+  lowpass.setStage(0, biquadLowpass(GYRO_LOWPASS_HZ, GYRO_SAMPLE_RATE));
+  std::normal_distribution<float> gyro_noise(0, noise);
+
+  float speed = speed_kmh / 3.6f;
+  Response result = {};
+  result.target = tracking ? TRACK_SHARE * maxYawRate(speed_kmh) : fminf(STEP_YAW_RATE, 0.6f * maxYawRate(speed_kmh));
+  float seconds = tracking ? TRACK_SECONDS : STEP_SECONDS;
+  float dt = 1.0f / SIM_RATE_HZ;
+  float yaw_rate = 0, yaw_v = 0, command = 0, servo_command = 0, pid_out = 0, peak = 0;
+  float next_sample = 0, next_pid = 0, next_frame = 0;
+  float rise_start = NAN, rise_end = NAN, settle = 0, squared = 0;
+  long tracked = 0;
+  for (long i = 0; i < (long)(seconds * SIM_RATE_HZ); i++) {
+    float t = i * dt;
+    float target = tracking ? result.target * sinf(2 * 3.14159265f * TRACK_HZ * t) : result.target;
+    bool sampled = t >= next_sample;
+    if (sampled) {
+      next_sample += 1.0f / GYRO_SAMPLE_RATE;
+      yaw_v = lowpass.process(yaw_rate + gyro_noise(rng));
+    }
+    if (controller == CONTROLLER_PID) {
+      if (t >= next_pid) {
+        next_pid += 1.0f / PID_RATE_HZ;
+        pid_out = pid.update(target, yaw_v, speed_kmh);
+      }
+      command = clampCommand(FEED_FORWARD_GAIN * feed_forward.command(target, speed) + pid_out);
+    } else if (sampled) {
+      command = lqr.update(target, yaw_v, speed, 1.0f / GYRO_SAMPLE_RATE);
+    }
+    if (t >= next_frame) {
+      next_frame += 1.0f / STEERING_FRAME_HZ;
+      servo_command = command;
+    }
+    yaw_rate = model.step(servo_command, speed, dt);
+
+    if (tracking) {
+      if (t >= 1.0f / TRACK_HZ) {
+        squared += (yaw_rate - target) * (yaw_rate - target);
+        tracked++;
+      }
+      continue;
+    }
+    peak = fmaxf(peak, yaw_rate);
+    if (isnan(rise_start) && yaw_rate >= 0.1f * target) {
+      rise_start = t;
+    }
+    if (isnan(rise_end) && yaw_rate >= 0.9f * target) {
+      rise_end = t;
+    }
+    if (fabsf(yaw_rate - target) > SETTLE_BAND * target) {
+      settle = t + dt;
+    }
+  }
+  if (tracking) {
+    result.rms = sqrtf(squared / tracked);
+  } else {
+    result.rise_ms = (rise_end - rise_start) * 1000.0f;
+    result.overshoot = fmaxf(0, peak - result.target) / result.target * 100.0f;
+    result.settle_ms = settle < STEP_SECONDS ? settle * 1000.0f : NAN;
+  }
+  return result;
+}
+
+struct TickCost {
+  double ns;
+  double cycles; // 0 without a TSC
+};
+
+// One controller tick as the sketch makes it: for the PID the schedule lookup, the AutoPID
+// step and the feed-forward, for the LQR its update
+static TickCost tickCost(Controller controller, long ticks) {
+  SteeringFeedForward feed_forward(WHEELBASE, MAX_STEERING_ANGLE_DEG);
+  SchedulePid pid;
+  YawRateLqr lqr = makeLqr(&feed_forward);
+  volatile float sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  #ifdef HAVE_TSC
+  uint64_t tsc_start = __rdtsc();
+  #endif
+  for (long i = 0; i < ticks; i++) {
+    // inputs that wander over the speeds and rates the car sees
+    float phase = (i & 1023) * (1.0f / 1024.0f);
+    float target = 120.0f * (phase - 0.5f);
+    float yaw_rate = target * 0.9f + (float)(i & 7);
+    float speed = 0.5f + 6.0f * phase;
+    if (controller == CONTROLLER_PID) {
+      sink = clampCommand(FEED_FORWARD_GAIN * feed_forward.command(target, speed) + pid.update(target, yaw_rate, speed * 3.6f));
+    } else {
+      sink = lqr.update(target, yaw_rate, speed, 1.0f / GYRO_SAMPLE_RATE);
+    }
+  }
+  TickCost cost = {};
+  #ifdef HAVE_TSC
+  cost.cycles = (double)(__rdtsc() - tsc_start) / ticks;
+  #endif
+  auto end = std::chrono::steady_clock::now();
+  cost.ns = std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+  (void)sink;
+  return cost;
+}
+
+int main(int argc, char **argv) {
+  float noise = 1.0f;
+  uint32_t seed = 1;
+  long ticks = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+      ticks = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--noise DPS] [--seed N] [--ticks N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  for (const Car &car : CARS) {
+    printf("%s car, step response\n", car.name);
+    printf("%6s %8s %10s %10s %10s %10s %10s %10s\n", "km/h", "target", "pid rise", "pid os", "pid ms", "lqr rise", "lqr os", "lqr ms");
+    for (float speed_kmh : STEP_SPEEDS) {
+      Response pid = run(CONTROLLER_PID, car, speed_kmh, false, noise, rng);
+      Response lqr = run(CONTROLLER_LQR, car, speed_kmh, false, noise, rng);
+      printf("%6.1f %8.1f %10.0f %9.1f%% %10.0f %10.0f %9.1f%% %10.0f\n", speed_kmh, pid.target, pid.rise_ms, pid.overshoot, pid.settle_ms,
+             lqr.rise_ms, lqr.overshoot, lqr.settle_ms);
+    }
+    printf("%s car, tracking a %.1f Hz sine\n", car.name, TRACK_HZ);
+    printf("%6s %8s %10s %10s\n", "km/h", "amp", "pid rms", "lqr rms");
+    for (float speed_kmh : TRACK_SPEEDS) {
+      Response pid = run(CONTROLLER_PID, car, speed_kmh, true, noise, rng);
+      Response lqr = run(CONTROLLER_LQR, car, speed_kmh, true, noise, rng);
+      printf("%6.1f %8.1f %10.2f %10.2f\n", speed_kmh, pid.target, pid.rms, lqr.rms);
+    }
+    printf("\n");
+  }
+
+  printf("%10s %8s %10s %8s %12s\n", "controller", "ns/tick", "cycles", "ticks/s", "us/s");
+  const float rates[CONTROLLER_COUNT] = {PID_RATE_HZ, GYRO_SAMPLE_RATE};
+  for (int c = 0; c < CONTROLLER_COUNT; c++) {
+    TickCost cost = tickCost((Controller)c, ticks);
+    printf("%10s %8.1f %10.1f %8.0f %12.2f\n", CONTROLLER_NAMES[c], cost.ns, cost.cycles, rates[c], cost.ns * rates[c] / 1000.0);
+  }
+  return 0;
+}
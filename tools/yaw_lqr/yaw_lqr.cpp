@@ -0,0 +1,211 @@
+// Solves the discrete LQR of YawRateLqr per speed and prints the gain table the sketch builds
+// with, arduino/FPV_RC_Car/YawLqrGains.h.
+//
+// Build:   g++ -std=c++11 -O2 tools/yaw_lqr/yaw_lqr.cpp -o yaw_lqr
+// Run:     ./yaw_lqr [--wheelbase M] [--servo-tau S] [--delay S] [--yaw-tau S] [--rate HZ] [--speed-min KMH]
+//            [--speed-step KMH] [--speeds N] [--rate-error DPS] [--heading-error DEG] [--wheel DEG]
+//            > arduino/FPV_RC_Car/YawLqrGains.h
+//
+// The model is the one VehicleModel simulates, linearised: wheel angle d (deg) following the
+// command u with the servo lag, yaw rate r (deg/s) following speed / wheelbase * d with the yaw
+// lag, and z the integral of r, the heading error in degrees. --delay is added to the servo lag:
+// the servo only takes a new position every frame and the gyro low-pass holds the yaw rate
+// back, the gains have to leave room for both. The model is discretised exactly at the
+// gyro rate the controller runs at and the Riccati equation is iterated to convergence. The
+// weights are Bryson's rule, each the inverse square of what is acceptable: --rate-error and
+// --heading-error for r and z, --wheel for the wheel angle command. The wheel angle itself is
+// not weighted. Defaults are the sketch's and VehicleModel's, change both together.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define N 3
+#define RICCATI_ITERATIONS_MAX 200000
+#define RICCATI_TOLERANCE 1e-10
+
+typedef double Matrix[N][N];
+typedef double Vector[N];
+
+static void multiply(const Matrix a, const Matrix b, Matrix out) {
+  Matrix result = {};
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      for (int k = 0; k < N; k++) {
+        result[i][j] += a[i][k] * b[k][j];
+      }
+    }
+  }
+  memcpy(out, result, sizeof(Matrix));
+}
+
+static void multiply(const Matrix a, const Vector v, Vector out) {
+  Vector result = {};
+  for (int i = 0; i < N; i++) {
+    for (int k = 0; k < N; k++) {
+      result[i] += a[i][k] * v[k];
+    }
+  }
+  memcpy(out, result, sizeof(Vector));
+}
+
+// Exact zero order hold discretisation by the series of exp(A t), A t is small at the gyro rate
+static void discretise(const Matrix a, const Vector b, double dt, Matrix ad, Vector bd) {
+  Matrix term = {}; // (A dt)^k / k!
+  Matrix integral_term = {}; // A^k dt^(k+1) / (k+1)!
+  memset(ad, 0, sizeof(Matrix));
+  Matrix integral = {};
+  for (int i = 0; i < N; i++) {
+    term[i][i] = 1;
+    integral_term[i][i] = dt;
+  }
+  for (int k = 0; k < 30; k++) {
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) {
+        ad[i][j] += term[i][j];
+        integral[i][j] += integral_term[i][j];
+      }
+    }
+    multiply(term, a, term);
+    multiply(integral_term, a, integral_term);
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) {
+        term[i][j] *= dt / (k + 1);
+        integral_term[i][j] *= dt / (k + 2);
+      }
+    }
+  }
+  multiply(integral, b, bd);
+}
+
+// Returns false if the iteration didn't converge to a stabilising gain
+static bool solveLqr(const Matrix a, const Vector b, const Vector q, double r, Vector k) {
+  Matrix p = {};
+  for (int i = 0; i < N; i++) {
+    p[i][i] = q[i];
+  }
+  for (int iteration = 0; iteration < RICCATI_ITERATIONS_MAX; iteration++) {
+    // K = (R + B'PB)^-1 B'PA, one input so the inverse is a division
+    Vector pb;
+    multiply(p, b, pb);
+    double s = r;
+    for (int i = 0; i < N; i++) {
+      s += b[i] * pb[i];
+    }
+    Matrix pa;
+    multiply(p, a, pa);
+    for (int j = 0; j < N; j++) {
+      k[j] = 0;
+      for (int i = 0; i < N; i++) {
+        k[j] += b[i] * pa[i][j];
+      }
+      k[j] /= s;
+    }
+    // P' = Q + A'P(A - BK)
+    Matrix closed;
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) {
+        closed[i][j] = a[i][j] - b[i] * k[j];
+      }
+    }
+    Matrix next = {};
+    Matrix p_closed;
+    multiply(p, closed, p_closed);
+    double change = 0, size = 0;
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) {
+        for (int m = 0; m < N; m++) {
+          next[i][j] += a[m][i] * p_closed[m][j];
+        }
+        next[i][j] += i == j ? q[i] : 0;
+        change = fmax(change, fabs(next[i][j] - p[i][j]));
+        size = fmax(size, fabs(next[i][j]));
+      }
+    }
+    memcpy(p, next, sizeof(Matrix));
+    if (change <= RICCATI_TOLERANCE * size) {
+      // stable if (A - BK)^(2^20) has gone to nothing
+      for (int square = 0; square < 20; square++) {
+        multiply(closed, closed, closed);
+      }
+      double norm = 0;
+      for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+          norm = fmax(norm, fabs(closed[i][j]));
+        }
+      }
+      return norm < 1e-6;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+  double wheelbase = 0.26, servo_tau = 0.03, delay = 0.03, yaw_tau = 0.08, rate_hz = 416;
+  double speed_min = 1, speed_step = 1;
+  int speeds = 30;
+  double rate_error = 10, heading_error = 5, wheel_limit = 5;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--wheelbase") && i + 1 < argc) {
+      wheelbase = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--servo-tau") && i + 1 < argc) {
+      servo_tau = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--delay") && i + 1 < argc) {
+      delay = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--yaw-tau") && i + 1 < argc) {
+      yaw_tau = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--speed-min") && i + 1 < argc) {
+      speed_min = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--speed-step") && i + 1 < argc) {
+      speed_step = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--speeds") && i + 1 < argc) {
+      speeds = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--rate-error") && i + 1 < argc) {
+      rate_error = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--heading-error") && i + 1 < argc) {
+      heading_error = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--wheel") && i + 1 < argc) {
+      wheel_limit = atof(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--wheelbase M] [--servo-tau S] [--delay S] [--yaw-tau S] [--rate HZ] [--speed-min KMH] [--speed-step KMH] [--speeds N]\n"
+              "          [--rate-error DPS] [--heading-error DEG] [--wheel DEG]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (speed_min <= 0 || speed_step <= 0 || speeds < 1 || speeds > 255 || rate_hz <= 0 || servo_tau + delay <= 0 || yaw_tau <= 0) {
+    fprintf(stderr, "speeds and rate must be above 0, at most 255 speeds\n");
+    return 1;
+  }
+
+  printf("// Generated by tools/yaw_lqr, rerun it instead of editing:\n");
+  printf("//   ./yaw_lqr --wheelbase %g --servo-tau %g --delay %g --yaw-tau %g --rate %g --speed-min %g --speed-step %g --speeds %d\n", wheelbase,
+         servo_tau, delay, yaw_tau, rate_hz, speed_min, speed_step, speeds);
+  printf("//     --rate-error %g --heading-error %g --wheel %g\n\n", rate_error, heading_error, wheel_limit);
+  printf("#ifndef YAW_LQR_GAINS_H\n#define YAW_LQR_GAINS_H\n\n#include \"YawRateLqr.h\"\n\n");
+  printf("#define YAW_LQR_SPEED_MIN %.1ff // km/h of the first row\n", speed_min);
+  printf("#define YAW_LQR_SPEED_STEP %.1ff // km/h between rows\n\n", speed_step);
+  printf("const YawLqrGain YAW_LQR_GAINS[] = {\n");
+  Vector q = {0, 1 / (rate_error * rate_error), 1 / (heading_error * heading_error)};
+  double r = 1 / (wheel_limit * wheel_limit);
+  for (int i = 0; i < speeds; i++) {
+    double speed_kmh = speed_min + i * speed_step;
+    double b = speed_kmh / 3.6 / wheelbase; // deg/s of yaw rate per degree of wheel angle
+    double lag = servo_tau + delay;
+    Matrix a = {{-1 / lag, 0, 0}, {b / yaw_tau, -1 / yaw_tau, 0}, {0, 1, 0}};
+    Vector input = {1 / lag, 0, 0};
+    Matrix ad;
+    Vector bd, k;
+    discretise(a, input, 1 / rate_hz, ad, bd);
+    if (!solveLqr(ad, bd, q, r, k)) {
+      fprintf(stderr, "no stabilising gain at %.1f km/h\n", speed_kmh);
+      return 1;
+    }
+    printf("  {%.6ff, %.6ff, %.6ff}, // %.1f km/h\n", k[0], k[1], k[2], speed_kmh);
+  }
+  printf("};\n\n#endif // YAW_LQR_GAINS_H\n");
+  return 0;
+}